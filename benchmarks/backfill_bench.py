@@ -0,0 +1,116 @@
+"""
+Historical backfill benchmark.
+
+Writes a synthetic log history (a live log plus rotated generations, the
+older ones gzipped, like logrotate's compress/delaycompress) to a temporary
+directory, then loads it with nanomq_bindings.LogBackfill at increasing
+thread counts and reports, for each:
+
+- load: mmap of plain files plus zlib inflate of the .gz ones
+- parse: the event parser over all chunks
+- order: the merge and time sort
+- total throughput in uncompressed GB/s, and the speed-up over one thread
+
+Parsing should scale with cores until memory bandwidth runs out. Inflate
+scales with the number of .gz files, since one file cannot be split.
+
+Usage:
+    python benchmarks/backfill_bench.py [--megabytes 64] [--generations 5] [--max-threads N]
+"""
+
+import argparse
+import gzip
+import os
+import random
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from utils import rotated_logs
+
+try:
+    import nanomq_bindings
+except ImportError:
+    nanomq_bindings = None
+
+DESKTOPS = ['laptop', 'studio', 'workstation', 'mini']
+
+
+def make_generation(megabytes, day, switch_ratio, rng):
+    target = megabytes * 1024 * 1024
+    lines, size, i = [], 0, 0
+    while size < target:
+        stamp = f"[2025-01-{day:02d}T{(i // 3600) % 24:02d}:{(i // 60) % 60:02d}:{i % 60:02d}]"
+        if rng.random() < switch_ratio:
+            line = (f'{stamp} INFO: switch from "{rng.choice(DESKTOPS)}-1234abcd" '
+                    f'to "{rng.choice(DESKTOPS)}-77773e4b" at {i % 1920},{i % 1080}')
+        else:
+            line = f'{stamp} DEBUG1: mouse move {i % 1920},{i % 1080} on secondary screen'
+        lines.append(line)
+        size += len(line) + 1
+        i += 1
+    return ('\n'.join(lines) + '\n').encode()
+
+
+def write_history(directory, megabytes, generations, switch_ratio):
+    """synergy.log, synergy.log.1, synergy.log.2.gz ... synergy.log.N.gz, each `megabytes` uncompressed."""
+    rng = random.Random(1)
+    live = os.path.join(directory, 'synergy.log')
+    for generation in range(generations):
+        data = make_generation(megabytes, generations - generation, switch_ratio, rng)
+        if generation == 0:
+            path = live
+        elif generation == 1:
+            path = f"{live}.1"
+        else:
+            path = f"{live}.{generation}.gz"
+            data = gzip.compress(data, compresslevel=6)
+        with open(path, 'wb') as f:
+            f.write(data)
+    return live
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark parallel backfill over rotated logs.')
+    parser.add_argument('--megabytes', type=int, default=64,
+                        help='Uncompressed size of each log generation (default: 64)')
+    parser.add_argument('--generations', type=int, default=5,
+                        help='Live log plus rotated logs; all but the newest two are gzipped (default: 5)')
+    parser.add_argument('--switch-ratio', type=float, default=0.02,
+                        help='Fraction of lines that are switch events (default: 0.02)')
+    parser.add_argument('--max-threads', type=int, default=os.cpu_count() or 1,
+                        help='Highest thread count to measure (default: all cores)')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='Runs per thread count, best is reported (default: 3)')
+    args = parser.parse_args()
+
+    if nanomq_bindings is None:
+        print("nanomq_bindings not built; nothing to benchmark")
+        return
+
+    with tempfile.TemporaryDirectory() as directory:
+        live = write_history(directory, args.megabytes, args.generations, args.switch_ratio)
+        paths = rotated_logs(live)
+        print(f"History: {len(paths)} files, {args.megabytes * args.generations} MB uncompressed\n")
+        print(f"{'threads':>7} {'load ms':>9} {'parse ms':>9} {'order ms':>9} {'GB/s':>8} {'speed-up':>8} {'events':>9}")
+
+        threads, single = 1, None
+        while threads <= args.max_threads:
+            best, stats = None, None
+            for _ in range(args.repeat):
+                start = time.perf_counter()
+                backfill = nanomq_bindings.LogBackfill(paths, threads=threads)
+                elapsed = time.perf_counter() - start
+                if best is None or elapsed < best:
+                    best, stats = elapsed, backfill.stats()
+            single = single or best
+            print(f"{threads:>7} {stats['load_us'] / 1000:9.1f} {stats['parse_us'] / 1000:9.1f} "
+                  f"{stats['order_us'] / 1000:9.1f} {stats['bytes'] / best / 1e9:8.3f} "
+                  f"{single / best:7.2f}x {stats['records']:>9}")
+            threads *= 2
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,134 @@
+"""
+Native daemon benchmark: synergy-monitord against the Python entry points.
+
+Reports what a desk machine pays for each way of running the same role:
+
+- startup: spawn to exit of `--help`, which covers loading the binary or the
+  interpreter plus every import, median of several runs
+- idle footprint: resident memory and CPU time of a subscriber connected to a
+  local MQTT broker stand-in while no messages arrive
+
+found-him is measured for both the daemon and found-him.py (with the nanomq
+client when the bindings are built, else paho); waldo's startup is measured
+too, since it is what a primary spawns.
+
+Usage:
+    python benchmarks/daemon_bench.py [--daemon build/synergy-monitord] [--runs 10] [--idle 5]
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+
+from mqtt_standin import BrokerStandIn
+
+CLOCK_TICKS = os.sysconf('SC_CLK_TCK')
+
+
+def startup_ms(command, env, runs):
+    """Median wall time from spawn to exit, in milliseconds."""
+    times = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run(command, env=env, cwd=ROOT, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                       check=True)
+        times.append((time.perf_counter() - start) * 1000)
+    return statistics.median(times)
+
+
+def rss_kb(pid):
+    out = subprocess.run(['ps', '-o', 'rss=', '-p', str(pid)], capture_output=True, text=True)
+    return int(out.stdout.strip() or 0)
+
+
+def cpu_seconds(pid):
+    """User plus system CPU time of pid, from /proc (Linux only)."""
+    with open(f'/proc/{pid}/stat') as f:
+        fields = f.read().rsplit(')', 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / CLOCK_TICKS
+
+
+def idle_footprint(command, env, settle, idle):
+    """Resident memory after settling, and CPU ms per second over the idle window."""
+    proc = subprocess.Popen(command, env=env, cwd=ROOT, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        time.sleep(settle)
+        if proc.poll() is not None:
+            raise RuntimeError(f"{command[0]} exited with {proc.returncode}")
+        rss = rss_kb(proc.pid)
+        cpu = None
+        if os.path.exists(f'/proc/{proc.pid}/stat'):
+            before = cpu_seconds(proc.pid)
+            time.sleep(idle)
+            cpu = (cpu_seconds(proc.pid) - before) * 1000 / idle
+        return rss, cpu
+    finally:
+        proc.terminate()
+        proc.wait(10)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare synergy-monitord with waldo.py and found-him.py.')
+    parser.add_argument('--daemon', default=os.path.join(ROOT, 'build', 'synergy-monitord'),
+                        help='Path to the synergy-monitord binary (default: build/synergy-monitord)')
+    parser.add_argument('--runs', type=int, default=10,
+                        help='Startup runs per command (default: 10)')
+    parser.add_argument('--settle', type=float, default=2.0,
+                        help='Seconds to let a subscriber connect before measuring (default: 2)')
+    parser.add_argument('--idle', type=float, default=5.0,
+                        help='Idle measurement window in seconds (default: 5)')
+    args = parser.parse_args()
+
+    daemon = args.daemon if os.access(args.daemon, os.X_OK) else None
+    if daemon is None:
+        print(f"{args.daemon} not found; build it with ./build.sh. Measuring the Python entry points only.\n")
+
+    try:
+        import nanomq_bindings  # noqa: F401
+        client_type = 'nanomq'
+    except ImportError:
+        client_type = 'paho'
+
+    broker = BrokerStandIn()
+    log_dir = tempfile.mkdtemp(prefix='daemon-bench-')
+    env = dict(os.environ, ROLE='secondary', TARGET_DESKTOP='bench', LOG_DIR=log_dir,
+               MQTT_BROKER='127.0.0.1', MQTT_PORT=str(broker.port), MQTT_CLIENT_TYPE=client_type)
+    python = sys.executable
+
+    print(f"Broker stand-in on 127.0.0.1:{broker.port}; Python entry points use the {client_type} client\n")
+    try:
+        print(f"  {'startup (--help)':<36} {'median':>10}")
+        for label, command in [
+            ('synergy-monitord', [daemon, '--help']),
+            ('python3 waldo.py', [python, 'waldo.py', '--help']),
+            ('python3 found-him.py', [python, 'found-him.py', '--help']),
+        ]:
+            if command[0] is None:
+                print(f"  {label:<36} {'not built':>10}")
+                continue
+            print(f"  {label:<36} {startup_ms(command, env, args.runs):>8.1f}ms")
+
+        print(f"\n  {'idle subscriber':<36} {'RSS':>10} {'idle CPU':>14}")
+        for label, command in [
+            ('synergy-monitord found-him', [daemon, 'found-him', 'bench', '--env', os.devnull]),
+            ('python3 found-him.py', [python, 'found-him.py', 'bench', '--client-type', client_type]),
+        ]:
+            if command[0] is None:
+                print(f"  {label:<36} {'not built':>10}")
+                continue
+            rss, cpu = idle_footprint(command, env, args.settle, args.idle)
+            cpu_text = f"{cpu:>9.2f}ms/s" if cpu is not None else f"{'n/a':>14}"
+            print(f"  {label:<36} {rss / 1024:>8.1f}MB {cpu_text}")
+    finally:
+        broker.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,247 @@
+"""
+Local MQTT 3.1.1 broker stand-in for benchmarks.
+
+Implements just enough of the protocol for the NanoMQ client benchmarks:
+CONNECT/CONNACK, PINGREQ/PINGRESP, SUBSCRIBE/SUBACK, UNSUBSCRIBE/UNSUBACK,
+QoS 0/1 PUBLISH with PUBACK, exact-match and '#' topic forwarding, retained
+messages sent after the SUBACK and DISCONNECT. Optionally wraps connections
+in TLS and records the handshake time and session reuse of every connection.
+Setting connack_code to a non-zero return code rejects new connections.
+
+This is a measurement fixture, not a broker: no QoS 2, no persistence.
+"""
+
+import os
+import socket
+import ssl
+import statistics
+import subprocess
+import threading
+import time
+
+CONNACK = b'\x20\x02\x00\x00'
+PINGRESP = b'\xd0\x00'
+
+
+def encode_length(length):
+    """Encode an MQTT variable-length 'remaining length' field."""
+    out = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        if length:
+            byte |= 0x80
+        out.append(byte)
+        if not length:
+            return bytes(out)
+
+
+def read_packet(conn):
+    """Read one MQTT control packet, returning (header byte, body) or None on EOF."""
+    header = conn.recv(1)
+    if not header:
+        return None
+    length, shift = 0, 0
+    while True:
+        b = conn.recv(1)
+        if not b:
+            return None
+        length |= (b[0] & 0x7F) << shift
+        shift += 7
+        if not b[0] & 0x80:
+            break
+    body = b''
+    while len(body) < length:
+        chunk = conn.recv(length - len(body))
+        if not chunk:
+            return None
+        body += chunk
+    return header[0], body
+
+
+def topic_matches(pattern, topic):
+    if pattern == topic or pattern == '#':
+        return True
+    if pattern.endswith('/#'):
+        return topic.startswith(pattern[:-1]) or topic == pattern[:-2]
+    return False
+
+
+def make_certificates(directory):
+    """Create a throwaway CA and a localhost server certificate with openssl."""
+    ca_key = os.path.join(directory, 'ca.key')
+    ca_crt = os.path.join(directory, 'ca.crt')
+    srv_key = os.path.join(directory, 'server.key')
+    srv_csr = os.path.join(directory, 'server.csr')
+    srv_crt = os.path.join(directory, 'server.crt')
+    ext = os.path.join(directory, 'san.ext')
+
+    with open(ext, 'w') as f:
+        f.write('subjectAltName=DNS:localhost,IP:127.0.0.1\n')
+
+    def run(*args):
+        subprocess.run(['openssl', *args], check=True, capture_output=True)
+
+    run('req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-days', '1',
+        '-subj', '/CN=bench-ca', '-keyout', ca_key, '-out', ca_crt)
+    run('req', '-newkey', 'rsa:2048', '-nodes', '-subj', '/CN=localhost',
+        '-keyout', srv_key, '-out', srv_csr)
+    run('x509', '-req', '-in', srv_csr, '-CA', ca_crt, '-CAkey', ca_key,
+        '-CAcreateserial', '-days', '1', '-extfile', ext, '-out', srv_crt)
+    return ca_crt, srv_crt, srv_key
+
+
+class BrokerStandIn:
+    """Threaded MQTT responder; pass cert/key to serve TLS instead of TCP."""
+
+    def __init__(self, cert=None, key=None):
+        self.context = None
+        if cert:
+            self.context = ssl.create_default_context(ssl.Purpose.CLIENT_AUTH)
+            self.context.load_cert_chain(cert, key)
+        self.listener = socket.create_server(('127.0.0.1', 0))
+        self.port = self.listener.getsockname()[1]
+        self.handshakes = []  # (handshake seconds, session_reused)
+        self.connections = []
+        self.subscriptions = {}  # connection -> set of topic filters
+        self.retained = {}  # topic -> PUBLISH body (topic and payload)
+        self.connack_code = 0  # e.g. 5 (not authorized) to reject CONNECTs
+        self.lock = threading.Lock()
+        self.running = True
+        threading.Thread(target=self._accept_loop, daemon=True).start()
+
+    def _accept_loop(self):
+        while self.running:
+            try:
+                raw, _ = self.listener.accept()
+            except OSError:
+                return
+            threading.Thread(target=self._serve, args=(raw,), daemon=True).start()
+
+    def _forward(self, topic, header, body):
+        # Forward at QoS 0: strip the packet id and clear the QoS bits
+        topic_len = int.from_bytes(body[:2], 'big')
+        qos = (header >> 1) & 0x03
+        payload = body[2 + topic_len + (2 if qos else 0):]
+        out_body = body[:2 + topic_len] + payload
+        with self.lock:
+            if header & 0x01:
+                # An empty retained payload clears the topic's retained message
+                if payload:
+                    self.retained[topic] = out_body
+                else:
+                    self.retained.pop(topic, None)
+            targets = [c for c, filters in self.subscriptions.items()
+                       if any(topic_matches(f, topic) for f in filters)]
+        # Live copies never carry the retain flag, as with a real broker
+        packet = bytes([0x30]) + encode_length(len(out_body)) + out_body
+        for conn in targets:
+            try:
+                conn.sendall(packet)
+            except OSError:
+                pass
+
+    def _serve(self, raw):
+        raw.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        conn = raw
+        if self.context:
+            start = time.perf_counter()
+            try:
+                conn = self.context.wrap_socket(raw, server_side=True)
+            except (ssl.SSLError, OSError):
+                raw.close()
+                return
+            elapsed = time.perf_counter() - start
+            with self.lock:
+                self.handshakes.append((elapsed, conn.session_reused))
+        with self.lock:
+            self.connections.append(conn)
+            self.subscriptions[conn] = set()
+        try:
+            while True:
+                packet = read_packet(conn)
+                if packet is None:
+                    break
+                kind, body = packet
+                ptype = kind >> 4
+                if ptype == 1:      # CONNECT
+                    if self.connack_code:
+                        # A broker closes the connection after refusing it
+                        conn.sendall(bytes([0x20, 0x02, 0x00, self.connack_code]))
+                        break
+                    conn.sendall(CONNACK)
+                elif ptype == 12:   # PINGREQ
+                    conn.sendall(PINGRESP)
+                elif ptype in (8, 10):  # SUBSCRIBE / UNSUBSCRIBE
+                    packet_id, pos, filters = body[:2], 2, []
+                    while pos < len(body):
+                        n = int.from_bytes(body[pos:pos + 2], 'big')
+                        filters.append(body[pos + 2:pos + 2 + n].decode())
+                        pos += 2 + n + (1 if ptype == 8 else 0)
+                    with self.lock:
+                        if ptype == 8:
+                            self.subscriptions[conn].update(filters)
+                        else:
+                            self.subscriptions[conn].difference_update(filters)
+                    if ptype == 8:
+                        conn.sendall(bytes([0x90, 2 + len(filters)]) + packet_id + b'\x01' * len(filters))
+                        with self.lock:
+                            held = [b for t, b in self.retained.items()
+                                    if any(topic_matches(f, t) for f in filters)]
+                        for held_body in held:
+                            conn.sendall(bytes([0x31]) + encode_length(len(held_body)) + held_body)
+                    else:
+                        conn.sendall(b'\xb0\x02' + packet_id)
+                elif ptype == 3:    # PUBLISH
+                    topic_len = int.from_bytes(body[:2], 'big')
+                    topic = body[2:2 + topic_len].decode()
+                    if (kind >> 1) & 0x03 == 1:
+                        conn.sendall(b'\x40\x02' + body[2 + topic_len:4 + topic_len])
+                    self._forward(topic, kind, body)
+                elif ptype == 14:   # DISCONNECT
+                    break
+        except (ssl.SSLError, OSError):
+            pass
+        finally:
+            with self.lock:
+                self.subscriptions.pop(conn, None)
+                if conn in self.connections:
+                    self.connections.remove(conn)
+            conn.close()
+
+    def drop_all(self):
+        """Close every live connection, forcing clients to reconnect."""
+        with self.lock:
+            live = list(self.connections)
+        for conn in live:
+            try:
+                conn.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+
+    def take_handshakes(self):
+        with self.lock:
+            taken, self.handshakes = self.handshakes, []
+        return taken
+
+    def close(self):
+        self.running = False
+        self.listener.close()
+        self.drop_all()
+
+
+def percentile(samples, fraction):
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * fraction))]
+
+
+def summarize(label, samples_ms, resumed=None):
+    """Print median/p90 of a list of millisecond samples."""
+    if not samples_ms:
+        print(f"  {label:<34} no samples")
+        return
+    line = (f"  {label:<34} median {statistics.median(samples_ms):8.3f} ms   "
+            f"p90 {percentile(samples_ms, 0.9):8.3f} ms   n={len(samples_ms)}")
+    if resumed is not None:
+        line += f"   resumed {resumed}/{len(samples_ms)}"
+    print(line)
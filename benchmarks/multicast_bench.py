@@ -0,0 +1,131 @@
+"""
+LAN multicast fast path benchmark.
+
+Measures publish() to subscriber callback latency for a stamped switch
+with and without the multicast copy:
+
+- broker: NanoMQTTClient publisher -> local MQTT broker stand-in -> NanoMQTTClient
+- multicast: the same, plus a datagram to the multicast group; the
+  subscriber delivers whichever copy arrives first and drops the other
+
+Both run on loopback in this process (the group is sent and joined on
+127.0.0.1), so the broker row shows the cost of the broker's forwarding
+rather than the network; across a LAN the broker path pays the network
+twice. The multicast row's stats say which copy won and by how much.
+Messages are sent in bursts as in tuning_profile_bench.py. The stand-in is
+a Python broker, so for figures representative of a deployment point
+--broker-port at a real broker on 127.0.0.1.
+
+Usage:
+    python benchmarks/multicast_bench.py [--messages 500] [--broker-port PORT]
+                                         [--group 239.255.77.77] [--port 1886]
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from mqtt_standin import BrokerStandIn, percentile
+
+TOPIC = 'bench/multicast'
+INTERFACE = '127.0.0.1'
+BURST_SIZE = 10
+BURST_GAP_S = 0.0001
+BURST_PAUSE_S = 0.02
+
+
+def measure(publish, messages, latencies):
+    """Send timestamped switches in bursts and wait for the stragglers."""
+    for i in range(messages):
+        publish(json.dumps({'desktop': f'bench-{i}', 't': time.perf_counter_ns()}))
+        time.sleep(BURST_PAUSE_S if (i + 1) % BURST_SIZE == 0 else BURST_GAP_S)
+    deadline = time.time() + 2
+    while len(latencies) < messages and time.time() < deadline:
+        time.sleep(0.01)
+
+
+def on_message_into(latencies):
+    def on_message(topic, payload):
+        latencies.append((time.perf_counter_ns() - json.loads(payload)['t']) / 1000)
+    return on_message
+
+
+def run(nanomq_bindings, port, messages, multicast):
+    """One publisher and one subscriber; multicast is (group, port) or None."""
+    latencies = []
+    label = 'multicast' if multicast else 'broker'
+    subscriber = nanomq_bindings.NanoMQTTClient('127.0.0.1', port)
+    publisher = nanomq_bindings.NanoMQTTClient('127.0.0.1', port)
+    # Seqs are what tell the two copies apart; a new source per run starts them at 1
+    publisher.enable_sequence(f'bench-{label}-{os.getpid()}')
+    subscriber.set_message_callback(on_message_into(latencies))
+    subscriber.connect(f'bench-{label}-sub-{os.getpid()}')
+    subscriber.subscribe(TOPIC, 0)
+    subscriber.start_message_loop()
+    if multicast:
+        subscriber.set_multicast_receive(multicast[0], multicast[1], INTERFACE)
+        publisher.enable_multicast(multicast[0], multicast[1], INTERFACE)
+    publisher.connect(f'bench-{label}-pub-{os.getpid()}')
+    time.sleep(0.2)
+    try:
+        measure(lambda payload: publisher.publish(TOPIC, payload, 0), messages, latencies)
+    finally:
+        subscriber.set_multicast_receive('')
+        subscriber.stop_message_loop()
+        publisher.disconnect()
+        subscriber.disconnect()
+    return latencies, subscriber.multicast_stats()
+
+
+def report(label, latencies, messages):
+    if not latencies:
+        print(f"  {label:<10} {'-':>10} {'-':>10} {0:>6}/{messages}")
+        return
+    print(f"  {label:<10} {percentile(latencies, 0.5):>8.1f}us {percentile(latencies, 0.99):>8.1f}us "
+          f"{len(latencies):>6}/{messages}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare first-arrival latency with and without multicast.')
+    parser.add_argument('--messages', type=int, default=500,
+                        help='Messages per path (default: 500)')
+    parser.add_argument('--broker-port', type=int, default=0,
+                        help='Use a real broker on 127.0.0.1:PORT instead of the stand-in')
+    parser.add_argument('--group', default='239.255.77.77',
+                        help='Multicast group (default: 239.255.77.77)')
+    parser.add_argument('--port', type=int, default=1886,
+                        help='Multicast port (default: 1886)')
+    args = parser.parse_args()
+
+    try:
+        import nanomq_bindings
+    except ImportError as e:
+        print(f"NanoMQ bindings not available ({e}); build with ./build.sh")
+        sys.exit(1)
+
+    broker = None if args.broker_port else BrokerStandIn()
+    port = args.broker_port or broker.port
+    print(f"{'Broker' if args.broker_port else 'Broker stand-in'} on 127.0.0.1:{port}, "
+          f"group {args.group}:{args.port}, {args.messages} messages per path\n")
+    print(f"  {'path':<10} {'median':>10} {'p99':>10} {'received':>13}")
+    try:
+        latencies, _ = run(nanomq_bindings, port, args.messages, None)
+        report('broker', latencies, args.messages)
+        try:
+            latencies, stats = run(nanomq_bindings, port, args.messages, (args.group, args.port))
+        except RuntimeError as e:
+            print(f"  multicast unavailable: {e}")
+            return
+        report('multicast', latencies, args.messages)
+    finally:
+        if broker:
+            broker.close()
+    print(f"\n  multicast stats: {stats}")
+
+
+if __name__ == '__main__':
+    main()
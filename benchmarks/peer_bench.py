@@ -0,0 +1,133 @@
+"""
+Brokerless peer mode benchmark.
+
+Measures publish() to subscriber callback latency for the two transports a
+secondary can use:
+
+- broker: NanoMQTTClient publisher -> local MQTT broker stand-in -> NanoMQTTClient
+- peer: PeerPublisher -> PeerSubscriber over one TCP connection, no broker
+
+Both run on loopback in this process, so the broker row shows the cost of
+the extra hop and the broker's forwarding rather than the network; across a
+LAN the broker path pays the network twice. Messages are sent in bursts as in
+tuning_profile_bench.py. The stand-in is a Python broker, so for figures
+representative of a deployment point --broker-port at a real broker on
+127.0.0.1.
+
+Usage:
+    python benchmarks/peer_bench.py [--messages 500] [--broker-port PORT]
+"""
+
+import argparse
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from mqtt_standin import BrokerStandIn, percentile
+
+TOPIC = 'bench/peer'
+BURST_SIZE = 10
+BURST_GAP_S = 0.0001
+BURST_PAUSE_S = 0.02
+
+
+def measure(publish, messages, latencies):
+    """Send timestamped messages in bursts and wait for the stragglers."""
+    for i in range(messages):
+        publish(str(time.perf_counter_ns()))
+        time.sleep(BURST_PAUSE_S if (i + 1) % BURST_SIZE == 0 else BURST_GAP_S)
+    deadline = time.time() + 2
+    while len(latencies) < messages and time.time() < deadline:
+        time.sleep(0.01)
+
+
+def on_message_into(latencies):
+    def on_message(topic, payload):
+        latencies.append((time.perf_counter_ns() - int(payload)) / 1000)
+    return on_message
+
+
+def run_broker(nanomq_bindings, port, messages):
+    latencies = []
+    subscriber = nanomq_bindings.NanoMQTTClient('127.0.0.1', port)
+    publisher = nanomq_bindings.NanoMQTTClient('127.0.0.1', port)
+    subscriber.set_message_callback(on_message_into(latencies))
+    subscriber.connect(f'bench-peer-sub-{os.getpid()}')
+    subscriber.subscribe(TOPIC, 0)
+    subscriber.start_message_loop()
+    publisher.connect(f'bench-peer-pub-{os.getpid()}')
+    time.sleep(0.2)
+    try:
+        measure(lambda payload: publisher.publish(TOPIC, payload, 0), messages, latencies)
+    finally:
+        subscriber.stop_message_loop()
+        publisher.disconnect()
+        subscriber.disconnect()
+    return latencies, subscriber.receive_stats()
+
+
+def run_peer(nanomq_bindings, messages):
+    latencies = []
+    publisher = nanomq_bindings.PeerPublisher(nanomq_bindings.peer_url('127.0.0.1', 0))
+    publisher.listen()
+    subscriber = nanomq_bindings.PeerSubscriber(nanomq_bindings.peer_url('127.0.0.1', publisher.bound_port()))
+    subscriber.set_message_callback(on_message_into(latencies))
+    subscriber.subscribe(TOPIC, 0)
+    subscriber.start_message_loop()
+    subscriber.connect()
+    deadline = time.time() + 2
+    while not subscriber.is_connected() and time.time() < deadline:
+        time.sleep(0.01)
+    time.sleep(0.2)
+    try:
+        # Distinct payloads: a subscriber drops a repeat of the last one
+        measure(lambda payload: publisher.publish(TOPIC, payload), messages, latencies)
+    finally:
+        subscriber.disconnect()
+        publisher.close()
+    return latencies, subscriber.receive_stats()
+
+
+def report(label, latencies, messages):
+    if not latencies:
+        print(f"  {label:<8} {'-':>10} {'-':>10} {0:>6}/{messages}")
+        return
+    print(f"  {label:<8} {percentile(latencies, 0.5):>8.1f}us {percentile(latencies, 0.99):>8.1f}us "
+          f"{len(latencies):>6}/{messages}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare broker and brokerless peer delivery latency.')
+    parser.add_argument('--messages', type=int, default=500,
+                        help='Messages per transport (default: 500)')
+    parser.add_argument('--broker-port', type=int, default=0,
+                        help='Use a real broker on 127.0.0.1:PORT instead of the stand-in')
+    args = parser.parse_args()
+
+    try:
+        import nanomq_bindings
+    except ImportError as e:
+        print(f"NanoMQ bindings not available ({e}); build with ./build.sh")
+        sys.exit(1)
+
+    broker = None if args.broker_port else BrokerStandIn()
+    port = args.broker_port or broker.port
+    print(f"{'Broker' if args.broker_port else 'Broker stand-in'} on 127.0.0.1:{port}, "
+          f"{args.messages} messages per transport\n")
+    print(f"  {'path':<8} {'median':>10} {'p99':>10} {'received':>13}")
+    try:
+        latencies, _ = run_broker(nanomq_bindings, port, args.messages)
+        report('broker', latencies, args.messages)
+    finally:
+        if broker:
+            broker.close()
+
+    latencies, stats = run_peer(nanomq_bindings, args.messages)
+    report('peer', latencies, args.messages)
+    print(f"\n  peer receive stats: {stats}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,126 @@
+"""
+Switch-line scanner benchmark.
+
+Generates a synthetic Synergy log (mostly DEBUG chatter, a few percent of
+switch lines, plus decoy lines that contain `to "` without being switches)
+and measures throughput in GB/s for:
+
+- legacy regex: the two per-line re.search / re.sub calls waldo.py used
+- python grammar: utils.SWITCH_LINE_RE per line, the fallback without bindings
+- native per line: nanomq_bindings.scan_switch_events called once per line,
+  what waldo.py does when reading stdin
+- native buffer: one scan_switch_events call over the whole buffer
+- native events: one parse_log_events call over the whole buffer, the
+  table-driven parser the log follower uses for each read (switches plus
+  connect/disconnect/clipboard lines)
+
+Every row also reports how many events it found; the legacy regex counts the
+decoys as switches, the grammar-checking rows do not.
+
+Usage:
+    python benchmarks/switch_scanner_bench.py [--megabytes 64] [--switch-ratio 0.02]
+"""
+
+import argparse
+import os
+import random
+import re
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from utils import SWITCH_HASH_SUFFIX_RE, SWITCH_LINE_RE
+
+try:
+    import nanomq_bindings
+except ImportError:
+    nanomq_bindings = None
+
+DESKTOPS = ['laptop', 'studio', 'workstation', 'mini']
+
+
+def make_log(megabytes, switch_ratio, decoy_ratio, seed=1):
+    rng = random.Random(seed)
+    target = megabytes * 1024 * 1024
+    lines, size, i = [], 0, 0
+    while size < target:
+        stamp = f"[2025-01-01T12:{(i // 60) % 60:02d}:{i % 60:02d}]"
+        r = rng.random()
+        if r < switch_ratio:
+            line = (f'{stamp} INFO: switch from "{rng.choice(DESKTOPS)}-1234abcd" '
+                    f'to "{rng.choice(DESKTOPS)}-77773e4b" at {i % 1920},{i % 1080}')
+        elif r < switch_ratio + decoy_ratio:
+            line = f'{stamp} DEBUG: sending clipboard to "{rng.choice(DESKTOPS)}" seq={i}'
+        else:
+            line = f'{stamp} DEBUG1: mouse move {i % 1920},{i % 1080} on secondary screen'
+        lines.append(line)
+        size += len(line) + 1
+        i += 1
+    text = '\n'.join(lines) + '\n'
+    return text, text.encode()
+
+
+def measure(name, nbytes, fn, repeat):
+    best, found = None, 0
+    for _ in range(repeat):
+        start = time.perf_counter()
+        found = fn()
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    print(f"{name:<18} {nbytes / best / 1e9:8.3f} GB/s  {best * 1000:9.1f} ms  {found:>8} events")
+
+
+def legacy_regex(lines):
+    found = 0
+    for line in lines:
+        match = re.search(r'to "([^"]+)"', line)
+        if match:
+            re.sub(r'-[0-9a-f]{8}$', '', match.group(1))
+            found += 1
+    return found
+
+
+def python_grammar(lines):
+    found = 0
+    for line in lines:
+        match = SWITCH_LINE_RE.search(line)
+        if match:
+            SWITCH_HASH_SUFFIX_RE.sub('', match.group(2))
+            found += 1
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark switch-line scanning throughput.')
+    parser.add_argument('--megabytes', type=int, default=64,
+                        help='Size of the synthetic log (default: 64)')
+    parser.add_argument('--switch-ratio', type=float, default=0.02,
+                        help='Fraction of lines that are switch events (default: 0.02)')
+    parser.add_argument('--decoy-ratio', type=float, default=0.03,
+                        help='Fraction of lines containing to "..." that are not switches (default: 0.03)')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='Runs per scenario, best is reported (default: 3)')
+    args = parser.parse_args()
+
+    text, data = make_log(args.megabytes, args.switch_ratio, args.decoy_ratio)
+    lines = text.splitlines(keepends=True)
+    print(f"Synthetic log: {len(data) / 1e6:.1f} MB, {len(lines)} lines\n")
+
+    measure('legacy regex', len(data), lambda: legacy_regex(lines), args.repeat)
+    measure('python grammar', len(data), lambda: python_grammar(lines), args.repeat)
+
+    if nanomq_bindings is None:
+        print("\nnanomq_bindings not built; skipping native scanner rows")
+        return
+
+    scan = nanomq_bindings.scan_switch_events
+    encoded = [line.encode() for line in lines]
+    measure('native per line', len(data), lambda: sum(len(scan(b)) for b in encoded), args.repeat)
+    measure('native buffer', len(data), lambda: len(scan(data)), args.repeat)
+    measure('native events', len(data), lambda: len(nanomq_bindings.parse_log_events(data)), args.repeat)
+    print(f"\nSIMD kernel: {nanomq_bindings.scan_kernel()}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,141 @@
+"""
+TLS reconnect benchmark for the NanoMQ client.
+
+Starts a local TLS broker stand-in (just enough MQTT to answer CONNECT,
+PINGREQ, SUBSCRIBE and QoS 1 PUBLISH), then measures:
+
+- reference: Python ssl client doing full handshakes vs. handshakes that
+  resume the previous TLS session, i.e. the cost resumption saves
+- nanomq cold: a fresh NanoMQTTClient per connect (TLS config parsed and a
+  full handshake every time), what a restarted process pays
+- nanomq reconnect: one NanoMQTTClient whose link is dropped by the broker;
+  the dialer redials with its cached TLS config
+
+For every broker-side connection the stand-in records the handshake time and
+whether the TLS session was resumed, so the report shows what the NNG TLS
+engine actually negotiated rather than what was requested.
+
+Usage:
+    python benchmarks/tls_reconnect_bench.py [--iterations 50]
+"""
+
+import argparse
+import os
+import socket
+import ssl
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from mqtt_standin import CONNACK, BrokerStandIn, make_certificates, summarize
+
+
+def mqtt_connect_packet(client_id):
+    cid = client_id.encode()
+    variable = b'\x00\x04MQTT\x04\x02\x00\x3c'
+    payload = len(cid).to_bytes(2, 'big') + cid
+    body = variable + payload
+    return bytes([0x10, len(body)]) + body
+
+
+def bench_reference(broker, ca_file, iterations):
+    """Python ssl client: full handshakes vs. resumed handshakes."""
+    context = ssl.create_default_context(cafile=ca_file)
+    full, resumed = [], []
+    session = None
+
+    def one(session_to_use):
+        start = time.perf_counter()
+        raw = socket.create_connection(('127.0.0.1', broker.port))
+        raw.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        conn = context.wrap_socket(raw, server_hostname='localhost', session=session_to_use)
+        conn.sendall(mqtt_connect_packet('bench-ref'))
+        ack = conn.recv(4)
+        elapsed = (time.perf_counter() - start) * 1000
+        assert ack == CONNACK
+        new_session, reused = conn.session, conn.session_reused
+        conn.close()
+        return elapsed, new_session, reused
+
+    for _ in range(iterations):
+        elapsed, session, _ = one(None)
+        full.append(elapsed)
+    broker.take_handshakes()
+
+    reused_count = 0
+    for _ in range(iterations):
+        elapsed, session, reused = one(session)
+        resumed.append(elapsed)
+        reused_count += int(reused)
+    broker.take_handshakes()
+
+    print("Reference (Python ssl, connect + CONNACK):")
+    summarize("full handshake", full)
+    summarize("resumed handshake", resumed, reused_count)
+
+
+def bench_nanomq(broker, ca_file, iterations):
+    """NanoMQTTClient cold connects vs. in-process reconnects."""
+    try:
+        import nanomq_bindings
+    except ImportError as e:
+        print(f"NanoMQ: skipped ({e}); build with ./build.sh --with-tls")
+        return
+
+    cold = []
+    for i in range(iterations):
+        start = time.perf_counter()
+        client = nanomq_bindings.NanoMQTTClient('localhost', broker.port)
+        client.configure_tls(ca_file)
+        client.connect(f'bench-cold-{i}')
+        cold.append((time.perf_counter() - start) * 1000)
+        del client
+    cold_resumed = sum(int(r) for _, r in broker.take_handshakes())
+
+    client = nanomq_bindings.NanoMQTTClient('localhost', broker.port)
+    client.configure_tls(ca_file)
+    client.connect('bench-reconnect')
+    broker.take_handshakes()
+
+    reconnect = []
+    for _ in range(iterations):
+        before = client.connection_stats()['connects']
+        broker.drop_all()
+        deadline = time.time() + 10
+        while client.connection_stats()['connects'] == before and time.time() < deadline:
+            time.sleep(0.0005)
+        if client.connection_stats()['connects'] == before:
+            print("  reconnect did not complete within 10s, stopping")
+            break
+        reconnect.append(client.connection_stats()['last_reconnect_us'] / 1000)
+    reconnect_resumed = sum(int(r) for _, r in broker.take_handshakes())
+    del client
+
+    print("NanoMQ (NanoMQTTClient over tls+mqtt-tcp):")
+    summarize("cold connect (new client)", cold, cold_resumed)
+    summarize("reconnect (dialer redial)", reconnect, reconnect_resumed)
+    print("  reconnect time includes the dialer's reconnect backoff")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark TLS full vs. resumed reconnects.')
+    parser.add_argument('--iterations', type=int, default=50,
+                        help='Connections per scenario (default: 50)')
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        ca_file, cert, key = make_certificates(tmp)
+        broker = BrokerStandIn(cert, key)
+        print(f"TLS broker stand-in on 127.0.0.1:{broker.port}, {args.iterations} iterations\n")
+        try:
+            bench_reference(broker, ca_file, args.iterations)
+            print()
+            bench_nanomq(broker, ca_file, args.iterations)
+        finally:
+            broker.close()
+
+
+if __name__ == '__main__':
+    main()
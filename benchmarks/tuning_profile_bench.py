@@ -0,0 +1,130 @@
+"""
+Tuning profile benchmark for the NanoMQ client.
+
+Runs each tuning profile in its own process (NNG thread pools are sized once
+per process) against a local MQTT broker stand-in and reports:
+
+- delivery latency: publish() to subscriber callback, median and p99
+- idle cost: CPU time and context switches of the subscriber process while
+  no messages arrive, which is what a desk machine pays all day
+
+Messages are sent in bursts (back-to-back with a short gap, then a pause), the
+way a pointer sweeping across screens produces them. The busy-poll row is the
+default profile with a 200 us spin budget and also reports spin hits/misses.
+
+Usage:
+    python benchmarks/tuning_profile_bench.py [--messages 500] [--idle 5]
+"""
+
+import argparse
+import json
+import os
+import resource
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from mqtt_standin import BrokerStandIn, percentile
+
+PROFILES = ['default', 'low-latency', 'low-power', 'busy-poll']
+BURST_SIZE = 10
+BURST_GAP_S = 0.0001
+BURST_PAUSE_S = 0.02
+
+
+def run_profile(profile, port, messages, idle_seconds):
+    """Measure one profile; runs inside a child process."""
+    import nanomq_bindings
+
+    if profile == 'busy-poll':
+        tuning = nanomq_bindings.TuningProfile.preset('default')
+        tuning.rx_busy_poll_us = 200
+    else:
+        tuning = nanomq_bindings.TuningProfile.preset(profile)
+    subscriber = nanomq_bindings.NanoMQTTClient('127.0.0.1', port, tuning)
+    publisher = nanomq_bindings.NanoMQTTClient('127.0.0.1', port)
+
+    latencies = []
+
+    def on_message(topic, payload):
+        latencies.append((time.perf_counter_ns() - int(payload)) / 1000)
+
+    subscriber.set_message_callback(on_message)
+    subscriber.connect(f'bench-sub-{os.getpid()}')
+    subscriber.subscribe('bench/tuning', 0)
+    subscriber.start_message_loop()
+    publisher.connect(f'bench-pub-{os.getpid()}')
+    time.sleep(0.2)
+
+    for i in range(messages):
+        publisher.publish('bench/tuning', str(time.perf_counter_ns()), 0)
+        time.sleep(BURST_PAUSE_S if (i + 1) % BURST_SIZE == 0 else BURST_GAP_S)
+    time.sleep(0.5)
+
+    before = resource.getrusage(resource.RUSAGE_SELF)
+    time.sleep(idle_seconds)
+    after = resource.getrusage(resource.RUSAGE_SELF)
+
+    cpu_ms = ((after.ru_utime - before.ru_utime) + (after.ru_stime - before.ru_stime)) * 1000
+    switches = (after.ru_nvcsw - before.ru_nvcsw) + (after.ru_nivcsw - before.ru_nivcsw)
+
+    subscriber.stop_message_loop()
+    return {
+        'profile': profile,
+        'received': len(latencies),
+        'median_us': percentile(latencies, 0.5) if latencies else None,
+        'p99_us': percentile(latencies, 0.99) if latencies else None,
+        'idle_cpu_ms_per_s': cpu_ms / idle_seconds,
+        'idle_switches_per_s': switches / idle_seconds,
+        'tuning': subscriber.tuning_report(),
+        'receive': subscriber.receive_stats(),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare NanoMQ tuning profiles.')
+    parser.add_argument('--messages', type=int, default=500,
+                        help='Messages per profile (default: 500)')
+    parser.add_argument('--idle', type=float, default=5.0,
+                        help='Idle measurement window in seconds (default: 5)')
+    parser.add_argument('--child', help=argparse.SUPPRESS)
+    parser.add_argument('--port', type=int, help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.child:
+        print(json.dumps(run_profile(args.child, args.port, args.messages, args.idle)))
+        return
+
+    try:
+        import nanomq_bindings  # noqa: F401
+    except ImportError as e:
+        print(f"NanoMQ bindings not available ({e}); build with ./build.sh")
+        sys.exit(1)
+
+    broker = BrokerStandIn()
+    print(f"Broker stand-in on 127.0.0.1:{broker.port}, {args.messages} messages, "
+          f"{args.idle:.0f}s idle window\n")
+    print(f"  {'profile':<12} {'median':>10} {'p99':>10} {'idle CPU':>14} {'idle ctx sw':>14}")
+    try:
+        for profile in PROFILES:
+            out = subprocess.run(
+                [sys.executable, __file__, '--child', profile, '--port', str(broker.port),
+                 '--messages', str(args.messages), '--idle', str(args.idle)],
+                capture_output=True, text=True, check=True)
+            result = json.loads(out.stdout.strip().splitlines()[-1])
+            print(f"  {profile:<12} {result['median_us']:>8.1f}us {result['p99_us']:>8.1f}us "
+                  f"{result['idle_cpu_ms_per_s']:>9.2f}ms/s {result['idle_switches_per_s']:>12.1f}/s")
+            for knob, status in sorted(result['tuning'].items()):
+                print(f"      {knob}: {status}")
+            rx = result['receive']
+            if rx['spin_hits'] or rx['spin_misses']:
+                print(f"      spin hits {rx['spin_hits']}, misses {rx['spin_misses']}, "
+                      f"blocking wakeups {rx['blocking_wakeups']}")
+    finally:
+        broker.close()
+
+
+if __name__ == '__main__':
+    main()
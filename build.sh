@@ -5,6 +5,9 @@
 
 set -e  # Exit on any error
 
+# TLS (mqtts://) support requires Mbed TLS; enabled with --with-tls
+ENABLE_TLS=${NANOMQ_ENABLE_TLS:-0}
+
 echo "=== Synergy Screen Monitor - NanoMQ Build Script ==="
 
 # Colors for output
@@ -54,8 +57,8 @@ check_dependencies() {
         echo ""
         echo "Please install the missing dependencies:"
         echo "  macOS: brew install cmake"
-        echo "  Ubuntu/Debian: sudo apt-get install cmake build-essential python3-dev"
-        echo "  CentOS/RHEL: sudo yum install cmake gcc-c++ python3-devel"
+        echo "  Ubuntu/Debian: sudo apt-get install cmake build-essential python3-dev zlib1g-dev"
+        echo "  CentOS/RHEL: sudo yum install cmake gcc-c++ python3-devel zlib-devel"
         exit 1
     fi
     
@@ -88,12 +91,18 @@ build_nanosdk() {
     mkdir -p build
     cd build
     
+    local tls_flag="OFF"
+    if [ "$ENABLE_TLS" = "1" ]; then
+        tls_flag="ON"
+    fi
+    
     # Configure CMake (disable QUIC to avoid problematic dependencies)
     cmake .. \
         -DCMAKE_BUILD_TYPE=Release \
         -DBUILD_SHARED_LIBS=OFF \
         -DNNG_ENABLE_MQTT=ON \
         -DNNG_ENABLE_QUIC=OFF \
+        -DNNG_ENABLE_TLS=$tls_flag \
         -DNNG_TESTS=OFF \
         -DNNG_TOOLS=OFF \
         -DCMAKE_POSITION_INDEPENDENT_CODE=ON
@@ -104,6 +113,15 @@ build_nanosdk() {
     
     cd ..
     print_status "NanoSDK build completed"
+    if [ -x build/synergy-monitord ]; then
+        print_status "Native daemon built: build/synergy-monitord"
+    fi
+    if [ -x build/synergy-current ]; then
+        print_status "State page reader built: build/synergy-current"
+    fi
+    if [ -x build/synergy-events ]; then
+        print_status "Event ring reader built: build/synergy-events"
+    fi
 }
 
 # Install Python build dependencies
@@ -123,7 +141,7 @@ build_python_extension() {
     print_status "Building Python extension..."
     
     # Try setuptools first, fall back to manual compilation
-    if python3 setup.py build_ext --inplace 2>/dev/null; then
+    if NANOMQ_ENABLE_TLS=$ENABLE_TLS python3 setup.py build_ext --inplace 2>/dev/null; then
         print_status "Python extension built successfully"
         return 0
     fi
@@ -154,15 +172,22 @@ build_python_extension() {
         PYTHON_LINK_FLAGS="-L$PYTHON_LIB_DIR -lpython$PYTHON_VERSION"
     fi
     
+    TLS_LINK_FLAGS=""
+    if [ "$ENABLE_TLS" = "1" ]; then
+        TLS_LINK_FLAGS="-lmbedtls -lmbedx509 -lmbedcrypto"
+    fi
+    
     # Compile the extension manually
     g++ -O3 -Wall -shared -std=c++17 -fPIC \
         -I"$PYTHON_INCLUDE" \
         -I"$PYBIND11_INCLUDE" \
+        -Imqtt_clients \
         -Iexternal/nanosdk/include \
         -Iexternal/nanosdk/src/core \
         mqtt_clients/nanomq_bindings.cpp \
         -Lbuild -Lbuild/external/nanosdk \
-        -lnng \
+        -lnng -lz \
+        $TLS_LINK_FLAGS \
         $PYTHON_LINK_FLAGS \
         -o nanomq_bindings$(python3-config --extension-suffix)
     
@@ -243,12 +268,17 @@ main() {
                 skip_tests=true
                 shift
                 ;;
+            --with-tls)
+                ENABLE_TLS=1
+                shift
+                ;;
             --help)
                 echo "Usage: $0 [options]"
                 echo ""
                 echo "Options:"
                 echo "  --clean        Clean build artifacts before building"
                 echo "  --skip-tests   Skip build verification tests"
+                echo "  --with-tls     Build with Mbed TLS for mqtts:// support"
                 echo "  --help         Show this help message"
                 exit 0
                 ;;
@@ -283,6 +313,8 @@ main() {
     echo "You can now use NanoMQ client with:"
     echo "  python3 waldo.py --client-type nanomq"
     echo "  python3 found-him.py desktop_name --client-type nanomq"
+    echo "or without Python, using the same .env:"
+    echo "  ./build/synergy-monitord"
     echo ""
 }
 
@@ -11,10 +11,11 @@ Environment variable loading priority:
 3. Application Defaults (lowest priority)
 """
 
+import ipaddress
 import os
 import socket
 from pathlib import Path
-from typing import Optional
+from typing import List, Optional, Tuple
 
 try:
     from dotenv import load_dotenv
@@ -22,7 +23,7 @@ try:
     load_dotenv()
 except ImportError:
     # python-dotenv not installed, environment variables will still work
-    pass
+    load_dotenv = None
 
 
 class Config:
@@ -30,18 +31,91 @@ class Config:
     Configuration class that loads settings from environment variables.
     
     Supports both primary and secondary deployment modes:
-    - Primary: Runs waldo.py (log monitor) + optional found-him.py  
+    - Primary: Runs waldo.py (log monitor) + optional local alerts (in-process or found-him.py)
     - Secondary: Runs found-him.py only for specific target desktop
     """
     
     # === Deployment Configuration ===
     ROLE = os.getenv('ROLE', 'secondary')  # primary or secondary
+    # Primary with TARGET_DESKTOP: 'combined' alerts from inside waldo.py on its own
+    # connection (nanomq only), 'separate' (the default) runs found-him.py as its
+    # own process
+    PRIMARY_RUNTIME = os.getenv('PRIMARY_RUNTIME', 'separate')
     
     # === MQTT Broker Configuration ===
     MQTT_BROKER = os.getenv('MQTT_BROKER', 'localhost')
     MQTT_PORT = int(os.getenv('MQTT_PORT', '1883'))
     MQTT_TOPIC = os.getenv('MQTT_TOPIC', 'synergy')
+    # Client connect/disconnect and clipboard events from the native follower (empty: not published)
+    MQTT_EVENTS_TOPIC = os.getenv('MQTT_EVENTS_TOPIC', '')
     MQTT_CLIENT_TYPE = os.getenv('MQTT_CLIENT_TYPE', 'paho')
+    # Switches waldo.py holds for publishing while the broker is slow or down (oldest dropped first)
+    PUBLISH_QUEUE_SIZE = int(os.getenv('PUBLISH_QUEUE_SIZE', '1024'))
+    # Flap suppression: rapid back-and-forth switches along a screen edge are held
+    # back until the pointer stays put this long (0 disables); clean switches are not delayed
+    FLAP_DWELL_MS = int(os.getenv('FLAP_DWELL_MS', '300'))
+    # Rapid reversals per burst still published before the burst counts as flapping
+    FLAP_HYSTERESIS = int(os.getenv('FLAP_HYSTERESIS', '0'))
+    # Publish "flapping"/"settled" status events to MQTT_EVENTS_TOPIC (native follower only)
+    FLAP_REPORT = os.getenv('FLAP_REPORT', 'false').lower() == 'true'
+    # Subscribers drop switches older than this by their own clock, e.g. ones
+    # queued through a reconnect (0 disables; nanomq client only). Off by
+    # default: it needs publisher and subscriber clocks in sync
+    EVENT_MAX_AGE_MS = int(os.getenv('EVENT_MAX_AGE_MS', '0'))
+    # Sequence numbers on published events, so subscribers notice missed ones and
+    # ask for the current state (nanomq client only; opt-in, as publishers then
+    # keep EVENT_SEQUENCE_FILE up to date)
+    EVENT_SEQUENCE = os.getenv('EVENT_SEQUENCE', 'false').lower() == 'true'
+    # Name stamped with each publisher's sequence numbers; must differ between primaries
+    EVENT_SOURCE = os.getenv('EVENT_SOURCE') or socket.gethostname()
+    # Where a publisher's sequence numbers persist across restarts; empty keeps them in memory
+    EVENT_SEQUENCE_FILE = os.getenv('EVENT_SEQUENCE_FILE',
+                                    os.path.join(os.getenv('LOG_DIR', './logs'), 'waldo.sequence'))
+    # Publish switches as the topic's retained message, so a subscriber knows the
+    # current desktop as soon as it subscribes (nanomq client only; opt-in, as
+    # the broker then keeps and replays the last switch)
+    MQTT_RETAIN_STATE = os.getenv('MQTT_RETAIN_STATE', 'false').lower() == 'true'
+    # Shared memory page where subscribers keep the current desktop for local
+    # readers such as synergy-current, e.g. /synergy-desktop (nanomq client only;
+    # empty, the default, disables it)
+    STATE_PAGE = os.getenv('STATE_PAGE', '')
+    # Shared memory ring the host's nanomq subscriber writes every accepted message
+    # to, so local consumers (MQTT_CLIENT_TYPE=ring, synergy-events) need no
+    # broker connection of their own, e.g. /synergy-events (empty, the default,
+    # disables it)
+    EVENT_RING = os.getenv('EVENT_RING', '')
+    # Brokerless mode (MQTT_CLIENT_TYPE=peer): the primary listens on PEER_PORT and
+    # secondaries dial PEER_HOST, by default the broker's host (usually the primary)
+    PEER_HOST = os.getenv('PEER_HOST', '')
+    PEER_PORT = int(os.getenv('PEER_PORT', '1885'))
+    # LAN fast path (nanomq client only; empty disables): primaries also send each
+    # switch to this IPv4 multicast group and secondaries take whichever copy,
+    # datagram or MQTT, arrives first. Needs EVENT_SEQUENCE on the primaries.
+    MULTICAST_GROUP = os.getenv('MULTICAST_GROUP', '')
+    MULTICAST_PORT = int(os.getenv('MULTICAST_PORT', '1886'))
+    # IPv4 address of the interface to send and join on (empty: the default route's)
+    MULTICAST_INTERFACE = os.getenv('MULTICAST_INTERFACE', '')
+    # Fleet presence (nanomq client only): each client keeps a retained online
+    # message at PRESENCE_TOPIC/PRESENCE_NAME/ROLE, with an offline Last Will on
+    # the same topic, and primaries watch the whole fleet's. Opt-in, as it adds
+    # retained topics and wills on the broker
+    PRESENCE = os.getenv('PRESENCE', 'false').lower() == 'true'
+    PRESENCE_TOPIC = os.getenv('PRESENCE_TOPIC', 'synergy/presence')
+    PRESENCE_NAME = os.getenv('PRESENCE_NAME') or socket.gethostname()
+    
+    # === MQTT TLS Configuration (nanomq client only) ===
+    MQTT_TLS = os.getenv('MQTT_TLS', 'false').lower() == 'true'
+    MQTT_TLS_CA_FILE = os.getenv('MQTT_TLS_CA_FILE', '')
+    MQTT_TLS_CERT_FILE = os.getenv('MQTT_TLS_CERT_FILE', '')
+    MQTT_TLS_KEY_FILE = os.getenv('MQTT_TLS_KEY_FILE', '')
+    MQTT_TLS_SERVER_NAME = os.getenv('MQTT_TLS_SERVER_NAME', '')
+    
+    # === NanoMQ Tuning (nanomq client only) ===
+    # Receive preset: default, low-latency or low-power (idle poll interval 10, 1 or 50 ms)
+    MQTT_TUNING_PROFILE = os.getenv('MQTT_TUNING_PROFILE', '')
+    # Busy-poll spin budget in microseconds after each received message
+    # (empty keeps the profile's value, 0 disables)
+    MQTT_BUSY_POLL_US = os.getenv('MQTT_BUSY_POLL_US', '')
     
     # === Synergy Configuration ===
     # Default Synergy log path (platform-specific)
@@ -63,6 +137,13 @@ class Config:
             return str(home / '.local' / 'share' / 'synergy' / 'synergy.log')
     
     SYNERGY_LOG_PATH = os.getenv('SYNERGY_LOG_PATH', _get_default_synergy_log_path.__func__())
+    # "tail" pipes tail -F into waldo.py, "native" follows the file in-process (nanomq only)
+    SYNERGY_LOG_FOLLOW = os.getenv('SYNERGY_LOG_FOLLOW', 'tail').lower()
+    # Several Synergy servers' logs for one native follower: "office=/path/a.log,lab=/path/b.log"
+    SYNERGY_LOG_SOURCES = os.getenv('SYNERGY_LOG_SOURCES', '')
+    # Where the native follower records its read position; empty disables resuming
+    SYNERGY_LOG_CHECKPOINT = os.getenv('SYNERGY_LOG_CHECKPOINT',
+                                       os.path.join(os.getenv('LOG_DIR', './logs'), 'waldo.checkpoint'))
     
     # === Target Desktop Configuration ===
     # Default to hostname for convenience, can be overridden
@@ -95,11 +176,13 @@ class Config:
         
         # Check if log path exists for primary
         if cls.is_primary():
-            log_path = Path(cls.SYNERGY_LOG_PATH)
-            if not log_path.exists():
-                errors.append(f"Synergy log file not found: {cls.SYNERGY_LOG_PATH}")
-            elif not log_path.is_file():
-                errors.append(f"Synergy log path is not a file: {cls.SYNERGY_LOG_PATH}")
+            errors.extend(log_source_errors(get_log_sources()))
+            for _, path in get_log_sources():
+                log_path = Path(path)
+                if not log_path.exists():
+                    errors.append(f"Synergy log file not found: {path}")
+                elif not log_path.is_file():
+                    errors.append(f"Synergy log path is not a file: {path}")
         
         return errors
     
@@ -140,6 +223,78 @@ class Config:
         if cls.MQTT_PORT < 1 or cls.MQTT_PORT > 65535:
             errors.append(f"Invalid MQTT_PORT: {cls.MQTT_PORT}. Must be between 1-65535")
         
+        if cls.PRIMARY_RUNTIME not in ['combined', 'separate']:
+            errors.append(f"Invalid PRIMARY_RUNTIME: {cls.PRIMARY_RUNTIME}. Must be 'combined' or 'separate'")
+        
+        if cls.PUBLISH_QUEUE_SIZE < 1:
+            errors.append(f"Invalid PUBLISH_QUEUE_SIZE: {cls.PUBLISH_QUEUE_SIZE}. Must be at least 1")
+        
+        if cls.FLAP_DWELL_MS < 0 or cls.FLAP_HYSTERESIS < 0:
+            errors.append("FLAP_DWELL_MS and FLAP_HYSTERESIS must not be negative")
+        
+        if cls.EVENT_MAX_AGE_MS < 0:
+            errors.append(f"Invalid EVENT_MAX_AGE_MS: {cls.EVENT_MAX_AGE_MS}. Must not be negative")
+        
+        if cls.MQTT_TLS:
+            if cls.MQTT_CLIENT_TYPE != 'nanomq':
+                errors.append("MQTT_TLS requires MQTT_CLIENT_TYPE=nanomq")
+            if not cls.MQTT_TLS_CA_FILE:
+                errors.append("MQTT_TLS_CA_FILE must be specified when MQTT_TLS is enabled")
+            elif not Path(cls.MQTT_TLS_CA_FILE).is_file():
+                errors.append(f"TLS CA file not found: {cls.MQTT_TLS_CA_FILE}")
+        
+        if cls.MQTT_TUNING_PROFILE:
+            if cls.MQTT_TUNING_PROFILE not in ['default', 'low-latency', 'low-power']:
+                errors.append(f"Invalid MQTT_TUNING_PROFILE: {cls.MQTT_TUNING_PROFILE}. "
+                              f"Must be 'default', 'low-latency' or 'low-power'")
+            if cls.MQTT_CLIENT_TYPE != 'nanomq':
+                errors.append("MQTT_TUNING_PROFILE requires MQTT_CLIENT_TYPE=nanomq")
+        
+        if cls.MQTT_BUSY_POLL_US:
+            if not cls.MQTT_BUSY_POLL_US.isdigit():
+                errors.append(f"Invalid MQTT_BUSY_POLL_US: {cls.MQTT_BUSY_POLL_US}. "
+                              f"Must be a non-negative number of microseconds")
+            if cls.MQTT_CLIENT_TYPE != 'nanomq':
+                errors.append("MQTT_BUSY_POLL_US requires MQTT_CLIENT_TYPE=nanomq")
+        
+        if cls.SYNERGY_LOG_FOLLOW not in ['tail', 'native']:
+            errors.append(f"Invalid SYNERGY_LOG_FOLLOW: {cls.SYNERGY_LOG_FOLLOW}. Must be 'tail' or 'native'")
+        elif cls.SYNERGY_LOG_FOLLOW == 'native' and cls.MQTT_CLIENT_TYPE != 'nanomq':
+            errors.append("SYNERGY_LOG_FOLLOW=native requires MQTT_CLIENT_TYPE=nanomq")
+        elif cls.SYNERGY_LOG_SOURCES and cls.SYNERGY_LOG_FOLLOW != 'native':
+            errors.append("SYNERGY_LOG_SOURCES requires SYNERGY_LOG_FOLLOW=native")
+        
+        for setting in ['STATE_PAGE', 'EVENT_RING']:
+            name = getattr(cls, setting)
+            if name and (not name.startswith('/') or '/' in name[1:] or len(name) < 2):
+                errors.append(f"Invalid {setting}: {name}. Must be /NAME with no other slashes")
+        if cls.MQTT_CLIENT_TYPE == 'ring':
+            if not cls.EVENT_RING:
+                errors.append("MQTT_CLIENT_TYPE=ring requires EVENT_RING")
+            if cls.is_primary():
+                errors.append("MQTT_CLIENT_TYPE=ring only subscribes; primaries need paho, nanomq or peer")
+        if cls.PEER_PORT < 1 or cls.PEER_PORT > 65535:
+            errors.append(f"Invalid PEER_PORT: {cls.PEER_PORT}. Must be between 1-65535")
+        
+        if cls.MULTICAST_GROUP:
+            try:
+                if not ipaddress.IPv4Address(cls.MULTICAST_GROUP).is_multicast:
+                    raise ValueError
+            except ValueError:
+                errors.append(f"Invalid MULTICAST_GROUP: {cls.MULTICAST_GROUP}. "
+                              f"Must be an IPv4 multicast address (224.0.0.0/4)")
+            if cls.MULTICAST_PORT < 1 or cls.MULTICAST_PORT > 65535:
+                errors.append(f"Invalid MULTICAST_PORT: {cls.MULTICAST_PORT}. Must be between 1-65535")
+            if cls.MQTT_CLIENT_TYPE != 'nanomq':
+                errors.append("MULTICAST_GROUP requires MQTT_CLIENT_TYPE=nanomq")
+            if cls.is_primary() and not cls.EVENT_SEQUENCE:
+                errors.append("MULTICAST_GROUP requires EVENT_SEQUENCE=true on primaries")
+        if cls.PRESENCE:
+            if not cls.PRESENCE_TOPIC or any(c in cls.PRESENCE_TOPIC for c in '+#'):
+                errors.append(f"Invalid PRESENCE_TOPIC: {cls.PRESENCE_TOPIC}. Must be a topic without wildcards")
+            if any(c in cls.PRESENCE_NAME for c in '/+#'):
+                errors.append(f"Invalid PRESENCE_NAME: {cls.PRESENCE_NAME}. Must not contain '/', '+' or '#'")
+        
         # Role-specific validation
         if cls.is_primary():
             errors.extend(cls.validate_primary_config())
@@ -156,14 +311,42 @@ class Config:
         print(f"  MQTT Broker: {cls.MQTT_BROKER}:{cls.MQTT_PORT}")
         print(f"  MQTT Topic: {cls.MQTT_TOPIC}")
         print(f"  Client Type: {cls.MQTT_CLIENT_TYPE}")
+        if cls.MQTT_CLIENT_TYPE == 'peer':
+            if cls.is_primary():
+                print(f"  Peer Listen Port: {cls.PEER_PORT}")
+            else:
+                print(f"  Peer Publisher: {cls.PEER_HOST or cls.MQTT_BROKER}:{cls.PEER_PORT}")
+        print(f"  TLS: {'enabled' if cls.MQTT_TLS else 'disabled'}")
+        if cls.MQTT_TUNING_PROFILE:
+            print(f"  Tuning Profile: {cls.MQTT_TUNING_PROFILE}")
+        if cls.MULTICAST_GROUP and cls.MQTT_CLIENT_TYPE == 'nanomq':
+            print(f"  Multicast: {cls.MULTICAST_GROUP}:{cls.MULTICAST_PORT} "
+                  f"({'sending' if cls.is_primary() else 'receiving'})")
+        if cls.PRESENCE and cls.MQTT_CLIENT_TYPE == 'nanomq':
+            print(f"  Presence: {cls.PRESENCE_TOPIC}/{cls.PRESENCE_NAME}")
         
         if cls.is_primary():
-            print(f"  Synergy Log: {cls.SYNERGY_LOG_PATH}")
+            if cls.SYNERGY_LOG_SOURCES:
+                for server, path in get_log_sources():
+                    print(f"  Synergy Log [{server or '-'}]: {path} (follow: {cls.SYNERGY_LOG_FOLLOW})")
+            else:
+                print(f"  Synergy Log: {cls.SYNERGY_LOG_PATH} (follow: {cls.SYNERGY_LOG_FOLLOW})")
+            if cls.SYNERGY_LOG_FOLLOW == 'native':
+                print(f"  Log Checkpoint: {cls.SYNERGY_LOG_CHECKPOINT or 'disabled'}")
             if cls.TARGET_DESKTOP:
-                print(f"  Local Target: {cls.TARGET_DESKTOP}")
+                print(f"  Local Target: {cls.TARGET_DESKTOP} (runtime: {cls.PRIMARY_RUNTIME})")
+            if cls.EVENT_SEQUENCE and cls.MQTT_CLIENT_TYPE == 'nanomq':
+                print(f"  Sequence Source: {cls.EVENT_SOURCE} (state: {cls.EVENT_SEQUENCE_FILE or 'memory'})")
+            if cls.MQTT_RETAIN_STATE and cls.MQTT_CLIENT_TYPE == 'nanomq':
+                print(f"  Retained State: {cls.MQTT_TOPIC}")
         
         if cls.is_secondary():
             print(f"  Target Desktop: {cls.TARGET_DESKTOP}")
+            if cls.STATE_PAGE and cls.MQTT_CLIENT_TYPE in ['nanomq', 'peer']:
+                print(f"  State Page: {cls.STATE_PAGE}")
+            if cls.EVENT_RING and cls.MQTT_CLIENT_TYPE in ['nanomq', 'ring', 'peer']:
+                print(f"  Event Ring: {cls.EVENT_RING} "
+                      f"({'reading' if cls.MQTT_CLIENT_TYPE == 'ring' else 'writing'})")
         
         print(f"  Log Level: {cls.LOG_LEVEL}")
         print(f"  Debug Mode: {cls.DEBUG_MODE}")
@@ -184,6 +367,152 @@ def get_mqtt_config() -> dict:
     }
 
 
+def get_client_options() -> dict:
+    """
+    Get optional client settings to pass through MQTTClientFactory.
+    
+    Only settings that are actually configured are included, so the result
+    is empty for a default setup and works with every client type.
+    
+    Returns:
+        dict: Keyword arguments for the client constructor
+    """
+    options = {}
+    
+    if Config.MQTT_TLS:
+        options['tls'] = {
+            'ca_file': Config.MQTT_TLS_CA_FILE,
+            'cert_file': Config.MQTT_TLS_CERT_FILE,
+            'key_file': Config.MQTT_TLS_KEY_FILE,
+            'server_name': Config.MQTT_TLS_SERVER_NAME,
+        }
+    
+    if Config.MQTT_TUNING_PROFILE:
+        options['tuning'] = Config.MQTT_TUNING_PROFILE
+    
+    if Config.MQTT_BUSY_POLL_US.isdigit():
+        options['busy_poll_us'] = int(Config.MQTT_BUSY_POLL_US)
+    
+    return options
+
+
+def get_multicast_options() -> Optional[dict]:
+    """
+    Get the multicast fast path settings for a nanomq publisher or subscriber.
+    
+    Returns:
+        dict: group, port and interface, or None if MULTICAST_GROUP is not set
+    """
+    if not Config.MULTICAST_GROUP:
+        return None
+    return {
+        'group': Config.MULTICAST_GROUP,
+        'port': Config.MULTICAST_PORT,
+        'interface': Config.MULTICAST_INTERFACE,
+    }
+
+
+def get_presence_options(role: str) -> Optional[dict]:
+    """
+    Get the presence settings for a nanomq client.
+    
+    Args:
+        role: What the client is, the last level of its presence topic
+              ('waldo' or 'found-him')
+    
+    Returns:
+        dict: topic, name and role, and watch for primaries, which follow the
+        whole fleet; None if PRESENCE is off
+    """
+    if not Config.PRESENCE:
+        return None
+    return {
+        'topic': Config.PRESENCE_TOPIC,
+        'name': Config.PRESENCE_NAME,
+        'role': role,
+        'watch': Config.is_primary(),
+    }
+
+
+def get_log_sources(specs: Optional[List[str]] = None) -> List[Tuple[str, str]]:
+    """
+    Get the Synergy logs to follow as (server, path) pairs.
+    
+    Each spec is "SERVER=PATH" or a bare "PATH" (no server tag). Without
+    specs, SYNERGY_LOG_SOURCES is used, and without that SYNERGY_LOG_PATH.
+    
+    Args:
+        specs: Optional sources from the command line
+        
+    Returns:
+        list: (server, path) pairs; server is '' for an untagged log
+    """
+    if not specs:
+        specs = [s for s in Config.SYNERGY_LOG_SOURCES.split(',') if s.strip()]
+    if not specs:
+        return [('', Config.SYNERGY_LOG_PATH)]
+    
+    sources = []
+    for spec in specs:
+        server, sep, path = spec.strip().partition('=')
+        sources.append((server.strip(), path.strip()) if sep else ('', server.strip()))
+    return sources
+
+
+def log_source_errors(sources: List[Tuple[str, str]]) -> List[str]:
+    """
+    Check that each server tag names one log.
+    
+    A tagged log's checkpoint file (SYNERGY_LOG_CHECKPOINT.SERVER) and the
+    "server" field its switches carry are keyed on the tag, so two logs
+    under one tag would overwrite each other's read position.
+    
+    Args:
+        sources: (server, path) pairs from get_log_sources()
+        
+    Returns:
+        list: Configuration errors, empty if the tags are unique
+    """
+    errors = []
+    seen = {}
+    for server, path in sources:
+        if not server:
+            continue
+        if server in seen:
+            errors.append(f"Duplicate Synergy log server tag '{server}': {seen[server]} and {path}")
+        else:
+            seen[server] = path
+    return errors
+
+
+def reload_config() -> dict:
+    """
+    Re-read the .env file for settings that can change on a live connection.
+    
+    Called on SIGHUP. Only values that are actually set are returned, so a
+    setting missing from the environment keeps whatever the CLI configured.
+    
+    Returns:
+        dict: Keyword arguments for the clients' reconfigure() (topic, value)
+    """
+    if load_dotenv:
+        load_dotenv(override=True)
+    
+    updates = {}
+    
+    topic = os.getenv('MQTT_TOPIC')
+    if topic:
+        Config.MQTT_TOPIC = topic
+        updates['topic'] = topic
+    
+    target = os.getenv('TARGET_DESKTOP')
+    if target:
+        Config.TARGET_DESKTOP = target
+        updates['value'] = target
+    
+    return updates
+
+
 def override_config(**kwargs):
     """
     Override configuration values (useful for CLI arguments).
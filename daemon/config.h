@@ -0,0 +1,443 @@
+/**
+ * synergy-monitord configuration
+ *
+ * The keys and defaults of config.py, read from the same .env file. As with
+ * python-dotenv's load_dotenv(), a variable already set in the environment
+ * wins over the file; reload() re-reads the file with the file winning, the
+ * way reload_config() does on SIGHUP.
+ *
+ * The daemon is always the nanomq client: MQTT_CLIENT_TYPE paho and nanomq
+ * both mean a broker, and peer (brokerless) is refused by validate() rather
+ * than silently replaced with a broker connection.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <climits>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+namespace monitord {
+
+using LogSource = std::pair<std::string, std::string>;   // (server, path), server "" for no tag
+
+// Like config.log_source_errors(): each server tag names one log, since its
+// checkpoint file and the "server" field subscribers see are keyed on it
+inline std::vector<std::string> log_source_errors(const std::vector<LogSource>& sources) {
+    std::vector<std::string> errors;
+    std::map<std::string, std::string> seen;
+    for (const auto& source : sources) {
+        if (source.first.empty()) {
+            continue;
+        }
+        auto inserted = seen.emplace(source.first, source.second);
+        if (!inserted.second) {
+            errors.push_back("Duplicate Synergy log server tag '" + source.first + "': " + inserted.first->second +
+                             " and " + source.second);
+        }
+    }
+    return errors;
+}
+
+inline std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+inline std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+inline bool is_file(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * KEY=VALUE lines as python-dotenv reads them: blank lines and # comments
+ * skipped, an optional "export " prefix, values optionally single or double
+ * quoted, and " #" starting a comment after an unquoted value. A missing
+ * file is simply empty.
+ */
+inline std::map<std::string, std::string> read_dotenv(const std::string& path) {
+    std::map<std::string, std::string> values;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line.compare(0, 7, "export ") == 0) {
+            line = trim(line.substr(7));
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+        char quote = value.empty() ? 0 : value[0];
+        size_t close = (quote == '"' || quote == '\'') ? value.find(quote, 1) : std::string::npos;
+        if (close != std::string::npos) {
+            std::string quoted = value.substr(1, close - 1);
+            value.clear();
+            for (size_t i = 0; i < quoted.size(); i++) {
+                if (quote == '"' && quoted[i] == '\\' && i + 1 < quoted.size()) {
+                    char next = quoted[++i];
+                    value += next == 'n' ? '\n' : next == 't' ? '\t' : next;
+                } else {
+                    value += quoted[i];
+                }
+            }
+        } else {
+            size_t comment = value.find(" #");
+            if (comment != std::string::npos) {
+                value = trim(value.substr(0, comment));
+            }
+        }
+        values[key] = value;
+    }
+    return values;
+}
+
+struct Config {
+    // === Deployment ===
+    std::string role = "secondary";
+    std::string primary_runtime = "separate";
+
+    // === MQTT ===
+    std::string broker = "localhost";
+    int port = 1883;
+    std::string topic = "synergy";
+    std::string client_type = "paho";
+    std::string events_topic;
+    int publish_queue_size = 1024;
+    int flap_dwell_ms = 300;
+    int flap_hysteresis = 0;
+    bool flap_report = false;
+    int event_max_age_ms = 0;
+    bool event_sequence = false;
+    std::string event_source;
+    std::string event_sequence_file;
+    bool retain_state = false;
+    std::string state_page;
+    std::string event_ring;
+    std::string multicast_group;
+    int multicast_port = 1886;
+    std::string multicast_interface;
+    bool presence = false;
+    std::string presence_topic = "synergy/presence";
+    std::string presence_name;
+
+    // === TLS and tuning ===
+    bool tls = false;
+    std::string tls_ca_file;
+    std::string tls_cert_file;
+    std::string tls_key_file;
+    std::string tls_server_name;
+    std::string tuning_profile;
+    std::string busy_poll_us;
+
+    // === Synergy ===
+    std::string log_path;
+    std::string log_follow = "tail";
+    std::string log_sources;
+    std::string log_checkpoint;
+    std::string target_desktop;
+
+    // === Logging ===
+    bool debug = false;
+    std::string log_dir = "./logs";
+
+    bool is_primary() const {
+        return lower(role) == "primary";
+    }
+
+    bool is_secondary() const {
+        return lower(role) == "secondary";
+    }
+
+    /**
+     * The Synergy logs to follow, like config.get_log_sources(): the given
+     * "SERVER=PATH" / "PATH" specs, else SYNERGY_LOG_SOURCES, else
+     * SYNERGY_LOG_PATH untagged.
+     */
+    std::vector<LogSource> sources(std::vector<std::string> specs = {}) const {
+        if (specs.empty()) {
+            size_t start = 0;
+            while (start <= log_sources.size()) {
+                size_t comma = std::min(log_sources.find(',', start), log_sources.size());
+                std::string spec = trim(log_sources.substr(start, comma - start));
+                if (!spec.empty()) {
+                    specs.push_back(spec);
+                }
+                start = comma + 1;
+            }
+        }
+        if (specs.empty()) {
+            return {{"", log_path}};
+        }
+        std::vector<LogSource> result;
+        for (const auto& spec : specs) {
+            size_t eq = spec.find('=');
+            if (eq == std::string::npos) {
+                result.emplace_back("", trim(spec));
+            } else {
+                result.emplace_back(trim(spec.substr(0, eq)), trim(spec.substr(eq + 1)));
+            }
+        }
+        return result;
+    }
+
+    // Config.validate_config(), of the client-type checks only peer; empty if valid
+    std::vector<std::string> validate() const {
+        std::vector<std::string> errors;
+        if (client_type == "peer") {
+            errors.push_back("MQTT_CLIENT_TYPE=peer (brokerless) is not supported by synergy-monitord; "
+                             "run waldo.py and found-him.py, or use a broker");
+        }
+        if (!is_primary() && !is_secondary()) {
+            errors.push_back("Invalid ROLE: " + role + ". Must be 'primary' or 'secondary'");
+        }
+        if (trim(broker).empty()) {
+            errors.push_back("MQTT_BROKER must be specified");
+        }
+        if (port < 1 || port > 65535) {
+            errors.push_back("Invalid MQTT_PORT: " + std::to_string(port) + ". Must be between 1-65535");
+        }
+        if (primary_runtime != "combined" && primary_runtime != "separate") {
+            errors.push_back("Invalid PRIMARY_RUNTIME: " + primary_runtime + ". Must be 'combined' or 'separate'");
+        }
+        if (publish_queue_size < 1) {
+            errors.push_back("Invalid PUBLISH_QUEUE_SIZE: " + std::to_string(publish_queue_size) +
+                             ". Must be at least 1");
+        }
+        if (flap_dwell_ms < 0 || flap_hysteresis < 0) {
+            errors.push_back("FLAP_DWELL_MS and FLAP_HYSTERESIS must not be negative");
+        }
+        if (event_max_age_ms < 0) {
+            errors.push_back("Invalid EVENT_MAX_AGE_MS: " + std::to_string(event_max_age_ms) +
+                             ". Must not be negative");
+        }
+        for (const auto& shm : {std::make_pair("STATE_PAGE", state_page), std::make_pair("EVENT_RING", event_ring)}) {
+            const std::string& name = shm.second;
+            if (!name.empty() && (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos)) {
+                errors.push_back(std::string("Invalid ") + shm.first + ": " + name +
+                                 ". Must be /NAME with no other slashes");
+            }
+        }
+        if (!multicast_group.empty()) {
+            in_addr group;
+            if (inet_pton(AF_INET, multicast_group.c_str(), &group) != 1 || (ntohl(group.s_addr) >> 28) != 0xE) {
+                errors.push_back("Invalid MULTICAST_GROUP: " + multicast_group +
+                                 ". Must be an IPv4 multicast address (224.0.0.0/4)");
+            }
+            if (multicast_port < 1 || multicast_port > 65535) {
+                errors.push_back("Invalid MULTICAST_PORT: " + std::to_string(multicast_port) +
+                                 ". Must be between 1-65535");
+            }
+            if (is_primary() && !event_sequence) {
+                errors.push_back("MULTICAST_GROUP requires EVENT_SEQUENCE=true on primaries");
+            }
+        }
+        if (presence) {
+            if (presence_topic.empty() || presence_topic.find_first_of("+#") != std::string::npos) {
+                errors.push_back("Invalid PRESENCE_TOPIC: " + presence_topic + ". Must be a topic without wildcards");
+            }
+            if (presence_name.find_first_of("/+#") != std::string::npos) {
+                errors.push_back("Invalid PRESENCE_NAME: " + presence_name + ". Must not contain '/', '+' or '#'");
+            }
+        }
+        if (tls) {
+            if (tls_ca_file.empty()) {
+                errors.push_back("MQTT_TLS_CA_FILE must be specified when MQTT_TLS is enabled");
+            } else if (!is_file(tls_ca_file)) {
+                errors.push_back("TLS CA file not found: " + tls_ca_file);
+            }
+        }
+        if (!tuning_profile.empty() && tuning_profile != "default" && tuning_profile != "low-latency" &&
+            tuning_profile != "low-power") {
+            errors.push_back("Invalid MQTT_TUNING_PROFILE: " + tuning_profile +
+                             ". Must be 'default', 'low-latency' or 'low-power'");
+        }
+        if (!busy_poll_us.empty() && busy_poll_us.find_first_not_of("0123456789") != std::string::npos) {
+            errors.push_back("Invalid MQTT_BUSY_POLL_US: " + busy_poll_us +
+                             ". Must be a non-negative number of microseconds");
+        }
+        if (log_follow != "tail" && log_follow != "native") {
+            errors.push_back("Invalid SYNERGY_LOG_FOLLOW: " + log_follow + ". Must be 'tail' or 'native'");
+        } else if (!log_sources.empty() && log_follow != "native") {
+            errors.push_back("SYNERGY_LOG_SOURCES requires SYNERGY_LOG_FOLLOW=native");
+        }
+        if (is_primary()) {
+            for (const auto& error : log_source_errors(sources())) {
+                errors.push_back(error);
+            }
+            for (const auto& source : sources()) {
+                struct stat st;
+                if (stat(source.second.c_str(), &st) != 0) {
+                    errors.push_back("Synergy log file not found: " + source.second);
+                } else if (!S_ISREG(st.st_mode)) {
+                    errors.push_back("Synergy log path is not a file: " + source.second);
+                }
+            }
+        } else if (is_secondary() && trim(target_desktop).empty()) {
+            errors.push_back("TARGET_DESKTOP must be specified for secondary machines");
+        }
+        return errors;
+    }
+};
+
+/**
+ * Looks keys up in the environment first, then the .env file, like
+ * os.getenv() after load_dotenv().
+ */
+class Settings {
+public:
+    explicit Settings(const std::string& env_file) : file(read_dotenv(env_file)) {
+    }
+
+    std::string get(const std::string& key, const std::string& fallback = "") const {
+        const char* env = getenv(key.c_str());
+        if (env) {
+            return env;
+        }
+        auto it = file.find(key);
+        return it != file.end() ? it->second : fallback;
+    }
+
+    int get_int(const std::string& key, int fallback) const {
+        std::string value = trim(get(key, std::to_string(fallback)));
+        char* end = nullptr;
+        long parsed = strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX) {
+            throw std::runtime_error("Invalid " + key + ": " + value + " (expected an integer)");
+        }
+        return static_cast<int>(parsed);
+    }
+
+    bool get_bool(const std::string& key, bool fallback) const {
+        return lower(get(key, fallback ? "true" : "false")) == "true";
+    }
+
+private:
+    std::map<std::string, std::string> file;
+};
+
+inline std::string default_synergy_log_path() {
+    const char* home = getenv("HOME");
+    std::string base = home ? home : ".";
+#ifdef __APPLE__
+    return base + "/Library/Logs/Synergy/synergy.log";
+#else
+    return base + "/.local/share/synergy/synergy.log";
+#endif
+}
+
+inline std::string hostname() {
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0) {
+        return "";
+    }
+    return name;
+}
+
+inline std::string default_target_desktop() {
+    return lower(hostname());
+}
+
+inline Config load_config(const std::string& env_file) {
+    Settings env(env_file);
+    Config c;
+    c.role = env.get("ROLE", c.role);
+    c.primary_runtime = env.get("PRIMARY_RUNTIME", c.primary_runtime);
+    c.broker = env.get("MQTT_BROKER", c.broker);
+    c.port = env.get_int("MQTT_PORT", c.port);
+    c.topic = env.get("MQTT_TOPIC", c.topic);
+    c.client_type = lower(env.get("MQTT_CLIENT_TYPE", c.client_type));
+    c.events_topic = env.get("MQTT_EVENTS_TOPIC");
+    c.publish_queue_size = env.get_int("PUBLISH_QUEUE_SIZE", c.publish_queue_size);
+    c.flap_dwell_ms = env.get_int("FLAP_DWELL_MS", c.flap_dwell_ms);
+    c.flap_hysteresis = env.get_int("FLAP_HYSTERESIS", c.flap_hysteresis);
+    c.flap_report = env.get_bool("FLAP_REPORT", c.flap_report);
+    c.event_max_age_ms = env.get_int("EVENT_MAX_AGE_MS", c.event_max_age_ms);
+    c.event_sequence = env.get_bool("EVENT_SEQUENCE", c.event_sequence);
+    c.retain_state = env.get_bool("MQTT_RETAIN_STATE", c.retain_state);
+    c.state_page = env.get("STATE_PAGE", c.state_page);
+    c.event_ring = env.get("EVENT_RING", c.event_ring);
+    c.multicast_group = env.get("MULTICAST_GROUP");
+    c.multicast_port = env.get_int("MULTICAST_PORT", c.multicast_port);
+    c.multicast_interface = env.get("MULTICAST_INTERFACE");
+    c.presence = env.get_bool("PRESENCE", c.presence);
+    c.presence_topic = env.get("PRESENCE_TOPIC", c.presence_topic);
+    c.presence_name = env.get("PRESENCE_NAME");
+    if (c.presence_name.empty()) {
+        c.presence_name = hostname();
+    }
+    c.event_source = env.get("EVENT_SOURCE");
+    if (c.event_source.empty()) {
+        c.event_source = hostname();
+    }
+    c.tls = env.get_bool("MQTT_TLS", c.tls);
+    c.tls_ca_file = env.get("MQTT_TLS_CA_FILE");
+    c.tls_cert_file = env.get("MQTT_TLS_CERT_FILE");
+    c.tls_key_file = env.get("MQTT_TLS_KEY_FILE");
+    c.tls_server_name = env.get("MQTT_TLS_SERVER_NAME");
+    c.tuning_profile = env.get("MQTT_TUNING_PROFILE");
+    c.busy_poll_us = env.get("MQTT_BUSY_POLL_US");
+    c.log_path = env.get("SYNERGY_LOG_PATH", default_synergy_log_path());
+    c.log_follow = lower(env.get("SYNERGY_LOG_FOLLOW", c.log_follow));
+    c.log_sources = env.get("SYNERGY_LOG_SOURCES");
+    c.log_dir = env.get("LOG_DIR", c.log_dir);
+    c.log_checkpoint = env.get("SYNERGY_LOG_CHECKPOINT", c.log_dir + "/waldo.checkpoint");
+    c.event_sequence_file = env.get("EVENT_SEQUENCE_FILE", c.log_dir + "/waldo.sequence");
+    c.target_desktop = env.get("TARGET_DESKTOP", default_target_desktop());
+    c.debug = env.get_bool("DEBUG_MODE", c.debug);
+    return c;
+}
+
+/**
+ * Settings that can change on a live connection, as reload_config() reads
+ * them on SIGHUP: the file wins over the environment, and only keys that
+ * are set are returned ("topic", "value").
+ */
+inline std::map<std::string, std::string> reload_config(const std::string& env_file) {
+    std::map<std::string, std::string> file = read_dotenv(env_file);
+    auto lookup = [&file](const std::string& key) {
+        auto it = file.find(key);
+        if (it != file.end()) {
+            return it->second;
+        }
+        const char* env = getenv(key.c_str());
+        return std::string(env ? env : "");
+    };
+
+    std::map<std::string, std::string> updates;
+    std::string topic = lookup("MQTT_TOPIC");
+    if (!topic.empty()) {
+        updates["topic"] = topic;
+    }
+    std::string target = lookup("TARGET_DESKTOP");
+    if (!target.empty()) {
+        updates["value"] = target;
+    }
+    return updates;
+}
+
+}  // namespace monitord
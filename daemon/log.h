@@ -0,0 +1,103 @@
+/**
+ * synergy-monitord logging
+ *
+ * The same records the Python entry points write with their logging setup:
+ * every level to LOG_DIR/<service>.log as
+ * "2025-01-02 03:04:05,678 - waldo - INFO - message", and errors (all
+ * levels with --debug) to stderr. watchdog.sh reads the timestamps to tell
+ * a live service from a stalled one, so the format matters.
+ */
+
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+namespace monitord {
+
+enum class Level { Debug, Info, Warning, Error };
+
+inline const char* level_name(Level level) {
+    switch (level) {
+        case Level::Debug: return "DEBUG";
+        case Level::Info: return "INFO";
+        case Level::Warning: return "WARNING";
+        case Level::Error: return "ERROR";
+    }
+    return "INFO";
+}
+
+class LogSink {
+public:
+    static LogSink& instance() {
+        static LogSink sink;
+        return sink;
+    }
+
+    // Append to path (created if missing); false if it could not be opened
+    bool open(const std::string& path, bool debug) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (file) {
+            fclose(file);
+        }
+        file = fopen(path.c_str(), "a");
+        console_level = debug ? Level::Debug : Level::Error;
+        return file != nullptr;
+    }
+
+    void write(Level level, const char* name, const std::string& message) {
+        auto now = std::chrono::system_clock::now();
+        std::time_t secs = std::chrono::system_clock::to_time_t(now);
+        int millis = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch()).count() % 1000);
+        std::tm local;
+        localtime_r(&secs, &local);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (file) {
+            fprintf(file, "%s,%03d - %s - %s - %s\n", stamp, millis, name, level_name(level), message.c_str());
+            fflush(file);
+        }
+        if (level >= console_level) {
+            fprintf(stderr, "%s,%03d - %s - %s - %s\n", stamp, millis, name, level_name(level), message.c_str());
+        }
+    }
+
+private:
+    std::mutex mutex;
+    FILE* file = nullptr;
+    Level console_level = Level::Error;
+};
+
+// A named logger, like logging.getLogger(name)
+class Logger {
+public:
+    explicit Logger(const char* name) : name(name) {
+    }
+
+    void debug(const std::string& message) const {
+        LogSink::instance().write(Level::Debug, name, message);
+    }
+
+    void info(const std::string& message) const {
+        LogSink::instance().write(Level::Info, name, message);
+    }
+
+    void warning(const std::string& message) const {
+        LogSink::instance().write(Level::Warning, name, message);
+    }
+
+    void error(const std::string& message) const {
+        LogSink::instance().write(Level::Error, name, message);
+    }
+
+private:
+    const char* name;
+};
+
+}  // namespace monitord
@@ -0,0 +1,287 @@
+/**
+ * Publish stage for the stdin (tail -F) path
+ *
+ * What mqtt_clients/publish_queue.py does for waldo.py, natively: the
+ * reader hands each switch over and goes back to the pipe, and a worker
+ * thread publishes from a bounded queue (native/event_queue.h). A failed
+ * publish is retried after retry_delay, then twice that, up to max_retries
+ * attempts; a retry overtaken by a newer successful publish, or due while a
+ * newer message also waits for one, is dropped as superseded. With a flap
+ * dwell, switches pass through a FlapFilter first and a flapping burst is
+ * published where it settled.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#include "native/event_queue.h"
+#include "native/flap_filter.h"
+#include "native/mqtt_client.h"
+#include "native/payloads.h"
+
+#include "log.h"
+
+namespace monitord {
+
+class PublishQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using PublishedCallback = std::function<void(const std::string& desktop)>;
+
+    PublishQueue(native::NanoMQTTClient& client, const std::string& topic, size_t capacity,
+                 int flap_dwell_ms, int flap_hysteresis, PublishedCallback on_published,
+                 int max_retries = 3, Clock::duration retry_delay = std::chrono::seconds(2))
+        : client(client), topic(topic), queue(capacity), on_published(std::move(on_published)),
+          max_retries(max_retries), retry_delay(retry_delay) {
+        if (flap_dwell_ms > 0) {
+            flap_filter.reset(new native::FlapFilter(flap_dwell_ms, flap_hysteresis));
+        }
+        worker = std::thread([this]() { run(); });
+    }
+
+    ~PublishQueue() {
+        close(std::chrono::milliseconds(0));
+    }
+
+    PublishQueue(const PublishQueue&) = delete;
+    PublishQueue& operator=(const PublishQueue&) = delete;
+
+    // Queue a switch to desktop, stamped now; never blocks. False if the oldest was dropped.
+    bool submit(const std::string& desktop) {
+        Message message{desktop, native::switch_event_payload(desktop)};
+        if (flap_filter) {
+            std::lock_guard<std::mutex> lock(flap_mutex);
+            native::FlapAction action = flap_filter->on_switch(desktop, Clock::now());
+            if (action != native::FlapAction::Publish) {
+                held = message;
+                if (action == native::FlapAction::StartFlapping) {
+                    log.info("Switches flapping at " + desktop + "; holding them until the pointer settles");
+                }
+                return true;
+            }
+        }
+        if (!queue.push(std::move(message))) {
+            log.warning("Publish queue full, dropped the oldest message");
+            return false;
+        }
+        return true;
+    }
+
+    // Stop accepting switches; publish what is queued and due until timeout
+    void close(Clock::duration timeout) {
+        if (!worker.joinable()) {
+            return;
+        }
+        drain_deadline = Clock::now() + timeout;
+        queue.close();
+        worker.join();
+    }
+
+    void set_topic(const std::string& new_topic) {
+        std::lock_guard<std::mutex> lock(topic_mutex);
+        topic = new_topic;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        std::map<std::string, uint64_t> result = queue.stats();
+        std::lock_guard<std::mutex> lock(counts_mutex);
+        result["published"] = published;
+        result["retries"] = retries_scheduled;
+        result["failures"] = failures;
+        result["superseded"] = superseded;
+        result["retry_pending"] = retry_pending;
+        if (flap_filter) {
+            std::lock_guard<std::mutex> flap_lock(flap_mutex);
+            result["flaps_suppressed"] = flap_filter->suppressed_count();
+            result["flap_bursts"] = flap_filter->burst_count();
+        }
+        return result;
+    }
+
+private:
+    struct Message {
+        std::string desktop;
+        std::string payload;
+    };
+
+    struct Retry {
+        Clock::time_point due;
+        uint64_t order;     // which message, counted as each is first attempted
+        int failures;
+        Message message;
+
+        bool operator>(const Retry& other) const {
+            return due != other.due ? due > other.due : order > other.order;
+        }
+    };
+
+    Logger log{"publish_queue"};
+    native::NanoMQTTClient& client;
+    mutable std::mutex topic_mutex;
+    std::string topic;
+    native::BoundedQueue<Message> queue;
+    PublishedCallback on_published;
+    int max_retries;
+    Clock::duration retry_delay;
+
+    // The filter is shared with the reader; held is the latest suppressed switch
+    std::unique_ptr<native::FlapFilter> flap_filter;
+    mutable std::mutex flap_mutex;
+    Message held;
+
+    // Only the worker touches the retry heap (std::push_heap order, earliest due first)
+    std::vector<Retry> retries;
+    uint64_t next_order = 0;
+    Clock::time_point drain_deadline;
+    std::thread worker;
+
+    mutable std::mutex counts_mutex;
+    uint64_t published = 0;
+    uint64_t retries_scheduled = 0;
+    uint64_t failures = 0;
+    uint64_t superseded = 0;
+    uint64_t retry_pending = 0;
+
+    void settle_flaps() {
+        if (!flap_filter) {
+            return;
+        }
+        Message message;
+        std::string desktop;
+        {
+            std::lock_guard<std::mutex> lock(flap_mutex);
+            if (!flap_filter->poll(Clock::now(), desktop)) {
+                return;
+            }
+            message = std::move(held);
+            held = Message();
+            log.info("Switches settled at " + flap_filter->screen() + " after " +
+                     std::to_string(flap_filter->burst_suppressed_count()) + " suppressed");
+        }
+        if (!desktop.empty() && !message.payload.empty()) {
+            attempt(std::move(message), 0, next_order++);
+        }
+    }
+
+    bool newer_retry_pending(uint64_t order) const {
+        return std::any_of(retries.begin(), retries.end(), [order](const Retry& r) { return r.order > order; });
+    }
+
+    void attempt(Message message, int attempts_failed, uint64_t order) {
+        std::string target;
+        {
+            std::lock_guard<std::mutex> lock(topic_mutex);
+            target = topic;
+        }
+        if (client.publish(target, message.payload, 1)) {
+            // Only older messages are superseded; a newer one's retry must still go out
+            size_t pending = retries.size();
+            retries.erase(std::remove_if(retries.begin(), retries.end(),
+                                         [order](const Retry& r) { return r.order < order; }),
+                          retries.end());
+            std::make_heap(retries.begin(), retries.end(), std::greater<Retry>());
+            {
+                std::lock_guard<std::mutex> lock(counts_mutex);
+                published++;
+                superseded += pending - retries.size();
+                retry_pending = retries.size();
+            }
+            if (on_published) {
+                on_published(message.desktop);
+            }
+            return;
+        }
+
+        attempts_failed++;
+        std::lock_guard<std::mutex> lock(counts_mutex);
+        if (attempts_failed < max_retries) {
+            Clock::duration delay = retry_delay * (1 << (attempts_failed - 1));
+            log.debug("Publish retry " + std::to_string(attempts_failed) + "/" + std::to_string(max_retries) +
+                      " in " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(delay).count()) +
+                      "ms");
+            retries_scheduled++;
+            retries.push_back(Retry{Clock::now() + delay, order, attempts_failed, std::move(message)});
+            std::push_heap(retries.begin(), retries.end(), std::greater<Retry>());
+            retry_pending = retries.size();
+        } else {
+            failures++;
+            log.error("Failed to publish after " + std::to_string(max_retries) + " retries: " + message.payload);
+        }
+    }
+
+    bool flap_deadline(Clock::time_point& deadline) const {
+        if (!flap_filter) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(flap_mutex);
+        deadline = flap_filter->deadline();
+        return flap_filter->is_flapping();
+    }
+
+    void run() {
+        while (true) {
+            settle_flaps();
+            Clock::time_point now = Clock::now();
+            while (!retries.empty() && retries.front().due <= now) {
+                std::pop_heap(retries.begin(), retries.end(), std::greater<Retry>());
+                Retry retry = std::move(retries.back());
+                retries.pop_back();
+                if (newer_retry_pending(retry.order)) {
+                    // Sending it first would flash a stale desktop
+                    std::lock_guard<std::mutex> lock(counts_mutex);
+                    superseded++;
+                    retry_pending = retries.size();
+                    continue;
+                }
+                attempt(std::move(retry.message), retry.failures, retry.order);
+            }
+
+            Clock::time_point settle_at;
+            bool flapping = flap_deadline(settle_at);
+            bool drained = queue.is_closed() && queue.size() == 0;
+            if (drained) {
+                if (retries.empty() && !flapping) {
+                    return;
+                }
+                if (now >= drain_deadline) {
+                    std::lock_guard<std::mutex> lock(counts_mutex);
+                    failures += retries.size();
+                    retry_pending = 0;
+                    retries.clear();
+                    return;
+                }
+            }
+
+            // A burst can start while we wait, so don't sleep far past a dwell
+            Clock::duration wait = flap_filter ? std::chrono::milliseconds(100) : std::chrono::milliseconds(500);
+            if (!retries.empty()) {
+                wait = std::min(wait, retries.front().due - now);
+            }
+            if (flapping) {
+                wait = std::min(wait, settle_at - now);
+            }
+            if (drained) {
+                // pop() no longer blocks once closed; sleep until the next retry or settle
+                std::this_thread::sleep_for(std::max(Clock::duration::zero(),
+                                                     std::min(wait, drain_deadline - now)));
+                continue;
+            }
+            auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(wait);
+            Message message;
+            if (queue.pop(message, std::max(wait_ms, std::chrono::milliseconds(1)))) {
+                attempt(std::move(message), 0, next_order++);
+            }
+        }
+    }
+};
+
+}  // namespace monitord
@@ -0,0 +1,144 @@
+/**
+ * synergy-current: print the active desktop from a subscriber's state page
+ *
+ * found-him.py and synergy-monitord keep the current desktop in a shared
+ * memory page (native/state_page.h, STATE_PAGE in the .env file). This
+ * reads it without a broker connection, a lock or an interpreter, so shell
+ * prompts and status bars can call it as often as they like.
+ *
+ *   synergy-current                        print the desktop, e.g. "laptop"
+ *   synergy-current --json                 print every field as one JSON object
+ *   synergy-current --max-age 600          fail if the page is older than 10 minutes
+ *   synergy-current --watch 200            print each change, polling every 200 ms
+ *
+ * Exits 0 when it printed a desktop, 1 when there is none (no subscriber
+ * wrote the page yet, or it is older than --max-age) and 2 on bad usage.
+ */
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "native/payloads.h"
+#include "native/state_page.h"
+
+namespace {
+
+static const char USAGE[] =
+    "usage: synergy-current [options]\n"
+    "\n"
+    "  --page NAME              shared memory page (default: STATE_PAGE or /synergy-desktop)\n"
+    "  --json                   print all fields as JSON instead of the desktop name\n"
+    "  --max-age SECONDS        treat an older page as unknown (default: no limit)\n"
+    "  --watch MS               keep printing on each change, polling every MS\n"
+    "  -h, --help               show this help and exit\n";
+
+struct Options {
+    std::string page;
+    bool json = false;
+    double max_age_s = 0;
+    int watch_ms = 0;
+};
+
+Options parse_args(int argc, char** argv) {
+    Options opts;
+    const char* env_page = getenv("STATE_PAGE");
+    opts.page = env_page && *env_page ? env_page : native::DEFAULT_STATE_PAGE;
+
+    auto value_of = [&](int& i, const char* flag) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("argument ") + flag + ": expected one argument");
+        }
+        return argv[++i];
+    };
+    auto number_of = [&](int& i, const char* flag) -> double {
+        std::string value = value_of(i, flag);
+        char* end = nullptr;
+        double parsed = strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || parsed < 0) {
+            throw std::runtime_error(std::string("argument ") + flag + ": invalid value: " + value);
+        }
+        return parsed;
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            fputs(USAGE, stdout);
+            exit(0);
+        } else if (arg == "--page") {
+            opts.page = value_of(i, "--page");
+        } else if (arg == "--json") {
+            opts.json = true;
+        } else if (arg == "--max-age") {
+            opts.max_age_s = number_of(i, "--max-age");
+        } else if (arg == "--watch") {
+            opts.watch_ms = static_cast<int>(number_of(i, "--watch"));
+        } else {
+            throw std::runtime_error("unrecognized argument: " + arg);
+        }
+    }
+    return opts;
+}
+
+double age_s(const native::StatePageSnapshot& snapshot) {
+    int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    return (now_us - snapshot.updated_us) / 1e6;
+}
+
+void print(const native::StatePageSnapshot& snapshot, bool json) {
+    if (!json) {
+        printf("%s\n", snapshot.desktop.c_str());
+    } else {
+        printf("{\"current_desktop\": \"%s\", \"server\": \"%s\", \"source\": \"%s\", \"seq\": %" PRIu64
+               ", \"timestamp\": \"%s\", \"topic\": \"%s\", \"retained\": %s, \"age_s\": %.3f}\n",
+               native::json_escape(snapshot.desktop).c_str(), native::json_escape(snapshot.server).c_str(),
+               native::json_escape(snapshot.source).c_str(), snapshot.seq,
+               native::json_escape(snapshot.timestamp).c_str(), native::json_escape(snapshot.topic).c_str(),
+               snapshot.retained ? "true" : "false", age_s(snapshot));
+    }
+    fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    try {
+        opts = parse_args(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%ssynergy-current: error: %s\n", USAGE, e.what());
+        return 2;
+    }
+
+    try {
+        native::StatePageReader reader(opts.page);
+        native::StatePageSnapshot snapshot;
+        if (opts.watch_ms <= 0) {
+            if (!reader.read(snapshot) || (opts.max_age_s > 0 && age_s(snapshot) > opts.max_age_s)) {
+                return 1;
+            }
+            print(snapshot, opts.json);
+            return 0;
+        }
+
+        uint64_t printed = 0;
+        for (;;) {
+            if (reader.read(snapshot) && snapshot.updates != printed) {
+                printed = snapshot.updates;
+                print(snapshot, opts.json);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(opts.watch_ms));
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "synergy-current: %s\n", e.what());
+        return 1;
+    }
+}
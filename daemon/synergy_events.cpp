@@ -0,0 +1,144 @@
+/**
+ * synergy-events: stream messages from the host's event ring
+ *
+ * The host's nanomq subscriber (synergy-monitord hub, or found-him with
+ * EVENT_RING set) writes every message it accepts to a shared memory ring
+ * (native/event_ring.h). This attaches with its own cursor and prints each
+ * payload on a line, sleeping on the ring's futex in between, so shell
+ * tools follow desktop switches without a broker connection:
+ *
+ *   synergy-events | while read -r message; do ...; done
+ *   synergy-events --topic 'synergy/#' -v  "topic payload" per line
+ *   synergy-events --from-oldest -n 10     the last ten events still held
+ *
+ * Exits 0 after --count events or --timeout without one, 1 if the ring
+ * does not exist and 2 on bad usage.
+ */
+
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+
+#include "native/event_ring.h"
+#include "native/topics.h"
+
+namespace {
+
+static const char USAGE[] =
+    "usage: synergy-events [options]\n"
+    "\n"
+    "  --ring NAME              shared memory ring (default: EVENT_RING or /synergy-events)\n"
+    "  --topic FILTER           only topics matching the MQTT filter (default: all)\n"
+    "  -v, --verbose            print \"topic payload\" instead of the payload\n"
+    "  --from-oldest            start at the oldest event still held, not the next one\n"
+    "  -n, --count N            exit after N events\n"
+    "  --timeout MS             exit if no event arrives for MS milliseconds\n"
+    "  --stats                  print received/lost counts to stderr on exit\n"
+    "  -h, --help               show this help and exit\n";
+
+// How long each wait lasts when there is no --timeout
+static const int WAIT_SLICE_MS = 60000;
+
+struct Options {
+    std::string ring;
+    std::string topic_filter;
+    bool verbose = false;
+    bool from_oldest = false;
+    uint64_t count = 0;
+    int timeout_ms = 0;
+    bool stats = false;
+};
+
+Options parse_args(int argc, char** argv) {
+    Options opts;
+    const char* env_ring = getenv("EVENT_RING");
+    opts.ring = env_ring && *env_ring ? env_ring : native::DEFAULT_EVENT_RING;
+
+    auto value_of = [&](int& i, const char* flag) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("argument ") + flag + ": expected one argument");
+        }
+        return argv[++i];
+    };
+    auto number_of = [&](int& i, const char* flag) -> long long {
+        std::string value = value_of(i, flag);
+        char* end = nullptr;
+        long long parsed = strtoll(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || parsed < 1) {
+            throw std::runtime_error(std::string("argument ") + flag + ": invalid value: " + value);
+        }
+        return parsed;
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            fputs(USAGE, stdout);
+            exit(0);
+        } else if (arg == "--ring") {
+            opts.ring = value_of(i, "--ring");
+        } else if (arg == "--topic") {
+            opts.topic_filter = value_of(i, "--topic");
+        } else if (arg == "-v" || arg == "--verbose") {
+            opts.verbose = true;
+        } else if (arg == "--from-oldest") {
+            opts.from_oldest = true;
+        } else if (arg == "-n" || arg == "--count") {
+            opts.count = static_cast<uint64_t>(number_of(i, "--count"));
+        } else if (arg == "--timeout") {
+            opts.timeout_ms = static_cast<int>(number_of(i, "--timeout"));
+        } else if (arg == "--stats") {
+            opts.stats = true;
+        } else {
+            throw std::runtime_error("unrecognized argument: " + arg);
+        }
+    }
+    return opts;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    try {
+        opts = parse_args(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%ssynergy-events: error: %s\n", USAGE, e.what());
+        return 2;
+    }
+
+    try {
+        native::EventRingReader reader(opts.ring, opts.from_oldest);
+        std::string topic, payload;
+        uint64_t printed = 0;
+        while (opts.count == 0 || printed < opts.count) {
+            if (!reader.next(topic, payload, opts.timeout_ms > 0 ? opts.timeout_ms : WAIT_SLICE_MS)) {
+                if (opts.timeout_ms > 0) {
+                    break;
+                }
+                continue;
+            }
+            if (!opts.topic_filter.empty() && !native::topic_matches(opts.topic_filter, topic)) {
+                continue;
+            }
+            if (opts.verbose) {
+                printf("%s %s\n", topic.c_str(), payload.c_str());
+            } else {
+                printf("%s\n", payload.c_str());
+            }
+            fflush(stdout);
+            printed++;
+        }
+        if (opts.stats) {
+            auto stats = reader.stats();
+            fprintf(stderr, "synergy-events: received %" PRIu64 ", lost %" PRIu64 "\n", stats["received"],
+                    stats["lost"]);
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "synergy-events: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,734 @@
+/**
+ * synergy-monitord: waldo.py and found-him.py as one native binary
+ *
+ * The same roles, .env keys, payloads and log files as the Python entry
+ * points, on the NanoMQTTClient the bindings wrap (native/mqtt_client.h),
+ * without an interpreter: nothing to import at startup, no interpreter heap
+ * while idle, and one process per machine even for a combined primary.
+ *
+ *   synergy-monitord                       run as ROLE says: waldo on a primary
+ *                                          (with the alert when PRIMARY_RUNTIME
+ *                                          is combined), found-him on a secondary
+ *   synergy-monitord waldo [--follow [SERVER=]PATH...] [--alert DESKTOP]
+ *   synergy-monitord found-him DESKTOP [-k KEY] [-q]
+ *   synergy-monitord hub                   hold the host's broker connection for
+ *                                          local consumers: the state page and
+ *                                          event ring, no bell
+ *
+ * Signals follow utils.install_signal_handlers(): SIGTERM/SIGINT shut down,
+ * SIGUSR1 restarts the connection in place, SIGHUP re-reads MQTT_TOPIC and
+ * TARGET_DESKTOP from the .env file.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "native/action_executor.h"
+#include "native/mqtt_client.h"
+#include "native/payloads.h"
+#include "native/switch_follower.h"
+#include "native/switch_scanner.h"
+
+#include "config.h"
+#include "log.h"
+#include "publish_queue.h"
+
+namespace monitord {
+namespace {
+
+// Like connect_with_retry(): 1s, doubling up to a minute
+static const int RECONNECT_DELAY_S = 1;
+static const int MAX_RECONNECT_DELAY_S = 60;
+
+// How long queued switches may take to go out on shutdown, as PublishQueue.close()
+static const int DRAIN_TIMEOUT_S = 10;
+
+// Matches this close together ring the bell once, as nanomq_client.BELL_DEBOUNCE_MS
+static const int BELL_DEBOUNCE_MS = 250;
+
+static const char USAGE[] =
+    "usage: synergy-monitord [waldo|found-him|hub] [options]\n"
+    "\n"
+    "  (no mode)                run as ROLE in the .env file says\n"
+    "  waldo                    publish desktop switches (primary)\n"
+    "    --follow [[SERVER=]PATH ...]\n"
+    "                           follow the logs natively instead of reading stdin\n"
+    "                           (default: SYNERGY_LOG_SOURCES or SYNERGY_LOG_PATH)\n"
+    "    --checkpoint PATH      --follow read position; \"\" to always start at the end\n"
+    "    --alert DESKTOP        also ring the bell for DESKTOP, on the same connection\n"
+    "  found-him DESKTOP        ring the bell when DESKTOP becomes active (secondary)\n"
+    "    -k, --key KEY          JSON key to check (default: current_desktop)\n"
+    "    -q, --quiet            suppress match notification output\n"
+    "  hub                      keep STATE_PAGE and EVENT_RING up to date for local\n"
+    "                           readers (synergy-current, synergy-events, ring clients)\n"
+    "\n"
+    "  -b, --broker HOST        MQTT broker address (default: MQTT_BROKER)\n"
+    "  -p, --port PORT          MQTT broker port (default: MQTT_PORT)\n"
+    "  -t, --topic TOPIC        MQTT topic (default: MQTT_TOPIC)\n"
+    "  --env FILE               settings file (default: .env)\n"
+    "  --debug                  log everything to stderr as well\n"
+    "  -h, --help               show this help and exit\n";
+
+struct Options {
+    std::string mode;
+    std::string env_file = ".env";
+    std::string broker;
+    std::string topic;
+    int port = 0;
+    bool debug = false;
+
+    // waldo
+    bool follow = false;
+    std::vector<std::string> follow_specs;
+    bool checkpoint_set = false;
+    std::string checkpoint;
+    std::string alert;
+
+    // found-him
+    std::string value;
+    std::string key = "current_desktop";
+    bool quiet = false;
+};
+
+Options parse_args(int argc, char** argv) {
+    Options opts;
+    int i = 1;
+    if (i < argc && (strcmp(argv[i], "waldo") == 0 || strcmp(argv[i], "found-him") == 0 ||
+                     strcmp(argv[i], "hub") == 0)) {
+        opts.mode = argv[i++];
+    }
+
+    auto value_of = [&](const char* flag) -> std::string {
+        if (i + 1 >= argc) {
+            throw std::runtime_error(std::string("argument ") + flag + ": expected one argument");
+        }
+        return argv[++i];
+    };
+
+    for (; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            fputs(USAGE, stdout);
+            exit(0);
+        } else if (arg == "-b" || arg == "--broker") {
+            opts.broker = value_of("--broker");
+        } else if (arg == "-p" || arg == "--port") {
+            std::string port = value_of("--port");
+            char* end = nullptr;
+            long parsed = strtol(port.c_str(), &end, 10);
+            if (port.empty() || *end != '\0' || parsed < 1 || parsed > 65535) {
+                throw std::runtime_error("argument --port: invalid port: " + port);
+            }
+            opts.port = static_cast<int>(parsed);
+        } else if (arg == "-t" || arg == "--topic") {
+            opts.topic = value_of("--topic");
+        } else if (arg == "--env") {
+            opts.env_file = value_of("--env");
+        } else if (arg == "--debug") {
+            opts.debug = true;
+        } else if (opts.mode == "waldo" && arg == "--follow") {
+            opts.follow = true;
+            while (i + 1 < argc && argv[i + 1][0] != '-') {
+                opts.follow_specs.push_back(argv[++i]);
+            }
+        } else if (opts.mode == "waldo" && arg == "--checkpoint") {
+            opts.checkpoint_set = true;
+            opts.checkpoint = value_of("--checkpoint");
+        } else if (opts.mode == "waldo" && arg == "--alert") {
+            opts.alert = value_of("--alert");
+        } else if (opts.mode == "found-him" && (arg == "-k" || arg == "--key")) {
+            opts.key = value_of("--key");
+        } else if (opts.mode == "found-him" && (arg == "-q" || arg == "--quiet")) {
+            opts.quiet = true;
+        } else if (opts.mode == "found-him" && arg[0] != '-' && opts.value.empty()) {
+            opts.value = arg;
+        } else {
+            throw std::runtime_error("unrecognized argument: " + arg);
+        }
+    }
+
+    if (opts.mode == "found-him" && opts.value.empty()) {
+        throw std::runtime_error("found-him: the DESKTOP argument is required");
+    }
+    return opts;
+}
+
+void log_stats(const Logger& log, const std::string& what, const std::map<std::string, uint64_t>& stats) {
+    std::string line;
+    for (const auto& entry : stats) {
+        line += (line.empty() ? "" : ", ") + entry.first + "=" + std::to_string(entry.second);
+    }
+    log.info(what + ": " + line);
+}
+
+/**
+ * found-him's matcher: ring the bell when key's value is the target desktop.
+ * The bell is spawned by an ActionExecutor, so on_message() returns at once
+ * and the receive thread never waits on it.
+ */
+class Alert {
+public:
+    Alert(const std::string& key, const std::string& value, bool quiet)
+        : key(key), value(value), quiet(quiet), actions(2, BELL_DEBOUNCE_MS) {
+        actions.set_action("bell", native::default_bell_command(), true);
+    }
+
+    // Stop ringing; logs the bell stats with --debug
+    void stop(bool debug) {
+        actions.stop(1000);
+        if (debug) {
+            log_stats(log, "Bell stats", actions.stats());
+        }
+    }
+
+    void on_message(const std::string& payload) {
+        std::string found;
+        if (!native::json_string_field(payload, key, found)) {
+            log.debug("No string '" + key + "' in message: " + payload);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (found != value) {
+                return;
+            }
+        }
+        actions.trigger("bell");
+        if (!quiet) {
+            printf("Match found! %s = %s\n", key.c_str(), found.c_str());
+            fflush(stdout);
+        }
+    }
+
+    void set_value(const std::string& target) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (target != value) {
+            log.info("Now alerting on " + key + " = " + target);
+            value = target;
+        }
+    }
+
+private:
+    Logger log{"found-him"};
+    std::string key;
+    std::mutex mutex;
+    std::string value;
+    bool quiet;
+    native::ActionExecutor actions;
+};
+
+/**
+ * Connection upkeep and signals for the main thread.
+ *
+ * All four signals are blocked in every thread (see block_signals()) and
+ * taken here with sigtimedwait(), so handlers never run inside the client or
+ * a follower thread. Between signals the connection is checked once a
+ * second: a link NanoSDK could not redial is reconnected with backoff. The
+ * subscription is made once; the client itself makes it again on every new
+ * session, since sessions are clean and the broker forgets it.
+ */
+class Supervisor {
+public:
+    Supervisor(native::NanoMQTTClient& client, const std::string& client_id)
+        : client(client), client_id(client_id) {
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGUSR1);
+        sigaddset(&signals, SIGHUP);
+    }
+
+    // Restore this subscription on every (re)connect; "" for none
+    void set_subscription(const std::string& topic, int qos) {
+        subscription = topic;
+        subscription_qos = qos;
+        subscribed = false;
+    }
+
+    const std::string& subscribed_topic() const {
+        return subscription;
+    }
+
+    // Move the subscription to topic on the live session
+    void resubscribe(const std::string& topic) {
+        if (!subscription.empty() && topic != subscription) {
+            client.resubscribe(subscription, topic, subscription_qos);
+            subscription = topic;
+        }
+    }
+
+    // Connect with backoff; false if told to shut down first
+    bool connect() {
+        int delay = RECONNECT_DELAY_S;
+        while (true) {
+            log.info("Attempting to connect to the MQTT broker");
+            try {
+                if (client.connect(client_id)) {
+                    log.info("Successfully connected to MQTT broker");
+                    restore_subscription();
+                    return true;
+                }
+                log.warning("Connection failed. Retrying in " + std::to_string(delay) + " seconds");
+            } catch (const std::exception& e) {
+                log.warning(std::string("Connection failed: ") + e.what() + ". Retrying in " +
+                            std::to_string(delay) + " seconds");
+            }
+            int sig = wait(std::chrono::seconds(delay));
+            if (sig == SIGTERM || sig == SIGINT) {
+                return false;
+            }
+            delay = std::min(delay * 2, MAX_RECONNECT_DELAY_S);
+        }
+    }
+
+    /**
+     * Keep the connection up until SIGTERM/SIGINT or done() returns true.
+     * on_reload gets reload_config()'s settings on SIGHUP.
+     */
+    void run(const std::function<void(const std::map<std::string, std::string>&)>& on_reload,
+             const std::function<bool()>& done = nullptr) {
+        while (!done || !done()) {
+            int sig = wait(std::chrono::seconds(1));
+            if (sig == SIGTERM || sig == SIGINT) {
+                log.info("Received signal " + std::to_string(sig) + ", shutting down");
+                return;
+            }
+            if (sig == SIGUSR1) {
+                log.info("Received SIGUSR1, restarting connection");
+                if (!client.restart()) {
+                    log.warning("Restart did not reconnect; retrying");
+                }
+            } else if (sig == SIGHUP) {
+                log.info("Received SIGHUP, reloading configuration");
+                on_reload(reload_config(env_file));
+            }
+
+            if (!client.is_connected()) {
+                if (!connect()) {
+                    return;
+                }
+            } else {
+                restore_subscription();
+            }
+        }
+    }
+
+    std::string env_file = ".env";
+
+private:
+    Logger log{"monitord"};
+    native::NanoMQTTClient& client;
+    std::string client_id;
+    sigset_t signals;
+    std::string subscription;
+    int subscription_qos = 0;
+    bool subscribed = false;
+
+    int wait(std::chrono::seconds timeout) {
+        struct timespec ts = {static_cast<time_t>(timeout.count()), 0};
+        int sig = sigtimedwait(&signals, nullptr, &ts);
+        return sig > 0 ? sig : 0;
+    }
+
+    // Until the first subscribe succeeds; after that the client restores it per session
+    void restore_subscription() {
+        if (subscription.empty() || subscribed) {
+            return;
+        }
+        if (client.subscribe(subscription, subscription_qos)) {
+            subscribed = true;
+            log.info("Subscribed to " + subscription);
+        }
+    }
+};
+
+// Blocked before any thread starts, so every thread inherits the mask
+void block_signals() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+std::unique_ptr<native::NanoMQTTClient> create_client(const Config& config) {
+    native::TuningProfile tuning = native::TuningProfile::preset(config.tuning_profile);
+    if (!config.busy_poll_us.empty()) {
+        tuning.rx_busy_poll_us = std::stoi(config.busy_poll_us);
+    }
+    std::unique_ptr<native::NanoMQTTClient> client(new native::NanoMQTTClient(config.broker, config.port, tuning));
+    if (config.tls) {
+        client->configure_tls(config.tls_ca_file, config.tls_cert_file, config.tls_key_file, "",
+                              config.tls_server_name);
+    }
+    return client;
+}
+
+// Keep the STATE_PAGE and EVENT_RING shared memory up to date; a failure only loses that one
+void attach_shared_memory(native::NanoMQTTClient& client, const Config& config, const Logger& log) {
+    if (!config.state_page.empty()) {
+        try {
+            client.set_state_page(config.state_page);
+        } catch (const std::exception& e) {
+            log.warning(std::string("State page disabled: ") + e.what());
+        }
+    }
+    if (!config.event_ring.empty()) {
+        try {
+            client.set_event_ring(config.event_ring);
+        } catch (const std::exception& e) {
+            log.warning(std::string("Event ring disabled: ") + e.what());
+        }
+    }
+}
+
+/**
+ * In-process alert on the publisher's connection, as
+ * waldo.attach_local_alert(); the receive loop starts once connected.
+ */
+void attach_local_alert(native::NanoMQTTClient& client, Supervisor& supervisor, Alert& alert,
+                        const Config& config) {
+    client.set_message_callback([&alert](const std::string&, const std::string& payload) {
+        alert.on_message(payload);
+    });
+    client.set_event_filter(config.event_max_age_ms, true);
+    client.set_sequence_tracking(config.event_sequence);
+    attach_shared_memory(client, config, Logger("waldo"));
+    client.set_local_delivery(config.topic);
+    supervisor.set_subscription(config.topic, 1);
+}
+
+int run_waldo(const Config& config, const Options& opts) {
+    Logger log("waldo");
+    std::unique_ptr<native::NanoMQTTClient> client = create_client(config);
+    Supervisor supervisor(*client, "");
+    supervisor.env_file = opts.env_file;
+    if (config.event_sequence) {
+        client->enable_sequence(config.event_source, config.event_sequence_file);
+        if (!config.multicast_group.empty()) {
+            try {
+                client->enable_multicast(config.multicast_group, config.multicast_port, config.multicast_interface);
+            } catch (const std::exception& e) {
+                log.warning(std::string("Multicast fast path disabled: ") + e.what());
+            }
+        }
+    }
+    if (config.retain_state) {
+        client->set_retained_topic(config.topic);
+    }
+    if (config.presence) {
+        // A primary also follows the fleet, to see which secondaries are listening
+        client->enable_presence(config.presence_topic, config.presence_name, "waldo");
+        client->watch_presence(config.presence_topic);
+    }
+
+    std::unique_ptr<Alert> alert;
+    if (!opts.alert.empty()) {
+        alert.reset(new Alert("current_desktop", opts.alert, false));
+        attach_local_alert(*client, supervisor, *alert, config);
+        log.info("Local alert for " + opts.alert + " shares the publisher's connection");
+    }
+    if (!supervisor.connect()) {
+        return 0;
+    }
+    if (config.event_sequence) {
+        // State requests arrive on the receive loop
+        client->serve_state(config.topic);
+    }
+    if (alert || config.event_sequence || config.presence) {
+        client->start_message_loop();
+    }
+
+    std::string topic = config.topic;
+    auto on_reload = [&](const std::map<std::string, std::string>& updates,
+                         const std::function<void(const std::string&)>& set_topic) {
+        auto value = updates.find("value");
+        if (value != updates.end() && alert) {
+            alert->set_value(value->second);
+        }
+        auto it = updates.find("topic");
+        if (it == updates.end() || it->second == topic) {
+            return;
+        }
+        log.info("Topic changed from " + topic + " to " + it->second);
+        topic = it->second;
+        set_topic(topic);
+        if (config.event_sequence) {
+            client->serve_state(topic);
+        }
+        if (config.retain_state) {
+            client->set_retained_topic(topic);
+        }
+        if (alert) {
+            client->set_local_delivery(topic);
+            supervisor.resubscribe(topic);
+        }
+    };
+
+    if (opts.follow) {
+        std::vector<LogSource> sources = config.sources(opts.follow_specs);
+        std::string checkpoint = opts.checkpoint_set ? opts.checkpoint : config.log_checkpoint;
+        native::SwitchLogFollower follower;
+        std::string names;
+        for (size_t index = 0; index < sources.size(); index++) {
+            const LogSource& source = sources[index];
+            std::string source_checkpoint = checkpoint;
+            if (!checkpoint.empty() && sources.size() > 1) {
+                source_checkpoint += "." + (source.first.empty() ? std::to_string(index) : source.first);
+            }
+            follower.add_log(source.second, source.first, true, source_checkpoint);
+            names += (names.empty() ? "" : ", ") + (source.first.empty() ? "" : source.first + "=") + source.second;
+        }
+        if (!config.events_topic.empty()) {
+            follower.set_events_topic(config.events_topic);
+        }
+        if (config.flap_dwell_ms > 0) {
+            follower.enable_flap_filter(config.flap_dwell_ms, config.flap_hysteresis, config.flap_report);
+        }
+        follower.start_publishing(client.get(), topic, 1,
+                                  [&log](const std::string& desktop, bool published, const std::string& server) {
+            if (published) {
+                printf("%s%s%s\n", server.c_str(), server.empty() ? "" : ": ", desktop.c_str());
+                fflush(stdout);
+            } else {
+                log.error("Failed to publish: " + desktop);
+            }
+        });
+        log.info("Following " + std::to_string(sources.size()) + " log(s) natively: " + names);
+
+        supervisor.run([&](const std::map<std::string, std::string>& updates) {
+            on_reload(updates, [&follower](const std::string& t) { follower.set_topic(t); });
+        });
+        follower.stop();
+        if (config.debug) {
+            log_stats(log, "Follower stats", follower.stats());
+        }
+    } else {
+        // Shared with the reader, which may still be blocked on the pipe at exit
+        auto queue = std::make_shared<PublishQueue>(*client, topic, config.publish_queue_size, config.flap_dwell_ms,
+                                                    config.flap_hysteresis, [](const std::string& desktop) {
+            printf("%s\n", desktop.c_str());
+            fflush(stdout);
+        });
+
+        // The reader blocks in getline(), so it gets its own thread and the
+        // main thread stays free for signals
+        auto eof = std::make_shared<std::atomic<bool>>(false);
+        std::thread reader([queue, eof]() {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                line += '\n';
+                native::scan_switch_events(line.data(), line.size(), [&queue](const native::SwitchEvent& event) {
+                    queue->submit(std::string(event.to, event.desktop_len));
+                });
+            }
+            eof->store(true);
+        });
+
+        supervisor.run([&](const std::map<std::string, std::string>& updates) {
+            on_reload(updates, [&queue](const std::string& t) { queue->set_topic(t); });
+        }, [&eof]() { return eof->load(); });
+
+        if (eof->load()) {
+            reader.join();
+        } else {
+            reader.detach();
+        }
+        queue->close(std::chrono::seconds(DRAIN_TIMEOUT_S));
+        log_stats(log, "Publish queue metrics", queue->stats());
+    }
+
+    if (config.debug) {
+        log_stats(log, "Connection stats", client->connection_stats());
+        log_stats(log, "Sequence stats", client->sequence_stats());
+        log_stats(log, "Multicast stats", client->multicast_stats());
+        log_stats(log, "Presence stats", client->presence_stats());
+    }
+    log.info("Closing MQTT connection");
+    client->disconnect();
+    if (alert) {
+        alert->stop(config.debug);
+    }
+    return 0;
+}
+
+int run_found_him(const Config& config, const Options& opts) {
+    bool hub = opts.mode == "hub";
+    Logger log(hub ? "hub" : "found-him");
+    std::unique_ptr<native::NanoMQTTClient> client = create_client(config);
+    std::string client_id = std::string(hub ? "synergy-hub-" : "synergy-found-him-") + std::to_string(getpid()) + "-" +
+                            std::to_string(static_cast<long long>(time(nullptr)));
+    Supervisor supervisor(*client, client_id);
+    supervisor.env_file = opts.env_file;
+
+    // A hub only feeds the shared memory, so it has no alert and no callback
+    std::unique_ptr<Alert> alert;
+    if (!hub) {
+        alert.reset(new Alert(opts.key, opts.value, opts.quiet));
+        Alert* target = alert.get();
+        client->set_message_callback([target](const std::string&, const std::string& payload) {
+            target->on_message(payload);
+        });
+    } else if (config.state_page.empty() && config.event_ring.empty()) {
+        log.error("A hub needs STATE_PAGE or EVENT_RING");
+        return 1;
+    }
+    client->set_event_filter(config.event_max_age_ms, true);
+    client->set_sequence_tracking(config.event_sequence);
+    attach_shared_memory(*client, config, log);
+    if (!config.multicast_group.empty()) {
+        try {
+            client->set_multicast_receive(config.multicast_group, config.multicast_port, config.multicast_interface);
+        } catch (const std::exception& e) {
+            log.warning(std::string("Multicast fast path disabled: ") + e.what());
+        }
+    }
+    if (config.presence) {
+        client->enable_presence(config.presence_topic, config.presence_name, hub ? "hub" : "found-him");
+    }
+    supervisor.set_subscription(config.topic, 1);
+    if (config.debug) {
+        printf("Listening for messages on topic '%s'\n", config.topic.c_str());
+        if (alert) {
+            printf("Will ring bell when '%s' matches '%s'\n", opts.key.c_str(), opts.value.c_str());
+        }
+        fflush(stdout);
+    }
+    if (!supervisor.connect()) {
+        return 0;
+    }
+    client->start_message_loop();
+
+    supervisor.run([&](const std::map<std::string, std::string>& updates) {
+        auto topic = updates.find("topic");
+        if (topic != updates.end()) {
+            supervisor.resubscribe(topic->second);
+        }
+        auto value = updates.find("value");
+        if (value != updates.end() && alert) {
+            alert->set_value(value->second);
+        }
+    });
+
+    if (config.debug) {
+        log_stats(log, "Receive stats", client->receive_stats());
+        log_stats(log, "Sequence stats", client->sequence_stats());
+        log_stats(log, "State page stats", client->state_page_stats());
+        log_stats(log, "Event ring stats", client->event_ring_stats());
+        log_stats(log, "Multicast stats", client->multicast_stats());
+        log_stats(log, "Presence stats", client->presence_stats());
+    }
+    log.info("Closing MQTT connection");
+    client->disconnect();
+    if (alert) {
+        alert->stop(config.debug);
+    }
+    return 0;
+}
+
+}  // namespace
+}  // namespace monitord
+
+int main(int argc, char** argv) {
+    using namespace monitord;
+
+    Options opts;
+    try {
+        opts = parse_args(argc, argv);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%ssynergy-monitord: error: %s\n", USAGE, e.what());
+        return 2;
+    }
+
+    Config config;
+    try {
+        config = load_config(opts.env_file);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "synergy-monitord: %s\n", e.what());
+        return 1;
+    }
+
+    // CLI takes precedence, as override_config()
+    if (!opts.broker.empty()) {
+        config.broker = opts.broker;
+    }
+    if (opts.port) {
+        config.port = opts.port;
+    }
+    if (!opts.topic.empty()) {
+        config.topic = opts.topic;
+    }
+    config.debug = config.debug || opts.debug;
+    if (opts.mode == "found-him") {
+        config.target_desktop = opts.value;
+    }
+
+    std::string mode = opts.mode;
+    if (mode.empty()) {
+        mode = config.is_primary() ? "waldo" : "found-him";
+        if (mode == "waldo") {
+            opts.follow = config.log_follow == "native";
+            if (lower(config.primary_runtime) == "combined" && !config.target_desktop.empty()) {
+                opts.alert = config.target_desktop;
+            }
+        } else {
+            opts.value = config.target_desktop;
+        }
+    }
+
+    mkdir(config.log_dir.c_str(), 0755);
+    std::string log_file = config.log_dir + "/" + mode + ".log";
+    if (!LogSink::instance().open(log_file, config.debug)) {
+        fprintf(stderr, "synergy-monitord: cannot open %s: %s\n", log_file.c_str(), strerror(errno));
+    }
+    Logger log(mode == "waldo" ? "waldo" : mode == "hub" ? "hub" : "found-him");
+    if (config.debug) {
+        log.info("Debug logging enabled");
+    }
+
+    std::vector<std::string> errors = config.validate();
+    if (!opts.follow_specs.empty()) {
+        for (const auto& error : log_source_errors(config.sources(opts.follow_specs))) {
+            errors.push_back(error);
+        }
+    }
+    if (!errors.empty()) {
+        log.error("Configuration errors:");
+        for (const auto& error : errors) {
+            log.error("  - " + error);
+        }
+        return 1;
+    }
+    if (mode == "found-him" && opts.value.empty()) {
+        log.error("No desktop to alert on; set TARGET_DESKTOP or pass found-him DESKTOP");
+        return 1;
+    }
+
+    block_signals();
+    try {
+        return mode == "waldo" ? run_waldo(config, opts) : run_found_him(config, opts);
+    } catch (const std::exception& e) {
+        log.error(std::string("Unexpected error: ") + e.what());
+        return 1;
+    }
+}
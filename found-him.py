@@ -8,7 +8,9 @@ import time
 import logging
 from datetime import datetime
 from mqtt_clients.factory import MQTTClientFactory
-from config import Config, get_mqtt_config, override_config
+from config import (Config, get_mqtt_config, get_client_options, get_multicast_options, get_presence_options,
+                    override_config, reload_config)
+from utils import install_signal_handlers
 
 # Configure logging - only show errors by default
 # Create logs directory if it doesn't exist
@@ -80,22 +82,48 @@ def main():
         print(f"Listening for messages on topic '{args.topic}'")
         print(f"Will ring bell when '{args.key}' matches '{args.value}'")
     
+    # The staleness filter, sequence tracking, state page and event ring are native,
+    # so only the nanomq client takes them (peer all but sequence tracking); the
+    # ring client reads what another writes
+    client_options = get_client_options()
+    broker, port = args.broker, args.port
+    if args.client_type == 'peer':
+        broker, port = Config.PEER_HOST or args.broker, Config.PEER_PORT
+        client_options['max_event_age_ms'] = Config.EVENT_MAX_AGE_MS
+        client_options['state_page'] = Config.STATE_PAGE
+        client_options['event_ring'] = Config.EVENT_RING
+    elif args.client_type == 'nanomq':
+        client_options['max_event_age_ms'] = Config.EVENT_MAX_AGE_MS
+        client_options['track_sequence'] = Config.EVENT_SEQUENCE
+        client_options['state_page'] = Config.STATE_PAGE
+        client_options['event_ring'] = Config.EVENT_RING
+        if Config.MULTICAST_GROUP:
+            client_options['multicast'] = get_multicast_options()
+        if Config.PRESENCE:
+            client_options['presence'] = get_presence_options('found-him')
+    elif args.client_type == 'ring':
+        client_options = {'ring': Config.EVENT_RING}
+    
     # Create subscriber using factory
     subscriber = MQTTClientFactory.create_subscriber(
         client_type=args.client_type,
-        broker=args.broker,
-        port=args.port,
+        broker=broker,
+        port=port,
         topic=args.topic,
         key=args.key,
         value=args.value,
         bell_func=None,
-        quiet=args.quiet
+        quiet=args.quiet,
+        **client_options
     )
     
     # Set bell function
     subscriber.bell_func = subscriber.get_bell_function()
     
     # Run
+    install_signal_handlers(subscriber.restart,
+                            lambda: subscriber.reconfigure(**reload_config()),
+                            restart_marker=os.path.join(log_dir, 'found-him.restarted'))
     subscriber.run()
 
 if __name__ == "__main__":
@@ -6,7 +6,7 @@ It allows runtime selection of different MQTT client implementations through
 dependency injection.
 """
 
-from typing import Optional, Callable
+from typing import Any, Optional, Callable
 from .interface import MQTTPublisherInterface, MQTTSubscriberInterface
 
 
@@ -21,21 +21,42 @@ class MQTTClientFactory:
     Supported client types:
     - paho: Eclipse Paho MQTT client (default)
     - nanomq: NanoSDK high-performance MQTT client
+    - ring: reads the host's shared memory event ring (subscribers only)
+    - peer: brokerless nng pub/sub, the primary listens and secondaries dial it
     """
     
-    SUPPORTED_CLIENTS = ['paho', 'nanomq']
+    SUPPORTED_CLIENTS = ['paho', 'nanomq', 'ring', 'peer']
+    # Clients that only receive; a ring is written by a nanomq subscriber on the same host
+    SUBSCRIBE_ONLY_CLIENTS = ['ring']
     DEFAULT_CLIENT = 'paho'
     
     @staticmethod
-    def create_publisher(client_type: str, broker_address: str, port: int, topic: str) -> MQTTPublisherInterface:
+    def _check_client_options(client_type: str, client_options: dict):
+        """
+        Reject client options the selected implementation cannot honour.
+        
+        Options such as TLS must never be dropped silently, otherwise a
+        misconfigured client would fall back to a cleartext connection.
+        
+        Raises:
+            ValueError: If options are given for a client that does not support them
+        """
+        if client_options and client_type == 'paho':
+            raise ValueError(f"Client options {sorted(client_options)} are only "
+                           f"supported by the nanomq client, not {client_type}")
+    
+    @staticmethod
+    def create_publisher(client_type: str, broker_address: str, port: int, topic: str,
+                         **client_options: Any) -> MQTTPublisherInterface:
         """
         Create an MQTT publisher instance.
         
         Args:
-            client_type: Type of MQTT client to create ('paho', 'nanomq')
+            client_type: Type of MQTT client to create ('paho', 'nanomq', 'peer')
             broker_address: MQTT broker hostname or IP address
             port: MQTT broker port number
             topic: MQTT topic to publish messages to
+            **client_options: Implementation-specific settings (e.g. tls, tuning), nanomq only
             
         Returns:
             MQTTPublisherInterface: Publisher instance
@@ -46,13 +67,19 @@ class MQTTClientFactory:
         if client_type not in MQTTClientFactory.SUPPORTED_CLIENTS:
             raise ValueError(f"Unsupported client type: {client_type}. "
                            f"Supported types: {MQTTClientFactory.SUPPORTED_CLIENTS}")
+        if client_type in MQTTClientFactory.SUBSCRIBE_ONLY_CLIENTS:
+            raise ValueError(f"The {client_type} client only subscribes; publish with paho, nanomq or peer")
+        MQTTClientFactory._check_client_options(client_type, client_options)
         
         if client_type == 'paho':
             from .paho_client import PahoMQTTPublisher
             return PahoMQTTPublisher(broker_address, port, topic)
         elif client_type == 'nanomq':
             from .nanomq_client import NanoMQTTPublisher
-            return NanoMQTTPublisher(broker_address, port, topic)
+            return NanoMQTTPublisher(broker_address, port, topic, **client_options)
+        elif client_type == 'peer':
+            from .nanomq_client import PeerPublisher
+            return PeerPublisher(broker_address, port, topic, **client_options)
         
         # This should never be reached due to the check above, but just in case
         raise ValueError(f"Unknown client type: {client_type}")
@@ -60,12 +87,12 @@ class MQTTClientFactory:
     @staticmethod
     def create_subscriber(client_type: str, broker: str, port: int, topic: str,
                          key: str, value: str, bell_func: Optional[Callable] = None,
-                         quiet: bool = False) -> MQTTSubscriberInterface:
+                         quiet: bool = False, **client_options: Any) -> MQTTSubscriberInterface:
         """
         Create an MQTT subscriber instance.
 
         Args:
-            client_type: Type of MQTT client to create ('paho', 'nanomq')
+            client_type: Type of MQTT client to create ('paho', 'nanomq', 'ring', 'peer')
             broker: MQTT broker hostname or IP address
             port: MQTT broker port number
             topic: MQTT topic to subscribe to
@@ -73,6 +100,7 @@ class MQTTClientFactory:
             value: Value to match for the specified key
             bell_func: Function to call when a match is found (optional)
             quiet: If True, suppress match notification output (bell still sounds)
+            **client_options: Implementation-specific settings (e.g. tls, tuning), nanomq only
 
         Returns:
             MQTTSubscriberInterface: Subscriber instance
@@ -83,26 +111,37 @@ class MQTTClientFactory:
         if client_type not in MQTTClientFactory.SUPPORTED_CLIENTS:
             raise ValueError(f"Unsupported client type: {client_type}. "
                            f"Supported types: {MQTTClientFactory.SUPPORTED_CLIENTS}")
+        MQTTClientFactory._check_client_options(client_type, client_options)
 
         if client_type == 'paho':
             from .paho_client import PahoMQTTSubscriber
             return PahoMQTTSubscriber(broker, port, topic, key, value, bell_func, quiet)
         elif client_type == 'nanomq':
             from .nanomq_client import NanoMQTTSubscriber
-            return NanoMQTTSubscriber(broker, port, topic, key, value, bell_func, quiet)
+            return NanoMQTTSubscriber(broker, port, topic, key, value, bell_func, quiet, **client_options)
+        elif client_type == 'ring':
+            from .nanomq_client import RingSubscriber
+            return RingSubscriber(broker, port, topic, key, value, bell_func, quiet, **client_options)
+        elif client_type == 'peer':
+            from .nanomq_client import PeerSubscriber
+            return PeerSubscriber(broker, port, topic, key, value, bell_func, quiet, **client_options)
 
         # This should never be reached due to the check above, but just in case
         raise ValueError(f"Unknown client type: {client_type}")
     
     @staticmethod
-    def get_supported_clients() -> list:
+    def get_supported_clients(publishing: bool = False) -> list:
         """
         Get list of supported MQTT client types.
         
+        Args:
+            publishing: Only list clients that can publish
+        
         Returns:
             list: List of supported client type strings
         """
-        return MQTTClientFactory.SUPPORTED_CLIENTS.copy()
+        return [client for client in MQTTClientFactory.SUPPORTED_CLIENTS
+                if not publishing or client not in MQTTClientFactory.SUBSCRIBE_ONLY_CLIENTS]
     
     @staticmethod
     def get_default_client() -> str:
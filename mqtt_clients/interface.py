@@ -6,6 +6,7 @@ must inherit from. This ensures a consistent API across different MQTT client li
 """
 
 from abc import ABC, abstractmethod
+from typing import Optional
 
 
 class MQTTPublisherInterface(ABC):
@@ -57,6 +58,29 @@ class MQTTPublisherInterface(ABC):
         Cleanly shut down the MQTT connection.
         """
         pass
+    
+    def restart(self) -> bool:
+        """
+        Re-establish the broker connection without recreating the client.
+        
+        Returns:
+            bool: True if the connection was restored, False if not supported or failed
+        """
+        return False
+    
+    def reconfigure(self, topic: Optional[str] = None) -> bool:
+        """
+        Switch to a new topic on the live connection, from the next publish on.
+        
+        Args:
+            topic: New topic to publish to (None keeps the current one)
+            
+        Returns:
+            bool: True if the new settings are in effect
+        """
+        if topic:
+            self.topic = topic
+        return True
 
 
 class MQTTSubscriberInterface(ABC):
@@ -99,4 +123,32 @@ class MQTTSubscriberInterface(ABC):
         
         This method blocks until interrupted and handles reconnections as needed.
         """
-        pass
\ No newline at end of file
+        pass
+    
+    def restart(self) -> bool:
+        """
+        Re-establish the broker connection and subscription in place.
+        
+        Returns:
+            bool: True if the connection was restored, False if not supported or failed
+        """
+        return False
+    
+    def reconfigure(self, topic: Optional[str] = None, key: Optional[str] = None,
+                    value: Optional[str] = None) -> bool:
+        """
+        Swap the topic and match target on the live connection.
+        
+        Implementations subscribe to the new topic before dropping the old one
+        and replace key and value together, so no message is lost or checked
+        against a half-updated target.
+        
+        Args:
+            topic: New topic to subscribe to (None keeps the current one)
+            key: New JSON key to monitor (None keeps the current one)
+            value: New value to match (None keeps the current one)
+            
+        Returns:
+            bool: True if the new settings are in effect, False if not supported or failed
+        """
+        return False
\ No newline at end of file
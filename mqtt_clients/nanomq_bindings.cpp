@@ -11,290 +11,755 @@
 #include <memory>
 #include <string>
 #include <functional>
-#include <thread>
-#include <chrono>
 #include <atomic>
-#include <mutex>
-#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
 
-extern "C" {
-#include <nng/nng.h>
-#include <nng/mqtt/mqtt_client.h>
-#include <nng/supplemental/util/platform.h>
-}
+#include "native/action_executor.h"
+#include "native/backfill.h"
+#include "native/event_parser.h"
+#include "native/event_ring.h"
+#include "native/event_queue.h"
+#include "native/flap_filter.h"
+#include "native/log_follower.h"
+#include "native/mqtt_client.h"
+#include "native/payloads.h"
+#include "native/peer.h"
+#include "native/state_page.h"
+#include "native/switch_follower.h"
+#include "native/switch_scanner.h"
 
 namespace py = pybind11;
 
-class NanoMQTTClient {
-private:
-    nng_socket sock;
-    nng_dialer dialer;
-    std::atomic<bool> connected{false};
-    std::atomic<bool> running{false};
-    std::string broker_url;
-    std::thread worker_thread;
-    std::mutex callback_mutex;
-    std::function<void(const std::string&, const std::string&)> message_callback;
-    
-    // Connection tracking
-    std::condition_variable conn_cv;
-    std::mutex conn_mutex;
-    bool conn_result = false;
-    bool conn_callback_called = false;
+using native::NanoMQTTClient;
+using native::TuningProfile;
+using native::CONNECT_TIMEOUT_MS;
+using native::DISCONNECT_TIMEOUT_MS;
+using native::switch_event_payload;
+using native::log_record_payload;
+
+// The follower's callback may be waiting for the GIL the destructor runs under
+class SwitchLogFollower : public native::SwitchLogFollower {
+public:
+    using native::SwitchLogFollower::SwitchLogFollower;
     
-    // Static callback functions
-    static void connect_cb(nng_pipe p, nng_pipe_ev ev, void *arg) {
-        NanoMQTTClient* client = static_cast<NanoMQTTClient*>(arg);
-        int reason;
-        nng_pipe_get_int(p, NNG_OPT_MQTT_CONNECT_REASON, &reason);
-        
-        std::lock_guard<std::mutex> lock(client->conn_mutex);
-        client->conn_result = (reason == 0); // 0 means success
-        client->conn_callback_called = true;
-        client->conn_cv.notify_one();
+    ~SwitchLogFollower() {
+        py::gil_scoped_release release;
+        stop();
+    }
+};
+
+/**
+ * Historical backfill over a Synergy log and its rotated predecessors.
+ * 
+ * Loading and parsing happen in the constructor, on all cores, without the
+ * GIL (see native/backfill.h). The result is a time-ordered list of events
+ * that can be written out as JSON lines or replayed through a client in
+ * batches, so the caller decides how fast they reach the broker. Payloads
+ * are the ones the live follower publishes, stamped with the log line's own
+ * time instead of the current one.
+ */
+class LogBackfill {
+public:
+    LogBackfill(const std::vector<std::string>& paths, const std::vector<std::string>& log_servers,
+                unsigned threads)
+        : backfill(paths, threads), servers(log_servers) {
+        servers.resize(paths.size());
     }
     
-    static void disconnect_cb(nng_pipe p, nng_pipe_ev ev, void *arg) {
-        NanoMQTTClient* client = static_cast<NanoMQTTClient*>(arg);
-        client->connected.store(false);
+    size_t size() const {
+        return backfill.size();
     }
     
-public:
-    NanoMQTTClient(const std::string& broker, int port) {
-        broker_url = "mqtt-tcp://" + broker + ":" + std::to_string(port);
-        
-        int rv = nng_mqtt_client_open(&sock);
-        if (rv != 0) {
-            throw std::runtime_error("Failed to open MQTT client: " + std::string(nng_strerror(rv)));
-        }
+    bool is_switch(size_t index) const {
+        return backfill.at(index).record.kind == native::EventKind::Switch;
     }
     
-    ~NanoMQTTClient() {
-        disconnect();
-        if (worker_thread.joinable()) {
-            worker_thread.join();
+    std::string payload(size_t index) const {
+        const native::BackfillRecord& r = backfill.at(index);
+        const std::string& server = servers[r.file];
+        std::string time = r.record.time ? std::string(r.record.time, r.record.time_len) : "";
+        if (r.record.kind == native::EventKind::Switch) {
+            return switch_event_payload(std::string(r.record.screen, r.record.desktop_len), server, time);
         }
-        nng_close(sock);
+        return log_record_payload(r.record, server, time);
     }
     
-    bool connect(const std::string& client_id = "") {
-        if (connected.load()) {
-            return true;
-        }
-        
-        int rv;
-        
-        // Create dialer
-        if ((rv = nng_dialer_create(&dialer, sock, broker_url.c_str())) != 0) {
-            throw std::runtime_error("Failed to create dialer: " + std::string(nng_strerror(rv)));
+    // Write every event as one JSON line; returns the number written
+    size_t write_jsonl(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open " + path + ": " + std::string(strerror(errno)));
         }
-        
-        // Create CONNECT message
-        nng_msg *connmsg;
-        if ((rv = nng_mqtt_msg_alloc(&connmsg, 0)) != 0) {
-            nng_dialer_close(dialer);
-            throw std::runtime_error("Failed to allocate CONNECT message: " + std::string(nng_strerror(rv)));
+        for (size_t i = 0; i < backfill.size(); i++) {
+            out << payload(i) << '\n';
         }
-        
-        // Set up CONNECT message
-        nng_mqtt_msg_set_packet_type(connmsg, NNG_MQTT_CONNECT);
-        nng_mqtt_msg_set_connect_proto_version(connmsg, 4); // MQTT 3.1.1
-        nng_mqtt_msg_set_connect_keep_alive(connmsg, 60);
-        nng_mqtt_msg_set_connect_clean_session(connmsg, true);
-        
-        // Set client ID if provided
-        if (!client_id.empty()) {
-            nng_mqtt_msg_set_connect_client_id(connmsg, client_id.c_str());
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed to write " + path);
         }
-        
-        // Set up connection callbacks
-        nng_mqtt_set_connect_cb(sock, connect_cb, this);
-        nng_mqtt_set_disconnect_cb(sock, disconnect_cb, this);
-        
-        // Set CONNECT message on dialer
-        nng_dialer_set_ptr(dialer, NNG_OPT_MQTT_CONNMSG, connmsg);
-        
-        // Start dialer
-        if ((rv = nng_dialer_start(dialer, NNG_FLAG_NONBLOCK)) != 0) {
-            nng_msg_free(connmsg);
-            nng_dialer_close(dialer);
-            throw std::runtime_error("Failed to start dialer: " + std::string(nng_strerror(rv)));
-        }
-        
-        // Wait for connection result with timeout
-        std::unique_lock<std::mutex> lock(conn_mutex);
-        if (conn_cv.wait_for(lock, std::chrono::seconds(10), [this] { return conn_callback_called; })) {
-            if (conn_result) {
-                connected.store(true);
-                return true;
+        return backfill.size();
+    }
+    
+    /**
+     * Publish events [begin, end): switches to topic, other events to
+     * events_topic (skipped when empty). Returns the number published.
+     */
+    size_t publish(NanoMQTTClient& client, const std::string& topic, const std::string& events_topic,
+                   size_t begin, size_t end, int qos) {
+        end = std::min(end, backfill.size());
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++) {
+            const std::string& target = is_switch(i) ? topic : events_topic;
+            if (target.empty()) {
+                continue;
+            }
+            if (client.publish(target, payload(i), qos)) {
+                count++;
             } else {
-                throw std::runtime_error("MQTT connection rejected by broker");
+                publish_failures.fetch_add(1);
             }
-        } else {
-            nng_dialer_close(dialer);
-            throw std::runtime_error("Connection timeout");
         }
+        published.fetch_add(count);
+        return count;
     }
     
-    void disconnect() {
-        if (connected.load()) {
-            running.store(false);
-            connected.store(false);
-            // Socket will be closed in destructor
-        }
+    std::map<std::string, uint64_t> stats() const {
+        std::map<std::string, uint64_t> result = backfill.stats();
+        result["published"] = published.load();
+        result["publish_failures"] = publish_failures.load();
+        return result;
     }
     
-    bool is_connected() const {
-        return connected.load();
+private:
+    native::Backfill backfill;
+    std::vector<std::string> servers;
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> publish_failures{0};
+};
+
+using EventQueue = native::BoundedQueue<std::string>;
+
+// Wait without the GIL; None on timeout or once the queue is closed and empty
+static py::object event_queue_pop(EventQueue& queue, int timeout_ms) {
+    std::string item;
+    bool got;
+    {
+        py::gil_scoped_release release;
+        got = queue.pop(item, std::chrono::milliseconds(timeout_ms));
     }
-    
-    bool publish(const std::string& topic, const std::string& payload, int qos = 0) {
-        if (!connected.load()) {
-            return false;
-        }
-        
-        nng_msg* msg;
-        int rv = nng_mqtt_msg_alloc(&msg, 0);
-        if (rv != 0) {
-            return false;
-        }
-        
-        // Set message type to PUBLISH
-        nng_mqtt_msg_set_packet_type(msg, NNG_MQTT_PUBLISH);
-        
-        // Set topic and payload
-        nng_mqtt_msg_set_publish_topic(msg, topic.c_str());
-        nng_mqtt_msg_set_publish_payload(msg, 
-            const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(payload.data())), 
-            payload.length());
-        nng_mqtt_msg_set_publish_qos(msg, qos);
-        
-        // Send message
-        rv = nng_sendmsg(sock, msg, NNG_FLAG_NONBLOCK);
-        if (rv != 0) {
-            nng_msg_free(msg);
-            return false;
-        }
-        
-        return true;
+    if (!got) {
+        return py::none();
     }
-    
-    bool subscribe(const std::string& topic, int qos = 0) {
-        if (!connected.load()) {
-            return false;
-        }
-        
-        nng_msg* msg;
-        int rv = nng_mqtt_msg_alloc(&msg, 0);
-        if (rv != 0) {
-            return false;
-        }
-        
-        // Set message type to SUBSCRIBE
-        nng_mqtt_msg_set_packet_type(msg, NNG_MQTT_SUBSCRIBE);
-        
-        // Create topic QoS array properly
-        nng_mqtt_topic_qos* topics = nng_mqtt_topic_qos_array_create(1);
-        if (!topics) {
-            nng_msg_free(msg);
-            return false;
-        }
-        nng_mqtt_topic_qos_array_set(topics, 0, topic.c_str(), topic.length(), qos, 0, 0, 0);
-        nng_mqtt_msg_set_subscribe_topics(msg, topics, 1);
-        nng_mqtt_topic_qos_array_free(topics, 1);
-        
-        // Send subscription
-        rv = nng_sendmsg(sock, msg, NNG_FLAG_NONBLOCK);
-        if (rv != 0) {
-            nng_msg_free(msg);
-            return false;
+    return py::str(item);
+}
+
+// FlapFilter on the steady clock for the Python publish path: "publish", "suppress" or "flapping"
+static std::string flap_filter_on_switch(native::FlapFilter& filter, const std::string& desktop) {
+    switch (filter.on_switch(desktop, std::chrono::steady_clock::now())) {
+        case native::FlapAction::Publish: return "publish";
+        case native::FlapAction::Suppress: return "suppress";
+        case native::FlapAction::StartFlapping: return "flapping";
+    }
+    return "publish";
+}
+
+// None until a flapping burst settles; then the screen to publish, or "" if none
+static py::object flap_filter_poll(native::FlapFilter& filter) {
+    std::string desktop;
+    if (!filter.poll(std::chrono::steady_clock::now(), desktop)) {
+        return py::none();
+    }
+    return py::str(desktop);
+}
+
+// Seconds until poll() should be called, None when not flapping
+static py::object flap_filter_timeout(const native::FlapFilter& filter) {
+    if (!filter.is_flapping()) {
+        return py::none();
+    }
+    auto left = filter.deadline() - std::chrono::steady_clock::now();
+    return py::cast(std::max(0.0, std::chrono::duration<double>(left).count()));
+}
+
+static std::map<std::string, uint64_t> flap_filter_stats(const native::FlapFilter& filter) {
+    return {{"suppressed", filter.suppressed_count()}, {"bursts", filter.burst_count()}};
+}
+
+static py::dict desktop_state_dict(const native::DesktopState& state) {
+    py::dict item;
+    item["topic"] = state.topic;
+    item["source"] = state.source;
+    item["server"] = state.server;
+    item["desktop"] = state.desktop;
+    item["timestamp"] = state.timestamp;
+    item["seq"] = state.seq;
+    item["retained"] = state.retained;
+    item["age_s"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - state.updated).count();
+    return item;
+}
+
+// Latest state from any server (server None) or from one server; None if none arrived yet
+template <typename Client>
+static py::object client_current_desktop(const Client& client, py::object server) {
+    native::DesktopState state;
+    bool found = server.is_none() ? client.current_state(state)
+                                  : client.current_state(state, false, server.cast<std::string>());
+    if (!found) {
+        return py::none();
+    }
+    return desktop_state_dict(state);
+}
+
+/**
+ * Ask topic's publisher for the current desktop, waiting without the GIL:
+ * a dict like current_desktop() with rtt_ms, and desktop None if the
+ * publisher has not published a switch yet; None on timeout.
+ */
+static py::object client_query_current(NanoMQTTClient& client, const std::string& topic, int timeout_ms,
+                                       const std::string& server) {
+    native::QueryResult result;
+    bool answered;
+    {
+        py::gil_scoped_release release;
+        answered = client.query_current(topic, timeout_ms, result, server);
+    }
+    if (!answered) {
+        return py::none();
+    }
+    py::dict item = desktop_state_dict(result.state);
+    item["topic"] = topic;
+    if (!result.known) {
+        item["desktop"] = py::none();
+    }
+    item["rtt_ms"] = result.rtt_us / 1000.0;
+    return item;
+}
+
+template <typename Client>
+static py::list client_current_states(const Client& client) {
+    py::list states;
+    for (const auto& state : client.current_states()) {
+        states.append(desktop_state_dict(state));
+    }
+    return states;
+}
+
+// The fleet's presence as {member: {...}}, "age_s" being how long the member has had its status
+static py::dict client_presence(NanoMQTTClient& client) {
+    int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    py::dict fleet;
+    for (const auto& entry : client.presence()) {
+        py::dict item;
+        item["name"] = entry.name;
+        item["role"] = entry.role;
+        item["online"] = entry.online;
+        item["pid"] = entry.pid;
+        item["since"] = entry.since;
+        item["reason"] = entry.reason;
+        item["age_s"] = (now_us - entry.changed_us) / 1e6;
+        fleet[py::str(entry.member)] = item;
+    }
+    return fleet;
+}
+
+// The page's current state as a dict like current_desktop(), None if nothing was written yet
+static py::object state_page_read(const native::StatePageReader& reader) {
+    native::StatePageSnapshot snapshot;
+    if (!reader.read(snapshot)) {
+        return py::none();
+    }
+    int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    py::dict item;
+    item["topic"] = snapshot.topic;
+    item["source"] = snapshot.source;
+    item["server"] = snapshot.server;
+    item["desktop"] = snapshot.desktop;
+    item["timestamp"] = snapshot.timestamp;
+    item["seq"] = snapshot.seq;
+    item["retained"] = snapshot.retained;
+    item["age_s"] = (now_us - snapshot.updated_us) / 1e6;
+    item["updates"] = snapshot.updates;
+    item["writer_pid"] = snapshot.writer_pid;
+    return item;
+}
+
+/**
+ * Next (topic, payload) from the ring whose topic matches topic_filter
+ * ('' or '#': any), waiting up to timeout_ms without the GIL; None on timeout.
+ */
+static py::object event_ring_next(native::EventRingReader& reader, int timeout_ms, const std::string& topic_filter) {
+    std::string topic, payload;
+    bool got;
+    {
+        py::gil_scoped_release release;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (;;) {
+            int remaining = static_cast<int>(std::max<int64_t>(
+                0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now())
+                       .count()));
+            got = reader.next(topic, payload, remaining);
+            if (!got || topic_filter.empty() || native::topic_matches(topic_filter, topic)) {
+                break;
+            }
         }
-        
-        return true;
     }
-    
-    void set_message_callback(std::function<void(const std::string&, const std::string&)> callback) {
-        std::lock_guard<std::mutex> lock(callback_mutex);
-        message_callback = callback;
+    if (!got) {
+        return py::none();
     }
+    return py::make_tuple(topic, payload);
+}
+
+/**
+ * Scan a buffer of log text for switch events.
+ * 
+ * Returns (from, to, desktop) tuples, where desktop is `to` without the
+ * hash suffix. The scan itself runs without the GIL.
+ */
+static std::vector<std::tuple<std::string, std::string, std::string>> scan_switch_events(py::buffer data) {
+    py::buffer_info info = data.request();
+    const char* bytes = static_cast<const char*>(info.ptr);
+    size_t len = static_cast<size_t>(info.size * info.itemsize);
     
-    void start_message_loop() {
-        if (running.load()) {
-            return;
-        }
-        
-        running.store(true);
-        worker_thread = std::thread([this]() {
-            message_loop();
+    std::vector<native::SwitchEvent> found;
+    {
+        py::gil_scoped_release release;
+        native::scan_switch_events(bytes, len, [&found](const native::SwitchEvent& event) {
+            found.push_back(event);
         });
     }
     
-    void stop_message_loop() {
-        running.store(false);
-        if (worker_thread.joinable()) {
-            worker_thread.join();
-        }
+    std::vector<std::tuple<std::string, std::string, std::string>> events;
+    events.reserve(found.size());
+    for (const auto& event : found) {
+        events.emplace_back(std::string(event.from, event.from_len),
+                            std::string(event.to, event.to_len),
+                            std::string(event.to, event.desktop_len));
     }
+    return events;
+}
+
+/**
+ * Parse a buffer of log text with the table-driven event parser.
+ * 
+ * Returns one dict per recognised line: kind, screen (as logged), desktop
+ * (without the hash suffix), and from, clipboard and time when present.
+ * The parse itself runs without the GIL.
+ */
+static py::list parse_log_events(py::buffer data) {
+    py::buffer_info info = data.request();
+    const char* bytes = static_cast<const char*>(info.ptr);
+    size_t len = static_cast<size_t>(info.size * info.itemsize);
     
-private:
-    void message_loop() {
-        while (running.load() && connected.load()) {
-            nng_msg* msg;
-            int rv = nng_recvmsg(sock, &msg, NNG_FLAG_NONBLOCK);
-            
-            if (rv == 0) {
-                handle_message(msg);
-                nng_msg_free(msg);
-            } else if (rv == NNG_EAGAIN) {
-                // No message available, sleep briefly
-                nng_msleep(10);
-            } else {
-                // Error receiving message
-                break;
-            }
-        }
+    std::vector<native::LogRecord> found;
+    {
+        py::gil_scoped_release release;
+        native::default_event_parser().parse(bytes, len, [&found](const native::LogRecord& record) {
+            found.push_back(record);
+        });
     }
     
-    void handle_message(nng_msg* msg) {
-        nng_mqtt_packet_type packet_type = nng_mqtt_msg_get_packet_type(msg);
-        
-        if (packet_type == NNG_MQTT_PUBLISH) {
-            uint32_t topic_len;
-            const char* topic = nng_mqtt_msg_get_publish_topic(msg, &topic_len);
-            uint32_t payload_len;
-            const uint8_t* payload = nng_mqtt_msg_get_publish_payload(msg, &payload_len);
-            
-            if (topic && payload) {
-                std::string topic_str(topic, topic_len);
-                std::string payload_str(reinterpret_cast<const char*>(payload), payload_len);
-                
-                std::lock_guard<std::mutex> lock(callback_mutex);
-                if (message_callback) {
-                    message_callback(topic_str, payload_str);
-                }
-            }
+    py::list records;
+    for (const auto& record : found) {
+        py::dict item;
+        item["kind"] = native::event_kind_name(record.kind);
+        item["screen"] = std::string(record.screen, record.screen_len);
+        item["desktop"] = std::string(record.screen, record.desktop_len);
+        if (record.from) {
+            item["from"] = std::string(record.from, record.from_len);
         }
+        if (record.clipboard >= 0) {
+            item["clipboard"] = record.clipboard;
+        }
+        if (record.time) {
+            item["time"] = std::string(record.time, record.time_len);
+        }
+        records.append(item);
     }
-};
+    return records;
+}
+
+static std::vector<std::pair<std::string, std::string>> event_grammars() {
+    std::vector<std::pair<std::string, std::string>> grammars;
+    for (const auto& grammar : native::EVENT_GRAMMARS) {
+        grammars.emplace_back(native::event_kind_name(grammar.kind), grammar.pattern);
+    }
+    return grammars;
+}
 
 PYBIND11_MODULE(nanomq_bindings, m) {
     m.doc() = "NanoMQ Python bindings for MQTT client functionality";
     
+    m.def("scan_switch_events", &scan_switch_events,
+          "Find Synergy switch lines in a bytes-like buffer; returns (from, to, desktop) tuples",
+          py::arg("data"));
+    m.def("scan_kernel", &native::scan_kernel_name,
+          "Name of the SIMD kernel the switch scanner uses on this CPU");
+    m.def("parse_log_events", &parse_log_events,
+          "Parse switch, connect, disconnect and clipboard lines from a bytes-like buffer",
+          py::arg("data"));
+    m.def("event_grammars", &event_grammars,
+          "The (kind, pattern) table the event parser is compiled from");
+    m.def("default_bell_command", &native::default_bell_command,
+          "The bell command for this platform, as argv");
+    
+    py::class_<TuningProfile>(m, "TuningProfile")
+        .def(py::init<>(), "Create a profile with NNG and OS defaults")
+        .def_readwrite("name", &TuningProfile::name)
+        .def_readwrite("tcp_nodelay", &TuningProfile::tcp_nodelay)
+        .def_readwrite("tcp_keepalive", &TuningProfile::tcp_keepalive)
+        .def_readwrite("send_buffer", &TuningProfile::send_buffer)
+        .def_readwrite("recv_buffer", &TuningProfile::recv_buffer)
+        .def_readwrite("task_threads", &TuningProfile::task_threads)
+        .def_readwrite("poller_threads", &TuningProfile::poller_threads)
+        .def_readwrite("rx_cpu", &TuningProfile::rx_cpu)
+        .def_readwrite("rx_realtime_priority", &TuningProfile::rx_realtime_priority)
+        .def_readwrite("rx_nice", &TuningProfile::rx_nice)
+        .def_readwrite("rx_poll_interval_ms", &TuningProfile::rx_poll_interval_ms)
+        .def_readwrite("rx_busy_poll_us", &TuningProfile::rx_busy_poll_us)
+        .def_static("low_latency", &TuningProfile::low_latency, "Preset with a 1 ms idle receive poll interval")
+        .def_static("low_power", &TuningProfile::low_power, "Preset with a 50 ms idle receive poll interval")
+        .def_static("preset", &TuningProfile::preset, "Look up a preset by name",
+                    py::arg("name"));
+    
     py::class_<NanoMQTTClient>(m, "NanoMQTTClient")
-        .def(py::init<const std::string&, int>(), "Create MQTT client", 
-             py::arg("broker"), py::arg("port"))
-        .def("connect", &NanoMQTTClient::connect, "Connect to MQTT broker",
-             py::arg("client_id") = "")
-        .def("disconnect", &NanoMQTTClient::disconnect, "Disconnect from MQTT broker")
+        .def(py::init<const std::string&, int, const TuningProfile&>(), "Create MQTT client", 
+             py::arg("broker"), py::arg("port"), py::arg("tuning") = TuningProfile())
+        .def("connect", &NanoMQTTClient::connect,
+             "Connect to MQTT broker, waiting up to timeout_ms for the CONNACK",
+             py::arg("client_id") = "", py::arg("timeout_ms") = CONNECT_TIMEOUT_MS)
+        .def("disconnect", &NanoMQTTClient::disconnect,
+             "Flush in-flight publishes, send DISCONNECT and stop the receive loop",
+             py::arg("timeout_ms") = DISCONNECT_TIMEOUT_MS,
+             py::call_guard<py::gil_scoped_release>())
+        .def("restart", &NanoMQTTClient::restart,
+             "Reconnect on the same socket and restore subscriptions and the receive loop",
+             py::call_guard<py::gil_scoped_release>())
         .def("is_connected", &NanoMQTTClient::is_connected, "Check connection status")
+        .def("configure_tls", &NanoMQTTClient::configure_tls,
+             "Enable TLS (mqtts) with the given CA, client certificate and key",
+             py::arg("ca_file"), py::arg("cert_file") = "", py::arg("key_file") = "",
+             py::arg("key_password") = "", py::arg("server_name") = "",
+             py::arg("verify_peer") = true)
+        .def("is_tls", &NanoMQTTClient::is_tls, "Check whether the transport uses TLS")
+        .def("tuning_profile", &NanoMQTTClient::tuning_profile,
+             "Get the tuning profile this client was created with")
+        .def("tuning_report", &NanoMQTTClient::tuning_report,
+             "Get which tuning knobs were applied, skipped or unsupported")
+        .def("receive_stats", &NanoMQTTClient::receive_stats,
+             "Get received message count, busy-poll spin hit/miss counters, local delivery counts "
+             "and stale/reordered events dropped")
+        .def("connection_stats", &NanoMQTTClient::connection_stats,
+             "Get connect count and last connect/reconnect latency in microseconds")
         .def("publish", &NanoMQTTClient::publish, "Publish message to topic",
-             py::arg("topic"), py::arg("payload"), py::arg("qos") = 0)
+             py::arg("topic"), py::arg("payload"), py::arg("qos") = 0, py::arg("retain") = false,
+             py::call_guard<py::gil_scoped_release>())
         .def("subscribe", &NanoMQTTClient::subscribe, "Subscribe to topic",
              py::arg("topic"), py::arg("qos") = 0)
+        .def("unsubscribe", &NanoMQTTClient::unsubscribe, "Unsubscribe from topic",
+             py::arg("topic"))
+        .def("resubscribe", &NanoMQTTClient::resubscribe,
+             "Subscribe to new_topic, then unsubscribe from old_topic, without a gap",
+             py::arg("old_topic"), py::arg("new_topic"), py::arg("qos") = 0)
         .def("set_message_callback", &NanoMQTTClient::set_message_callback,
-             "Set callback for received messages")
+             "Set callback for received messages",
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_event_filter", &NanoMQTTClient::set_event_filter,
+             "Drop messages older than max_age_ms (0: no limit) or, with order, older than the last "
+             "one from the same topic, source and server; negative max_age_ms with order off removes it",
+             py::arg("max_age_ms"), py::arg("order") = true,
+             py::call_guard<py::gil_scoped_release>())
+        .def("enable_sequence", &NanoMQTTClient::enable_sequence,
+             "Stamp every publish with source and a per-topic, per-server seq, persisted to "
+             "state_file unless it is empty",
+             py::arg("source"), py::arg("state_file") = "",
+             py::call_guard<py::gil_scoped_release>())
+        .def("serve_state", &NanoMQTTClient::serve_state,
+             "Answer state requests on topic + '/resync' with the last stamped message per server "
+             "and queries on topic + '/query' with the last one; needs the message loop running, "
+             "empty stops",
+             py::arg("topic"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_sequence_tracking", &NanoMQTTClient::set_sequence_tracking,
+             "Drop duplicate and late seqs before the callback and request the current state "
+             "on a gap or a new subscription",
+             py::arg("enabled") = true,
+             py::call_guard<py::gil_scoped_release>())
+        .def("sequence_stats", &NanoMQTTClient::sequence_stats,
+             "Get seq gap, missed, duplicate, late and reset counts, state requests sent/answered "
+             "and queries answered/rejected",
+             py::call_guard<py::gil_scoped_release>())
+        .def("query_current", &client_query_current,
+             "Ask the publisher serving topic for the current desktop (or server's) and wait up to "
+             "timeout_ms; a dict with rtt_ms, or None on timeout. Needs the message loop running",
+             py::arg("topic"), py::arg("timeout_ms") = native::QUERY_TIMEOUT_MS, py::arg("server") = "")
+        .def("query_stats", &NanoMQTTClient::query_stats,
+             "Get queries sent, answered, timed out, answered late and pending, and round trip times")
+        .def("set_retained_topic", &NanoMQTTClient::set_retained_topic,
+             "Publish to topic with the retain flag, clearing the retained message on the previous "
+             "topic; empty stops retaining",
+             py::arg("topic"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("current_desktop", &client_current_desktop<NanoMQTTClient>,
+             "Get the last switch received (from any server, or from server) as a dict, or None",
+             py::arg("server") = py::none())
+        .def("current_states", &client_current_states<NanoMQTTClient>,
+             "Get the last switch received per topic, source and server as a list of dicts")
+        .def("set_event_ring", &NanoMQTTClient::set_event_ring,
+             "Write accepted messages to the shared memory ring name (e.g. '/synergy-events') "
+             "for EventRingReader consumers; empty stops",
+             py::arg("name"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("event_ring_stats", &NanoMQTTClient::event_ring_stats,
+             "Get whether this client holds the event ring, and events written and oversize",
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_state_page", &NanoMQTTClient::set_state_page,
+             "Copy the latest state to the shared memory page name (e.g. '/synergy-desktop') "
+             "for StatePageReader; empty stops",
+             py::arg("name"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("state_page_stats", &NanoMQTTClient::state_page_stats,
+             "Get whether a state page is set, whether this client holds it and states written",
+             py::call_guard<py::gil_scoped_release>())
+        .def("enable_multicast", &NanoMQTTClient::enable_multicast,
+             "Also send every stamped publish as a UDP datagram to group:port, out of the interface "
+             "with address interface (empty: default); empty group stops",
+             py::arg("group"), py::arg("port") = native::DEFAULT_MULTICAST_PORT, py::arg("interface") = "",
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_multicast_receive", &NanoMQTTClient::set_multicast_receive,
+             "Join group:port and deliver datagrams on subscribed topics next to the broker's copies, "
+             "whichever arrives first; needs the message loop running, empty group stops",
+             py::arg("group"), py::arg("port") = native::DEFAULT_MULTICAST_PORT, py::arg("interface") = "",
+             py::call_guard<py::gil_scoped_release>())
+        .def("multicast_stats", &NanoMQTTClient::multicast_stats,
+             "Get datagrams sent/received, which path delivered first, copies dropped and how far "
+             "multicast arrived ahead of the broker (microseconds)",
+             py::call_guard<py::gil_scoped_release>())
+        .def("enable_presence", &NanoMQTTClient::enable_presence,
+             "Announce this client online, retained, at prefix/name/role on every session, with an "
+             "offline Last Will on the same topic; call before connect(), empty prefix stops",
+             py::arg("prefix"), py::arg("name"), py::arg("role"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("watch_presence", &NanoMQTTClient::watch_presence,
+             "Track every member announced under prefix as the broker pushes changes; empty stops",
+             py::arg("prefix") = native::DEFAULT_PRESENCE_TOPIC,
+             py::call_guard<py::gil_scoped_release>())
+        .def("presence", &client_presence,
+             "Get the watched fleet as {member: {name, role, online, pid, since, reason, age_s}}")
+        .def("presence_stats", &NanoMQTTClient::presence_stats,
+             "Get members online and offline, status changes seen and presence messages published",
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_local_delivery", &NanoMQTTClient::set_local_delivery,
+             "Deliver own publishes matching topic_filter to the callback in-process and "
+             "drop the broker's echo; empty turns it off",
+             py::arg("topic_filter"))
         .def("start_message_loop", &NanoMQTTClient::start_message_loop,
              "Start message receiving loop")
         .def("stop_message_loop", &NanoMQTTClient::stop_message_loop,
-             "Stop message receiving loop");
+             "Stop message receiving loop",
+             py::call_guard<py::gil_scoped_release>());
+    
+    m.def("peer_url", &native::peer_url, "The nng URL a peer publisher listens on and subscribers dial",
+          py::arg("host"), py::arg("port") = native::DEFAULT_PEER_PORT);
+    m.attr("DEFAULT_PEER_PORT") = native::DEFAULT_PEER_PORT;
+    m.attr("DEFAULT_MULTICAST_GROUP") = native::DEFAULT_MULTICAST_GROUP;
+    m.attr("DEFAULT_MULTICAST_PORT") = native::DEFAULT_MULTICAST_PORT;
+    m.attr("DEFAULT_PRESENCE_TOPIC") = native::DEFAULT_PRESENCE_TOPIC;
+    
+    py::class_<native::PeerPublisher>(m, "PeerPublisher")
+        .def(py::init<const std::string&>(), "Create a brokerless publisher for url (e.g. 'tcp://0.0.0.0:1885')",
+             py::arg("url"))
+        .def("listen", &native::PeerPublisher::listen,
+             "Start accepting subscribers; raises if the address cannot be bound")
+        .def("close", &native::PeerPublisher::close, "Stop listening and drop connected subscribers",
+             py::call_guard<py::gil_scoped_release>())
+        .def("is_listening", &native::PeerPublisher::is_listening, "Check whether it is listening")
+        .def("bound_port", &native::PeerPublisher::bound_port, "The TCP port listened on, 0 if not listening")
+        .def("publish", &native::PeerPublisher::publish,
+             "Send to every connected subscriber and remember it per topic for ones that connect later",
+             py::arg("topic"), py::arg("payload"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("stats", &native::PeerPublisher::stats, "Get connected peers, sent, failed and replayed counts");
+    
+    py::class_<native::PeerSubscriber>(m, "PeerSubscriber")
+        .def(py::init<const std::string&>(), "Create a brokerless subscriber for a PeerPublisher at url",
+             py::arg("url"))
+        .def("connect", &native::PeerSubscriber::connect,
+             "Start dialing the publisher; returns at once and redials whenever the link drops")
+        .def("disconnect", &native::PeerSubscriber::disconnect,
+             "Stop the receive loop and hang up, keeping subscriptions",
+             py::call_guard<py::gil_scoped_release>())
+        .def("restart", &native::PeerSubscriber::restart,
+             "Hang up and dial again, keeping subscriptions and the receive loop",
+             py::call_guard<py::gil_scoped_release>())
+        .def("is_connected", &native::PeerSubscriber::is_connected, "Check whether a publisher is linked")
+        .def("subscribe", &native::PeerSubscriber::subscribe, "Subscribe to an MQTT topic filter",
+             py::arg("topic"), py::arg("qos") = 0)
+        .def("unsubscribe", &native::PeerSubscriber::unsubscribe, "Unsubscribe from topic",
+             py::arg("topic"))
+        .def("resubscribe", &native::PeerSubscriber::resubscribe,
+             "Subscribe to new_topic, then unsubscribe from old_topic, without a gap",
+             py::arg("old_topic"), py::arg("new_topic"), py::arg("qos") = 0)
+        .def("set_message_callback", &native::PeerSubscriber::set_message_callback,
+             "Set callback for received messages",
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_event_filter", &native::PeerSubscriber::set_event_filter,
+             "As NanoMQTTClient.set_event_filter()",
+             py::arg("max_age_ms"), py::arg("order") = true,
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_state_page", &native::PeerSubscriber::set_state_page,
+             "As NanoMQTTClient.set_state_page()",
+             py::arg("name"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("set_event_ring", &native::PeerSubscriber::set_event_ring,
+             "As NanoMQTTClient.set_event_ring()",
+             py::arg("name"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("current_desktop", &client_current_desktop<native::PeerSubscriber>,
+             "Get the last switch received (from any server, or from server) as a dict, or None",
+             py::arg("server") = py::none())
+        .def("current_states", &client_current_states<native::PeerSubscriber>,
+             "Get the last switch received per topic, source and server as a list of dicts")
+        .def("receive_stats", &native::PeerSubscriber::receive_stats,
+             "Get received, connect, unmatched, repeated, stale and reordered counts")
+        .def("start_message_loop", &native::PeerSubscriber::start_message_loop,
+             "Start message receiving loop")
+        .def("stop_message_loop", &native::PeerSubscriber::stop_message_loop,
+             "Stop message receiving loop",
+             py::call_guard<py::gil_scoped_release>());
+    
+    py::class_<SwitchLogFollower>(m, "LogFollower")
+        .def(py::init<>(), "Create a follower; add logs with add_log()")
+        .def(py::init<const std::string&, bool>(), "Follow a Synergy log file",
+             py::arg("path"), py::arg("start_at_end") = true)
+        .def("add_log", &SwitchLogFollower::add_log,
+             "Follow another log, tagging its events with server; returns its index",
+             py::arg("path"), py::arg("server") = "", py::arg("start_at_end") = true,
+             py::arg("checkpoint_path") = "")
+        .def("enable_checkpoint", &SwitchLogFollower::enable_checkpoint,
+             "Persist the read position to a file and resume from it on the next start",
+             py::arg("checkpoint_path"))
+        .def("start", &SwitchLogFollower::start,
+             "Follow the logs and call on_event(desktop, published, server) for each switch",
+             py::arg("on_event"))
+        .def("start_publishing", &SwitchLogFollower::start_publishing,
+             "Follow the logs and publish each switch through client from the native thread",
+             py::arg("client"), py::arg("topic"), py::arg("qos") = 1,
+             py::arg("on_event") = nullptr, py::keep_alive<1, 2>())
+        .def("set_topic", &SwitchLogFollower::set_topic, "Change the topic switches are published to",
+             py::arg("topic"))
+        .def("enable_flap_filter", &SwitchLogFollower::enable_flap_filter,
+             "Hold back edge-riding switch bursts until the pointer settles; call before starting",
+             py::arg("dwell_ms"), py::arg("hysteresis") = 0, py::arg("report") = false)
+        .def("set_events_topic", &SwitchLogFollower::set_events_topic,
+             "Publish connect, disconnect and clipboard events to this topic (empty: don't)",
+             py::arg("topic"))
+        .def("stop", &SwitchLogFollower::stop, "Stop following the log",
+             py::call_guard<py::gil_scoped_release>())
+        .def("is_running", &SwitchLogFollower::is_running, "Check whether the follower is running")
+        .def("stats", &SwitchLogFollower::stats,
+             "Get bytes read, rotations, truncations, wake-ups, checkpoint activity, "
+             "switch/connect/disconnect/clipboard counts, publish failures and suppressed flaps")
+        .def("log_stats", &SwitchLogFollower::log_stats,
+             "Get bytes read, rotations, truncations and checkpoint activity for one log",
+             py::arg("index"));
+    
+    py::class_<EventQueue>(m, "EventQueue")
+        .def(py::init<size_t>(), "Create a bounded queue of messages", py::arg("capacity") = 1024)
+        .def("push", &EventQueue::push,
+             "Queue a message without blocking; returns False if the oldest was dropped to fit it",
+             py::arg("message"))
+        .def("pop", &event_queue_pop,
+             "Wait up to timeout_ms for a message; None on timeout or when closed and empty",
+             py::arg("timeout_ms") = 100)
+        .def("close", &EventQueue::close, "Wake waiting consumers; queued messages can still be popped")
+        .def("is_closed", &EventQueue::is_closed, "Check whether close() was called")
+        .def("__len__", &EventQueue::size)
+        .def("stats", &EventQueue::stats,
+             "Get capacity, depth, high-water mark, and pushed, popped and dropped counts");
+    
+    py::class_<native::FlapFilter>(m, "FlapFilter")
+        .def(py::init<int, int>(), "Create a switch flap filter",
+             py::arg("dwell_ms") = 300, py::arg("hysteresis") = 0)
+        .def("on_switch", &flap_filter_on_switch,
+             "Classify a switch now: 'publish', 'suppress', or 'flapping' (suppressed, burst started)",
+             py::arg("desktop"))
+        .def("poll", &flap_filter_poll,
+             "Settle a flapping burst if the pointer stayed put for dwell; None if not settled, "
+             "else the screen to publish ('' if it is the one already published)")
+        .def("timeout", &flap_filter_timeout, "Seconds until poll() is due, None when not flapping")
+        .def("is_flapping", &native::FlapFilter::is_flapping, "Check whether a burst is being suppressed")
+        .def("screen", &native::FlapFilter::screen, "The screen of the latest switch")
+        .def("burst_suppressed", &native::FlapFilter::burst_suppressed_count,
+             "Switches suppressed in the current or last flapping burst")
+        .def("stats", &flap_filter_stats, "Get suppressed switch and flapping burst counts");
+    
+    py::class_<native::ActionExecutor>(m, "ActionExecutor")
+        .def(py::init<int, int>(), "Create a match action executor with its worker thread",
+             py::arg("max_concurrent") = 2, py::arg("debounce_ms") = 250)
+        .def("set_action", &native::ActionExecutor::set_action,
+             "Register the command (argv, no shell) for an action; with bell_fallback a terminal "
+             "bell is written if it cannot start or exits non-zero",
+             py::arg("name"), py::arg("argv"), py::arg("bell_fallback") = false)
+        .def("trigger", &native::ActionExecutor::trigger,
+             "Queue an action without blocking; returns False if debounced or coalesced",
+             py::arg("name"))
+        .def("stop", &native::ActionExecutor::stop,
+             "Drop queued actions and wait up to timeout_ms for running ones",
+             py::arg("timeout_ms") = 1000, py::call_guard<py::gil_scoped_release>())
+        .def("stats", &native::ActionExecutor::stats,
+             "Get triggered, started, debounced, coalesced and failed counts, and queue delay, "
+             "spawn and run times (last and max, microseconds)");
+    
+    py::class_<native::StatePageReader>(m, "StatePageReader")
+        .def(py::init<const std::string&>(),
+             "Map a subscriber's current-desktop page read-only; raises if it does not exist",
+             py::arg("name") = native::DEFAULT_STATE_PAGE)
+        .def("read", &state_page_read,
+             "Get the current state as a dict (desktop, server, source, seq, age_s, ...), "
+             "or None if nothing was written yet")
+        .def("name", &native::StatePageReader::page_name, "The shared memory object name");
+    
+    py::class_<native::EventRingReader>(m, "EventRingReader")
+        .def(py::init<const std::string&, bool>(),
+             "Attach to a host's event ring with a cursor at the newest event (or the oldest held); "
+             "raises if it does not exist",
+             py::arg("name") = native::DEFAULT_EVENT_RING, py::arg("from_oldest") = false)
+        .def("next", &event_ring_next,
+             "Wait up to timeout_ms for the next (topic, payload) matching topic_filter; None on timeout",
+             py::arg("timeout_ms") = 1000, py::arg("topic_filter") = "")
+        .def("backlog", &native::EventRingReader::backlog, "Events waiting to be read")
+        .def("stats", &native::EventRingReader::stats, "Get received, lost and wait counts and the cursor")
+        .def("name", &native::EventRingReader::ring_name, "The shared memory object name");
+    
+    py::class_<LogBackfill>(m, "LogBackfill")
+        .def(py::init<const std::vector<std::string>&, const std::vector<std::string>&, unsigned>(),
+             "Load and parse logs (oldest first, .gz allowed) on all cores into time-ordered events",
+             py::arg("paths"), py::arg("servers") = std::vector<std::string>(), py::arg("threads") = 0,
+             py::call_guard<py::gil_scoped_release>())
+        .def("__len__", &LogBackfill::size)
+        .def("is_switch", &LogBackfill::is_switch, "Whether event index is a desktop switch",
+             py::arg("index"))
+        .def("payload", &LogBackfill::payload, "The JSON message for event index",
+             py::arg("index"))
+        .def("write_jsonl", &LogBackfill::write_jsonl,
+             "Write every event's JSON message to path, one per line; returns the count",
+             py::arg("path"), py::call_guard<py::gil_scoped_release>())
+        .def("publish", &LogBackfill::publish,
+             "Publish events [begin, end) through client; returns the number published",
+             py::arg("client"), py::arg("topic"), py::arg("events_topic") = "",
+             py::arg("begin") = 0, py::arg("end") = SIZE_MAX, py::arg("qos") = 1,
+             py::call_guard<py::gil_scoped_release>())
+        .def("stats", &LogBackfill::stats,
+             "Get files, bytes, chunks, records, threads, load/parse/order time and publish counts");
 }
\ No newline at end of file
@@ -11,7 +11,7 @@ import os
 import time
 import logging
 import threading
-from typing import Optional, Callable
+from typing import List, Optional, Callable, Tuple
 from .interface import MQTTPublisherInterface, MQTTSubscriberInterface
 
 logger = logging.getLogger('nanomq_client')
@@ -25,6 +25,68 @@ except ImportError as e:
     NANOMQ_AVAILABLE = False
 
 
+TUNING_PROFILES = ['default', 'low-latency', 'low-power']
+
+# Matches this close together ring the bell once
+BELL_DEBOUNCE_MS = 250
+
+
+def create_native_client(broker: str, port: int, tls: Optional[dict] = None, tuning: Optional[str] = None,
+                         busy_poll_us: Optional[int] = None):
+    """
+    Create a native NanoMQTTClient with optional TLS and tuning profile.
+    
+    Args:
+        broker: MQTT broker hostname or IP address
+        port: MQTT broker port number
+        tls: Optional TLS settings (ca_file, cert_file, key_file, server_name)
+        tuning: Optional tuning profile name ('default', 'low-latency', 'low-power')
+        busy_poll_us: Optional receive spin budget after each message (0 disables)
+        
+    Returns:
+        nanomq_bindings.NanoMQTTClient: Configured, unconnected client
+    """
+    if tuning or busy_poll_us is not None:
+        profile = nanomq_bindings.TuningProfile.preset(tuning or 'default')
+        if busy_poll_us is not None:
+            profile.rx_busy_poll_us = busy_poll_us
+        client = nanomq_bindings.NanoMQTTClient(broker, port, profile)
+    else:
+        client = nanomq_bindings.NanoMQTTClient(broker, port)
+    
+    if tls:
+        client.configure_tls(**tls)
+    
+    return client
+
+
+def enable_presence(client, presence: dict):
+    """Announce a native client at presence's topic/name/role and, with watch, follow the fleet."""
+    client.enable_presence(presence['topic'], presence['name'], presence['role'])
+    if presence.get('watch'):
+        client.watch_presence(presence['topic'])
+
+
+def load_backfill(sources: List[Tuple[str, str]], threads: int = 0):
+    """
+    Parse historical Synergy logs into one time-ordered list of events.
+    
+    Files are loaded (.gz ones inflated) and parsed on all cores by native
+    code, without the GIL. List each server's logs oldest first, e.g. with
+    utils.rotated_logs(), so events with the same timestamp keep log order.
+    
+    Args:
+        sources: (server, path) pairs, server '' for no tag
+        threads: Worker threads, 0 for one per core
+        
+    Returns:
+        nanomq_bindings.LogBackfill: The parsed events; write_jsonl() them or
+        replay them with NanoMQTTPublisher.backfill()
+    """
+    return nanomq_bindings.LogBackfill([path for _, path in sources],
+                                       [server for server, _ in sources], threads)
+
+
 class NanoMQTTPublisher(MQTTPublisherInterface):
     """
     MQTT publisher for Synergy desktop switching events using NanoMQ client.
@@ -40,9 +102,14 @@ class NanoMQTTPublisher(MQTTPublisherInterface):
         connected: Current connection status
         reconnect_delay: Current reconnection delay in seconds
         max_reconnect_delay: Maximum reconnection delay in seconds
+        source: Name stamped on messages with their sequence numbers (None: not stamped)
+        retain: Whether switches are published as the topic's retained message
     """
     
-    def __init__(self, broker_address: str, port: int, topic: str):
+    def __init__(self, broker_address: str, port: int, topic: str, tls: Optional[dict] = None,
+                 tuning: Optional[str] = None, busy_poll_us: Optional[int] = None,
+                 source: Optional[str] = None, sequence_file: str = '', retain: bool = False,
+                 multicast: Optional[dict] = None, presence: Optional[dict] = None):
         """
         Initialize the MQTT publisher.
         
@@ -50,6 +117,22 @@ class NanoMQTTPublisher(MQTTPublisherInterface):
             broker_address: MQTT broker hostname or IP address
             port: MQTT broker port number
             topic: MQTT topic to publish messages to
+            tls: Optional TLS settings (ca_file, cert_file, key_file, server_name)
+            tuning: Optional tuning profile name ('default', 'low-latency', 'low-power')
+            busy_poll_us: Optional receive spin budget after each message (0 disables)
+            source: Optional name (usually the hostname) to stamp on every message with
+                a per-topic, per-server sequence number; subscribers tracking them
+                detect missed events and ask this publisher for its current state
+            sequence_file: Where the sequence numbers persist across restarts
+                ('' keeps them in memory)
+            retain: Publish switches with the retain flag, so the broker hands the
+                last one to every new subscriber straight away
+            multicast: Optional fast path settings (group, port, interface): also
+                send each switch as a UDP multicast datagram for subscribers on
+                the LAN; needs source, as the sequence numbers tell the copies apart
+            presence: Optional presence settings (topic, name, role, watch): keep a
+                retained online message at topic/name/role with an offline Last
+                Will, and with watch follow every member's (see presence())
             
         Raises:
             RuntimeError: If NanoMQ bindings are not available
@@ -66,7 +149,20 @@ class NanoMQTTPublisher(MQTTPublisherInterface):
         self.max_reconnect_delay = 60
         
         # Create NanoMQ client
-        self.client = nanomq_bindings.NanoMQTTClient(broker_address, port)
+        self.client = create_native_client(broker_address, port, tls, tuning, busy_poll_us)
+        self.follower = None
+        self.subscriber = None
+        self.source = source
+        if source:
+            self.client.enable_sequence(source, sequence_file)
+        self.retain = retain
+        if retain:
+            self.client.set_retained_topic(topic)
+        if multicast and source:
+            self.client.enable_multicast(**multicast)
+        self.presence_options = presence
+        if presence:
+            enable_presence(self.client, presence)
         
     def connect_with_retry(self) -> bool:
         """
@@ -86,6 +182,15 @@ class NanoMQTTPublisher(MQTTPublisherInterface):
                     self.connected = True
                     self.reconnect_delay = 1  # Reset delay on successful connection
                     logger.info("Successfully connected to MQTT broker")
+                    if self.source:
+                        # State requests arrive on the receive loop
+                        self.client.serve_state(self.topic)
+                    if self.source or self.presence_options:
+                        # So do presence changes, and a redial re-announces from it
+                        self.client.start_message_loop()
+                    if self.subscriber:
+                        # Sessions are clean: the broker forgot the subscription
+                        self.subscriber.attach()
                     return True
                 else:
                     raise Exception("Connection failed")
@@ -131,12 +236,213 @@ class NanoMQTTPublisher(MQTTPublisherInterface):
         """
         Cleanly shut down the MQTT connection.
         
-        Disconnects from the broker and cleans up resources.
+        Waits briefly for in-flight publishes, sends DISCONNECT and cleans up resources.
         """
+        if self.subscriber:
+            self.subscriber.detach()
         if self.connected:
-            self.client.disconnect()
+            if not self.client.disconnect():
+                logger.warning("Closed with publishes still in flight")
             self.connected = False
             logger.info("MQTT connection closed")
+    
+    def restart(self) -> bool:
+        """
+        Reconnect in place, reusing the native socket, TLS config and tuning.
+        
+        Returns:
+            bool: True if the connection was restored, False otherwise
+        """
+        try:
+            self.connected = self.client.restart()
+        except Exception as e:
+            logger.warning(f"In-place restart failed: {e}")
+            self.connected = False
+        
+        if self.connected:
+            logger.info("MQTT connection restarted in place")
+        return self.connected
+    
+    def reconfigure(self, topic: Optional[str] = None) -> bool:
+        """
+        Switch to a new topic, including for a running log follower.
+        
+        Args:
+            topic: New topic to publish to (None keeps the current one)
+            
+        Returns:
+            bool: True if the new settings are in effect
+        """
+        if topic:
+            self.topic = topic
+            if self.source:
+                self.client.serve_state(topic)
+            if self.retain:
+                # Clears the retained switch on the old topic
+                self.client.set_retained_topic(topic)
+            if self.follower:
+                self.follower.set_topic(topic)
+            if self.subscriber:
+                return self.subscriber.reconfigure(topic=topic)
+        return True
+    
+    def local_subscriber(self, key: str, value: str, bell_func: Optional[Callable] = None,
+                         quiet: bool = False, max_event_age_ms: Optional[int] = None,
+                         track_sequence: bool = False, state_page: str = '',
+                         event_ring: str = '') -> 'NanoMQTTSubscriber':
+        """
+        Create a subscriber that shares this publisher's connection.
+        
+        For a primary machine that also alerts locally: instead of a second
+        process and broker connection, the subscriber receives this process's
+        own switches straight from publish() (see NanoMQTTSubscriber.attach),
+        and other machines' through the broker. It is re-attached whenever
+        this publisher reconnects and follows its topic on reconfigure().
+        
+        Args:
+            key: JSON key to monitor in messages
+            value: Value to match for the specified key
+            bell_func: Function to call when a match is found (None: system bell)
+            quiet: If True, suppress match notification output
+            max_event_age_ms: Optional staleness limit (see NanoMQTTSubscriber)
+            track_sequence: Track sequence numbers (see NanoMQTTSubscriber)
+            state_page: Shared memory page for the current desktop (see NanoMQTTSubscriber)
+            event_ring: Shared memory ring for local consumers (see NanoMQTTSubscriber)
+            
+        Returns:
+            NanoMQTTSubscriber: The subscriber; call attach() once connected
+        """
+        self.subscriber = NanoMQTTSubscriber(self.broker_address, self.port, self.topic, key, value,
+                                             bell_func, quiet=quiet, max_event_age_ms=max_event_age_ms,
+                                             track_sequence=track_sequence, state_page=state_page,
+                                             event_ring=event_ring, client=self.client)
+        return self.subscriber
+    
+    def follow_log(self, log_path: str, on_event: Optional[Callable[[str, bool, str], None]] = None,
+                   start_at_end: bool = True, checkpoint_path: Optional[str] = None):
+        """
+        Follow the Synergy log natively and publish switch events as they are written.
+        
+        Replaces the `tail -F | waldo.py` pipeline: the native follower waits for
+        file change notifications, parses switch lines and publishes from its own
+        thread, handling log rotation and truncation itself.
+        
+        Args:
+            log_path: Synergy log file to follow
+            on_event: Optional callback(desktop, published, server) run after each publish
+            start_at_end: Skip lines already in the log (when there is no checkpoint)
+            checkpoint_path: Optional file recording the read position, so a
+                restart resumes after the last published switch
+            
+        Returns:
+            The native follower; stop it with stop_following()
+        """
+        self.follower = nanomq_bindings.LogFollower(log_path, start_at_end)
+        if checkpoint_path:
+            self.follower.enable_checkpoint(checkpoint_path)
+        self.follower.start_publishing(self.client, self.topic, qos=1, on_event=on_event)
+        logger.info(f"Following {log_path} natively")
+        return self.follower
+    
+    def follow_logs(self, sources: List[Tuple[str, str]],
+                    on_event: Optional[Callable[[str, bool, str], None]] = None,
+                    start_at_end: bool = True, checkpoint_path: Optional[str] = None,
+                    events_topic: Optional[str] = None, flap_dwell_ms: int = 0,
+                    flap_hysteresis: int = 0, report_flapping: bool = False):
+        """
+        Follow several Synergy servers' logs from one native thread.
+        
+        All logs publish through this publisher's single connection. Events
+        from a log with a server name carry it in the payload's "server"
+        field; an untagged log publishes exactly like follow_log().
+        
+        Args:
+            sources: (server, path) pairs, server '' for no tag
+            on_event: Optional callback(desktop, published, server) run after each publish
+            start_at_end: Skip lines already in the logs (when there is no checkpoint)
+            checkpoint_path: Optional checkpoint file; with several logs, each
+                gets its own file named after its server (or index)
+            events_topic: Optional topic for client connect/disconnect and
+                clipboard events, which are otherwise only counted
+            flap_dwell_ms: Hold back switches flapping along a screen edge until
+                the pointer stays put this long (0 publishes every switch)
+            flap_hysteresis: Rapid reversals per burst published before suppressing
+            report_flapping: Also publish "flapping"/"settled" events to events_topic
+            
+        Returns:
+            The native follower; stop it with stop_following()
+        """
+        self.follower = nanomq_bindings.LogFollower()
+        for index, (server, path) in enumerate(sources):
+            checkpoint = ''
+            if checkpoint_path:
+                checkpoint = checkpoint_path if len(sources) == 1 else f"{checkpoint_path}.{server or index}"
+            self.follower.add_log(path, server=server, start_at_end=start_at_end,
+                                  checkpoint_path=checkpoint)
+        if events_topic:
+            self.follower.set_events_topic(events_topic)
+        if flap_dwell_ms > 0:
+            self.follower.enable_flap_filter(flap_dwell_ms, flap_hysteresis, report_flapping)
+        self.follower.start_publishing(self.client, self.topic, qos=1, on_event=on_event)
+        logger.info(f"Following {len(sources)} log(s) natively: "
+                    f"{', '.join(f'{s}={p}' if s else p for s, p in sources)}")
+        return self.follower
+    
+    def backfill(self, sources: List[Tuple[str, str]], rate: float = 0.0, threads: int = 0,
+                 events_topic: Optional[str] = None) -> int:
+        """
+        Replay historical Synergy logs through this publisher, oldest event first.
+        
+        Messages are the ones the live follower sends, stamped with the time
+        of their log line. Events are published in native batches; with a
+        rate, the batches are spaced so the broker and subscribers are not
+        flooded.
+        
+        Args:
+            sources: (server, path) pairs, each server's logs oldest first
+            rate: Events per second, 0 for as fast as the client accepts them
+            threads: Parser threads, 0 for one per core
+            events_topic: Optional topic for connect/disconnect/clipboard
+                events, which are otherwise skipped
+            
+        Returns:
+            int: Number of messages published
+        """
+        backfill = load_backfill(sources, threads)
+        total = len(backfill)
+        batch = max(1, int(rate / 10)) if rate > 0 else 1000
+        published = 0
+        start = time.monotonic()
+        for begin in range(0, total, batch):
+            published += backfill.publish(self.client, self.topic, events_topic or '',
+                                          begin, begin + batch, qos=1)
+            if rate > 0:
+                delay = start + min(begin + batch, total) / rate - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+        logger.info(f"Backfilled {published}/{total} events from {len(sources)} file(s)")
+        logger.debug(f"Backfill stats: {backfill.stats()}")
+        return published
+    
+    def stop_following(self):
+        """Stop the native log follower, if one is running."""
+        if self.follower:
+            self.follower.stop()
+            logger.debug(f"Log follower stats: {self.follower.stats()}")
+            self.follower = None
+    
+    def presence(self) -> dict:
+        """
+        Fleet presence, pushed by the broker rather than polled.
+        
+        Only filled when the presence settings have watch on.
+        
+        Returns:
+            dict: member ("NAME/ROLE") -> name, role, online, pid, since (epoch
+                seconds the session came online), reason ("lost" or "shutdown"
+                when offline) and age_s, how long it has had that status
+        """
+        return self.client.presence()
 
 
 class NanoMQTTSubscriber(MQTTSubscriberInterface):
@@ -161,9 +467,14 @@ class NanoMQTTSubscriber(MQTTSubscriberInterface):
         max_reconnect_delay: Maximum reconnection delay in seconds
         last_message_time: Timestamp of last received message
         message_thread: Thread for message processing
+        actions: Native action executor the default bell runs on
     """
     
-    def __init__(self, broker: str, port: int, topic: str, key: str, value: str, bell_func: Optional[Callable], quiet: bool = False):
+    def __init__(self, broker: str, port: int, topic: str, key: str, value: str, bell_func: Optional[Callable],
+                 quiet: bool = False, tls: Optional[dict] = None, tuning: Optional[str] = None,
+                 busy_poll_us: Optional[int] = None, max_event_age_ms: Optional[int] = None,
+                 track_sequence: bool = False, state_page: str = '', event_ring: str = '',
+                 multicast: Optional[dict] = None, presence: Optional[dict] = None, client=None):
         """
         Initialize the MQTT subscriber.
 
@@ -175,6 +486,29 @@ class NanoMQTTSubscriber(MQTTSubscriberInterface):
             value: Value to match for the specified key
             bell_func: Function to call when a match is found
             quiet: If True, suppress match notification output (bell still sounds)
+            tls: Optional TLS settings (ca_file, cert_file, key_file, server_name)
+            tuning: Optional tuning profile name ('default', 'low-latency', 'low-power')
+            busy_poll_us: Optional receive spin budget after each message (0 disables)
+            max_event_age_ms: Optional staleness limit: drop switches older than
+                this, and any older than the last one applied from the same
+                source, before they reach the callback (0 checks order only)
+            track_sequence: Drop duplicate and late sequence numbers, and ask the
+                publishers for their current state on a gap and after subscribing
+            state_page: Shared memory object name (e.g. '/synergy-desktop') to keep
+                the current desktop in for local readers (StatePageReader,
+                synergy-current); '' disables
+            event_ring: Shared memory ring (e.g. '/synergy-events') to write every
+                accepted message to for local consumers (RingSubscriber,
+                synergy-events); '' disables
+            multicast: Optional fast path settings (group, port, interface): also
+                receive switches as UDP multicast datagrams and deliver whichever
+                copy, datagram or broker message, arrives first
+            presence: Optional presence settings (topic, name, role, watch): keep a
+                retained online message at topic/name/role with an offline Last
+                Will, and with watch follow every member's (see presence())
+            client: Optional native client to share with a publisher in this
+                process (see NanoMQTTPublisher.local_subscriber); tls, tuning
+                and busy_poll_us are then ignored
 
         Raises:
             RuntimeError: If NanoMQ bindings are not available
@@ -186,8 +520,7 @@ class NanoMQTTSubscriber(MQTTSubscriberInterface):
         self.broker = broker
         self.port = port
         self.topic = topic
-        self.key = key
-        self.value = value
+        self._match = (key, value)
         self.bell_func = bell_func
         self.quiet = quiet
         self.connected = False
@@ -196,38 +529,90 @@ class NanoMQTTSubscriber(MQTTSubscriberInterface):
         self.max_reconnect_delay = 60
         self.last_message_time = time.time()
         self.message_thread = None
+        self.actions = None
         
-        # Create NanoMQ client
-        self.client = nanomq_bindings.NanoMQTTClient(broker, port)
+        # Create NanoMQ client, unless sharing a publisher's
+        self.shared = client is not None
+        self.client = client if self.shared else create_native_client(broker, port, tls, tuning, busy_poll_us)
         
         # Set message callback
         self.client.set_message_callback(self._on_message)
+        if max_event_age_ms is not None:
+            self.client.set_event_filter(max_event_age_ms, True)
+        if track_sequence:
+            self.client.set_sequence_tracking(True)
+        if state_page:
+            try:
+                self.client.set_state_page(state_page)
+            except RuntimeError as e:
+                logger.warning(f"State page disabled: {e}")
+        if event_ring:
+            try:
+                self.client.set_event_ring(event_ring)
+            except RuntimeError as e:
+                logger.warning(f"Event ring disabled: {e}")
+        if multicast:
+            try:
+                self.client.set_multicast_receive(**multicast)
+            except RuntimeError as e:
+                logger.warning(f"Multicast fast path disabled: {e}")
+        if presence and not self.shared:
+            enable_presence(self.client, presence)
+    
+    @property
+    def key(self) -> str:
+        """JSON key to monitor; stored with value as one tuple so both swap together."""
+        return self._match[0]
+    
+    @key.setter
+    def key(self, key: str):
+        self._match = (key, self._match[1])
+    
+    @property
+    def value(self) -> str:
+        """Value to match for the monitored key."""
+        return self._match[1]
+    
+    @value.setter
+    def value(self, value: str):
+        self._match = (self._match[0], value)
     
     def get_bell_function(self):
         """
-        Determine the appropriate bell/beep function based on the operating system.
+        Create the bell for match notifications.
+        
+        Calling it only queues the sound: the native action executor spawns
+        the platform's bell command (no shell) from its own thread, so a match
+        never holds up the receive thread. Re-entries within
+        BELL_DEBOUNCE_MS, or while the bell still plays, ring once (see
+        native/action_executor.h).
         
         Returns:
-            callable: A function that produces a system bell/beep sound
+            callable: A function that queues a system bell/beep sound
         """
-        import platform
-        import subprocess
-        
-        system = platform.system().lower()
-        
-        if system == 'darwin':  # macOS
-            return lambda: subprocess.run(['osascript', '-e', 'beep'], check=False)
-        elif system == 'linux':
-            return lambda: os.system('paplay /usr/share/sounds/freedesktop/bell.oga 2>/dev/null || echo -e "\\a"')
-        elif system == 'windows':
-            return lambda: os.system('echo \\a')
-        else:
-            return lambda: print('\\a')  # Fallback to print bell character
+        return self._ring_bell
+    
+    def _ring_bell(self):
+        # Created on first use, and again after detach() or run() stopped it
+        if self.actions is None:
+            self.actions = nanomq_bindings.ActionExecutor(debounce_ms=BELL_DEBOUNCE_MS)
+            self.actions.set_action('bell', nanomq_bindings.default_bell_command(), bell_fallback=True)
+        self.actions.trigger('bell')
+    
+    def _stop_actions(self):
+        if self.actions is not None:
+            self.actions.stop()
+            logger.debug(f"Bell stats: {self.actions.stats()}")
+            self.actions = None
     
     def _on_message(self, topic: str, payload: str):
         """
         Process incoming MQTT messages and trigger bell on matching content.
         
+        Retained messages and state replies never get here: the native
+        client files them for get_current_desktop() only, as they are the
+        current state rather than a switch happening now.
+        
         Args:
             topic: The topic the message was received on
             payload: The message payload as a string
@@ -239,13 +624,14 @@ class NanoMQTTSubscriber(MQTTSubscriberInterface):
             data = json.loads(payload)
             
             # Check if specified key exists and matches value
-            if self.key in data and data[self.key] == self.value:
+            key, value = self._match
+            if key in data and data[key] == value:
                 # Ring terminal bell
                 if self.bell_func:
                     self.bell_func()
 
                 if not self.quiet:
-                    print(f"Match found! {self.key} = {data[self.key]}")
+                    print(f"Match found! {key} = {data[key]}")
         
         except json.JSONDecodeError:
             logger.debug(f"Failed to parse JSON message: {payload}")
@@ -334,6 +720,598 @@ class NanoMQTTSubscriber(MQTTSubscriberInterface):
         finally:
             self.running = False
             self.client.stop_message_loop()
+            self._stop_actions()
+            logger.debug(f"Receive stats: {self.client.receive_stats()}")
+            logger.debug(f"Sequence stats: {self.client.sequence_stats()}")
+            logger.debug(f"State page stats: {self.client.state_page_stats()}")
+            logger.debug(f"Event ring stats: {self.client.event_ring_stats()}")
+            logger.debug(f"Query stats: {self.client.query_stats()}")
+            logger.debug(f"Multicast stats: {self.client.multicast_stats()}")
+            logger.debug(f"Presence stats: {self.client.presence_stats()}")
             if self.connected:
                 self.client.disconnect()
-                self.connected = False
\ No newline at end of file
+                self.connected = False
+    
+    def presence(self) -> dict:
+        """
+        Fleet presence, pushed by the broker rather than polled.
+        
+        Only filled when the presence settings have watch on.
+        
+        Returns:
+            dict: member ("NAME/ROLE") -> name, role, online, pid, since (epoch
+                seconds the session came online), reason ("lost" or "shutdown"
+                when offline) and age_s, how long it has had that status
+        """
+        return self.client.presence()
+    
+    def get_current_desktop(self, server: Optional[str] = None) -> Optional[dict]:
+        """
+        Last switch received, answered from memory without a broker round trip.
+        
+        Filled by every switch the subscriber accepts, including the retained
+        one the broker sends right after subscribing when the publisher
+        retains (MQTT_RETAIN_STATE), so it is usually known straight after
+        connecting rather than at the next switch.
+        
+        Args:
+            server: Only consider switches from this server (None: any server)
+            
+        Returns:
+            dict: desktop, server, source, seq, timestamp, topic, whether it came
+                from the retained message and its age in seconds; None if no
+                switch has arrived yet
+        """
+        return self.client.current_desktop(server)
+    
+    def query_current(self, timeout: float = 1.0, server: Optional[str] = None) -> Optional[dict]:
+        """
+        Ask the primary's publisher for the current desktop and wait for the answer.
+        
+        Unlike get_current_desktop(), this does not depend on having received
+        a switch: the publisher answers a correlated query from memory (see
+        serve_state), so it also works for a subscriber that just started on
+        a broker without retained state. Several threads may query at once;
+        each gets its own answer.
+        
+        Args:
+            timeout: Seconds to wait for the answer
+            server: Only ask about this server's desktop (None: the latest from any)
+            
+        Returns:
+            dict: as get_current_desktop(), plus rtt_ms, the round trip to the
+                publisher; desktop is None if it has not published a switch yet.
+                None if no answer came in time or the subscriber is not running.
+        """
+        try:
+            return self.client.query_current(self.topic, int(timeout * 1000), server or '')
+        except RuntimeError as e:
+            logger.warning(f"Current desktop query failed: {e}")
+            return None
+    
+    def attach(self) -> bool:
+        """
+        Start receiving on a client shared with a publisher in this process.
+        
+        The publisher owns the connection. This subscribes on it and turns on
+        local delivery: the publisher's own messages reach _on_message from
+        publish() itself, with no broker round trip, and the broker's copy of
+        each is dropped as a duplicate. Messages from other publishers arrive
+        through the broker as usual. Local delivery works while the broker is
+        down; the subscription is retried when the publisher reconnects.
+        
+        Returns:
+            bool: True if subscribed on the broker as well
+        """
+        if self.bell_func is None:
+            self.bell_func = self.get_bell_function()
+        
+        self.client.set_local_delivery(self.topic)
+        self.connected = self.client.subscribe(self.topic, qos=1)
+        if self.connected:
+            logger.info(f"Subscribed to {self.topic} on the shared connection")
+        else:
+            logger.warning(f"Could not subscribe to {self.topic}; local events are still delivered")
+        self.running = True
+        self.client.start_message_loop()
+        return self.connected
+    
+    def detach(self):
+        """Stop receiving on a shared client; the publisher keeps the connection."""
+        if not self.running:
+            return
+        self.running = False
+        self.client.set_local_delivery('')
+        self.client.stop_message_loop()
+        self._stop_actions()
+        logger.debug(f"Receive stats: {self.client.receive_stats()}")
+    
+    def restart(self) -> bool:
+        """
+        Reconnect in place; the native client restores the subscription and
+        receive loop itself.
+        
+        Returns:
+            bool: True if the connection was restored, False otherwise
+        """
+        try:
+            self.connected = self.client.restart()
+        except Exception as e:
+            logger.warning(f"In-place restart failed: {e}")
+            self.connected = False
+        
+        if self.connected:
+            self.last_message_time = time.time()
+            logger.info("MQTT connection restarted in place")
+        return self.connected
+    
+    def reconfigure(self, topic: Optional[str] = None, key: Optional[str] = None,
+                    value: Optional[str] = None) -> bool:
+        """
+        Swap the topic and match target on the live connection.
+        
+        The native client subscribes to the new topic before unsubscribing
+        from the old one, so there is no window without a subscription.
+        
+        Args:
+            topic: New topic to subscribe to (None keeps the current one)
+            key: New JSON key to monitor (None keeps the current one)
+            value: New value to match (None keeps the current one)
+            
+        Returns:
+            bool: True if the new settings are in effect, False otherwise
+        """
+        if topic and topic != self.topic:
+            if self.connected:
+                if not self.client.resubscribe(self.topic, topic, qos=1):
+                    logger.error(f"Failed to move subscription from {self.topic} to {topic}")
+                    return False
+            else:
+                # connect_with_retry() subscribes to self.topic
+                self.client.unsubscribe(self.topic)
+            self.topic = topic
+            if self.running and self.shared:
+                self.client.set_local_delivery(topic)
+        
+        self._match = (key or self.key, value or self.value)
+        logger.info(f"Reconfigured: topic={self.topic}, {self.key} = {self.value}")
+        return True
+
+def ring_available(name: str) -> bool:
+    """
+    Check whether a host's event ring exists and can be attached to.
+    
+    Args:
+        name: Shared memory object name of the ring (e.g. '/synergy-events')
+        
+    Returns:
+        bool: True if a RingSubscriber on name would attach straight away
+    """
+    if not NANOMQ_AVAILABLE or not name:
+        return False
+    try:
+        nanomq_bindings.EventRingReader(name)
+        return True
+    except RuntimeError:
+        return False
+
+
+class RingSubscriber(NanoMQTTSubscriber):
+    """
+    Subscriber that reads the host's shared memory event ring instead of the broker.
+    
+    One process per host holds the broker connection and writes every
+    message it accepts to the ring (EVENT_RING; see native/event_ring.h):
+    synergy-monitord hub, or any nanomq subscriber with the ring enabled.
+    Each RingSubscriber keeps its own cursor and sleeps on the ring's futex
+    between events, so local consumers need no broker connection and see
+    messages already deduplicated and filtered by the writer.
+    
+    Matching and the bell are NanoMQTTSubscriber's; broker and port are kept
+    for the interface only.
+    """
+    
+    def __init__(self, broker: str, port: int, topic: str, key: str, value: str, bell_func: Optional[Callable],
+                 quiet: bool = False, ring: str = '/synergy-events'):
+        """
+        Initialize the ring subscriber.
+        
+        Args:
+            broker: MQTT broker the ring's writer uses (informational)
+            port: MQTT broker port (informational)
+            topic: Topic filter for ring events ('#' or wildcards allowed)
+            key: JSON key to monitor in messages
+            value: Value to match for the specified key
+            bell_func: Function to call when a match is found
+            quiet: If True, suppress match notification output (bell still sounds)
+            ring: Shared memory object name of the ring
+            
+        Raises:
+            RuntimeError: If NanoMQ bindings are not available
+        """
+        if not NANOMQ_AVAILABLE:
+            raise RuntimeError("NanoMQ bindings are not available. "
+                             "Please build the extension with: pip install -e .[build]")
+        
+        self.broker = broker
+        self.port = port
+        self.topic = topic
+        self.ring = ring
+        self._match = (key, value)
+        self.bell_func = bell_func
+        self.quiet = quiet
+        self.connected = False
+        self.running = False
+        self.reconnect_delay = 1
+        self.max_reconnect_delay = 60
+        self.last_message_time = time.time()
+        self.actions = None
+        self.shared = False
+        self.reader = None
+        self._last_state = None
+    
+    def connect_with_retry(self) -> bool:
+        """
+        Attach to the ring, waiting with backoff until its writer has created it.
+        
+        Returns:
+            bool: True when attached (never returns False)
+        """
+        while not self.connected:
+            try:
+                self.reader = nanomq_bindings.EventRingReader(self.ring)
+                self.connected = True
+                self.reconnect_delay = 1
+                logger.info(f"Attached to event ring {self.ring}")
+                return True
+            except RuntimeError as e:
+                logger.warning(f"Event ring not available: {e}. Retrying in {self.reconnect_delay} seconds")
+                time.sleep(self.reconnect_delay)
+                self.reconnect_delay = min(self.reconnect_delay * 2, self.max_reconnect_delay)
+        return True
+    
+    def _on_message(self, topic: str, payload: str):
+        """Remember the last switch for get_current_desktop(), then match as usual."""
+        try:
+            data = json.loads(payload)
+            if isinstance(data, dict) and 'current_desktop' in data:
+                self._last_state = data
+        except json.JSONDecodeError:
+            pass
+        super()._on_message(topic, payload)
+    
+    def run(self):
+        """
+        Read ring events and ring the bell on matches until interrupted.
+        """
+        if self.bell_func is None:
+            self.bell_func = self.get_bell_function()
+        
+        self.connect_with_retry()
+        self.running = True
+        try:
+            while self.running:
+                # Waits without the GIL; the timeout lets signal handlers run
+                event = self.reader.next(1000, self.topic)
+                if event is not None:
+                    self._on_message(*event)
+        except KeyboardInterrupt:
+            logger.info("Received interrupt signal, shutting down")
+        finally:
+            self.running = False
+            self._stop_actions()
+            if self.reader is not None:
+                logger.debug(f"Event ring stats: {self.reader.stats()}")
+    
+    def get_current_desktop(self, server: Optional[str] = None) -> Optional[dict]:
+        """
+        Last switch read from the ring (None before the first one).
+        
+        Args:
+            server: Only return it if it came from this server (None: any)
+            
+        Returns:
+            dict: The switch message, or None
+        """
+        state = self._last_state
+        if state is None or (server is not None and state.get('server', '') != server):
+            return None
+        return state
+    
+    def query_current(self, timeout: float = 1.0, server: Optional[str] = None) -> Optional[dict]:
+        """
+        The ring has no broker connection to ask on, so this is get_current_desktop().
+        
+        Args:
+            timeout: Ignored
+            server: Only return it if it came from this server (None: any)
+            
+        Returns:
+            dict: The last switch read from the ring, or None
+        """
+        return self.get_current_desktop(server)
+    
+    def presence(self) -> dict:
+        """The ring has no broker connection to hear presence on, so this is empty."""
+        return {}
+    
+    def restart(self) -> bool:
+        """
+        Re-attach to the ring, e.g. after its writer re-created it.
+        
+        Returns:
+            bool: True if attached again
+        """
+        try:
+            self.reader = nanomq_bindings.EventRingReader(self.ring)
+            self.connected = True
+        except RuntimeError as e:
+            logger.warning(f"Re-attaching to event ring failed: {e}")
+            self.connected = False
+        return self.connected
+    
+    def reconfigure(self, topic: Optional[str] = None, key: Optional[str] = None,
+                    value: Optional[str] = None) -> bool:
+        """
+        Swap the topic filter and match target; takes effect from the next event.
+        
+        Args:
+            topic: New topic filter (None keeps the current one)
+            key: New JSON key to monitor (None keeps the current one)
+            value: New value to match (None keeps the current one)
+            
+        Returns:
+            bool: Always True
+        """
+        if topic:
+            self.topic = topic
+        self._match = (key or self.key, value or self.value)
+        logger.info(f"Reconfigured: topic={self.topic}, {self.key} = {self.value}")
+        return True
+
+
+class PeerPublisher(MQTTPublisherInterface):
+    """
+    Publisher that sends switches straight to subscribers, without a broker.
+    
+    Listens on an nng pub0 socket (see native/peer.h); PeerSubscribers on
+    the secondaries dial it, so each switch takes one network hop and keeps
+    flowing while no broker runs. The last message per topic is sent again
+    to every subscriber that connects, standing in for a retained message.
+    
+    Attributes:
+        broker_address: Address to listen on (the bind address, not a broker)
+        port: TCP port subscribers dial
+        topic: Topic stamped on every message
+        client: Native peer publisher
+        connected: Whether it is listening
+        reconnect_delay: Current retry delay in seconds
+        max_reconnect_delay: Maximum retry delay in seconds
+    """
+    
+    def __init__(self, broker_address: str, port: int, topic: str, bind: str = '0.0.0.0'):
+        """
+        Initialize the peer publisher.
+        
+        Args:
+            broker_address: Kept for the interface; subscribers dial this host
+            port: TCP port to listen on
+            topic: Topic stamped on every message
+            bind: Local address to listen on
+        
+        Raises:
+            RuntimeError: If NanoMQ bindings are not available
+        """
+        if not NANOMQ_AVAILABLE:
+            raise RuntimeError("NanoMQ bindings are not available. "
+                             "Please build the extension with: pip install -e .[build]")
+        
+        self.broker_address = broker_address
+        self.port = port
+        self.topic = topic
+        self.connected = False
+        self.reconnect_delay = 1
+        self.max_reconnect_delay = 60
+        self.client = nanomq_bindings.PeerPublisher(nanomq_bindings.peer_url(bind, port))
+    
+    def connect_with_retry(self) -> bool:
+        """
+        Start listening, retrying with backoff while the port is taken.
+        
+        Returns:
+            bool: True when listening (never returns False)
+        """
+        while not self.connected:
+            try:
+                self.client.listen()
+                self.connected = True
+                self.reconnect_delay = 1
+                logger.info(f"Listening for peer subscribers on port {self.client.bound_port()}")
+                return True
+            except RuntimeError as e:
+                logger.warning(f"Peer listen failed: {e}. Retrying in {self.reconnect_delay} seconds")
+                time.sleep(self.reconnect_delay)
+                self.reconnect_delay = min(self.reconnect_delay * 2, self.max_reconnect_delay)
+        return True
+    
+    def publish(self, message: str) -> bool:
+        """
+        Send a message to every connected subscriber.
+        
+        With none connected it is only remembered, for the next to connect.
+        
+        Args:
+            message: Message string to publish
+        
+        Returns:
+            bool: True if the message was sent or remembered, False otherwise
+        """
+        if not self.connected:
+            self.connect_with_retry()
+        
+        if self.client.publish(self.topic, message):
+            logger.debug(f"Sent message to peers on {self.topic}")
+            return True
+        logger.error("Failed to send message to peers")
+        return False
+    
+    def close(self):
+        """Stop listening and drop connected subscribers."""
+        if self.connected:
+            self.client.close()
+            self.connected = False
+            logger.debug(f"Peer stats: {self.client.stats()}")
+            logger.info("Peer publisher closed")
+    
+    def restart(self) -> bool:
+        """
+        Listen again on the same socket; subscribers redial on their own.
+        
+        Returns:
+            bool: True if listening again, False otherwise
+        """
+        self.client.close()
+        try:
+            self.client.listen()
+            self.connected = True
+        except RuntimeError as e:
+            logger.warning(f"Peer restart failed: {e}")
+            self.connected = False
+        return self.connected
+    
+    def reconfigure(self, topic: Optional[str] = None) -> bool:
+        """
+        Switch to a new topic.
+        
+        Args:
+            topic: New topic to publish to (None keeps the current one)
+        
+        Returns:
+            bool: Always True
+        """
+        if topic:
+            self.topic = topic
+        return True
+
+
+class PeerSubscriber(NanoMQTTSubscriber):
+    """
+    Subscriber that dials a PeerPublisher directly instead of a broker.
+    
+    The native peer subscriber mirrors the parts of the nanomq client a
+    subscriber uses (event filter, current state, state page, event ring),
+    so matching, the bell and get_current_desktop() are NanoMQTTSubscriber's.
+    It redials a lost publisher on its own and is brought up to date by the
+    publisher's replay when it does. There are no sequence numbers or
+    queries over a peer link; the replay on connect replaces both.
+    """
+    
+    def __init__(self, broker: str, port: int, topic: str, key: str, value: str, bell_func: Optional[Callable],
+                 quiet: bool = False, max_event_age_ms: Optional[int] = None, state_page: str = '',
+                 event_ring: str = ''):
+        """
+        Initialize the peer subscriber.
+        
+        Args:
+            broker: Host of the primary's PeerPublisher
+            port: TCP port it listens on
+            topic: Topic filter to subscribe to (wildcards allowed)
+            key: JSON key to monitor in messages
+            value: Value to match for the specified key
+            bell_func: Function to call when a match is found
+            quiet: If True, suppress match notification output (bell still sounds)
+            max_event_age_ms: As for NanoMQTTSubscriber
+            state_page: As for NanoMQTTSubscriber
+            event_ring: As for NanoMQTTSubscriber
+        
+        Raises:
+            RuntimeError: If NanoMQ bindings are not available
+        """
+        if not NANOMQ_AVAILABLE:
+            raise RuntimeError("NanoMQ bindings are not available. "
+                             "Please build the extension with: pip install -e .[build]")
+        
+        client = nanomq_bindings.PeerSubscriber(nanomq_bindings.peer_url(broker, port))
+        super().__init__(broker, port, topic, key, value, bell_func, quiet, max_event_age_ms=max_event_age_ms,
+                         state_page=state_page, event_ring=event_ring, client=client)
+        # The client is this subscriber's own, not a publisher's
+        self.shared = False
+        self.linked = False
+    
+    def connect_with_retry(self) -> bool:
+        """
+        Start dialing the publisher and subscribe.
+        
+        Returns at once: the native dialer keeps retrying until the
+        publisher is up, and messages flow from then on.
+        
+        Returns:
+            bool: True once dialing (never returns False)
+        """
+        while not self.connected:
+            try:
+                self.client.connect()
+                if not self.client.subscribe(self.topic):
+                    raise RuntimeError(f"Failed to subscribe to {self.topic}")
+                self.connected = True
+                self.reconnect_delay = 1
+                logger.info(f"Dialing peer publisher at {self.broker}:{self.port} for {self.topic}")
+                return True
+            except RuntimeError as e:
+                logger.warning(f"Peer connect failed: {e}. Retrying in {self.reconnect_delay} seconds")
+                time.sleep(self.reconnect_delay)
+                self.reconnect_delay = min(self.reconnect_delay * 2, self.max_reconnect_delay)
+        return True
+    
+    def run(self):
+        """
+        Receive from the publisher and ring the bell on matches until interrupted.
+        """
+        if self.bell_func is None:
+            self.bell_func = self.get_bell_function()
+        
+        self.connect_with_retry()
+        self.running = True
+        self.client.start_message_loop()
+        
+        try:
+            while self.running:
+                # nng redials by itself; only report link changes
+                linked = self.client.is_connected()
+                if linked != self.linked:
+                    self.linked = linked
+                    if linked:
+                        logger.info("Linked to peer publisher")
+                    else:
+                        logger.warning("Peer publisher unreachable, redialing")
+                time.sleep(1)
+        except KeyboardInterrupt:
+            logger.info("Received interrupt signal, shutting down")
+        finally:
+            self.running = False
+            self.client.stop_message_loop()
+            self._stop_actions()
+            logger.debug(f"Receive stats: {self.client.receive_stats()}")
+            if self.connected:
+                self.client.disconnect()
+                self.connected = False
+    
+    def query_current(self, timeout: float = 1.0, server: Optional[str] = None) -> Optional[dict]:
+        """
+        A peer link carries no queries, so this is get_current_desktop().
+        
+        The publisher replays its last switch to every subscriber that
+        connects, so the answer is known soon after linking.
+        
+        Args:
+            timeout: Ignored
+            server: Only return it if it came from this server (None: any)
+        
+        Returns:
+            dict: As get_current_desktop()
+        """
+        return self.get_current_desktop(server)
+    
+    def presence(self) -> dict:
+        """Presence needs a broker to hold the retained states and wills, so this is empty."""
+        return {}
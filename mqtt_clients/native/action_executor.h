@@ -0,0 +1,329 @@
+/**
+ * Match action executor
+ *
+ * found-him's bell used to be os.system('paplay ... || echo -e "\a"'): a
+ * shell forked on the NanoSDK receive thread, under the callback lock, so
+ * every match held up message delivery for as long as the shell and paplay
+ * ran. Here trigger() only marks the action due and returns; a worker thread
+ * starts it with posix_spawnp (no shell) and reaps it.
+ *
+ * - Debounce: a trigger within debounce_ms of the last accepted one is
+ *   dropped, so re-entering a screen several times in a row rings once.
+ * - Coalescing: an action already queued or still running absorbs further
+ *   triggers instead of starting a second copy.
+ * - Concurrency: at most max_concurrent actions run at once; the rest wait
+ *   in trigger order.
+ *
+ * stats() reports those counts plus queue delay (trigger to spawn), spawn
+ * time and run time (spawn to exit), last and max, in microseconds.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdio>
+#include <csignal>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace native {
+
+// How often running actions are checked for exit; only while one runs
+static const int ACTION_REAP_INTERVAL_MS = 10;
+
+// The command get_bell_function() ran through the shell, without the shell
+inline std::vector<std::string> default_bell_command() {
+#ifdef __APPLE__
+    return {"osascript", "-e", "beep"};
+#else
+    return {"paplay", "/usr/share/sounds/freedesktop/bell.oga"};
+#endif
+}
+
+class ActionExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ActionExecutor(int max_concurrent = 2, int debounce_ms = 250)
+        : max_concurrent(max_concurrent), debounce(std::chrono::milliseconds(debounce_ms)) {
+        if (max_concurrent < 1) {
+            throw std::runtime_error("max_concurrent must be at least 1");
+        }
+        worker = std::thread([this]() { run(); });
+    }
+
+    ~ActionExecutor() {
+        stop(0);
+    }
+
+    ActionExecutor(const ActionExecutor&) = delete;
+    ActionExecutor& operator=(const ActionExecutor&) = delete;
+
+    /**
+     * Register (or replace) the command for name. With bell_fallback, a
+     * terminal bell is written to stdout if the command cannot be started
+     * or exits non-zero, as the old `|| echo -e "\a"` did.
+     */
+    void set_action(const std::string& name, const std::vector<std::string>& argv, bool bell_fallback = false) {
+        if (argv.empty()) {
+            throw std::runtime_error("Action " + name + " needs a command");
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        Action& action = actions[name];
+        action.argv = argv;
+        action.bell_fallback = bell_fallback;
+    }
+
+    // Queue name to run; never blocks. False if debounced or coalesced.
+    bool trigger(const std::string& name) {
+        auto now = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = actions.find(name);
+            if (it == actions.end()) {
+                throw std::runtime_error("Unknown action: " + name);
+            }
+            Action& action = it->second;
+            triggered++;
+            if (stopping) {
+                return false;
+            }
+            if (action.pending || action.running) {
+                coalesced++;
+                return false;
+            }
+            if (action.accepted && now - action.last_accepted < debounce) {
+                debounced++;
+                return false;
+            }
+            action.accepted = true;
+            action.last_accepted = now;
+            action.pending = true;
+            ready.push_back(name);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    /**
+     * Drop queued actions and wait up to timeout_ms for running ones to
+     * exit. Ones still running after that are left to finish on their own.
+     */
+    void stop(int timeout_ms) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping && !worker.joinable()) {
+                return;
+            }
+            stopping = true;
+            stop_deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+            for (const auto& name : ready) {
+                actions[name].pending = false;
+            }
+            ready.clear();
+        }
+        wake.notify_one();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {
+            {"triggered", triggered},
+            {"started", started},
+            {"debounced", debounced},
+            {"coalesced", coalesced},
+            {"spawn_failures", spawn_failures},
+            {"failed", failed},
+            {"completed", completed},
+            {"running", children.size()},
+            {"queued", ready.size()},
+            {"last_queue_delay_us", last_queue_delay_us},
+            {"max_queue_delay_us", max_queue_delay_us},
+            {"last_spawn_us", last_spawn_us},
+            {"max_spawn_us", max_spawn_us},
+            {"last_run_us", last_run_us},
+            {"max_run_us", max_run_us},
+        };
+    }
+
+private:
+    struct Action {
+        std::vector<std::string> argv;
+        bool bell_fallback = false;
+        bool accepted = false;
+        Clock::time_point last_accepted;
+        bool pending = false;
+        bool running = false;
+    };
+
+    struct Child {
+        pid_t pid;
+        std::string name;
+        Clock::time_point spawned;
+    };
+
+    int max_concurrent;
+    Clock::duration debounce;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::map<std::string, Action> actions;
+    std::deque<std::string> ready;
+    std::vector<Child> children;
+    bool stopping = false;
+    Clock::time_point stop_deadline;
+    std::thread worker;
+
+    uint64_t triggered = 0;
+    uint64_t started = 0;
+    uint64_t debounced = 0;
+    uint64_t coalesced = 0;
+    uint64_t spawn_failures = 0;
+    uint64_t failed = 0;
+    uint64_t completed = 0;
+    uint64_t last_queue_delay_us = 0;
+    uint64_t max_queue_delay_us = 0;
+    uint64_t last_spawn_us = 0;
+    uint64_t max_spawn_us = 0;
+    uint64_t last_run_us = 0;
+    uint64_t max_run_us = 0;
+
+    static uint64_t elapsed_us(Clock::time_point since, Clock::time_point now) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(now - since).count();
+    }
+
+    static void record(uint64_t value, uint64_t& last, uint64_t& max) {
+        last = value;
+        if (value > max) {
+            max = value;
+        }
+    }
+
+    static void terminal_bell() {
+        fputs("\a", stdout);
+        fflush(stdout);
+    }
+
+    /**
+     * posix_spawnp with default signal handling and an empty mask, so the
+     * child does not inherit signals the caller blocked or ignored
+     * (synergy-monitord blocks its four in every thread). Returns 0 or an
+     * errno value.
+     */
+    static int spawn(const std::vector<std::string>& argv, pid_t& pid) {
+        std::vector<char*> args;
+        for (const auto& arg : argv) {
+            args.push_back(const_cast<char*>(arg.c_str()));
+        }
+        args.push_back(nullptr);
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t none, defaults;
+        sigemptyset(&none);
+        sigemptyset(&defaults);
+        for (int sig : {SIGTERM, SIGINT, SIGHUP, SIGUSR1, SIGPIPE, SIGCHLD}) {
+            sigaddset(&defaults, sig);
+        }
+        posix_spawnattr_setsigmask(&attr, &none);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+        int rv = posix_spawnp(&pid, args[0], nullptr, &attr, args.data(), environ);
+        posix_spawnattr_destroy(&attr);
+        return rv;
+    }
+
+    // Start queued actions while there is room; called with the lock held
+    void launch(std::unique_lock<std::mutex>& lock) {
+        while (!ready.empty() && children.size() < static_cast<size_t>(max_concurrent)) {
+            std::string name = ready.front();
+            ready.pop_front();
+            Action& action = actions[name];
+            action.pending = false;
+            std::vector<std::string> argv = action.argv;
+            bool bell_fallback = action.bell_fallback;
+            Clock::time_point queued = action.last_accepted;
+
+            // Spawn without the lock so trigger() never waits on a fork
+            lock.unlock();
+            Clock::time_point before = Clock::now();
+            pid_t pid = 0;
+            int rv = spawn(argv, pid);
+            Clock::time_point after = Clock::now();
+            if (rv != 0 && bell_fallback) {
+                terminal_bell();
+            }
+            lock.lock();
+
+            record(elapsed_us(queued, before), last_queue_delay_us, max_queue_delay_us);
+            record(elapsed_us(before, after), last_spawn_us, max_spawn_us);
+            if (rv != 0) {
+                spawn_failures++;
+                continue;
+            }
+            started++;
+            actions[name].running = true;
+            children.push_back(Child{pid, name, after});
+        }
+    }
+
+    // Collect exited actions; called with the lock held
+    void reap() {
+        for (size_t i = 0; i < children.size();) {
+            int status = 0;
+            pid_t rv = waitpid(children[i].pid, &status, WNOHANG);
+            if (rv == 0) {
+                i++;
+                continue;
+            }
+            Child child = children[i];
+            children.erase(children.begin() + i);
+            Action& action = actions[child.name];
+            action.running = false;
+            record(elapsed_us(child.spawned, Clock::now()), last_run_us, max_run_us);
+            completed++;
+            bool ok = rv == child.pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            if (!ok) {
+                failed++;
+                if (action.bell_fallback) {
+                    terminal_bell();
+                }
+            }
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            reap();
+            if (stopping && (children.empty() || Clock::now() >= stop_deadline)) {
+                return;
+            }
+            if (!stopping) {
+                launch(lock);
+            }
+            if (children.empty()) {
+                wake.wait(lock, [this]() { return stopping || !ready.empty(); });
+            } else {
+                wake.wait_for(lock, std::chrono::milliseconds(ACTION_REAP_INTERVAL_MS));
+            }
+        }
+    }
+};
+
+}  // namespace native
@@ -0,0 +1,380 @@
+/**
+ * Historical backfill
+ *
+ * Parses a set of Synergy logs (the live one and its rotated, possibly
+ * gzipped, predecessors) into one time-ordered list of events:
+ *
+ *   1. load: plain files are memory-mapped; .gz files are inflated into
+ *      memory. gzip cannot be split, so each compressed file is inflated by
+ *      one worker, with several files in flight at once.
+ *   2. parse: every buffer is cut into chunks at line boundaries, and the
+ *      workers pull chunks from a shared counter and run the event parser
+ *      over them. Chunks are independent, so this scales with cores.
+ *   3. order: chunk results are joined in file order and stably sorted by
+ *      the timestamp at the start of each line. Lines without one take the
+ *      timestamp of the line before them in the same file.
+ *
+ * Records point into the loaded buffers, which live as long as the Backfill.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "event_parser.h"
+
+namespace native {
+
+// "2025-01-01T12:00:00[.123]" -> microseconds since the epoch (as if UTC); -1 if not a timestamp
+inline int64_t parse_log_time(const char* s, size_t len) {
+    auto digits = [s, len](size_t at, size_t n, int& out) {
+        if (at + n > len) {
+            return false;
+        }
+        out = 0;
+        for (size_t i = at; i < at + n; i++) {
+            if (s[i] < '0' || s[i] > '9') {
+                return false;
+            }
+            out = out * 10 + (s[i] - '0');
+        }
+        return true;
+    };
+    int y, mo, d, h, mi, sec;
+    if (!digits(0, 4, y) || !digits(5, 2, mo) || !digits(8, 2, d) || !digits(11, 2, h) ||
+        !digits(14, 2, mi) || !digits(17, 2, sec) || s[4] != '-' || s[7] != '-' ||
+        (s[10] != 'T' && s[10] != ' ') || s[13] != ':' || s[16] != ':' || mo < 1 || mo > 12) {
+        return -1;
+    }
+    // Days from civil (Howard Hinnant's algorithm)
+    int yy = mo <= 2 ? y - 1 : y;
+    int era = (yy >= 0 ? yy : yy - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(yy - era * 400);
+    unsigned doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = static_cast<int64_t>(era) * 146097 + static_cast<int64_t>(doe) - 719468;
+
+    int64_t micros = 0;
+    size_t i = 19;
+    if (i < len && s[i] == '.') {
+        int64_t scale = 100000;
+        for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+            micros += (s[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+    return ((days * 24 + h) * 60 + mi) * 60 * 1000000LL + sec * 1000000LL + micros;
+}
+
+struct BackfillRecord {
+    LogRecord record;
+    int64_t time_us;            // parsed timestamp, -1 if the file had none yet
+    uint32_t file;              // index into the input paths
+    uint64_t offset;            // line end within that file
+};
+
+class Backfill {
+public:
+    // Chunks are at least this big, so small logs are not split needlessly
+    static constexpr size_t MIN_CHUNK_BYTES = 4 << 20;
+
+    /**
+     * Load and parse `paths` (oldest first, so equal timestamps keep log
+     * order) with `threads` workers; 0 uses every core.
+     */
+    explicit Backfill(const std::vector<std::string>& paths, unsigned threads = 0,
+                      const EventParser& parser = default_event_parser()) {
+        worker_count = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        auto start = std::chrono::steady_clock::now();
+        load(paths);
+        auto loaded = std::chrono::steady_clock::now();
+        parse(parser);
+        auto parsed = std::chrono::steady_clock::now();
+        order();
+        auto ordered = std::chrono::steady_clock::now();
+
+        load_us = elapsed_us(start, loaded);
+        parse_us = elapsed_us(loaded, parsed);
+        order_us = elapsed_us(parsed, ordered);
+    }
+
+    ~Backfill() {
+        for (auto& file : files) {
+            if (file.mapped) {
+                munmap(const_cast<char*>(file.data), file.size);
+            }
+        }
+    }
+
+    Backfill(const Backfill&) = delete;
+    Backfill& operator=(const Backfill&) = delete;
+
+    size_t size() const {
+        return records.size();
+    }
+
+    const BackfillRecord& at(size_t index) const {
+        return records.at(index);
+    }
+
+    const std::vector<BackfillRecord>& all() const {
+        return records;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        uint64_t bytes = 0, compressed = 0;
+        for (const auto& file : files) {
+            bytes += file.size;
+            compressed += file.compressed_size;
+        }
+        return {
+            {"files", files.size()},
+            {"bytes", bytes},
+            {"compressed_bytes", compressed},
+            {"chunks", chunk_count},
+            {"records", records.size()},
+            {"threads", worker_count},
+            {"load_us", load_us},
+            {"parse_us", parse_us},
+            {"order_us", order_us},
+        };
+    }
+
+private:
+    struct LoadedFile {
+        std::string path;
+        const char* data = nullptr;
+        size_t size = 0;
+        size_t compressed_size = 0;
+        bool mapped = false;
+        std::string inflated;       // owns the data of a .gz file
+    };
+
+    struct Chunk {
+        uint32_t file;
+        size_t begin;
+        size_t end;
+        std::vector<BackfillRecord> found;
+    };
+
+    std::vector<LoadedFile> files;
+    std::vector<BackfillRecord> records;
+    unsigned worker_count;
+    uint64_t chunk_count = 0;
+    uint64_t load_us = 0;
+    uint64_t parse_us = 0;
+    uint64_t order_us = 0;
+
+    static uint64_t elapsed_us(std::chrono::steady_clock::time_point from,
+                               std::chrono::steady_clock::time_point to) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+    }
+
+    // Run fn(i) for i in [0, count) on the worker threads
+    template <class Fn>
+    void parallel_for(size_t count, Fn fn) {
+        std::atomic<size_t> next{0};
+        std::vector<std::string> errors(worker_count);
+        auto work = [&](unsigned worker) {
+            try {
+                for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                    fn(i);
+                }
+            } catch (const std::exception& e) {
+                errors[worker] = e.what();
+                next.store(count);
+            }
+        };
+        std::vector<std::thread> pool;
+        unsigned n = static_cast<unsigned>(std::min<size_t>(worker_count, count));
+        for (unsigned w = 1; w < n; w++) {
+            pool.emplace_back(work, w);
+        }
+        work(0);
+        for (auto& t : pool) {
+            t.join();
+        }
+        for (const auto& error : errors) {
+            if (!error.empty()) {
+                throw std::runtime_error(error);
+            }
+        }
+    }
+
+    void load(const std::vector<std::string>& paths) {
+        files.resize(paths.size());
+        parallel_for(paths.size(), [this, &paths](size_t i) {
+            files[i].path = paths[i];
+            const std::string& path = paths[i];
+            if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+                inflate_file(files[i]);
+            } else {
+                map_file(files[i]);
+            }
+        });
+    }
+
+    static void map_file(LoadedFile& file) {
+        int fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + file.path + ": " + std::string(strerror(errno)));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to stat " + file.path + ": " + std::string(strerror(errno)));
+        }
+        file.size = static_cast<size_t>(st.st_size);
+        if (file.size == 0) {
+            close(fd);
+            return;
+        }
+        void* p = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("Failed to map " + file.path + ": " + std::string(strerror(errno)));
+        }
+        madvise(p, file.size, MADV_SEQUENTIAL);
+        file.data = static_cast<const char*>(p);
+        file.mapped = true;
+    }
+
+    static void inflate_file(LoadedFile& file) {
+        LoadedFile compressed;
+        compressed.path = file.path;
+        map_file(compressed);
+        file.compressed_size = compressed.size;
+
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        // 15 + 32: gzip or zlib header, detected automatically
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+            throw std::runtime_error("Failed to initialise zlib for " + file.path);
+        }
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data));
+        zs.avail_in = static_cast<uInt>(compressed.size);
+
+        std::string& out = file.inflated;
+        out.resize(std::max<size_t>(compressed.size * 4, 64 * 1024));
+        size_t produced = 0;
+        int rv = Z_OK;
+        while (zs.avail_in > 0 || rv == Z_OK) {
+            if (produced == out.size()) {
+                out.resize(out.size() * 2);
+            }
+            zs.next_out = reinterpret_cast<Bytef*>(&out[produced]);
+            zs.avail_out = static_cast<uInt>(std::min<size_t>(out.size() - produced, UINT32_MAX));
+            size_t before = zs.avail_out;
+            rv = inflate(&zs, Z_NO_FLUSH);
+            produced += before - zs.avail_out;
+            if (rv == Z_STREAM_END) {
+                // logrotate can append members; keep going if there is more input
+                if (zs.avail_in == 0) {
+                    break;
+                }
+                inflateReset(&zs);
+                rv = Z_OK;
+            } else if (rv != Z_OK && rv != Z_BUF_ERROR) {
+                inflateEnd(&zs);
+                munmap(const_cast<char*>(compressed.data), compressed.size);
+                throw std::runtime_error("Corrupt gzip data in " + file.path);
+            } else if (rv == Z_BUF_ERROR && zs.avail_in == 0) {
+                break;      // truncated file: keep what was inflated
+            }
+        }
+        inflateEnd(&zs);
+        if (compressed.data) {
+            munmap(const_cast<char*>(compressed.data), compressed.size);
+        }
+        out.resize(produced);
+        file.data = out.data();
+        file.size = out.size();
+    }
+
+    void parse(const EventParser& parser) {
+        size_t total = 0;
+        for (const auto& file : files) {
+            total += file.size;
+        }
+        // A few chunks per worker evens out files of different sizes
+        size_t target = std::max(MIN_CHUNK_BYTES, total / (worker_count * 4 + 1));
+
+        std::vector<Chunk> chunks;
+        for (uint32_t f = 0; f < files.size(); f++) {
+            const char* data = files[f].data;
+            size_t size = files[f].size;
+            size_t begin = 0;
+            while (begin < size) {
+                size_t end = std::min(size, begin + target);
+                if (end < size) {
+                    const char* nl = static_cast<const char*>(memchr(data + end, '\n', size - end));
+                    end = nl ? static_cast<size_t>(nl - data) + 1 : size;
+                }
+                chunks.push_back({f, begin, end, {}});
+                begin = end;
+            }
+        }
+        chunk_count = chunks.size();
+
+        parallel_for(chunks.size(), [this, &chunks, &parser](size_t i) {
+            Chunk& chunk = chunks[i];
+            const char* base = files[chunk.file].data + chunk.begin;
+            parser.parse(base, chunk.end - chunk.begin, [&chunk](const LogRecord& record) {
+                BackfillRecord r;
+                r.record = record;
+                r.time_us = record.time ? parse_log_time(record.time, record.time_len) : -1;
+                r.file = chunk.file;
+                r.offset = chunk.begin + record.line_end;
+                chunk.found.push_back(r);
+            });
+        });
+
+        size_t count = 0;
+        for (const auto& chunk : chunks) {
+            count += chunk.found.size();
+        }
+        records.reserve(count);
+        for (auto& chunk : chunks) {
+            records.insert(records.end(), chunk.found.begin(), chunk.found.end());
+        }
+    }
+
+    void order() {
+        // Records are in file and offset order here; carry timestamps forward
+        int64_t last = -1;
+        uint32_t file = UINT32_MAX;
+        for (auto& r : records) {
+            if (r.file != file) {
+                file = r.file;
+                last = -1;
+            }
+            if (r.time_us < 0) {
+                r.time_us = last;
+            } else {
+                last = r.time_us;
+            }
+        }
+        std::stable_sort(records.begin(), records.end(),
+                         [](const BackfillRecord& a, const BackfillRecord& b) {
+                             return a.time_us < b.time_us;
+                         });
+    }
+};
+
+}  // namespace native
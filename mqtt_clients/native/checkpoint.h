@@ -0,0 +1,161 @@
+/**
+ * Ingestion checkpoint
+ *
+ * Persists where log ingestion stopped: the file (device and inode), the
+ * byte offset to resume from, and the position and hash of the last event
+ * acted on. The hash lets a restart tell the same file apart from one that
+ * was truncated and rewritten in place.
+ *
+ * The record is a fixed-size line rewritten in place with pwrite(). That
+ * reaches the page cache, which survives the process being killed, so a
+ * crashed or restarted waldo resumes exactly. fsync() only guards against
+ * power loss and runs at most once per SYNC_INTERVAL_MS, plus on close.
+ */
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cinttypes>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace native {
+
+// FNV-1a, 64-bit: event line hashes and the record checksum
+inline uint64_t fnv1a(const char* data, size_t len, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+struct IngestPosition {
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    uint64_t offset = 0;        // resume reading here
+    uint64_t event_end = 0;     // offset just past the last event's line
+    uint64_t event_len = 0;     // length of that line, 0 if none in this file
+    uint64_t event_hash = 0;    // fnv1a of that line
+};
+
+class CheckpointFile {
+public:
+    static constexpr int SYNC_INTERVAL_MS = 1000;
+    static constexpr size_t RECORD_SIZE = 160;
+
+    explicit CheckpointFile(const std::string& path) : path(path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open checkpoint " + path + ": " +
+                                     std::string(strerror(errno)));
+        }
+    }
+
+    ~CheckpointFile() {
+        sync();
+        close(fd);
+    }
+
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+    const std::string& file_path() const {
+        return path;
+    }
+
+    /**
+     * Read the stored position. Returns false when there is none, or when
+     * the record is damaged (checksum mismatch), so the caller starts fresh.
+     */
+    bool load(IngestPosition& position) const {
+        char buf[RECORD_SIZE + 1];
+        ssize_t n = pread(fd, buf, RECORD_SIZE, 0);
+        if (n <= 0) {
+            return false;
+        }
+        buf[n] = '\0';
+
+        IngestPosition p;
+        uint64_t checksum = 0;
+        int consumed = 0;
+        if (sscanf(buf, "waldo-checkpoint 1 %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+                        " %" SCNu64 " %" SCNx64 "%n",
+                   &p.dev, &p.ino, &p.offset, &p.event_end, &p.event_len,
+                   &p.event_hash, &consumed) != 6) {
+            return false;
+        }
+        if (sscanf(buf + consumed, " %" SCNx64, &checksum) != 1 ||
+            checksum != fnv1a(buf, static_cast<size_t>(consumed))) {
+            return false;
+        }
+        position = p;
+        return true;
+    }
+
+    // Record a position; fsync if the last one was long enough ago
+    void store(const IngestPosition& p) {
+        char buf[RECORD_SIZE];
+        int len = snprintf(buf, sizeof(buf),
+                           "waldo-checkpoint 1 %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+                           " %" PRIu64 " %016" PRIx64,
+                           p.dev, p.ino, p.offset, p.event_end, p.event_len, p.event_hash);
+        len += snprintf(buf + len, sizeof(buf) - len, " %016" PRIx64,
+                        fnv1a(buf, static_cast<size_t>(len)));
+        // Pad to a fixed size so a shorter record never leaves a stale tail
+        memset(buf + len, ' ', sizeof(buf) - len - 1);
+        buf[sizeof(buf) - 1] = '\n';
+
+        if (pwrite(fd, buf, sizeof(buf), 0) == static_cast<ssize_t>(sizeof(buf))) {
+            writes.fetch_add(1);
+            dirty = true;
+        }
+        sync_if_due();
+    }
+
+    void sync_if_due() {
+        if (dirty && std::chrono::steady_clock::now() - last_sync >=
+                         std::chrono::milliseconds(SYNC_INTERVAL_MS)) {
+            sync();
+        }
+    }
+
+    void sync() {
+        if (!dirty) {
+            return;
+        }
+#if defined(__APPLE__)
+        fsync(fd);
+#else
+        fdatasync(fd);
+#endif
+        dirty = false;
+        syncs.fetch_add(1);
+        last_sync = std::chrono::steady_clock::now();
+    }
+
+    // Safe to read from other threads while the owner stores
+    uint64_t write_count() const {
+        return writes.load();
+    }
+
+    uint64_t sync_count() const {
+        return syncs.load();
+    }
+
+private:
+    std::string path;
+    int fd = -1;
+    bool dirty = false;
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> syncs{0};
+    std::chrono::steady_clock::time_point last_sync{};
+};
+
+}  // namespace native
@@ -0,0 +1,156 @@
+/**
+ * Subscriber-side event filter
+ *
+ * A switch that sat in a broker queue through a reconnect still arrives
+ * afterwards, sometimes minutes late, and found-him would ring for a desktop
+ * the user left long ago. A reconnect can also let an older message through
+ * behind a newer one. Each message's "timestamp" is checked before the
+ * callback sees it:
+ *
+ * - Stale: older than max_age (when set) by the subscriber's clock.
+ * - Reordered: older than the last message accepted from the same
+ *   publisher, i.e. the same topic, "source" and "server" fields (as
+ *   SequenceTracker and FirstCopyFilter key them).
+ *
+ * waldo.py and the native publishers send local time with its UTC offset,
+ * so time zones don't matter; timestamps without one (older publishers) are
+ * read as the subscriber's local time. The age check still assumes the
+ * clocks roughly agree, which is why it is off unless max_age is set.
+ * Messages without a readable timestamp are always accepted. Retained
+ * messages and state replies never get here: NanoMQTTClient files them as
+ * current state without calling back, so they cannot ring a bell however
+ * old they are.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+
+#include "payloads.h"
+
+namespace native {
+
+enum class EventVerdict : uint8_t {
+    Accept,
+    Stale,
+    Reordered,
+};
+
+/**
+ * Microseconds since the epoch for an ISO 8601 timestamp,
+ * "YYYY-MM-DDTHH:MM:SS[.ffffff][Z|+HH:MM|-HH:MM]" (a space for the T is
+ * fine). False if it is not one.
+ */
+inline bool parse_iso_timestamp(const std::string& text, int64_t& epoch_us) {
+    auto digits = [&text](size_t pos, size_t count, int& out) {
+        if (pos + count > text.size()) {
+            return false;
+        }
+        out = 0;
+        for (size_t i = pos; i < pos + count; i++) {
+            if (text[i] < '0' || text[i] > '9') {
+                return false;
+            }
+            out = out * 10 + (text[i] - '0');
+        }
+        return true;
+    };
+
+    std::tm tm = {};
+    int year, month, day, hour, minute, second;
+    if (!digits(0, 4, year) || text.size() < 19 || text[4] != '-' || !digits(5, 2, month) || text[7] != '-' ||
+        !digits(8, 2, day) || (text[10] != 'T' && text[10] != ' ') || !digits(11, 2, hour) || text[13] != ':' ||
+        !digits(14, 2, minute) || text[16] != ':' || !digits(17, 2, second)) {
+        return false;
+    }
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+
+    size_t pos = 19;
+    int64_t micros = 0;
+    if (pos < text.size() && text[pos] == '.') {
+        int scale = 100000;
+        for (pos++; pos < text.size() && text[pos] >= '0' && text[pos] <= '9'; pos++) {
+            micros += (text[pos] - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    std::time_t secs;
+    if (pos == text.size()) {
+        tm.tm_isdst = -1;
+        secs = mktime(&tm);
+    } else {
+        int offset_s = 0;
+        if (text[pos] != 'Z' || pos + 1 != text.size()) {
+            int offset_h, offset_m;
+            if ((text[pos] != '+' && text[pos] != '-') || pos + 6 != text.size() || !digits(pos + 1, 2, offset_h) ||
+                text[pos + 3] != ':' || !digits(pos + 4, 2, offset_m)) {
+                return false;
+            }
+            offset_s = (offset_h * 60 + offset_m) * 60 * (text[pos] == '-' ? -1 : 1);
+        }
+        secs = timegm(&tm) - offset_s;
+    }
+    if (secs == static_cast<std::time_t>(-1)) {
+        return false;
+    }
+    epoch_us = static_cast<int64_t>(secs) * 1000000 + micros;
+    return true;
+}
+
+class EventFilter {
+public:
+    using Clock = std::chrono::system_clock;
+
+    // max_age_ms <= 0 turns the age check off; order off accepts any order
+    EventFilter(int max_age_ms, bool order) : max_age_us(static_cast<int64_t>(max_age_ms) * 1000), order(order) {
+    }
+
+    EventVerdict check(const std::string& topic, const std::string& payload, Clock::time_point now = Clock::now()) {
+        std::string timestamp;
+        int64_t event_us;
+        if (!json_string_field(payload, "timestamp", timestamp) || !parse_iso_timestamp(timestamp, event_us)) {
+            return EventVerdict::Accept;
+        }
+
+        int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+        if (max_age_us > 0 && now_us - event_us > max_age_us) {
+            return EventVerdict::Stale;
+        }
+        if (!order) {
+            return EventVerdict::Accept;
+        }
+
+        std::string source, server;
+        json_string_field(payload, "source", source);
+        json_string_field(payload, "server", server);
+        std::string key = topic + '\0' + source + '\0' + server;
+        auto it = last_applied_us.find(key);
+        if (it != last_applied_us.end() && event_us < it->second) {
+            return EventVerdict::Reordered;
+        }
+        last_applied_us[key] = event_us;
+        return EventVerdict::Accept;
+    }
+
+    size_t source_count() const {
+        return last_applied_us.size();
+    }
+
+private:
+    int64_t max_age_us;
+    bool order;
+    std::unordered_map<std::string, int64_t> last_applied_us;
+};
+
+}  // namespace native
@@ -0,0 +1,398 @@
+/**
+ * Table-driven log event parser
+ *
+ * Turns Synergy-family server logs into typed records: screen switches,
+ * client connects and disconnects, and clipboard updates. The formats are
+ * declared in EVENT_GRAMMARS below. At construction the anchor of every
+ * grammar (its text up to the first field) is compiled into one
+ * Aho-Corasick DFA, so each line is read once, a byte per table lookup,
+ * whatever the number of grammars. When a state completes an anchor, the
+ * rest of that one grammar is matched in place; no pattern re-scans the
+ * line.
+ *
+ * If every anchor contains a common byte (the '"' around screen names in the
+ * built-in table), lines without it are skipped with memchr and never enter
+ * the DFA, which keeps the common case close to memory speed.
+ *
+ * Grammar syntax: literal text plus fields in braces.
+ *
+ *     {from}, {screen}   a non-empty name up to the next literal character
+ *     {clipboard}        a decimal clipboard id
+ *
+ * A grammar matches only if it is followed by the end of the line, a space
+ * or '\r', like switch_scanner.h's switch grammar.
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include "switch_scanner.h"
+
+namespace native {
+
+enum class EventKind : uint8_t {
+    Switch,
+    Connect,
+    Disconnect,
+    Clipboard,
+};
+
+inline const char* event_kind_name(EventKind kind) {
+    switch (kind) {
+        case EventKind::Switch: return "switch";
+        case EventKind::Connect: return "connect";
+        case EventKind::Disconnect: return "disconnect";
+        case EventKind::Clipboard: return "clipboard";
+    }
+    return "unknown";
+}
+
+struct EventGrammar {
+    EventKind kind;
+    const char* pattern;
+};
+
+/*
+ * Synergy 1.x, Synergy 3.x, Barrier, Input Leap and Deskflow are all built
+ * on the same server core and keep its log messages, so one row covers
+ * every product; the products differ only in the line prefix, which the
+ * parser does not depend on. Add a row here for a product-specific wording.
+ */
+static const EventGrammar EVENT_GRAMMARS[] = {
+    {EventKind::Switch, "switch from \"{from}\" to \"{screen}\""},
+    {EventKind::Connect, "client \"{screen}\" has connected"},
+    {EventKind::Disconnect, "client \"{screen}\" has disconnected"},
+    {EventKind::Clipboard, "screen \"{screen}\" updated clipboard {clipboard}"},
+};
+
+struct LogRecord {
+    EventKind kind;
+    const char* from;           // switch source screen, else null
+    size_t from_len;
+    const char* screen;         // switch target, client, or clipboard owner, as logged
+    size_t screen_len;
+    size_t desktop_len;         // screen without the -xxxxxxxx hash suffix
+    int clipboard;              // clipboard id, -1 for other kinds
+    const char* time;           // contents of a leading "[...]" timestamp, else null
+    size_t time_len;
+    size_t line_end;            // buffer offset just past the record's line
+};
+
+class EventParser {
+public:
+    explicit EventParser(const EventGrammar* grammars = EVENT_GRAMMARS,
+                         size_t count = sizeof(EVENT_GRAMMARS) / sizeof(EVENT_GRAMMARS[0])) {
+        for (size_t i = 0; i < count; i++) {
+            add_grammar(grammars[i]);
+        }
+        build_dfa();
+    }
+
+    size_t grammar_count() const {
+        return compiled.size();
+    }
+
+    size_t state_count() const {
+        return next.size();
+    }
+
+    // Byte every anchor contains, used to skip lines; 0 when there is none
+    char required_byte() const {
+        return required;
+    }
+
+    /**
+     * Call on_record(const LogRecord&) for every recognised line, in order,
+     * at most once per line. Same `final` contract and return value as
+     * scan_switch_events().
+     */
+    template <class Handler>
+    size_t parse(const char* data, size_t len, Handler&& on_record, bool final = true) const {
+        const char* end = data + len;
+        const char* complete_end = end;
+        if (!final) {
+            complete_end = data;
+            for (const char* q = end; q > data; q--) {
+                if (q[-1] == '\n') {
+                    complete_end = q;
+                    break;
+                }
+            }
+        }
+
+        const char* p = data;
+        LogRecord record;
+        while (p < complete_end) {
+            const char* line = p;
+            if (required) {
+                const char* hit = static_cast<const char*>(memchr(p, required, complete_end - p));
+                if (!hit) {
+                    break;
+                }
+                line = hit;
+                while (line > p && line[-1] != '\n') {
+                    line--;
+                }
+            }
+            const char* nl = static_cast<const char*>(memchr(line, '\n', complete_end - line));
+            const char* line_end = nl ? nl : complete_end;
+
+            if (parse_line(line, line_end, record)) {
+                record.line_end = (nl ? nl + 1 : complete_end) - data;
+                on_record(static_cast<const LogRecord&>(record));
+            }
+            p = nl ? nl + 1 : complete_end;
+        }
+        return complete_end - data;
+    }
+
+    // Run the DFA over one line (without its newline); at most one record per line
+    bool parse_line(const char* line, const char* line_end, LogRecord& record) const {
+        uint16_t state = 0;
+        for (const char* p = line; p < line_end;) {
+            state = next[state][static_cast<unsigned char>(*p++)];
+            if (!accepting[state]) {
+                continue;
+            }
+            for (uint16_t g : outputs[state]) {
+                const Compiled& grammar = compiled[g];
+                if (match_tail(grammar, p, line_end, record)) {
+                    record.kind = grammar.kind;
+                    line_timestamp(line, line_end, record);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    enum class Field : uint8_t { None, From, Screen, Clipboard };
+
+    // Literal text followed by a field; the last step may have no field
+    struct Step {
+        std::string literal;
+        Field field;
+    };
+
+    struct Compiled {
+        EventKind kind;
+        std::string anchor;         // literal text before the first field
+        Field anchor_field;         // the field right after the anchor
+        std::vector<Step> steps;    // everything after that field
+    };
+
+    std::vector<Compiled> compiled;
+    std::vector<std::array<uint16_t, 256>> next;
+    std::vector<std::vector<uint16_t>> outputs;
+    std::vector<uint8_t> accepting;
+    char required = 0;
+
+    static Field parse_field(const std::string& name) {
+        if (name == "from") return Field::From;
+        if (name == "screen") return Field::Screen;
+        if (name == "clipboard") return Field::Clipboard;
+        throw std::invalid_argument("Unknown field in event grammar: {" + name + "}");
+    }
+
+    void add_grammar(const EventGrammar& grammar) {
+        std::vector<Step> steps;
+        std::string literal;
+        for (const char* c = grammar.pattern; *c; c++) {
+            if (*c != '{') {
+                literal += *c;
+                continue;
+            }
+            const char* close = strchr(c, '}');
+            if (!close) {
+                throw std::invalid_argument(std::string("Unclosed field in event grammar: ") + grammar.pattern);
+            }
+            steps.push_back({literal, parse_field(std::string(c + 1, close))});
+            literal.clear();
+            c = close;
+        }
+        steps.push_back({literal, Field::None});
+
+        if (steps.front().literal.empty() || steps.front().field == Field::None) {
+            throw std::invalid_argument(std::string("Event grammar needs text before a field: ") + grammar.pattern);
+        }
+        for (size_t i = 1; i + 1 < steps.size(); i++) {
+            if (steps[i].literal.empty()) {
+                throw std::invalid_argument(std::string("Adjacent fields in event grammar: ") + grammar.pattern);
+            }
+        }
+
+        Compiled c;
+        c.kind = grammar.kind;
+        c.anchor = steps.front().literal;
+        c.anchor_field = steps.front().field;
+        c.steps.assign(steps.begin() + 1, steps.end());
+        compiled.push_back(c);
+    }
+
+    // Aho-Corasick over the anchors, flattened into a full transition table
+    void build_dfa() {
+        std::vector<std::array<int, 256>> go(1);
+        go[0].fill(-1);
+        outputs.assign(1, {});
+        for (size_t g = 0; g < compiled.size(); g++) {
+            int state = 0;
+            for (unsigned char c : compiled[g].anchor) {
+                if (go[state][c] < 0) {
+                    go[state][c] = static_cast<int>(go.size());
+                    go.emplace_back();
+                    go.back().fill(-1);
+                    outputs.emplace_back();
+                }
+                state = go[state][c];
+            }
+            outputs[state].push_back(static_cast<uint16_t>(g));
+        }
+        if (go.size() > UINT16_MAX) {
+            throw std::invalid_argument("Event grammar table too large");
+        }
+
+        next.assign(go.size(), {});
+        std::vector<int> fail(go.size(), 0);
+        std::vector<int> queue;
+        for (int c = 0; c < 256; c++) {
+            int s = go[0][c];
+            next[0][c] = static_cast<uint16_t>(s < 0 ? 0 : s);
+            if (s > 0) {
+                queue.push_back(s);
+            }
+        }
+        for (size_t i = 0; i < queue.size(); i++) {
+            int state = queue[i];
+            const auto& inherited = outputs[fail[state]];
+            outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+            for (int c = 0; c < 256; c++) {
+                int s = go[state][c];
+                if (s < 0) {
+                    next[state][c] = next[fail[state]][c];
+                } else {
+                    fail[s] = next[fail[state]][c];
+                    next[state][c] = static_cast<uint16_t>(s);
+                    queue.push_back(s);
+                }
+            }
+        }
+
+        accepting.resize(next.size());
+        for (size_t state = 0; state < next.size(); state++) {
+            accepting[state] = !outputs[state].empty();
+        }
+        choose_required_byte();
+    }
+
+    // Prefer punctuation, which is rarer in log text than letters
+    void choose_required_byte() {
+        required = 0;
+        for (int c = 1; c < 256; c++) {
+            bool in_all = !compiled.empty();
+            for (const Compiled& grammar : compiled) {
+                if (grammar.anchor.find(static_cast<char>(c)) == std::string::npos) {
+                    in_all = false;
+                    break;
+                }
+            }
+            if (!in_all) {
+                continue;
+            }
+            bool alnum_or_space = isalnum(c) || c == ' ';
+            if (!required || !alnum_or_space) {
+                required = static_cast<char>(c);
+                if (!alnum_or_space) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Read one field starting at p, ending before `until` (the next literal's first character)
+    static bool read_field(Field field, const char*& p, const char* line_end, char until,
+                           LogRecord& record) {
+        const char* start = p;
+        if (field == Field::Clipboard) {
+            int value = 0;
+            while (p < line_end && *p >= '0' && *p <= '9' && value < 100000) {
+                value = value * 10 + (*p - '0');
+                p++;
+            }
+            if (p == start) {
+                return false;
+            }
+            record.clipboard = value;
+            return true;
+        }
+
+        const char* found = until
+            ? static_cast<const char*>(memchr(p, until, line_end - p))
+            : line_end;
+        if (!found || found == start) {
+            return false;
+        }
+        p = found;
+        if (field == Field::From) {
+            record.from = start;
+            record.from_len = found - start;
+        } else {
+            record.screen = start;
+            record.screen_len = found - start;
+            record.desktop_len = strip_hash_suffix(start, found - start);
+        }
+        return true;
+    }
+
+    static bool match_tail(const Compiled& grammar, const char* p, const char* line_end,
+                           LogRecord& record) {
+        record.from = nullptr;
+        record.from_len = 0;
+        record.screen = nullptr;
+        record.screen_len = record.desktop_len = 0;
+        record.clipboard = -1;
+
+        Field field = grammar.anchor_field;
+        for (const Step& step : grammar.steps) {
+            char until = step.literal.empty() ? '\0' : step.literal[0];
+            if (!read_field(field, p, line_end, until, record)) {
+                return false;
+            }
+            size_t n = step.literal.size();
+            if (static_cast<size_t>(line_end - p) < n || memcmp(p, step.literal.data(), n) != 0) {
+                return false;
+            }
+            p += n;
+            field = step.field;
+        }
+        return p == line_end || *p == ' ' || *p == '\r';
+    }
+
+    // "[2025-01-01T12:00:00] INFO: ..." -> "2025-01-01T12:00:00"
+    static void line_timestamp(const char* line, const char* line_end, LogRecord& record) {
+        record.time = nullptr;
+        record.time_len = 0;
+        if (line < line_end && *line == '[') {
+            const char* close = static_cast<const char*>(memchr(line, ']', line_end - line));
+            if (close && close - line > 1) {
+                record.time = line + 1;
+                record.time_len = close - line - 1;
+            }
+        }
+    }
+};
+
+inline const EventParser& default_event_parser() {
+    static const EventParser parser;
+    return parser;
+}
+
+}  // namespace native
@@ -0,0 +1,121 @@
+/**
+ * Bounded event queue
+ *
+ * Connects waldo's log reader to its publish stage. push() never blocks:
+ * when the queue is full the oldest item is dropped to make room, because
+ * for desktop switches the newest state is the one worth delivering, and a
+ * reader that stalls on a slow broker backs up into the log pipe instead.
+ * pop() waits up to a timeout, so the consumer can wake for its own timers
+ * (publish retries) without a second thread.
+ *
+ * A ring buffer under one mutex: at most one push and one pop per logged
+ * event, which is far below where contention would matter.
+ */
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace native {
+
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : slots(capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("Queue capacity must be at least 1");
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Never blocks; returns false if the oldest item was dropped to fit this one
+    bool push(T item) {
+        bool dropped_one = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (count == slots.size()) {
+                head = (head + 1) % slots.size();
+                count--;
+                dropped++;
+                dropped_one = true;
+            }
+            slots[(head + count) % slots.size()] = std::move(item);
+            count++;
+            pushed++;
+            if (count > high_water) {
+                high_water = count;
+            }
+        }
+        ready.notify_one();
+        return !dropped_one;
+    }
+
+    // Wait up to timeout for an item; false on timeout, or once closed and empty
+    bool pop(T& out, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!ready.wait_for(lock, timeout, [this] { return count > 0 || closed; }) || count == 0) {
+            return false;
+        }
+        out = std::move(slots[head]);
+        head = (head + 1) % slots.size();
+        count--;
+        popped++;
+        return true;
+    }
+
+    // Wake waiting consumers; items already queued can still be popped
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+
+    bool is_closed() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {
+            {"capacity", slots.size()},
+            {"depth", count},
+            {"high_water", high_water},
+            {"pushed", pushed},
+            {"popped", popped},
+            {"dropped", dropped},
+        };
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+    bool closed = false;
+
+    uint64_t high_water = 0;
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+    uint64_t dropped = 0;
+};
+
+}  // namespace native
@@ -0,0 +1,357 @@
+/**
+ * Shared-memory event ring for local fan-out
+ *
+ * found-him, watch-desktops.sh and other local tools each used to open
+ * their own broker connection and parse the same messages. Instead, one
+ * process per host (synergy-monitord hub, or any nanomq subscriber with
+ * EVENT_RING set) writes every message it accepts into a ring of
+ * fixed-size slots in a POSIX shared memory object. Local consumers map
+ * the ring read-only and each keeps its own cursor, so delivery is a copy
+ * out of shared memory and consumers never slow the writer or each other.
+ *
+ * - Slots: each carries a seqlock word, 2 * index + 1 while being written
+ *   and 2 * index + 2 once complete. A reader that finds another value, or
+ *   sees it change during the copy, was lapped and counts the event lost.
+ * - Head: the number of events written. It advances after the slot is
+ *   complete, so everything before it is readable.
+ * - Waiting: a reader with nothing new sleeps on a futex word the writer
+ *   bumps and wakes after each event. Readers map the ring read-only, so
+ *   they cannot register as waiters and the writer always makes the wake
+ *   call, one syscall per switch. Where there is no futex (macOS) readers
+ *   poll every EVENT_RING_POLL_MS instead.
+ * - Slow readers: the writer never waits for readers. One that falls more
+ *   than EVENT_RING_SLOTS behind skips ahead and counts what it missed.
+ * - One writer: as with the state page, a writer takes an flock() on the
+ *   object and only writes while it holds it; a restarted hub carries on
+ *   from the existing head, so attached readers keep their cursors.
+ *
+ * Messages longer than a slot (EVENT_RING_SLOT_SIZE, ample for switch
+ * payloads) are not written and are counted as oversize.
+ */
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "state_page.h"
+
+namespace native {
+
+// Shared memory object name (shm_open) used when none is configured
+static const char* const DEFAULT_EVENT_RING = "/synergy-events";
+
+// Ring geometry; fixed so every writer and reader agrees on the layout
+static const uint32_t EVENT_RING_SLOTS = 256;
+static const uint32_t EVENT_RING_SLOT_SIZE = 1024;
+
+// Reader wait granularity where there is no futex
+static const int EVENT_RING_POLL_MS = 5;
+
+static const uint32_t EVENT_RING_MAGIC = 0x52455953;  // "SYER"
+static const uint32_t EVENT_RING_VERSION = 1;
+
+struct alignas(64) EventRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slot_size;
+    std::atomic<uint64_t> head;         // events written; the next goes to slot head % slots
+    std::atomic<uint32_t> signal;       // futex word, bumped after each event
+    uint32_t writer_pid;
+};
+
+struct EventRingSlot {
+    std::atomic<uint64_t> sequence;     // 2 * index + 1 while writing, 2 * index + 2 when complete
+    uint32_t topic_len;
+    uint32_t payload_len;
+    // topic, then payload, fill the rest of the slot
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the futex word needs a lock-free 32-bit atomic");
+
+static const size_t EVENT_RING_DATA_SIZE = EVENT_RING_SLOT_SIZE - sizeof(EventRingSlot);
+static const size_t EVENT_RING_BYTES = sizeof(EventRingHeader) + size_t(EVENT_RING_SLOTS) * EVENT_RING_SLOT_SIZE;
+
+inline EventRingSlot* event_ring_slot(void* base, uint64_t index) {
+    return reinterpret_cast<EventRingSlot*>(static_cast<char*>(base) + sizeof(EventRingHeader) +
+                                            (index % EVENT_RING_SLOTS) * EVENT_RING_SLOT_SIZE);
+}
+
+// Sleep until *word != expected, a wake, or timeout; spurious returns are fine
+inline void event_ring_wait(std::atomic<uint32_t>* word, uint32_t expected, std::chrono::nanoseconds timeout) {
+#if defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    // Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    (void)word;
+    (void)expected;
+    std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(timeout, std::chrono::milliseconds(EVENT_RING_POLL_MS)));
+#endif
+}
+
+inline void event_ring_wake(std::atomic<uint32_t>* word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+class EventRingWriter {
+public:
+    explicit EventRingWriter(const std::string& name) : name(name) {
+        if (!is_state_page_name(name)) {
+            throw std::runtime_error("Invalid event ring name " + name + ": must be /NAME");
+        }
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open event ring " + name + ": " + std::string(strerror(errno)));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 ||
+            (static_cast<size_t>(st.st_size) < EVENT_RING_BYTES && ftruncate(fd, EVENT_RING_BYTES) != 0)) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Failed to size event ring " + name + ": " + std::string(strerror(err)));
+        }
+        base = mmap(nullptr, EVENT_RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Failed to map event ring " + name + ": " + std::string(strerror(err)));
+        }
+        header = static_cast<EventRingHeader*>(base);
+    }
+
+    ~EventRingWriter() {
+        munmap(base, EVENT_RING_BYTES);
+        close(fd);  // releases the flock
+    }
+
+    EventRingWriter(const EventRingWriter&) = delete;
+    EventRingWriter& operator=(const EventRingWriter&) = delete;
+
+    // Append an event and wake waiting readers; false while another writer holds the ring, or if it does not fit
+    bool write(const std::string& topic, const std::string& payload) {
+        if (!owner && !take_ownership()) {
+            return false;
+        }
+        if (topic.size() + payload.size() > EVENT_RING_DATA_SIZE) {
+            oversize++;
+            return false;
+        }
+        uint64_t index = header->head.load(std::memory_order_relaxed);
+        EventRingSlot* slot = event_ring_slot(base, index);
+        slot->sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->topic_len = static_cast<uint32_t>(topic.size());
+        slot->payload_len = static_cast<uint32_t>(payload.size());
+        char* data = reinterpret_cast<char*>(slot + 1);
+        memcpy(data, topic.data(), topic.size());
+        memcpy(data + topic.size(), payload.data(), payload.size());
+
+        slot->sequence.store(2 * index + 2, std::memory_order_release);
+        header->head.store(index + 1, std::memory_order_release);
+
+        // A reader that read the old signal before this either sees the
+        // new one when it calls FUTEX_WAIT, or is asleep and woken here
+        header->signal.fetch_add(1, std::memory_order_release);
+        event_ring_wake(&header->signal);
+        written++;
+        return true;
+    }
+
+    const std::string& ring_name() const {
+        return name;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"owner", owner ? 1u : 0u},
+            {"written", written},
+            {"oversize", oversize},
+        };
+    }
+
+private:
+    bool take_ownership() {
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            return false;
+        }
+        owner = true;
+        // A fresh ring (or one from another layout) starts over; otherwise
+        // carry on from its head so attached readers keep their place
+        if (header->magic != EVENT_RING_MAGIC || header->version != EVENT_RING_VERSION ||
+            header->slots != EVENT_RING_SLOTS || header->slot_size != EVENT_RING_SLOT_SIZE) {
+            memset(base, 0, EVENT_RING_BYTES);
+            header->slots = EVENT_RING_SLOTS;
+            header->slot_size = EVENT_RING_SLOT_SIZE;
+            header->version = EVENT_RING_VERSION;
+            std::atomic_thread_fence(std::memory_order_release);
+            header->magic = EVENT_RING_MAGIC;
+        }
+        header->writer_pid = static_cast<uint32_t>(getpid());
+        return true;
+    }
+
+    std::string name;
+    int fd = -1;
+    void* base = nullptr;
+    EventRingHeader* header = nullptr;
+    bool owner = false;
+    uint64_t written = 0;
+    uint64_t oversize = 0;
+};
+
+class EventRingReader {
+public:
+    /**
+     * Attach to the ring `name` with a cursor at its newest event, or with
+     * from_oldest at the oldest one still held. Throws if no writer has
+     * created it yet.
+     */
+    explicit EventRingReader(const std::string& name = DEFAULT_EVENT_RING, bool from_oldest = false) : name(name) {
+        if (!is_state_page_name(name)) {
+            throw std::runtime_error("Invalid event ring name " + name + ": must be /NAME");
+        }
+        int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open event ring " + name + ": " + std::string(strerror(errno)));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < EVENT_RING_BYTES) {
+            close(fd);
+            throw std::runtime_error("Event ring " + name + " is not initialised");
+        }
+        base = mmap(nullptr, EVENT_RING_BYTES, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("Failed to map event ring " + name + ": " + std::string(strerror(errno)));
+        }
+        header = static_cast<EventRingHeader*>(base);
+        if (header->magic != EVENT_RING_MAGIC || header->version != EVENT_RING_VERSION ||
+            header->slots != EVENT_RING_SLOTS || header->slot_size != EVENT_RING_SLOT_SIZE) {
+            munmap(base, EVENT_RING_BYTES);
+            throw std::runtime_error("Event ring " + name + " has an unknown layout");
+        }
+        uint64_t head = header->head.load(std::memory_order_acquire);
+        cursor = from_oldest && head > EVENT_RING_SLOTS ? head - EVENT_RING_SLOTS : (from_oldest ? 0 : head);
+    }
+
+    ~EventRingReader() {
+        munmap(base, EVENT_RING_BYTES);
+    }
+
+    EventRingReader(const EventRingReader&) = delete;
+    EventRingReader& operator=(const EventRingReader&) = delete;
+
+    /**
+     * The next event after the cursor, waiting up to timeout_ms for one
+     * (0: don't wait). False on timeout.
+     */
+    bool next(std::string& topic, std::string& payload, int timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (;;) {
+            uint64_t head = header->head.load(std::memory_order_acquire);
+            if (cursor < head) {
+                if (head - cursor > EVENT_RING_SLOTS) {
+                    lost += head - cursor - EVENT_RING_SLOTS;
+                    cursor = head - EVENT_RING_SLOTS;
+                }
+                if (copy_slot(cursor, topic, payload)) {
+                    cursor++;
+                    received++;
+                    return true;
+                }
+                // Overwritten while we looked: lapped by the writer
+                lost++;
+                cursor++;
+                continue;
+            }
+
+            auto remaining = deadline - std::chrono::steady_clock::now();
+            if (remaining <= std::chrono::nanoseconds::zero()) {
+                return false;
+            }
+            // FUTEX_WAIT only reads the word, so the read-only mapping is enough
+            auto* signal = const_cast<std::atomic<uint32_t>*>(&header->signal);
+            uint32_t seen = signal->load(std::memory_order_acquire);
+            if (header->head.load(std::memory_order_acquire) != head) {
+                continue;
+            }
+            waits++;
+            event_ring_wait(signal, seen, std::chrono::duration_cast<std::chrono::nanoseconds>(remaining));
+        }
+    }
+
+    // Events waiting to be read
+    uint64_t backlog() const {
+        uint64_t head = header->head.load(std::memory_order_acquire);
+        return head > cursor ? std::min<uint64_t>(head - cursor, EVENT_RING_SLOTS) : 0;
+    }
+
+    const std::string& ring_name() const {
+        return name;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"received", received},
+            {"lost", lost},
+            {"waits", waits},
+            {"cursor", cursor},
+        };
+    }
+
+private:
+    bool copy_slot(uint64_t index, std::string& topic, std::string& payload) const {
+        const EventRingSlot* slot = event_ring_slot(base, index);
+        uint64_t before = slot->sequence.load(std::memory_order_acquire);
+        if (before != 2 * index + 2) {
+            return false;
+        }
+        uint32_t topic_len = slot->topic_len;
+        uint32_t payload_len = slot->payload_len;
+        if (size_t(topic_len) + payload_len > EVENT_RING_DATA_SIZE) {
+            return false;
+        }
+        const char* data = reinterpret_cast<const char*>(slot + 1);
+        topic.assign(data, topic_len);
+        payload.assign(data + topic_len, payload_len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    std::string name;
+    void* base = nullptr;
+    const EventRingHeader* header = nullptr;
+    uint64_t cursor = 0;
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    uint64_t waits = 0;
+};
+
+}  // namespace native
@@ -0,0 +1,137 @@
+/**
+ * Switch flap suppression
+ *
+ * When the pointer rides along a screen edge, Synergy logs bursts like
+ * A->B->A->B, and publishing each one wakes every subscriber. FlapFilter
+ * decides per switch whether to publish it:
+ *
+ *   - a switch after at least dwell of quiet is clean and is published at
+ *     once, so ordinary switches get no added latency
+ *   - a rapid switch (within dwell of the previous one) that goes back to
+ *     the screen just left is a reversal; the first `hysteresis` reversals
+ *     of a burst are still published, after that the burst is flapping and
+ *     further switches are suppressed
+ *   - once the pointer has stayed put for dwell, the burst has settled:
+ *     the screen it ended on is published if it is not the one last sent
+ *
+ * Rapid switches that are not reversals (A->B->C, crossing a screen on the
+ * way) are published as usual. Time is passed in, so the filter is a plain
+ * state machine; the owner calls poll() at deadline() to settle a burst.
+ * Not thread-safe: one owner drives it.
+ */
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+namespace native {
+
+enum class FlapAction : uint8_t {
+    Publish,
+    Suppress,
+    StartFlapping,      // suppressed, and the burst just became flapping
+};
+
+class FlapFilter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FlapFilter(int dwell_ms, int hysteresis) : dwell(std::chrono::milliseconds(dwell_ms)), hysteresis(hysteresis) {
+    }
+
+    FlapAction on_switch(const std::string& to, Clock::time_point now) {
+        bool rapid = has_switched && now - last_switch < dwell;
+        bool reversal = rapid && to == previous;
+        previous = current;
+        current = to;
+        last_switch = now;
+        has_switched = true;
+
+        if (!rapid) {
+            // A flapping burst nobody polled has settled by now; this switch replaces it
+            flapping = false;
+            reversals = 0;
+            published = to;
+            return FlapAction::Publish;
+        }
+        if (flapping) {
+            suppressed++;
+            burst_suppressed++;
+            return FlapAction::Suppress;
+        }
+        if (reversal && ++reversals > hysteresis) {
+            flapping = true;
+            bursts++;
+            suppressed++;
+            burst_suppressed = 1;
+            return FlapAction::StartFlapping;
+        }
+        published = to;
+        return FlapAction::Publish;
+    }
+
+    /**
+     * Settle a flapping burst once dwell has passed since its last switch.
+     * Returns true when it settled; `publish` is set to the screen to send,
+     * or cleared if it ended where the last published switch already went.
+     */
+    bool poll(Clock::time_point now, std::string& publish) {
+        if (!flapping || now - last_switch < dwell) {
+            return false;
+        }
+        flapping = false;
+        reversals = 0;
+        publish.clear();
+        if (current != published) {
+            published = current;
+            publish = current;
+        }
+        return true;
+    }
+
+    bool is_flapping() const {
+        return flapping;
+    }
+
+    // When poll() should next be called; only meaningful while flapping
+    Clock::time_point deadline() const {
+        return last_switch + dwell;
+    }
+
+    const std::string& screen() const {
+        return current;
+    }
+
+    // Switches suppressed in the current (or last) flapping burst
+    uint64_t burst_suppressed_count() const {
+        return burst_suppressed;
+    }
+
+    uint64_t suppressed_count() const {
+        return suppressed;
+    }
+
+    uint64_t burst_count() const {
+        return bursts;
+    }
+
+private:
+    Clock::duration dwell;
+    int hysteresis;
+
+    bool has_switched = false;
+    bool flapping = false;
+    int reversals = 0;
+    Clock::time_point last_switch{};
+    std::string previous;
+    std::string current;
+    std::string published;
+
+    uint64_t suppressed = 0;
+    uint64_t burst_suppressed = 0;
+    uint64_t bursts = 0;
+};
+
+}  // namespace native
@@ -0,0 +1,862 @@
+/**
+ * Native log follower
+ *
+ * Follows append-only log files the way `tail -F` does, without the extra
+ * process and pipe: it sleeps until the kernel reports a change in a log's
+ * directory (inotify on Linux, kqueue on macOS/BSD), reads the appended bytes
+ * straight from the file and hands them to a callback in blocks of complete
+ * lines, so the consumer can scan a whole read at once.
+ *
+ * Any number of logs (one per Synergy server) are followed by a single thread
+ * with a single inotify descriptor or kqueue, so the wait costs the same for
+ * one log as for ten. Each notification names the log it concerns, and only
+ * that log is read.
+ *
+ * Rotation (the path now names a different inode) and truncation (the file
+ * shrank below the read offset) are checked on every wake-up. The old file is
+ * drained before switching, so lines written just before a rotation are not
+ * lost.
+ *
+ * With a checkpoint file enabled, the position after every handled chunk (and
+ * every event the consumer commits) is recorded, and the next start resumes
+ * from it instead of the end of the log: from the same file if it is still
+ * there, from its rotated name in the same directory if the log was rotated
+ * in between, or from the start of the current log otherwise.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define NANOMQ_FOLLOW_INOTIFY 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#include <sys/event.h>
+#define NANOMQ_FOLLOW_KQUEUE 1
+#endif
+
+#include "checkpoint.h"
+
+namespace native {
+
+/**
+ * One followed log: its open file, read position, carried-over partial line
+ * and checkpoint. Not thread-safe except for stats(); LogFollower drives it
+ * from its worker thread.
+ */
+class LogSource {
+public:
+    // Receives one or more complete lines, each terminated by '\n'
+    using ChunkHandler = std::function<void(const char* data, size_t len)>;
+
+    // A "line" longer than this without a newline is dropped, not buffered
+    static const size_t MAX_LINE_BYTES = 1 << 20;
+
+    LogSource(const std::string& path, bool start_at_end)
+        : path(path), start_at_end(start_at_end) {
+        std::string::size_type slash = path.rfind('/');
+        if (slash == std::string::npos) {
+            dir = ".";
+            name = path;
+        } else {
+            dir = slash == 0 ? "/" : path.substr(0, slash);
+            name = path.substr(slash + 1);
+        }
+        if (name.empty()) {
+            throw std::invalid_argument("Log path names a directory: " + path);
+        }
+    }
+
+    ~LogSource() {
+        close_file();
+    }
+
+    LogSource(const LogSource&) = delete;
+    LogSource& operator=(const LogSource&) = delete;
+
+    const std::string& log_path() const {
+        return path;
+    }
+
+    const std::string& directory() const {
+        return dir;
+    }
+
+    const std::string& file_name() const {
+        return name;
+    }
+
+    int file_fd() const {
+        return fd;
+    }
+
+    void enable_checkpoint(const std::string& checkpoint_path) {
+        checkpoint.reset(new CheckpointFile(checkpoint_path));
+    }
+
+    // handler receives the lines; on_open is told about every file opened
+    void attach(ChunkHandler handler, std::function<void(LogSource&)> on_open) {
+        on_chunk = std::move(handler);
+        on_file_open = std::move(on_open);
+    }
+
+    // Open the log: from the checkpoint if there is a usable one
+    void open_initial() {
+        IngestPosition saved;
+        if (!(checkpoint && checkpoint->load(saved) && resume(saved))) {
+            open_file(start_at_end);
+        }
+    }
+
+    void drain() {
+        if (fd < 0) {
+            return;
+        }
+        char buf[64 * 1024];
+        for (;;) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return;
+            }
+            bytes_read.fetch_add(static_cast<uint64_t>(n));
+            uint64_t read_offset = offset.fetch_add(static_cast<uint64_t>(n));
+            split_lines(buf, static_cast<size_t>(n), read_offset);
+        }
+    }
+
+    /**
+     * Switch to a new file if the path was rotated or the file truncated.
+     * Returns true when reading should restart immediately.
+     */
+    bool check_replaced() {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            // Rotated away and not recreated yet; keep the old file open
+            return false;
+        }
+
+        if (fd < 0 || st.st_dev != file_dev || st.st_ino != file_ino) {
+            bool was_open = fd >= 0;
+            if (!open_file(false)) {
+                return false;
+            }
+            if (was_open) {
+                rotations.fetch_add(1);
+            }
+            return true;
+        }
+
+        if (static_cast<uint64_t>(st.st_size) < offset.load()) {
+            lseek(fd, 0, SEEK_SET);
+            offset.store(0);
+            emit_offset = 0;
+            partial.clear();
+            dropping_line = false;
+            position.offset = 0;
+            position.event_end = position.event_len = position.event_hash = 0;
+            record_position();
+            truncations.fetch_add(1);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Record that the event whose line ends `line_end` bytes into the chunk
+     * being handled has been acted on. Only valid inside the chunk handler;
+     * a restart after this call resumes past that line.
+     */
+    void commit_event(size_t line_end) {
+        if (!checkpoint || !chunk_data) {
+            return;
+        }
+        const char* end = chunk_data + line_end;
+        const char* start = end - 1;    // the line's newline
+        while (start > chunk_data && start[-1] != '\n') {
+            start--;
+        }
+        position.offset = chunk_base + line_end;
+        position.event_end = position.offset;
+        position.event_len = static_cast<uint64_t>(end - start);
+        position.event_hash = fnv1a(start, end - start);
+        checkpoint->store(position);
+    }
+
+    void sync_checkpoint(bool force) {
+        if (checkpoint) {
+            if (force) {
+                checkpoint->sync();
+            } else {
+                checkpoint->sync_if_due();
+            }
+        }
+    }
+
+    void close_file() {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"bytes", bytes_read.load()},
+            {"rotations", rotations.load()},
+            {"truncations", truncations.load()},
+            {"offset", offset.load()},
+            {"resumed", resumed.load()},
+            {"checkpoint_writes", checkpoint ? checkpoint->write_count() : 0},
+            {"checkpoint_syncs", checkpoint ? checkpoint->sync_count() : 0},
+        };
+    }
+
+    // Follower bookkeeping: set when a notification concerns this log
+    bool pending = true;
+    int watch_id = -1;          // inotify watch or kqueue directory descriptor
+
+private:
+    std::string path;
+    std::string dir;
+    std::string name;
+    bool start_at_end;
+
+    int fd = -1;
+    dev_t file_dev = 0;
+    ino_t file_ino = 0;
+    std::string partial;
+    bool dropping_line = false;
+
+    ChunkHandler on_chunk;
+    std::function<void(LogSource&)> on_file_open;
+
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> rotations{0};
+    std::atomic<uint64_t> truncations{0};
+    std::atomic<uint64_t> offset{0};    // bytes consumed, including a partial line
+    std::atomic<uint64_t> resumed{0};
+
+    std::unique_ptr<CheckpointFile> checkpoint;
+    IngestPosition position;            // last position recorded
+    uint64_t emit_offset = 0;           // file offset of the first byte not yet handed out
+    const char* chunk_data = nullptr;   // chunk being handled, for commit_event()
+    uint64_t chunk_base = 0;
+
+    bool open_file(bool seek_end) {
+        int new_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (new_fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(new_fd, &st) != 0) {
+            close(new_fd);
+            return false;
+        }
+
+        adopt_file(new_fd, st, seek_end ? st.st_size : 0);
+        record_position();
+        return true;
+    }
+
+    void adopt_file(int new_fd, const struct stat& st, off_t start) {
+        close_file();
+        fd = new_fd;
+        file_dev = st.st_dev;
+        file_ino = st.st_ino;
+        partial.clear();
+        dropping_line = false;
+
+        lseek(fd, start, SEEK_SET);
+        offset.store(static_cast<uint64_t>(start));
+        emit_offset = static_cast<uint64_t>(start);
+
+        position = IngestPosition();
+        position.dev = static_cast<uint64_t>(st.st_dev);
+        position.ino = static_cast<uint64_t>(st.st_ino);
+        position.offset = emit_offset;
+
+        if (on_file_open) {
+            on_file_open(*this);
+        }
+    }
+
+    /**
+     * Reopen the file a checkpoint was taken in and continue after the last
+     * line handled. Returns false when the checkpoint cannot be used and the
+     * log should be opened as if there were none.
+     */
+    bool resume(const IngestPosition& saved) {
+        std::string found = find_file(saved.dev, saved.ino);
+        if (found.empty()) {
+            // Rotated away and gone: everything in the current log is newer
+            // than the checkpoint
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) {
+                return false;
+            }
+            resumed.store(1);
+            return open_file(false);
+        }
+
+        int new_fd = open(found.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (new_fd < 0 || fstat(new_fd, &st) != 0) {
+            if (new_fd >= 0) {
+                close(new_fd);
+            }
+            return false;
+        }
+
+        // Same inode, but truncated and rewritten since: read it from the start
+        uint64_t start = saved.offset;
+        if (static_cast<uint64_t>(st.st_size) < saved.offset || !event_matches(new_fd, saved)) {
+            start = 0;
+            truncations.fetch_add(1);
+        }
+
+        adopt_file(new_fd, st, static_cast<off_t>(start));
+        if (start == saved.offset) {
+            position = saved;
+        }
+        record_position();
+        resumed.store(1);
+        return true;
+    }
+
+    // The path itself or, after a rotation, a sibling such as synergy.log.1
+    std::string find_file(uint64_t dev, uint64_t ino) const {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 &&
+            static_cast<uint64_t>(st.st_dev) == dev && static_cast<uint64_t>(st.st_ino) == ino) {
+            return path;
+        }
+
+        std::string found;
+        DIR* d = opendir(dir.c_str());
+        if (!d) {
+            return found;
+        }
+        while (struct dirent* entry = readdir(d)) {
+            if (strncmp(entry->d_name, name.c_str(), name.size()) != 0 ||
+                static_cast<uint64_t>(entry->d_ino) != ino) {
+                continue;
+            }
+            std::string candidate = dir + "/" + entry->d_name;
+            if (stat(candidate.c_str(), &st) == 0 && static_cast<uint64_t>(st.st_dev) == dev &&
+                static_cast<uint64_t>(st.st_ino) == ino) {
+                found = candidate;
+                break;
+            }
+        }
+        closedir(d);
+        return found;
+    }
+
+    static bool event_matches(int file_fd, const IngestPosition& saved) {
+        if (saved.event_len == 0) {
+            return true;
+        }
+        if (saved.event_len > MAX_LINE_BYTES || saved.event_end < saved.event_len) {
+            return false;
+        }
+        std::string line(static_cast<size_t>(saved.event_len), '\0');
+        ssize_t n = pread(file_fd, &line[0], line.size(),
+                          static_cast<off_t>(saved.event_end - saved.event_len));
+        return n == static_cast<ssize_t>(line.size()) &&
+               fnv1a(line.data(), line.size()) == saved.event_hash;
+    }
+
+    void record_position() {
+        if (checkpoint) {
+            position.offset = emit_offset;
+            checkpoint->store(position);
+        }
+    }
+
+    // read_offset: file offset of data[0]
+    void split_lines(const char* data, size_t len, uint64_t read_offset) {
+        const char* end = data + len;
+
+        // Complete a line carried over from the previous read first
+        if (!partial.empty() || dropping_line) {
+            const char* nl = static_cast<const char*>(memchr(data, '\n', len));
+            if (!nl) {
+                buffer_partial(data, len);
+                return;
+            }
+            if (dropping_line) {
+                dropping_line = false;
+                emit_offset = read_offset + (nl + 1 - data);
+                record_position();
+            } else {
+                partial.append(data, nl + 1 - data);
+                emit(partial.data(), partial.size());
+                partial.clear();
+            }
+            data = nl + 1;
+        }
+
+        const char* last_nl = end;
+        while (last_nl > data && last_nl[-1] != '\n') {
+            last_nl--;
+        }
+        if (last_nl > data) {
+            emit(data, last_nl - data);
+        }
+        if (last_nl < end) {
+            buffer_partial(last_nl, end - last_nl);
+        }
+    }
+
+    void buffer_partial(const char* data, size_t len) {
+        if (dropping_line) {
+            return;
+        }
+        if (partial.size() + len > MAX_LINE_BYTES) {
+            partial.clear();
+            dropping_line = true;
+            return;
+        }
+        partial.append(data, len);
+    }
+
+    void emit(const char* data, size_t len) {
+        chunk_data = data;
+        chunk_base = emit_offset;
+        if (on_chunk) {
+            on_chunk(data, len);
+        }
+        chunk_data = nullptr;
+        emit_offset += len;
+        record_position();
+    }
+};
+
+class LogFollower {
+public:
+    // Receives complete lines read from the log with the given index
+    using ChunkHandler = std::function<void(size_t source, const char* data, size_t len)>;
+    // Runs on the follower thread at the time last requested with wake_at()
+    using TickHandler = std::function<void()>;
+
+    // Safety net: re-check every log this often even without a notification
+    // (missing directory, events dropped on overflow, network filesystems)
+    static const int RESCAN_INTERVAL_MS = 1000;
+
+    LogFollower() {
+        if (pipe(wake_pipe) != 0) {
+            throw std::runtime_error("Failed to create wake pipe: " + std::string(strerror(errno)));
+        }
+        for (int fd : wake_pipe) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    explicit LogFollower(const std::string& path, bool start_at_end = true) : LogFollower() {
+        add_source(path, start_at_end);
+    }
+
+    ~LogFollower() {
+        stop();
+        sources.clear();
+        close_watch();
+        close(wake_pipe[0]);
+        close(wake_pipe[1]);
+    }
+
+    LogFollower(const LogFollower&) = delete;
+    LogFollower& operator=(const LogFollower&) = delete;
+
+    // Follow another log; call before start(). Returns its source index.
+    size_t add_source(const std::string& path, bool start_at_end = true) {
+        if (running.load()) {
+            throw std::runtime_error("Logs must be added before the follower starts");
+        }
+        sources.emplace_back(new LogSource(path, start_at_end));
+        return sources.size() - 1;
+    }
+
+    // Persist a log's read position to checkpoint_path and resume from it; call before start()
+    void enable_checkpoint(const std::string& checkpoint_path, size_t source = 0) {
+        if (running.load()) {
+            throw std::runtime_error("Checkpoint must be enabled before the follower starts");
+        }
+        sources.at(source)->enable_checkpoint(checkpoint_path);
+    }
+
+    size_t source_count() const {
+        return sources.size();
+    }
+
+    // Handler for wake_at() deadlines; call before start()
+    void set_tick_handler(TickHandler handler) {
+        if (running.load()) {
+            throw std::runtime_error("Tick handler must be set before the follower starts");
+        }
+        on_tick = std::move(handler);
+    }
+
+    /**
+     * Run the tick handler at `when` (or soon after), even if no log
+     * changes. Only valid on the follower thread, i.e. inside the chunk or
+     * tick handler; an earlier pending deadline is kept.
+     */
+    void wake_at(std::chrono::steady_clock::time_point when) {
+        if (!has_tick || when < next_tick) {
+            next_tick = when;
+            has_tick = true;
+        }
+    }
+
+    void start(ChunkHandler handler) {
+        if (sources.empty()) {
+            throw std::runtime_error("No logs to follow");
+        }
+        if (running.exchange(true)) {
+            return;
+        }
+        on_chunk = std::move(handler);
+        for (size_t i = 0; i < sources.size(); i++) {
+            sources[i]->attach(
+                [this, i](const char* data, size_t len) { on_chunk(i, data, len); },
+                [this](LogSource& source) { watch_file(source); });
+        }
+        worker = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        running.store(false);
+        char byte = 1;
+        ssize_t ignored = write(wake_pipe[1], &byte, 1);
+        (void)ignored;
+        if (worker.joinable()) {
+            worker.join();
+        }
+        for (auto& source : sources) {
+            source->sync_checkpoint(true);
+        }
+    }
+
+    bool is_running() const {
+        return running.load();
+    }
+
+    const std::string& log_path(size_t source = 0) const {
+        return sources.at(source)->log_path();
+    }
+
+    /**
+     * Record that an event in the chunk being handled has been acted on; see
+     * LogSource::commit_event. Only valid inside the chunk handler.
+     */
+    void commit_event(size_t line_end) {
+        if (current) {
+            current->commit_event(line_end);
+        }
+    }
+
+    // Totals over all logs
+    std::map<std::string, uint64_t> stats() const {
+        std::map<std::string, uint64_t> total;
+        for (const auto& source : sources) {
+            for (const auto& kv : source->stats()) {
+                total[kv.first] += kv.second;
+            }
+        }
+        total["wakeups"] = wakeups.load();
+        total["sources"] = sources.size();
+        return total;
+    }
+
+    std::map<std::string, uint64_t> source_stats(size_t source) const {
+        return sources.at(source)->stats();
+    }
+
+private:
+    std::vector<std::unique_ptr<LogSource>> sources;
+    LogSource* current = nullptr;       // source whose chunk is being handled
+
+    int watch_fd = -1;
+    int wake_pipe[2] = {-1, -1};
+
+    std::thread worker;
+    std::atomic<bool> running{false};
+    ChunkHandler on_chunk;
+    TickHandler on_tick;
+    bool has_tick = false;
+    std::chrono::steady_clock::time_point next_tick{};
+
+    std::atomic<uint64_t> wakeups{0};
+
+    void run() {
+        open_watch();
+        for (auto& source : sources) {
+            source->open_initial();
+        }
+
+        while (running.load()) {
+            bool again = false;
+            for (auto& source : sources) {
+                if (!source->pending) {
+                    continue;
+                }
+                source->pending = false;
+                current = source.get();
+                source->drain();
+                current = nullptr;
+                if (source->check_replaced()) {
+                    // Read the new file right away, it may already have lines
+                    source->pending = true;
+                    again = true;
+                }
+            }
+            if (again) {
+                continue;
+            }
+
+            wait_for_change();
+            run_tick();
+            for (auto& source : sources) {
+                source->sync_checkpoint(false);
+            }
+        }
+    }
+
+    // How long to wait for a change: the rescan interval, or less if a tick is due sooner
+    int wait_timeout_ms(bool& for_tick) const {
+        for_tick = false;
+        if (!has_tick) {
+            return RESCAN_INTERVAL_MS;
+        }
+        auto until = std::chrono::duration_cast<std::chrono::milliseconds>(
+            next_tick - std::chrono::steady_clock::now()).count() + 1;
+        if (until >= RESCAN_INTERVAL_MS) {
+            return RESCAN_INTERVAL_MS;
+        }
+        for_tick = true;
+        return until > 0 ? static_cast<int>(until) : 0;
+    }
+
+    void run_tick() {
+        if (has_tick && std::chrono::steady_clock::now() >= next_tick) {
+            has_tick = false;
+            if (on_tick) {
+                on_tick();
+            }
+        }
+    }
+
+    void mark_all() {
+        for (auto& source : sources) {
+            source->pending = true;
+        }
+    }
+
+#if defined(NANOMQ_FOLLOW_INOTIFY)
+    void open_watch() {
+        watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watch_fd < 0) {
+            return;
+        }
+        // Watching the directory covers writes, creation and renames of the
+        // log under its name, so one watch survives any number of rotations.
+        // Logs sharing a directory get the same watch descriptor back.
+        for (auto& source : sources) {
+            source->watch_id = inotify_add_watch(watch_fd, source->directory().c_str(),
+                                                 IN_MODIFY | IN_CREATE | IN_MOVED_TO |
+                                                 IN_MOVED_FROM | IN_DELETE | IN_ATTRIB);
+        }
+    }
+
+    void watch_file(LogSource&) {
+    }
+
+    void close_watch() {
+        if (watch_fd >= 0) {
+            close(watch_fd);
+            watch_fd = -1;
+        }
+    }
+
+    void wait_for_change() {
+        struct pollfd fds[2] = {
+            {wake_pipe[0], POLLIN, 0},
+            {watch_fd, POLLIN, 0},
+        };
+        bool for_tick;
+        int rv = poll(fds, watch_fd >= 0 ? 2 : 1, wait_timeout_ms(for_tick));
+        wakeups.fetch_add(1);
+        drain_wake_pipe();
+        if (rv == 0 && for_tick && watch_fd >= 0) {
+            return;     // woken early for a tick, not a rescan
+        }
+        if (rv <= 0 || watch_fd < 0) {
+            mark_all();
+            return;
+        }
+
+        // Events for other files in a watched directory only cost this read
+        alignas(struct inotify_event) char buf[4096];
+        ssize_t n;
+        while ((n = read(watch_fd, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + n;) {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    mark_all();
+                    continue;
+                }
+                for (auto& source : sources) {
+                    // Prefix match also catches writes to a just-rotated log.1
+                    const std::string& name = source->file_name();
+                    if (source->watch_id == event->wd &&
+                        (event->len == 0 || strncmp(event->name, name.c_str(), name.size()) == 0)) {
+                        source->pending = true;
+                    }
+                }
+            }
+        }
+    }
+#elif defined(NANOMQ_FOLLOW_KQUEUE)
+    void open_watch() {
+        watch_fd = kqueue();
+        if (watch_fd < 0) {
+            return;
+        }
+
+        struct kevent ev;
+        EV_SET(&ev, wake_pipe[0], EVFILT_READ, EV_ADD, 0, 0, nullptr);
+        kevent(watch_fd, &ev, 1, nullptr, 0, nullptr);
+
+        // Directory writes report a log being created or renamed; one
+        // descriptor per directory, shared by the logs in it
+        std::map<std::string, int> dir_fds;
+        for (auto& source : sources) {
+            auto it = dir_fds.find(source->directory());
+            if (it != dir_fds.end()) {
+                source->watch_id = it->second;
+                continue;
+            }
+#ifdef O_EVTONLY
+            int dir_fd = open(source->directory().c_str(), O_EVTONLY | O_CLOEXEC);
+#else
+            int dir_fd = open(source->directory().c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+            dir_fds[source->directory()] = dir_fd;
+            source->watch_id = dir_fd;
+            if (dir_fd >= 0) {
+                EV_SET(&ev, dir_fd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE, 0, nullptr);
+                kevent(watch_fd, &ev, 1, nullptr, 0, nullptr);
+                watched_dirs.push_back(dir_fd);
+            }
+        }
+    }
+
+    // kqueue watches descriptors, so each newly opened file is registered;
+    // closing the previous file removed its registration
+    void watch_file(LogSource& source) {
+        if (watch_fd < 0) {
+            return;
+        }
+        struct kevent ev;
+        EV_SET(&ev, source.file_fd(), EVFILT_VNODE, EV_ADD | EV_CLEAR,
+               NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME | NOTE_ATTRIB, 0, &source);
+        kevent(watch_fd, &ev, 1, nullptr, 0, nullptr);
+    }
+
+    void close_watch() {
+        for (int dir_fd : watched_dirs) {
+            close(dir_fd);
+        }
+        watched_dirs.clear();
+        if (watch_fd >= 0) {
+            close(watch_fd);
+            watch_fd = -1;
+        }
+    }
+
+    void wait_for_change() {
+        wakeups.fetch_add(1);
+        bool for_tick;
+        int timeout_ms = wait_timeout_ms(for_tick);
+        if (watch_fd < 0) {
+            poll(nullptr, 0, timeout_ms);
+            mark_all();
+            return;
+        }
+        struct kevent events[16];
+        struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+        int n = kevent(watch_fd, nullptr, 0, events, 16, &timeout);
+        drain_wake_pipe();
+        if (n == 0 && for_tick) {
+            return;     // woken early for a tick, not a rescan
+        }
+        if (n <= 0) {
+            mark_all();
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].udata) {
+                static_cast<LogSource*>(events[i].udata)->pending = true;
+                continue;
+            }
+            for (auto& source : sources) {
+                if (source->watch_id == static_cast<int>(events[i].ident)) {
+                    source->pending = true;
+                }
+            }
+        }
+    }
+
+    std::vector<int> watched_dirs;
+#else
+    // No change notification on this platform: poll at the rescan interval
+    void open_watch() {
+    }
+
+    void watch_file(LogSource&) {
+    }
+
+    void close_watch() {
+    }
+
+    void wait_for_change() {
+        struct pollfd wake = {wake_pipe[0], POLLIN, 0};
+        bool for_tick;
+        poll(&wake, 1, wait_timeout_ms(for_tick));
+        wakeups.fetch_add(1);
+        drain_wake_pipe();
+        mark_all();
+    }
+#endif
+
+    void drain_wake_pipe() {
+        char buf[64];
+        while (read(wake_pipe[0], buf, sizeof(buf)) > 0) {
+        }
+    }
+};
+
+}  // namespace native
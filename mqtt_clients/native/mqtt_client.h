@@ -0,0 +1,1879 @@
+/**
+ * NanoSDK MQTT client
+ *
+ * The MQTT 3.1.1 client behind both the Python bindings (nanomq_bindings.cpp)
+ * and the synergy-monitord daemon (daemon/): dialing and redialing with
+ * optional TLS, a pool of send aios for publishes, subscriptions restored on
+ * restart(), and a receive thread that hands each PUBLISH to a callback.
+ * Transport and thread tuning come from a TuningProfile.
+ *
+ * Plain C++ with no Python in it: callbacks are std::function and run on the
+ * receive thread (or, with local delivery, on the publishing thread). An
+ * optional EventFilter (native/event_filter.h) keeps stale and out-of-order
+ * events from reaching the callback, and optional sequence numbers
+ * (native/sequence.h) let a subscriber notice missed events and ask the
+ * publisher for its current state. Every switch received is also filed in
+ * a StateCache (native/state_cache.h), so the current desktop is known
+ * without waiting for the callback, and optionally copied to a shared
+ * memory page local processes read without a connection
+ * (native/state_page.h). Retained messages and state replies only go to
+ * the cache: they are the current state, not new switches. Accepted messages can also be fanned out to local
+ * consumers through a shared memory ring (native/event_ring.h). A client
+ * can also ask the publisher for the current desktop and wait for the
+ * answer (native/query.h). On a LAN, switches can also travel as UDP
+ * multicast datagrams next to the MQTT publish, and subscribers deliver
+ * whichever copy arrives first (native/multicast.h). A client can keep a
+ * retained presence message and Last Will, and watch the whole fleet's
+ * (native/presence.h).
+ */
+
+#pragma once
+
+#include <string>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <nng/nng.h>
+#include <nng/mqtt/mqtt_client.h>
+#include <nng/supplemental/tls/tls.h>
+#include <nng/supplemental/util/platform.h>
+}
+
+#include "event_filter.h"
+#include "event_ring.h"
+#include "multicast.h"
+#include "presence.h"
+#include "query.h"
+#include "sequence.h"
+#include "state_cache.h"
+#include "state_page.h"
+#include "topics.h"
+
+// nng_init_set_parameter() (runtime thread pool sizing) arrived in NNG 1.8
+#if NNG_MAJOR_VERSION > 1 || (NNG_MAJOR_VERSION == 1 && NNG_MINOR_VERSION >= 8)
+#define NANOMQ_HAVE_INIT_PARAMS 1
+#endif
+
+namespace native {
+
+static const char* const MQTTS_PREFIX = "mqtts://";
+
+// Publishes that can be in flight at once before publish() falls back to
+// a fire-and-forget send that disconnect() cannot wait for
+static const int SEND_AIO_POOL_SIZE = 32;
+
+// Time budget for disconnect(): flush, DISCONNECT and worker join
+static const int DISCONNECT_TIMEOUT_MS = 100;
+
+// How long connect() waits for the CONNACK
+static const int CONNECT_TIMEOUT_MS = 10000;
+
+// Locally delivered publishes remembered until the broker echoes them back;
+// more than this means the echoes are not coming (broker down), so the
+// oldest are forgotten
+static const size_t LOCAL_PENDING_MAX = 256;
+
+// While anything is restored per session (subscriptions, the state request
+// topic, presence), how often an idle busy-poll receive wakes to restore it
+// after the dialer redialed
+static const int RESTORE_CHECK_MS = 1000;
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+inline std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to read " + path);
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+/**
+ * Transport and threading knobs applied when a client is constructed.
+ * 
+ * Zero / negative values keep the NNG or OS default. NNG thread counts are
+ * process-wide and only take effect for the first client in a process.
+ */
+struct TuningProfile {
+    std::string name = "default";
+    
+    // Transport (applied to the dialer, i.e. every connection it makes)
+    bool tcp_nodelay = true;
+    bool tcp_keepalive = false;
+    int send_buffer = 0;            // NNG_OPT_SENDBUF, messages queued on send
+    int recv_buffer = 0;            // NNG_OPT_RECVBUF, messages queued on receive
+    
+    // NNG thread pools
+    int task_threads = 0;
+    int poller_threads = 0;
+    
+    // Receive thread
+    int rx_cpu = -1;                // pin to this CPU (Linux only)
+    int rx_realtime_priority = 0;   // SCHED_FIFO priority 1-99, needs privileges
+    int rx_nice = 0;                // per-thread nice value (Linux only)
+    int rx_poll_interval_ms = 10;   // idle sleep between receive polls
+    int rx_busy_poll_us = 0;        // spin this long after each message, then block (0 = off)
+    
+    // The presets only move the idle poll interval, whose effect follows
+    // from the receive loop: a message waits at most one interval before it
+    // is read, and an idle client wakes 1000 / interval times a second.
+    // The other knobs stay at their defaults until measured.
+    static TuningProfile low_latency() {
+        TuningProfile p;
+        p.name = "low-latency";
+        p.rx_poll_interval_ms = 1;
+        return p;
+    }
+    
+    static TuningProfile low_power() {
+        TuningProfile p;
+        p.name = "low-power";
+        p.rx_poll_interval_ms = 50;
+        return p;
+    }
+    
+    static TuningProfile preset(const std::string& preset_name) {
+        if (preset_name.empty() || preset_name == "default") {
+            return TuningProfile();
+        }
+        if (preset_name == "low-latency") {
+            return low_latency();
+        }
+        if (preset_name == "low-power") {
+            return low_power();
+        }
+        throw std::invalid_argument("Unknown tuning profile: " + preset_name +
+                                    " (expected default, low-latency or low-power)");
+    }
+};
+
+class NanoMQTTClient {
+private:
+    nng_socket sock;
+    nng_dialer dialer;
+    bool dialer_started = false;
+    std::atomic<bool> connected{false};
+    std::atomic<bool> running{false};
+    std::string broker_host;
+    int broker_port;
+    std::string broker_url;
+    
+    // TLS configuration is built once and shared by every dial attempt, so
+    // reconnects never re-parse the CA bundle or key material.
+    bool use_tls = false;
+    nng_tls_config* tls_cfg = nullptr;
+    std::thread worker_thread;
+    std::mutex callback_mutex;
+    
+    // Receive loop wake-ups: the poll loop sleeps on rx_cv and the blocking
+    // receive is an aio, so a stop request interrupts either immediately
+    std::mutex rx_mutex;
+    std::condition_variable rx_cv;
+    nng_aio* rx_aio = nullptr;
+    
+    // Publishes go out through a fixed pool of send aios; a slot returns to
+    // the pool when NanoSDK is done with the message (for QoS 1, once the
+    // PUBACK arrives), which is what disconnect() waits on to flush.
+    struct SendSlot {
+        NanoMQTTClient* client;
+        nng_aio* aio;
+    };
+    std::vector<std::unique_ptr<SendSlot>> send_slots;
+    std::vector<SendSlot*> free_send_slots;
+    std::mutex send_mutex;
+    std::condition_variable send_cv;
+    
+    // Remembered so restart() can bring the session back as it was
+    std::string last_client_id;
+    std::mutex subscriptions_mutex;
+    std::map<std::string, int> subscriptions;
+    // Sessions are clean: subscriptions are made again once per connect_count,
+    // including after the dialer redials on its own
+    std::atomic<uint64_t> subscriptions_connects{UINT64_MAX};
+    std::function<void(const std::string&, const std::string&)> message_callback;
+    
+    // Local delivery: publishes matching local_topic go straight to the
+    // message callback, and are remembered so the broker's echo is dropped
+    std::mutex local_mutex;
+    std::string local_topic;
+    std::deque<std::pair<std::string, std::string>> local_pending;
+    std::atomic<uint64_t> local_delivered{0};
+    std::atomic<uint64_t> local_echoes_dropped{0};
+    
+    // Checked before the callback, under callback_mutex; none until set_event_filter()
+    std::unique_ptr<EventFilter> event_filter;
+    std::atomic<uint64_t> stale_dropped{0};
+    std::atomic<uint64_t> reordered_dropped{0};
+    // Retained messages and state replies filed without reaching the callback
+    std::atomic<uint64_t> state_only{0};
+    
+    // Sequence numbers: publishes are stamped and sent under sequence_mutex,
+    // so seqs leave in order whichever thread publishes. The state request
+    // topic is re-subscribed once per session (state_connects).
+    std::mutex sequence_mutex;
+    std::unique_ptr<SequenceStamper> stamper;
+    std::string state_topic;
+    std::atomic<bool> serving_state{false};
+    std::atomic<uint64_t> state_connects{UINT64_MAX};
+    std::atomic<uint64_t> state_requests_answered{0};
+    std::atomic<uint64_t> queries_answered{0};
+    std::atomic<uint64_t> queries_rejected{0};
+    // Subscriber side, under callback_mutex; none until set_sequence_tracking()
+    std::unique_ptr<SequenceTracker> sequence_tracker;
+    std::atomic<bool> tracking{false};
+    std::atomic<uint64_t> state_requests_sent{0};
+    
+    // Publishes to retained_topic (under sequence_mutex) carry the retain
+    // flag; received switches are filed in states
+    std::string retained_topic;
+    StateCache states;
+    
+    // Queries this client sent: callers wait in pending_queries until the
+    // receive thread resolves them from a reply. Reply topics are
+    // subscribed once per session, like the state request topic.
+    PendingQueries pending_queries;
+    std::mutex query_mutex;
+    std::string query_inbox;
+    std::map<std::string, uint64_t> query_reply_topics;     // reply topic -> connect_count subscribed on
+    
+    // Shared memory copy of the latest state and ring of accepted messages; guarded by callback_mutex
+    std::unique_ptr<StatePageWriter> state_page;
+    std::unique_ptr<EventRingWriter> event_ring;
+    
+    // Multicast fast path: stamped publishes also go out as datagrams
+    // (multicast_sender, under sequence_mutex); received datagrams race the
+    // broker's copies and first_copy (under callback_mutex) keeps whichever
+    // arrives first. multicast_mutex guards replacing the receiver.
+    std::unique_ptr<MulticastSender> multicast_sender;
+    std::mutex multicast_mutex;
+    std::unique_ptr<MulticastReceiver> multicast_receiver;
+    std::unique_ptr<FirstCopyFilter> first_copy;
+    std::atomic<uint64_t> multicast_unmatched{0};
+    std::atomic<uint64_t> multicast_untracked{0};
+    
+    // Presence: this client's retained topic and payloads (under
+    // presence_mutex), published once per session like the state request
+    // subscription, and the fleet seen on the watched prefix
+    std::mutex presence_mutex;
+    std::string presence_topic_name;
+    std::string presence_name;
+    std::string presence_role;
+    std::string presence_offline;
+    std::string presence_watched;
+    std::shared_ptr<PresenceMap> presence_map;
+    std::atomic<uint64_t> presence_connects{UINT64_MAX};
+    std::atomic<uint64_t> presence_published{0};
+    
+    // Connection tracking
+    std::condition_variable conn_cv;
+    std::mutex conn_mutex;
+    bool conn_result = false;
+    bool conn_callback_called = false;
+    
+    // Connection timing (microseconds, steady clock)
+    std::atomic<uint64_t> connect_count{0};
+    std::atomic<uint64_t> dial_started_us{0};
+    std::atomic<uint64_t> disconnected_us{0};
+    std::atomic<uint64_t> last_connect_us{0};
+    std::atomic<uint64_t> last_reconnect_us{0};
+    
+    // Busy-poll receive counters
+    std::atomic<uint64_t> rx_messages{0};
+    std::atomic<uint64_t> rx_spin_hits{0};
+    std::atomic<uint64_t> rx_spin_misses{0};
+    std::atomic<uint64_t> rx_blocking_wakeups{0};
+    
+    TuningProfile tuning;
+    std::mutex tuning_mutex;
+    std::map<std::string, std::string> tuning_results;
+    
+    static uint64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    // Static callback functions
+    static void connect_cb(nng_pipe p, nng_pipe_ev /* ev */, void *arg) {
+        NanoMQTTClient* client = static_cast<NanoMQTTClient*>(arg);
+        int reason;
+        nng_pipe_get_int(p, NNG_OPT_MQTT_CONNECT_REASON, &reason);
+        
+        if (reason == 0) {
+            uint64_t now = now_us();
+            uint64_t dropped = client->disconnected_us.exchange(0);
+            if (dropped != 0) {
+                // The dialer redialed on its own after a link drop
+                client->last_reconnect_us.store(now - dropped);
+            } else {
+                client->last_connect_us.store(now - client->dial_started_us.load());
+            }
+            client->connect_count.fetch_add(1);
+            client->connected.store(true);
+        }
+        
+        std::lock_guard<std::mutex> lock(client->conn_mutex);
+        client->conn_result = (reason == 0); // 0 means success
+        client->conn_callback_called = true;
+        client->conn_cv.notify_one();
+    }
+    
+    static void send_done_cb(void* arg) {
+        SendSlot* slot = static_cast<SendSlot*>(arg);
+        if (nng_aio_result(slot->aio) != 0) {
+            // Ownership of the message stays with us when a send fails
+            nng_msg* msg = nng_aio_get_msg(slot->aio);
+            if (msg) {
+                nng_msg_free(msg);
+            }
+        }
+        
+        NanoMQTTClient* client = slot->client;
+        std::lock_guard<std::mutex> lock(client->send_mutex);
+        client->free_send_slots.push_back(slot);
+        client->send_cv.notify_all();
+    }
+    
+    static void disconnect_cb(nng_pipe /* p */, nng_pipe_ev /* ev */, void *arg) {
+        NanoMQTTClient* client = static_cast<NanoMQTTClient*>(arg);
+        client->disconnected_us.store(now_us());
+        client->connected.store(false);
+        
+        std::lock_guard<std::mutex> lock(client->conn_mutex);
+        client->conn_callback_called = false;
+    }
+    
+    void record_tuning(const std::string& knob, int rv) {
+        std::lock_guard<std::mutex> lock(tuning_mutex);
+        tuning_results[knob] = (rv == 0) ? "applied" : std::string("failed: ") + nng_strerror(rv);
+    }
+    
+    void record_tuning(const std::string& knob, const std::string& result) {
+        std::lock_guard<std::mutex> lock(tuning_mutex);
+        tuning_results[knob] = result;
+    }
+    
+    void apply_thread_tuning() {
+        // Must run before the first NNG call in the process
+        static std::atomic<bool> nng_started{false};
+        if (tuning.task_threads <= 0 && tuning.poller_threads <= 0) {
+            nng_started.store(true);
+            return;
+        }
+        if (nng_started.exchange(true)) {
+            record_tuning("threads", "skipped: NNG already initialized in this process");
+            return;
+        }
+#ifdef NANOMQ_HAVE_INIT_PARAMS
+        if (tuning.task_threads > 0) {
+            nng_init_set_parameter(NNG_INIT_NUM_TASK_THREADS, tuning.task_threads);
+            nng_init_set_parameter(NNG_INIT_MAX_TASK_THREADS, tuning.task_threads);
+        }
+        if (tuning.poller_threads > 0) {
+            nng_init_set_parameter(NNG_INIT_NUM_POLLER_THREADS, tuning.poller_threads);
+        }
+        record_tuning("threads", "applied");
+#else
+        record_tuning("threads", "unsupported: NNG < 1.8, set NNG_NUM_TASKQ_THREADS at build time");
+#endif
+    }
+    
+    void apply_dialer_tuning() {
+        int rv = nng_dialer_set_bool(dialer, NNG_OPT_TCP_NODELAY, tuning.tcp_nodelay);
+        record_tuning("tcp_nodelay", rv);
+        rv = nng_dialer_set_bool(dialer, NNG_OPT_TCP_KEEPALIVE, tuning.tcp_keepalive);
+        record_tuning("tcp_keepalive", rv);
+    }
+    
+    void apply_socket_tuning() {
+        if (tuning.send_buffer > 0) {
+            record_tuning("send_buffer", nng_socket_set_int(sock, NNG_OPT_SENDBUF, tuning.send_buffer));
+        }
+        if (tuning.recv_buffer > 0) {
+            record_tuning("recv_buffer", nng_socket_set_int(sock, NNG_OPT_RECVBUF, tuning.recv_buffer));
+        }
+    }
+    
+    // Runs on the receive thread itself
+    void apply_receive_thread_tuning() {
+        if (tuning.rx_cpu >= 0) {
+#ifdef __linux__
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(tuning.rx_cpu, &cpus);
+            int rv = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            record_tuning("rx_cpu", rv == 0 ? "applied" : std::string("failed: ") + strerror(rv));
+#else
+            record_tuning("rx_cpu", "unsupported on this platform");
+#endif
+        }
+        
+        if (tuning.rx_realtime_priority > 0) {
+            sched_param param{};
+            param.sched_priority = tuning.rx_realtime_priority;
+            int rv = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            record_tuning("rx_realtime_priority", rv == 0 ? "applied" : std::string("failed: ") + strerror(rv));
+        }
+        
+        if (tuning.rx_nice != 0) {
+#ifdef __linux__
+            // On Linux nice values are per thread when addressed by TID
+            pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+            int rv = setpriority(PRIO_PROCESS, tid, tuning.rx_nice);
+            record_tuning("rx_nice", rv == 0 ? "applied" : std::string("failed: ") + strerror(errno));
+#else
+            record_tuning("rx_nice", "unsupported on this platform");
+#endif
+        }
+    }
+    
+    std::string build_url() const {
+        // NanoSDK names the TLS transport "tls+mqtt-tcp"
+        return std::string(use_tls ? "tls+mqtt-tcp://" : "mqtt-tcp://") +
+            broker_host + ":" + std::to_string(broker_port);
+    }
+    
+public:
+    NanoMQTTClient(const std::string& broker, int port, const TuningProfile& profile = TuningProfile())
+        : broker_port(port), tuning(profile) {
+        broker_host = broker;
+        if (broker.compare(0, strlen(MQTTS_PREFIX), MQTTS_PREFIX) == 0) {
+            broker_host = broker.substr(strlen(MQTTS_PREFIX));
+            use_tls = true;
+        }
+        broker_url = build_url();
+        
+        apply_thread_tuning();
+        
+        int rv = nng_mqtt_client_open(&sock);
+        if (rv != 0) {
+            throw std::runtime_error("Failed to open MQTT client: " + std::string(nng_strerror(rv)));
+        }
+        
+        apply_socket_tuning();
+        
+        if ((rv = nng_aio_alloc(&rx_aio, nullptr, nullptr)) != 0) {
+            nng_close(sock);
+            throw std::runtime_error("Failed to allocate receive aio: " + std::string(nng_strerror(rv)));
+        }
+        for (int i = 0; i < SEND_AIO_POOL_SIZE; i++) {
+            std::unique_ptr<SendSlot> slot(new SendSlot{this, nullptr});
+            if (nng_aio_alloc(&slot->aio, send_done_cb, slot.get()) != 0) {
+                break;
+            }
+            free_send_slots.push_back(slot.get());
+            send_slots.push_back(std::move(slot));
+        }
+    }
+    
+    ~NanoMQTTClient() {
+        set_multicast_receive("", 0);
+        disconnect();
+        nng_close(sock);
+        // Waits for any callback still running on a send aio
+        for (auto& slot : send_slots) {
+            nng_aio_free(slot->aio);
+        }
+        nng_aio_free(rx_aio);
+        if (tls_cfg) {
+            nng_tls_config_free(tls_cfg);
+        }
+    }
+    
+    void configure_tls(const std::string& ca_file, const std::string& cert_file = "",
+                       const std::string& key_file = "", const std::string& key_password = "",
+                       const std::string& server_name = "", bool verify_peer = true) {
+        if (dialer_started) {
+            throw std::runtime_error("TLS must be configured before connect()");
+        }
+        
+        nng_tls_config* cfg;
+        int rv = nng_tls_config_alloc(&cfg, NNG_TLS_MODE_CLIENT);
+        if (rv != 0) {
+            throw std::runtime_error("Failed to allocate TLS config: " + std::string(nng_strerror(rv)));
+        }
+        
+        const std::string& sni = server_name.empty() ? broker_host : server_name;
+        if ((rv = nng_tls_config_server_name(cfg, sni.c_str())) != 0) {
+            nng_tls_config_free(cfg);
+            throw std::runtime_error("Failed to set TLS server name: " + std::string(nng_strerror(rv)));
+        }
+        
+        if (!ca_file.empty() && (rv = nng_tls_config_ca_file(cfg, ca_file.c_str())) != 0) {
+            nng_tls_config_free(cfg);
+            throw std::runtime_error("Failed to load CA file: " + std::string(nng_strerror(rv)));
+        }
+        
+        if (!cert_file.empty()) {
+            std::string cert_pem = read_file(cert_file);
+            std::string key_pem = read_file(key_file.empty() ? cert_file : key_file);
+            rv = nng_tls_config_own_cert(cfg, cert_pem.c_str(), key_pem.c_str(),
+                                         key_password.empty() ? nullptr : key_password.c_str());
+            if (rv != 0) {
+                nng_tls_config_free(cfg);
+                throw std::runtime_error("Failed to load client certificate: " + std::string(nng_strerror(rv)));
+            }
+        }
+        
+        nng_tls_config_auth_mode(cfg, verify_peer ? NNG_TLS_AUTH_MODE_REQUIRED : NNG_TLS_AUTH_MODE_NONE);
+        
+        if (tls_cfg) {
+            nng_tls_config_free(tls_cfg);
+        }
+        tls_cfg = cfg;
+        use_tls = true;
+        broker_url = build_url();
+    }
+    
+    bool is_tls() const {
+        return use_tls;
+    }
+    
+    const TuningProfile& tuning_profile() const {
+        return tuning;
+    }
+    
+    std::map<std::string, std::string> tuning_report() {
+        std::lock_guard<std::mutex> lock(tuning_mutex);
+        return tuning_results;
+    }
+    
+    std::map<std::string, uint64_t> connection_stats() {
+        size_t in_flight;
+        {
+            std::lock_guard<std::mutex> lock(send_mutex);
+            in_flight = send_slots.size() - free_send_slots.size();
+        }
+        return {
+            {"in_flight", in_flight},
+            {"connects", connect_count.load()},
+            {"last_connect_us", last_connect_us.load()},
+            {"last_reconnect_us", last_reconnect_us.load()},
+        };
+    }
+    
+    std::map<std::string, uint64_t> receive_stats() const {
+        return {
+            {"messages", rx_messages.load()},
+            {"spin_hits", rx_spin_hits.load()},
+            {"spin_misses", rx_spin_misses.load()},
+            {"blocking_wakeups", rx_blocking_wakeups.load()},
+            {"local_delivered", local_delivered.load()},
+            {"local_echoes_dropped", local_echoes_dropped.load()},
+            {"stale_dropped", stale_dropped.load()},
+            {"reordered_dropped", reordered_dropped.load()},
+            {"state_only", state_only.load()},
+        };
+    }
+    
+    bool connect(const std::string& client_id = "", int timeout_ms = CONNECT_TIMEOUT_MS) {
+        if (connected.load()) {
+            return true;
+        }
+        last_client_id = client_id;
+        
+        // A started dialer redials on its own after a link drop, reusing the
+        // TLS config; wait for that instead of tearing the dialer down.
+        if (dialer_started) {
+            if (disconnected_us.load() == 0) {
+                // The link never dropped; only the local flag was cleared
+                connected.store(true);
+                return true;
+            }
+            return wait_for_connack(timeout_ms);
+        }
+        
+        int rv;
+        
+        // NNG does not load the system trust store, so mqtts:// needs a CA
+        if (use_tls && !tls_cfg) {
+            throw std::runtime_error("mqtts:// requires configure_tls() with a CA file before connect()");
+        }
+        
+        // Create dialer
+        if ((rv = nng_dialer_create(&dialer, sock, broker_url.c_str())) != 0) {
+            throw std::runtime_error("Failed to create dialer: " + std::string(nng_strerror(rv)));
+        }
+        
+        if (tls_cfg && (rv = nng_dialer_set_ptr(dialer, NNG_OPT_TLS_CONFIG, tls_cfg)) != 0) {
+            nng_dialer_close(dialer);
+            throw std::runtime_error("Failed to apply TLS config: " + std::string(nng_strerror(rv)));
+        }
+        
+        apply_dialer_tuning();
+        
+        // Create CONNECT message
+        nng_msg *connmsg;
+        if ((rv = nng_mqtt_msg_alloc(&connmsg, 0)) != 0) {
+            nng_dialer_close(dialer);
+            throw std::runtime_error("Failed to allocate CONNECT message: " + std::string(nng_strerror(rv)));
+        }
+        
+        // Set up CONNECT message
+        nng_mqtt_msg_set_packet_type(connmsg, NNG_MQTT_CONNECT);
+        nng_mqtt_msg_set_connect_proto_version(connmsg, 4); // MQTT 3.1.1
+        nng_mqtt_msg_set_connect_keep_alive(connmsg, 60);
+        nng_mqtt_msg_set_connect_clean_session(connmsg, true);
+        
+        // Set client ID if provided
+        if (!client_id.empty()) {
+            nng_mqtt_msg_set_connect_client_id(connmsg, client_id.c_str());
+        }
+        
+        // The broker publishes the will for us if the session ends without a DISCONNECT
+        {
+            std::lock_guard<std::mutex> lock(presence_mutex);
+            if (!presence_topic_name.empty()) {
+                std::string will = presence_offline;
+                nng_mqtt_msg_set_connect_will_topic(connmsg, presence_topic_name.c_str());
+                nng_mqtt_msg_set_connect_will_msg(connmsg, reinterpret_cast<uint8_t*>(&will[0]),
+                                                  static_cast<uint32_t>(will.size()));
+                nng_mqtt_msg_set_connect_will_retain(connmsg, true);
+                nng_mqtt_msg_set_connect_will_qos(connmsg, 1);
+            }
+        }
+        
+        // Set up connection callbacks
+        nng_mqtt_set_connect_cb(sock, connect_cb, this);
+        nng_mqtt_set_disconnect_cb(sock, disconnect_cb, this);
+        
+        // Set CONNECT message on dialer
+        nng_dialer_set_ptr(dialer, NNG_OPT_MQTT_CONNMSG, connmsg);
+        
+        {
+            std::lock_guard<std::mutex> lock(conn_mutex);
+            conn_callback_called = false;
+        }
+        dial_started_us.store(now_us());
+        disconnected_us.store(0);
+        
+        // Start dialer
+        if ((rv = nng_dialer_start(dialer, NNG_FLAG_NONBLOCK)) != 0) {
+            nng_msg_free(connmsg);
+            nng_dialer_close(dialer);
+            throw std::runtime_error("Failed to start dialer: " + std::string(nng_strerror(rv)));
+        }
+        dialer_started = true;
+        
+        if (!wait_for_connack(timeout_ms)) {
+            return false;
+        }
+        restore_subscriptions();
+        restore_presence();
+        return true;
+    }
+    
+    /**
+     * Graceful close within timeout_ms: wait for in-flight publishes, send
+     * an MQTT DISCONNECT so the broker drops the session at once instead of
+     * waiting out the keepalive, close the dialer and join the receive loop.
+     * 
+     * The socket, TLS config and tuning are kept, so connect() or restart()
+     * can be called again. Returns false if publishes were still in flight
+     * when the budget ran out.
+     */
+    bool disconnect(int timeout_ms = DISCONNECT_TIMEOUT_MS) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        bool flushed = true;
+        
+        if (dialer_started) {
+            if (connected.load()) {
+                // A DISCONNECT cancels the will, so say we are going first
+                std::string topic, offline;
+                {
+                    std::lock_guard<std::mutex> lock(presence_mutex);
+                    topic = presence_topic_name;
+                    offline = presence_payload_shutdown();
+                }
+                if (!topic.empty() && send_publish(topic, offline, 1, true)) {
+                    presence_published.fetch_add(1);
+                }
+                flushed = flush_publishes(deadline);
+                send_disconnect(deadline);
+            }
+            nng_dialer_close(dialer);
+            dialer_started = false;
+        }
+        connected.store(false);
+        
+        stop_message_loop();
+        return flushed;
+    }
+    
+    /**
+     * Close and reconnect on the same socket, then restore subscriptions and
+     * the receive loop. Nothing is re-read or re-allocated, so recovering
+     * from a wedged connection does not need a new process.
+     */
+    bool restart() {
+        bool was_running = running.load();
+        disconnect();
+        
+        // connect() restores the subscriptions on the new session
+        if (!connect(last_client_id)) {
+            return false;
+        }
+        
+        if (was_running) {
+            start_message_loop();
+        }
+        return true;
+    }
+    
+    bool is_connected() const {
+        return connected.load();
+    }
+    
+    bool publish(const std::string& topic, const std::string& payload, int qos = 0, bool retain = false) {
+        restore_subscriptions();
+        restore_state_subscription();
+        restore_presence();
+        
+        std::lock_guard<std::mutex> lock(sequence_mutex);
+        retain = retain || (!retained_topic.empty() && topic == retained_topic);
+        std::string stamped;
+        if (stamper) {
+            stamped = stamper->stamp(topic, payload);
+        }
+        const std::string& message = stamper ? stamped : payload;
+        
+        // Before the send, so the echo can never arrive first; and even when
+        // the broker is down, since the local subscriber needs no broker
+        deliver_locally(topic, message);
+        // Unstamped messages cannot be told apart from the broker's copy, so they are not multicast
+        if (multicast_sender && stamper) {
+            multicast_sender->send(topic, message);
+        }
+        bool sent = send_publish(topic, message, qos, retain);
+        if (sent && stamper) {
+            stamper->sent(topic, message);
+        }
+        return sent;
+    }
+    
+    bool subscribe(const std::string& topic, int qos = 0) {
+        if (!connected.load()) {
+            return false;
+        }
+        
+        nng_msg* msg;
+        int rv = nng_mqtt_msg_alloc(&msg, 0);
+        if (rv != 0) {
+            return false;
+        }
+        
+        // Set message type to SUBSCRIBE
+        nng_mqtt_msg_set_packet_type(msg, NNG_MQTT_SUBSCRIBE);
+        
+        // Create topic QoS array properly
+        nng_mqtt_topic_qos* topics = nng_mqtt_topic_qos_array_create(1);
+        if (!topics) {
+            nng_msg_free(msg);
+            return false;
+        }
+        nng_mqtt_topic_qos_array_set(topics, 0, topic.c_str(), topic.length(), qos, 0, 0, 0);
+        nng_mqtt_msg_set_subscribe_topics(msg, topics, 1);
+        nng_mqtt_topic_qos_array_free(topics, 1);
+        
+        // Send subscription
+        rv = nng_sendmsg(sock, msg, NNG_FLAG_NONBLOCK);
+        if (rv != 0) {
+            nng_msg_free(msg);
+            return false;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            subscriptions[topic] = qos;
+        }
+        
+        // A new or restored subscription knows nothing yet; the broker
+        // handles the SUBSCRIBE first, so the replies are not missed
+        if (tracking.load() && !is_state_request_topic(topic) && !is_query_topic(topic) &&
+            !is_own_reply_topic(topic) && topic.find_first_of("+#") == std::string::npos) {
+            request_state(topic, "", "");
+        }
+        return true;
+    }
+    
+    bool unsubscribe(const std::string& topic) {
+        {
+            // Sessions are clean, so a topic dropped while disconnected is
+            // simply not restored on the next connect or restart()
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            subscriptions.erase(topic);
+        }
+        if (!connected.load()) {
+            return false;
+        }
+        
+        nng_msg* msg;
+        int rv = nng_mqtt_msg_alloc(&msg, 0);
+        if (rv != 0) {
+            return false;
+        }
+        
+        // Set message type to UNSUBSCRIBE
+        nng_mqtt_msg_set_packet_type(msg, NNG_MQTT_UNSUBSCRIBE);
+        
+        nng_mqtt_topic* topics = nng_mqtt_topic_array_create(1);
+        if (!topics) {
+            nng_msg_free(msg);
+            return false;
+        }
+        nng_mqtt_topic_array_set(topics, 0, topic.c_str());
+        nng_mqtt_msg_set_unsubscribe_topics(msg, topics, 1);
+        nng_mqtt_topic_array_free(topics, 1);
+        
+        rv = nng_sendmsg(sock, msg, NNG_FLAG_NONBLOCK);
+        if (rv != 0) {
+            nng_msg_free(msg);
+            return false;
+        }
+        
+        return true;
+    }
+    
+    /**
+     * Move a subscription from old_topic to new_topic on the live connection.
+     * 
+     * SUBSCRIBE for the new topic is queued before UNSUBSCRIBE for the old
+     * one on the same connection, and the broker handles them in order, so
+     * the two subscriptions overlap briefly instead of leaving a gap in
+     * which messages would be lost.
+     */
+    bool resubscribe(const std::string& old_topic, const std::string& new_topic, int qos = 0) {
+        if (old_topic == new_topic) {
+            return subscribe(new_topic, qos);
+        }
+        if (!subscribe(new_topic, qos)) {
+            return false;
+        }
+        return unsubscribe(old_topic);
+    }
+    
+    void set_message_callback(std::function<void(const std::string&, const std::string&)> callback) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        message_callback = callback;
+    }
+    
+    /**
+     * Drop messages whose "timestamp" is more than max_age_ms old (0: no age
+     * limit) or, with order, older than the last one accepted from the same
+     * topic, "source" and "server"; receive_stats() counts both. A negative max_age_ms
+     * with order off removes the filter.
+     */
+    void set_event_filter(int max_age_ms, bool order = true) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        if (max_age_ms < 0 && !order) {
+            event_filter.reset();
+        } else {
+            event_filter.reset(new EventFilter(max_age_ms, order));
+        }
+    }
+    
+    /**
+     * Stamp every publish with source and a per-topic, per-"server" seq
+     * (native/sequence.h), persisted to state_path unless it is empty.
+     * Call before publishing; the counters carry on from state_path.
+     */
+    void enable_sequence(const std::string& source, const std::string& state_path = "") {
+        std::lock_guard<std::mutex> lock(sequence_mutex);
+        stamper.reset(new SequenceStamper(source, state_path));
+    }
+    
+    /**
+     * Answer state requests for topic (published by subscribers on
+     * topic + "/resync") with the last message stamped per server, and
+     * queries (topic + "/query", see query_current()) with the last one
+     * stamped. Needs enable_sequence() and a running message loop; the
+     * request topics are re-subscribed after every redial. An empty topic
+     * stops answering.
+     */
+    void serve_state(const std::string& topic) {
+        std::string old_topic;
+        {
+            std::lock_guard<std::mutex> lock(sequence_mutex);
+            if (!stamper && !topic.empty()) {
+                throw std::runtime_error("serve_state() needs enable_sequence() first");
+            }
+            old_topic = state_topic;
+            state_topic = topic;
+        }
+        if (!old_topic.empty() && old_topic != topic) {
+            unsubscribe(state_request_topic(old_topic));
+            unsubscribe(query_topic(old_topic));
+        }
+        serving_state.store(!topic.empty());
+        state_connects.store(UINT64_MAX);
+        restore_state_subscription();
+    }
+    
+    /**
+     * Track seqs per topic, source and server before the callback: drop
+     * duplicates and late arrivals, and on a gap (or a new subscription)
+     * ask the publishers for their current state. sequence_stats() counts
+     * what was seen.
+     */
+    void set_sequence_tracking(bool enabled) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        sequence_tracker.reset(enabled ? new SequenceTracker() : nullptr);
+        tracking.store(enabled);
+    }
+    
+    std::map<std::string, uint64_t> sequence_stats() {
+        std::map<std::string, uint64_t> stats;
+        {
+            std::lock_guard<std::mutex> lock(callback_mutex);
+            if (sequence_tracker) {
+                stats = sequence_tracker->stats();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(sequence_mutex);
+            stats["seq_file_writes"] = stamper ? stamper->file_writes() : 0;
+        }
+        stats["state_requests_sent"] = state_requests_sent.load();
+        stats["state_requests_answered"] = state_requests_answered.load();
+        stats["queries_answered"] = queries_answered.load();
+        stats["queries_rejected"] = queries_rejected.load();
+        return stats;
+    }
+    
+    /**
+     * Ask the publisher serving topic (serve_state()) for the current
+     * desktop, or only server's, and wait up to timeout_ms for the answer
+     * instead of for the next switch. False on timeout or while
+     * disconnected; otherwise result says whether the publisher knew a
+     * desktop, and the round trip. Any number of threads may query at once:
+     * each waits for its own reply. Needs a running message loop.
+     */
+    bool query_current(const std::string& topic, int timeout_ms, QueryResult& result, const std::string& server = "") {
+        if (topic.empty() || topic.find_first_of("+#") != std::string::npos) {
+            throw std::runtime_error("query_current() needs a topic without wildcards");
+        }
+        if (!running.load()) {
+            throw std::runtime_error("query_current() needs the message loop running");
+        }
+        if (!connected.load()) {
+            return false;
+        }
+        
+        // Subscribed before the query is sent, so the broker has the
+        // subscription by the time the answer comes back
+        std::string reply_to;
+        bool subscribe_reply = false;
+        uint64_t connects = connect_count.load();
+        {
+            std::lock_guard<std::mutex> lock(query_mutex);
+            if (query_inbox.empty()) {
+                query_inbox = make_query_inbox();
+            }
+            reply_to = query_reply_topic(topic, query_inbox);
+            auto found = query_reply_topics.find(reply_to);
+            if (found == query_reply_topics.end() || found->second != connects) {
+                query_reply_topics[reply_to] = connects;
+                subscribe_reply = true;
+            }
+        }
+        if (subscribe_reply && !subscribe(reply_to, 1)) {
+            std::lock_guard<std::mutex> lock(query_mutex);
+            query_reply_topics.erase(reply_to);
+            return false;
+        }
+        
+        // Registered before sending, so even an instant answer finds its caller
+        uint64_t id = pending_queries.open();
+        std::string query = "{\"id\": " + std::to_string(id) + ", \"reply_to\": \"" + json_escape(reply_to) + "\"";
+        if (!server.empty()) {
+            query += ", \"server\": \"" + json_escape(server) + "\"";
+        }
+        query += "}";
+        if (!send_publish(query_topic(topic), query, 1)) {
+            pending_queries.cancel(id);
+            return false;
+        }
+        
+        std::string reply;
+        if (!pending_queries.wait(id, timeout_ms, reply, result.rtt_us)) {
+            return false;
+        }
+        result.known = parse_desktop_state(topic, reply, false, result.state);
+        return true;
+    }
+    
+    // Queries sent, answered, timed out and answered too late, and round trip times
+    std::map<std::string, uint64_t> query_stats() const {
+        return pending_queries.stats();
+    }
+    
+    /**
+     * Publish to topic with the retain flag from now on, so the broker
+     * keeps the last switch and hands it to every new subscription. The
+     * broker keeps one retained message per topic: with several primaries
+     * or servers on one topic only the latest switch is retained. Moving to
+     * another topic clears the retained message on the old one; empty stops
+     * retaining.
+     */
+    void set_retained_topic(const std::string& topic) {
+        std::string old_topic;
+        {
+            std::lock_guard<std::mutex> lock(sequence_mutex);
+            old_topic = retained_topic;
+            retained_topic = topic;
+        }
+        if (!old_topic.empty() && old_topic != topic) {
+            send_publish(old_topic, "", 1, true);
+        }
+    }
+    
+    /**
+     * The desktop from the most recent switch received from any server or,
+     * with any_server false, from `server`; false if none arrived yet.
+     */
+    bool current_state(DesktopState& state, bool any_server = true, const std::string& server = "") const {
+        return states.latest(state, any_server, server);
+    }
+    
+    // Last switch received per topic, source and server
+    std::vector<DesktopState> current_states() const {
+        return states.all();
+    }
+    
+    /**
+     * Copy the latest state to the shared memory page `name` (e.g.
+     * "/synergy-desktop") for StatePageReader; empty stops. Writes the state
+     * already known straight away. Throws if the page cannot be created.
+     */
+    void set_state_page(const std::string& name) {
+        std::unique_ptr<StatePageWriter> page;
+        if (!name.empty()) {
+            page.reset(new StatePageWriter(name));
+        }
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        state_page = std::move(page);
+        write_state_page();
+    }
+    
+    /**
+     * Write every message that reaches the callback (or would, without
+     * one) to the shared memory ring `name` (e.g. "/synergy-events") for
+     * EventRingReader consumers; empty stops. Throws if the ring cannot be
+     * created.
+     */
+    void set_event_ring(const std::string& name) {
+        std::unique_ptr<EventRingWriter> ring;
+        if (!name.empty()) {
+            ring.reset(new EventRingWriter(name));
+        }
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        event_ring = std::move(ring);
+    }
+    
+    /**
+     * Also send every stamped publish as a UDP datagram to group:port
+     * (native/multicast.h), out of the interface with the IPv4 address
+     * interface_address (empty: the default one). Only messages stamped by
+     * enable_sequence() are sent. An empty group stops.
+     */
+    void enable_multicast(const std::string& group, int port, const std::string& interface_address = "") {
+        std::unique_ptr<MulticastSender> sender;
+        if (!group.empty()) {
+            sender.reset(new MulticastSender(group, port, interface_address));
+        }
+        std::lock_guard<std::mutex> lock(sequence_mutex);
+        multicast_sender = std::move(sender);
+    }
+    
+    /**
+     * Join group:port and deliver datagrams on subscribed topics while the
+     * message loop runs, next to the broker's messages: whichever copy of a
+     * switch arrives first goes through the sequence, event filter, state
+     * cache, shared memory and callback, and the other is dropped.
+     * Datagrams without a source and seq are ignored. The callback then
+     * also runs on the multicast receive thread. An empty group stops.
+     */
+    void set_multicast_receive(const std::string& group, int port, const std::string& interface_address = "") {
+        std::lock_guard<std::mutex> guard(multicast_mutex);
+        if (multicast_receiver) {
+            // Not under callback_mutex: the receive thread may be waiting for it
+            multicast_receiver->stop();
+            multicast_receiver.reset();
+        }
+        std::unique_ptr<MulticastReceiver> receiver;
+        if (!group.empty()) {
+            receiver.reset(new MulticastReceiver(group, port, interface_address));
+        }
+        {
+            std::lock_guard<std::mutex> lock(callback_mutex);
+            if (!receiver) {
+                first_copy.reset();
+            } else if (!first_copy) {
+                first_copy.reset(new FirstCopyFilter());
+            }
+        }
+        if (receiver) {
+            receiver->start([this](const std::string& topic, const std::string& payload) {
+                handle_datagram(topic, payload);
+            });
+            multicast_receiver = std::move(receiver);
+        }
+    }
+    
+    // Datagrams sent and received, which path delivered first, copies dropped and the multicast lead
+    std::map<std::string, uint64_t> multicast_stats() {
+        std::map<std::string, uint64_t> stats;
+        {
+            std::lock_guard<std::mutex> lock(sequence_mutex);
+            if (multicast_sender) {
+                auto sender = multicast_sender->stats();
+                stats.insert(sender.begin(), sender.end());
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(multicast_mutex);
+            if (multicast_receiver) {
+                auto receiver = multicast_receiver->stats();
+                stats.insert(receiver.begin(), receiver.end());
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(callback_mutex);
+            if (first_copy) {
+                auto copies = first_copy->stats();
+                stats.insert(copies.begin(), copies.end());
+            }
+        }
+        stats["multicast_unmatched"] = multicast_unmatched.load();
+        stats["multicast_untracked"] = multicast_untracked.load();
+        return stats;
+    }
+    
+    /**
+     * Announce this client at prefix/name/role (native/presence.h): a
+     * retained online message on every new session and an offline one as
+     * the Last Will. The will is part of the CONNECT, so call this before
+     * connect(); later it takes effect on the next restart(). An empty
+     * prefix stops announcing.
+     */
+    void enable_presence(const std::string& prefix, const std::string& name, const std::string& role) {
+        if (!prefix.empty() && (name.empty() || role.empty() || name.find_first_of("/+#") != std::string::npos ||
+                                role.find_first_of("/+#") != std::string::npos)) {
+            throw std::runtime_error("Presence name and role must be non-empty and contain no '/', '+' or '#'");
+        }
+        std::lock_guard<std::mutex> lock(presence_mutex);
+        if (prefix.empty()) {
+            presence_topic_name.clear();
+            return;
+        }
+        presence_topic_name = presence_topic(prefix, name, role);
+        presence_name = name;
+        presence_role = role;
+        presence_offline = presence_payload(name, role, false, "lost", 0, 0);
+        presence_connects.store(UINT64_MAX);
+    }
+    
+    /**
+     * Keep the presence of every member under prefix in presence(): the
+     * broker sends the retained states on subscribe and each change as it
+     * happens. An empty prefix stops watching.
+     */
+    void watch_presence(const std::string& prefix) {
+        std::string old;
+        {
+            std::lock_guard<std::mutex> lock(presence_mutex);
+            old = presence_watched;
+            presence_watched = prefix;
+            presence_map = prefix.empty() ? nullptr : std::make_shared<PresenceMap>(prefix);
+            presence_connects.store(UINT64_MAX);
+        }
+        if (!old.empty() && old != prefix) {
+            unsubscribe(presence_filter(old));
+        }
+        restore_presence();
+    }
+    
+    // Every member seen on the watched prefix, online or not
+    std::vector<PresenceEntry> presence() {
+        std::shared_ptr<PresenceMap> map = watched_presence();
+        return map ? map->entries() : std::vector<PresenceEntry>();
+    }
+    
+    // Members online and offline, status changes seen, and presence messages this client published
+    std::map<std::string, uint64_t> presence_stats() {
+        std::shared_ptr<PresenceMap> map = watched_presence();
+        std::map<std::string, uint64_t> stats;
+        if (map) {
+            stats = map->stats();
+        }
+        stats["published"] = presence_published.load();
+        return stats;
+    }
+    
+    // Whether this client holds the ring, and events written and too large for a slot
+    std::map<std::string, uint64_t> event_ring_stats() {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        if (!event_ring) {
+            return {};
+        }
+        return event_ring->stats();
+    }
+    
+    // Whether a state page is set, whether this client holds it, and states written to it
+    std::map<std::string, uint64_t> state_page_stats() {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        return {
+            {"enabled", state_page ? 1u : 0u},
+            {"owner", state_page && state_page->is_owner() ? 1u : 0u},
+            {"writes", state_page ? state_page->write_count() : 0},
+        };
+    }
+    
+    /**
+     * Deliver this client's own publishes to topic_filter to the message
+     * callback in-process, at publish() time, instead of after a round trip
+     * through the broker. When the broker's copy comes back on a matching
+     * subscription it is recognised by topic and payload and dropped, so each
+     * message reaches the callback once. An empty filter turns this off.
+     * 
+     * For a publisher and subscriber sharing one client in one process; the
+     * callback may then run on whichever thread publishes.
+     */
+    void set_local_delivery(const std::string& topic_filter) {
+        std::lock_guard<std::mutex> lock(local_mutex);
+        local_topic = topic_filter;
+        local_pending.clear();
+    }
+    
+    void start_message_loop() {
+        if (running.load()) {
+            return;
+        }
+        
+        running.store(true);
+        worker_thread = std::thread([this]() {
+            apply_receive_thread_tuning();
+            message_loop();
+        });
+    }
+    
+    void stop_message_loop() {
+        {
+            std::lock_guard<std::mutex> lock(rx_mutex);
+            running.store(false);
+            nng_aio_cancel(rx_aio);
+        }
+        rx_cv.notify_all();
+        if (worker_thread.joinable()) {
+            worker_thread.join();
+        }
+    }
+    
+private:
+    bool send_publish(const std::string& topic, const std::string& payload, int qos, bool retain = false) {
+        if (!connected.load()) {
+            return false;
+        }
+        
+        nng_msg* msg;
+        int rv = nng_mqtt_msg_alloc(&msg, 0);
+        if (rv != 0) {
+            return false;
+        }
+        
+        // Set message type to PUBLISH
+        nng_mqtt_msg_set_packet_type(msg, NNG_MQTT_PUBLISH);
+        
+        // Set topic and payload
+        nng_mqtt_msg_set_publish_topic(msg, topic.c_str());
+        nng_mqtt_msg_set_publish_payload(msg, 
+            const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(payload.data())), 
+            payload.length());
+        nng_mqtt_msg_set_publish_qos(msg, qos);
+        nng_mqtt_msg_set_publish_retain(msg, retain);
+        
+        SendSlot* slot = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(send_mutex);
+            if (!free_send_slots.empty()) {
+                slot = free_send_slots.back();
+                free_send_slots.pop_back();
+            }
+        }
+        
+        if (slot) {
+            nng_aio_set_msg(slot->aio, msg);
+            nng_send_aio(sock, slot->aio);
+            return true;
+        }
+        
+        // Pool exhausted: send untracked rather than block the caller
+        rv = nng_sendmsg(sock, msg, NNG_FLAG_NONBLOCK);
+        if (rv != 0) {
+            nng_msg_free(msg);
+            return false;
+        }
+        
+        return true;
+    }
+    
+
+    // Ask the publishers on topic (or only source/server, if given) for their current state
+    void request_state(const std::string& topic, const std::string& source, const std::string& server) {
+        std::string request = "{";
+        if (!source.empty()) {
+            request += "\"source\": \"" + json_escape(source) + "\"";
+        }
+        if (!server.empty()) {
+            request += std::string(source.empty() ? "" : ", ") + "\"server\": \"" + json_escape(server) + "\"";
+        }
+        request += "}";
+        if (send_publish(state_request_topic(topic), request, 0)) {
+            state_requests_sent.fetch_add(1);
+        }
+    }
+    
+    // True if this was a state request for the served topic (and it was answered)
+    bool answer_state_request(const std::string& topic, const std::string& payload) {
+        std::string served;
+        std::vector<std::string> replies;
+        {
+            std::lock_guard<std::mutex> lock(sequence_mutex);
+            if (!stamper || state_topic.empty() || topic != state_request_topic(state_topic)) {
+                return false;
+            }
+            served = state_topic;
+            replies = stamper->state_replies(served, payload);
+        }
+        for (const auto& reply : replies) {
+            send_publish(served, reply, 1);
+        }
+        state_requests_answered.fetch_add(1);
+        return true;
+    }
+    
+    // True if this was a query for the served topic (answered, unless malformed)
+    bool answer_query(const std::string& topic, const std::string& payload) {
+        std::string served, reply_to, latest;
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(sequence_mutex);
+            if (!stamper || state_topic.empty() || topic != query_topic(state_topic)) {
+                return false;
+            }
+            served = state_topic;
+            if (!json_uint_field(payload, "id", id) || !json_string_field(payload, "reply_to", reply_to) ||
+                !is_reply_topic_for(served, reply_to)) {
+                queries_rejected.fetch_add(1);
+                return true;
+            }
+            latest = stamper->latest_state(served, payload);
+        }
+        const std::string id_field = "\"id\": " + std::to_string(id);
+        send_publish(reply_to, latest.empty() ? "{" + id_field + "}" : json_append_fields(latest, ", " + id_field), 1);
+        queries_answered.fetch_add(1);
+        return true;
+    }
+    
+    // True if topic is one this client receives query answers on
+    bool is_own_reply_topic(const std::string& topic) {
+        std::lock_guard<std::mutex> lock(query_mutex);
+        return query_reply_topics.count(topic) != 0;
+    }
+    
+    // The reply topic's last level: the client ID, which the broker keeps unique
+    std::string make_query_inbox() const {
+        std::string inbox = last_client_id;
+        if (inbox.empty()) {
+            inbox = "client-" + std::to_string(getpid()) + "-" +
+                    std::to_string(reinterpret_cast<uintptr_t>(this) & 0xffffff);
+        }
+        std::replace_if(inbox.begin(), inbox.end(), [](char c) { return c == '/' || c == '+' || c == '#'; }, '_');
+        return inbox;
+    }
+    
+    std::shared_ptr<PresenceMap> watched_presence() {
+        std::lock_guard<std::mutex> lock(presence_mutex);
+        return presence_map;
+    }
+    
+    // presence_mutex held
+    std::string presence_payload_shutdown() const {
+        return presence_payload(presence_name, presence_role, false, "shutdown", 0, 0);
+    }
+    
+    // Once per session: announce this client online and subscribe to the watched prefix
+    void restore_presence() {
+        uint64_t connects = connect_count.load();
+        if (presence_connects.load() == connects || !connected.load()) {
+            return;
+        }
+        std::string topic, online, watched;
+        {
+            std::lock_guard<std::mutex> lock(presence_mutex);
+            topic = presence_topic_name;
+            watched = presence_watched;
+            if (!topic.empty()) {
+                online = presence_payload(presence_name, presence_role, true, "", static_cast<uint64_t>(getpid()),
+                                          static_cast<uint64_t>(time(nullptr)));
+            }
+        }
+        bool done = true;
+        if (!topic.empty()) {
+            done = send_publish(topic, online, 1, true);
+            if (done) {
+                presence_published.fetch_add(1);
+            }
+        }
+        if (!watched.empty()) {
+            done = subscribe(presence_filter(watched), 1) && done;
+        }
+        if (done) {
+            presence_connects.store(connects);
+        }
+    }
+    
+    /**
+     * Once per session: subscribe again to everything subscribed before.
+     * A redial by the dialer opens a new clean session and sets connected
+     * again, so without this a subscriber would stay connected and hear
+     * nothing after a broker restart.
+     */
+    void restore_subscriptions() {
+        uint64_t connects = connect_count.load();
+        if (subscriptions_connects.load() == connects || !connected.load()) {
+            return;
+        }
+        std::map<std::string, int> topics;
+        {
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            topics = subscriptions;
+        }
+        bool done = true;
+        for (const auto& entry : topics) {
+            done = subscribe(entry.first, entry.second) && done;
+        }
+        if (done) {
+            subscriptions_connects.store(connects);
+        }
+    }
+    
+    // True if a new session has anything for the restore_*() calls to redo
+    bool restores_per_session() {
+        if (serving_state.load()) {
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(presence_mutex);
+            if (!presence_topic_name.empty() || !presence_watched.empty()) {
+                return true;
+            }
+        }
+        std::lock_guard<std::mutex> lock(subscriptions_mutex);
+        return !subscriptions.empty();
+    }
+    
+    // Sessions are clean, so the state request topic is subscribed again on each new one
+    void restore_state_subscription() {
+        uint64_t connects = connect_count.load();
+        if (!serving_state.load() || state_connects.load() == connects || !connected.load()) {
+            return;
+        }
+        std::string topic;
+        {
+            std::lock_guard<std::mutex> lock(sequence_mutex);
+            topic = state_topic;
+        }
+        if (!topic.empty() && subscribe(state_request_topic(topic), 1) && subscribe(query_topic(topic), 1)) {
+            state_connects.store(connects);
+        }
+    }
+    
+    void deliver_locally(const std::string& topic, const std::string& payload) {
+        {
+            std::lock_guard<std::mutex> lock(local_mutex);
+            if (local_topic.empty() || !topic_matches(local_topic, topic)) {
+                return;
+            }
+            // A publish retry of a message already delivered; a short linear
+            // scan, as pending entries only build up while the broker is away
+            for (const auto& entry : local_pending) {
+                if (entry.first == topic && entry.second == payload) {
+                    return;
+                }
+            }
+            if (local_pending.size() == LOCAL_PENDING_MAX) {
+                local_pending.pop_front();
+            }
+            local_pending.emplace_back(topic, payload);
+        }
+        local_delivered.fetch_add(1);
+        
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        dispatch(topic, payload);
+    }
+    
+    /**
+     * Hand a message to the state cache and the callback unless the
+     * sequence tracker, first-copy filter or event filter drops it;
+     * retained messages and state replies only reach the cache.
+     * callback_mutex held
+     */
+    void dispatch(const std::string& topic, const std::string& payload, bool retained = false,
+                  CopyPath path = CopyPath::Broker) {
+        SequenceVerdict sequence = SequenceVerdict::Untracked;
+        // Seqs are tracked on the broker's copies only: a lost datagram is not a gap
+        if (sequence_tracker && path == CopyPath::Broker) {
+            sequence = sequence_tracker->check(topic, payload);
+            if (sequence == SequenceVerdict::Duplicate || sequence == SequenceVerdict::Late ||
+                sequence == SequenceVerdict::Current) {
+                return;
+            }
+        }
+        if (first_copy) {
+            CopyVerdict copy = first_copy->check(topic, payload, path);
+            if (copy == CopyVerdict::Untracked && path == CopyPath::Multicast) {
+                multicast_untracked.fetch_add(1);
+                return;
+            }
+            if (copy == CopyVerdict::Repeat || copy == CopyVerdict::Superseded) {
+                // The datagram already delivered it, but the broker still missed some
+                if (sequence == SequenceVerdict::Gap) {
+                    request_state_after_gap(topic, payload);
+                }
+                return;
+            }
+        }
+        // A retained message or state reply is the current state however old
+        // it is, not a switch happening now: it updates the cache and state
+        // page but never reaches the ring or the callback (and its bell)
+        if (retained || json_true_field(payload, "state")) {
+            file_state(topic, payload, retained);
+            state_only.fetch_add(1);
+            return;
+        }
+        if (event_filter) {
+            EventVerdict verdict = event_filter->check(topic, payload);
+            if (verdict == EventVerdict::Stale) {
+                stale_dropped.fetch_add(1);
+                return;
+            }
+            if (verdict == EventVerdict::Reordered) {
+                reordered_dropped.fetch_add(1);
+                return;
+            }
+        }
+        file_state(topic, payload, false);
+        if (event_ring) {
+            event_ring->write(topic, payload);
+        }
+        if (message_callback) {
+            message_callback(topic, payload);
+        }
+        
+        if (sequence == SequenceVerdict::Gap) {
+            request_state_after_gap(topic, payload);
+        }
+    }
+    
+    void request_state_after_gap(const std::string& topic, const std::string& payload) {
+        std::string source, server;
+        json_string_field(payload, "source", source);
+        json_string_field(payload, "server", server);
+        request_state(topic, source, server);
+    }
+    
+    // A datagram from the multicast receive thread
+    void handle_datagram(const std::string& topic, const std::string& payload) {
+        if (!running.load() || !is_subscribed(topic)) {
+            multicast_unmatched.fetch_add(1);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        dispatch(topic, payload, false, CopyPath::Multicast);
+    }
+    
+    bool is_subscribed(const std::string& topic) {
+        std::lock_guard<std::mutex> lock(subscriptions_mutex);
+        for (const auto& entry : subscriptions) {
+            if (topic_matches(entry.first, topic)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Cache a received switch and copy the latest to the state page; callback_mutex held
+    void file_state(const std::string& topic, const std::string& payload, bool retained) {
+        if (states.update(topic, payload, retained)) {
+            write_state_page();
+        }
+    }
+    
+    void write_state_page() {
+        DesktopState latest;
+        if (state_page && states.latest(latest)) {
+            state_page->write(latest);
+        }
+    }
+    
+    // True (and forgotten) if this is the broker's copy of a local delivery
+    bool is_local_echo(const std::string& topic, const std::string& payload) {
+        std::lock_guard<std::mutex> lock(local_mutex);
+        for (auto it = local_pending.begin(); it != local_pending.end(); ++it) {
+            if (it->first == topic && it->second == payload) {
+                local_pending.erase(it);
+                local_echoes_dropped.fetch_add(1);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    bool flush_publishes(std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(send_mutex);
+        return send_cv.wait_until(lock, deadline, [this] {
+            return free_send_slots.size() == send_slots.size();
+        });
+    }
+    
+    void send_disconnect(std::chrono::steady_clock::time_point deadline) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            return;
+        }
+        
+        nng_msg* msg;
+        if (nng_mqtt_msg_alloc(&msg, 0) != 0) {
+            return;
+        }
+        nng_mqtt_msg_set_packet_type(msg, NNG_MQTT_DISCONNECT);
+        
+        nng_aio* aio;
+        if (nng_aio_alloc(&aio, nullptr, nullptr) != 0) {
+            nng_msg_free(msg);
+            return;
+        }
+        nng_aio_set_timeout(aio, static_cast<nng_duration>(remaining));
+        nng_aio_set_msg(aio, msg);
+        nng_send_aio(sock, aio);
+        nng_aio_wait(aio);
+        if (nng_aio_result(aio) != 0) {
+            nng_msg_free(msg);
+        }
+        nng_aio_free(aio);
+    }
+    
+    bool wait_for_connack(int timeout_ms) {
+        // Wait for connection result with timeout
+        bool answered, accepted;
+        {
+            std::unique_lock<std::mutex> lock(conn_mutex);
+            answered = conn_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                        [this] { return conn_callback_called || connected.load(); });
+            accepted = answered && (conn_result || connected.load());
+            if (answered && !accepted) {
+                conn_callback_called = false;
+            }
+        }
+        if (accepted) {
+            connected.store(true);
+            return true;
+        }
+        // Rejected or unanswered: close the dialer so the next connect()
+        // dials afresh instead of trusting a session that never existed.
+        // Outside conn_mutex, as closing runs the disconnect callback
+        nng_dialer_close(dialer);
+        dialer_started = false;
+        connected.store(false);
+        throw std::runtime_error(answered ? "MQTT connection rejected by broker" : "Connection timeout");
+    }
+    
+    void message_loop() {
+        if (tuning.rx_busy_poll_us > 0) {
+            busy_poll_loop();
+            return;
+        }
+        
+        while (running.load()) {
+            restore_subscriptions();
+            restore_state_subscription();
+            restore_presence();
+            nng_msg* msg;
+            int rv = nng_recvmsg(sock, &msg, NNG_FLAG_NONBLOCK);
+            
+            if (rv == 0) {
+                rx_messages.fetch_add(1);
+                handle_message(msg);
+                nng_msg_free(msg);
+            } else if (rv == NNG_ECLOSED) {
+                break;
+            } else {
+                // Nothing to read (or the link is down and the dialer is
+                // redialing); sleep briefly unless asked to stop
+                std::unique_lock<std::mutex> lock(rx_mutex);
+                rx_cv.wait_for(lock, std::chrono::milliseconds(tuning.rx_poll_interval_ms),
+                               [this] { return !running.load(); });
+            }
+        }
+    }
+    
+    /**
+     * Low-latency receive loop.
+     * 
+     * Messages tend to arrive in bursts (a pointer sweeping across screens),
+     * so after each message the loop spins on the receive queue for the
+     * configured budget; the next message of a burst is then picked up
+     * without a context switch. Once the budget expires without traffic it
+     * falls back to a blocking receive, so an idle client costs no CPU
+     * beyond a wakeup every RESTORE_CHECK_MS to catch a redial.
+     * The blocking receive is an aio that stop_message_loop() cancels.
+     */
+    void busy_poll_loop() {
+        const auto budget = std::chrono::microseconds(tuning.rx_busy_poll_us);
+        bool spinning = false;
+        std::chrono::steady_clock::time_point spin_deadline;
+        
+        while (running.load()) {
+            nng_msg* msg;
+            int rv;
+            
+            if (spinning) {
+                rv = nng_recvmsg(sock, &msg, NNG_FLAG_NONBLOCK);
+                if (rv == NNG_EAGAIN) {
+                    if (std::chrono::steady_clock::now() < spin_deadline) {
+                        cpu_relax();
+                        continue;
+                    }
+                    rx_spin_misses.fetch_add(1);
+                    spinning = false;
+                    continue;
+                }
+                if (rv == 0) {
+                    rx_spin_hits.fetch_add(1);
+                }
+            } else {
+                restore_subscriptions();
+                restore_state_subscription();
+                restore_presence();
+                rv = blocking_receive(&msg);
+                if (rv == NNG_ECANCELED || rv == NNG_ETIMEDOUT) {
+                    continue;
+                }
+                if (rv == 0) {
+                    rx_blocking_wakeups.fetch_add(1);
+                }
+            }
+            
+            if (rv != 0) {
+                // Error receiving message
+                break;
+            }
+            
+            rx_messages.fetch_add(1);
+            handle_message(msg);
+            nng_msg_free(msg);
+            
+            spinning = true;
+            spin_deadline = std::chrono::steady_clock::now() + budget;
+        }
+    }
+    
+    int blocking_receive(nng_msg** msg) {
+        // Wake now and then so a redial during the wait gets its restores
+        nng_duration timeout = restores_per_session() ? RESTORE_CHECK_MS : NNG_DURATION_DEFAULT;
+        {
+            // Checked under rx_mutex so a stop cannot slip in between the
+            // check and the receive and leave it waiting forever
+            std::lock_guard<std::mutex> lock(rx_mutex);
+            if (!running.load()) {
+                return NNG_ECANCELED;
+            }
+            nng_aio_set_timeout(rx_aio, timeout);
+            nng_recv_aio(sock, rx_aio);
+        }
+        nng_aio_wait(rx_aio);
+        
+        int rv = nng_aio_result(rx_aio);
+        if (rv == 0) {
+            *msg = nng_aio_get_msg(rx_aio);
+        }
+        return rv;
+    }
+    
+    void handle_message(nng_msg* msg) {
+        nng_mqtt_packet_type packet_type = nng_mqtt_msg_get_packet_type(msg);
+        
+        if (packet_type == NNG_MQTT_PUBLISH) {
+            uint32_t topic_len;
+            const char* topic = nng_mqtt_msg_get_publish_topic(msg, &topic_len);
+            uint32_t payload_len;
+            const uint8_t* payload = nng_mqtt_msg_get_publish_payload(msg, &payload_len);
+            
+            if (topic && payload) {
+                std::string topic_str(topic, topic_len);
+                std::string payload_str(reinterpret_cast<const char*>(payload), payload_len);
+                if (is_state_request_topic(topic_str) && answer_state_request(topic_str, payload_str)) {
+                    return;
+                }
+                if (is_query_topic(topic_str) && answer_query(topic_str, payload_str)) {
+                    return;
+                }
+                // Answers skip the filters and callback; they go to the waiting caller
+                uint64_t query_id;
+                if (is_own_reply_topic(topic_str)) {
+                    if (json_uint_field(payload_str, "id", query_id)) {
+                        pending_queries.resolve(query_id, payload_str);
+                    }
+                    return;
+                }
+                // Presence goes to the fleet map, not the callback
+                std::shared_ptr<PresenceMap> presence = watched_presence();
+                if (presence && presence->covers(topic_str)) {
+                    presence->update(topic_str, payload_str);
+                    return;
+                }
+                if (is_local_echo(topic_str, payload_str)) {
+                    return;
+                }
+                
+                std::lock_guard<std::mutex> lock(callback_mutex);
+                dispatch(topic_str, payload_str, nng_mqtt_msg_get_publish_retain(msg));
+            }
+        }
+    }
+};
+
+}  // namespace native
@@ -0,0 +1,398 @@
+/**
+ * UDP multicast fast path
+ *
+ * Through the broker a switch crosses the network twice, and a subscriber
+ * hears of it only after the broker has handled it. Secondaries on the
+ * primary's subnet can hear it sooner: the publisher also sends each
+ * stamped switch as one UDP datagram to a multicast group, and subscribers
+ * that joined the group deliver whichever copy, datagram or broker
+ * message, arrives first.
+ *
+ * Multicast is best effort (no retransmits, no order), so the MQTT path
+ * stays the reliable one: the datagram is sent in addition to the publish,
+ * never instead of it. Only messages with a source and seq
+ * (native/sequence.h) are sent, since that is what tells the two copies of
+ * a switch apart. The datagram is a 3-byte header ("SW" and a format
+ * version), the topic, a NUL and the payload exactly as published, and is
+ * only sent if it fits in MULTICAST_MAX_DATAGRAM bytes.
+ *
+ * FirstCopyFilter is the subscriber's side. Per topic, source and server it
+ * remembers the last SEQUENCE_WINDOW seqs delivered and sorts each copy into:
+ *
+ * - First: not delivered yet; passed on.
+ * - Repeat: the other copy of one already delivered; dropped, and the
+ *   delay between the two is recorded.
+ * - Superseded: older than one already delivered (its own copy was lost or
+ *   is still on its way); dropped, as the subscriber has newer state.
+ *
+ * A seq delivered before with a different payload means the publisher lost
+ * its sequence file and started over; the window starts over too.
+ */
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "payloads.h"
+#include "sequence.h"
+
+namespace native {
+
+// Group and port when the configuration names none
+static const char* const DEFAULT_MULTICAST_GROUP = "239.255.77.77";
+static const int DEFAULT_MULTICAST_PORT = 1886;
+
+// One hop: the fast path is for secondaries on the publisher's own subnet
+static const int MULTICAST_TTL = 1;
+
+// Larger messages would fragment; they go over MQTT only
+static const size_t MULTICAST_MAX_DATAGRAM = 1400;
+
+static const char MULTICAST_MAGIC[3] = {'S', 'W', 1};
+
+inline std::string multicast_datagram(const std::string& topic, const std::string& payload) {
+    std::string datagram(MULTICAST_MAGIC, sizeof(MULTICAST_MAGIC));
+    datagram.reserve(sizeof(MULTICAST_MAGIC) + topic.size() + 1 + payload.size());
+    datagram += topic;
+    datagram += '\0';
+    datagram += payload;
+    return datagram;
+}
+
+// False if data is not a datagram of this format
+inline bool parse_multicast_datagram(const char* data, size_t size, std::string& topic, std::string& payload) {
+    if (size < sizeof(MULTICAST_MAGIC) + 2 || memcmp(data, MULTICAST_MAGIC, sizeof(MULTICAST_MAGIC)) != 0) {
+        return false;
+    }
+    const char* begin = data + sizeof(MULTICAST_MAGIC);
+    const char* nul = static_cast<const char*>(memchr(begin, '\0', size - sizeof(MULTICAST_MAGIC)));
+    if (!nul || nul == begin) {
+        return false;
+    }
+    topic.assign(begin, nul - begin);
+    payload.assign(nul + 1, data + size - (nul + 1));
+    return true;
+}
+
+// An IPv4 address for a socket option; empty means any
+inline in_addr multicast_address(const std::string& address, const char* what) {
+    in_addr addr;
+    addr.s_addr = htonl(INADDR_ANY);
+    if (!address.empty() && inet_pton(AF_INET, address.c_str(), &addr) != 1) {
+        throw std::runtime_error(std::string("Invalid ") + what + " address: " + address);
+    }
+    return addr;
+}
+
+inline in_addr multicast_group_address(const std::string& group) {
+    in_addr addr = multicast_address(group, "multicast group");
+    if (group.empty() || !IN_MULTICAST(ntohl(addr.s_addr))) {
+        throw std::runtime_error("Not an IPv4 multicast group (224.0.0.0/4): " + group);
+    }
+    return addr;
+}
+
+// Publisher side; send() is thread-safe
+class MulticastSender {
+public:
+    /**
+     * interface_address picks the outgoing interface by one of its IPv4
+     * addresses (empty: the system's choice, usually the default route's).
+     * Loopback is on, so subscribers on the publishing host hear it too.
+     */
+    MulticastSender(const std::string& group, int port, const std::string& interface_address = "") {
+        memset(&destination, 0, sizeof(destination));
+        destination.sin_family = AF_INET;
+        destination.sin_addr = multicast_group_address(group);
+        destination.sin_port = htons(static_cast<uint16_t>(port));
+        in_addr interface_addr = multicast_address(interface_address, "multicast interface");
+
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open multicast socket: " + std::string(strerror(errno)));
+        }
+        unsigned char ttl = MULTICAST_TTL;
+        unsigned char loop = 1;
+        if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0 ||
+            setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0 ||
+            (!interface_address.empty() &&
+             setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interface_addr, sizeof(interface_addr)) != 0)) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Failed to configure multicast socket: " + std::string(strerror(err)));
+        }
+    }
+
+    ~MulticastSender() {
+        close(fd);
+    }
+
+    MulticastSender(const MulticastSender&) = delete;
+    MulticastSender& operator=(const MulticastSender&) = delete;
+
+    // False if the message is too large or the datagram could not be queued
+    bool send(const std::string& topic, const std::string& payload) {
+        if (sizeof(MULTICAST_MAGIC) + topic.size() + 1 + payload.size() > MULTICAST_MAX_DATAGRAM) {
+            too_large.fetch_add(1);
+            return false;
+        }
+        std::string datagram = multicast_datagram(topic, payload);
+        ssize_t n = sendto(fd, datagram.data(), datagram.size(), MSG_DONTWAIT,
+                           reinterpret_cast<const sockaddr*>(&destination), sizeof(destination));
+        if (n != static_cast<ssize_t>(datagram.size())) {
+            send_failures.fetch_add(1);
+            return false;
+        }
+        sent.fetch_add(1);
+        return true;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"multicast_sent", sent.load()},
+            {"multicast_too_large", too_large.load()},
+            {"multicast_send_failures", send_failures.load()},
+        };
+    }
+
+private:
+    int fd = -1;
+    sockaddr_in destination;
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> too_large{0};
+    std::atomic<uint64_t> send_failures{0};
+};
+
+/**
+ * Subscriber side: joins the group and hands each valid datagram to the
+ * handler on its own thread. Several processes on one host can receive
+ * the same group and port.
+ */
+class MulticastReceiver {
+public:
+    using Handler = std::function<void(const std::string&, const std::string&)>;
+
+    MulticastReceiver(const std::string& group, int port, const std::string& interface_address = "") {
+        ip_mreq membership;
+        membership.imr_multiaddr = multicast_group_address(group);
+        membership.imr_interface = multicast_address(interface_address, "multicast interface");
+
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open multicast socket: " + std::string(strerror(errno)));
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#endif
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons(static_cast<uint16_t>(port));
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0 ||
+            setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Failed to join multicast group " + group + ":" + std::to_string(port) +
+                                     ": " + std::string(strerror(err)));
+        }
+        // stop() writes here to wake the receive thread out of poll()
+        if (pipe(wake) != 0) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Failed to create wake pipe: " + std::string(strerror(err)));
+        }
+    }
+
+    ~MulticastReceiver() {
+        stop();
+        close(fd);
+        close(wake[0]);
+        close(wake[1]);
+    }
+
+    MulticastReceiver(const MulticastReceiver&) = delete;
+    MulticastReceiver& operator=(const MulticastReceiver&) = delete;
+
+    void start(Handler on_datagram) {
+        if (running.exchange(true)) {
+            return;
+        }
+        handler = on_datagram;
+        worker_thread = std::thread([this]() { receive_loop(); });
+    }
+
+    // Wait for the receive thread to finish; it must not be holding a lock the caller holds
+    void stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+        char byte = 0;
+        ssize_t ignored = write(wake[1], &byte, 1);
+        (void)ignored;
+        if (worker_thread.joinable()) {
+            worker_thread.join();
+        }
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"multicast_received", received.load()},
+            {"multicast_invalid", invalid.load()},
+        };
+    }
+
+private:
+    void receive_loop() {
+        std::string buffer(65536, '\0');
+        std::string topic, payload;
+        pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+        while (running.load()) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (fds[1].revents) {
+                break;
+            }
+            ssize_t n = recv(fd, &buffer[0], buffer.size(), MSG_DONTWAIT);
+            if (n <= 0) {
+                continue;
+            }
+            if (!parse_multicast_datagram(buffer.data(), static_cast<size_t>(n), topic, payload)) {
+                invalid.fetch_add(1);
+                continue;
+            }
+            received.fetch_add(1);
+            handler(topic, payload);
+        }
+    }
+
+    int fd = -1;
+    int wake[2] = {-1, -1};
+    std::thread worker_thread;
+    std::atomic<bool> running{false};
+    Handler handler;
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> invalid{0};
+};
+
+enum class CopyPath : uint8_t {
+    Broker,
+    Multicast,
+};
+
+enum class CopyVerdict : uint8_t {
+    Untracked,
+    First,
+    Repeat,
+    Superseded,
+};
+
+// Subscriber side; not thread-safe (NanoMQTTClient checks under callback_mutex)
+class FirstCopyFilter {
+public:
+    CopyVerdict check(const std::string& topic, const std::string& payload, CopyPath path) {
+        uint64_t seq = 0;
+        std::string source;
+        if (!json_uint_field(payload, "seq", seq) || !json_string_field(payload, "source", source)) {
+            return CopyVerdict::Untracked;
+        }
+        std::string server;
+        json_string_field(payload, "server", server);
+        size_t digest = std::hash<std::string>()(payload);
+        auto now = std::chrono::steady_clock::now();
+
+        Window& window = sources[topic + '\0' + source + '\0' + server];
+        const Slot& slot = window.slots[seq % SEQUENCE_WINDOW];
+        if (slot.seq == seq && seq != 0) {
+            if (slot.digest == digest) {
+                repeats++;
+                if (slot.path == CopyPath::Multicast && path != CopyPath::Multicast) {
+                    lead_last_us = static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(now - slot.arrived).count());
+                    lead_max_us = lead_last_us > lead_max_us ? lead_last_us : lead_max_us;
+                }
+                return CopyVerdict::Repeat;
+            }
+            // Same seq, different message: the publisher started over
+            window = Window();
+            resets++;
+        } else if (seq < window.newest) {
+            if (seq != 1) {
+                superseded++;
+                return CopyVerdict::Superseded;
+            }
+            // As SequenceTracker: seq 1 again means the publisher started over
+            window = Window();
+            resets++;
+        }
+
+        if (seq > window.newest) {
+            window.newest = seq;
+        }
+        Slot& fresh = window.slots[seq % SEQUENCE_WINDOW];
+        fresh.seq = seq;
+        fresh.digest = digest;
+        fresh.path = path;
+        fresh.arrived = now;
+        (path == CopyPath::Multicast ? first_multicast : first_broker)++;
+        return CopyVerdict::First;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"first_multicast", first_multicast},
+            {"first_broker", first_broker},
+            {"copies_dropped", repeats},
+            {"copies_superseded", superseded},
+            {"copy_resets", resets},
+            {"multicast_lead_last_us", lead_last_us},
+            {"multicast_lead_max_us", lead_max_us},
+        };
+    }
+
+private:
+    struct Slot {
+        uint64_t seq = 0;
+        size_t digest = 0;
+        CopyPath path = CopyPath::Broker;
+        std::chrono::steady_clock::time_point arrived;
+    };
+
+    // Newest seq delivered and the last SEQUENCE_WINDOW delivered, by seq % SEQUENCE_WINDOW
+    struct Window {
+        uint64_t newest = 0;
+        Slot slots[SEQUENCE_WINDOW];
+    };
+
+    std::map<std::string, Window> sources;
+    uint64_t first_multicast = 0;
+    uint64_t first_broker = 0;
+    uint64_t repeats = 0;
+    uint64_t superseded = 0;
+    uint64_t resets = 0;
+    uint64_t lead_last_us = 0;
+    uint64_t lead_max_us = 0;
+};
+
+}  // namespace native
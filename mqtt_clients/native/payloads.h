@@ -0,0 +1,196 @@
+/**
+ * Message payloads
+ *
+ * The JSON messages published for switches, connect/disconnect/clipboard
+ * records and flap status, built by hand so the native publishers (live
+ * follower, backfill, synergy-monitord) send exactly what waldo.py sends:
+ * same keys, same order, same local-time ISO timestamp with its UTC offset. The json_*_field()
+ * helpers read fields back on the subscribing side.
+ */
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+#include "event_parser.h"
+#include "flap_filter.h"
+
+namespace native {
+
+inline std::string json_escape(const std::string& in) {
+    std::string out;
+    out.reserve(in.size());
+    for (char c : in) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    out += esc;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+// Local time with its UTC offset, same shape as Python's datetime.now().astimezone().isoformat()
+inline std::string iso_timestamp_now() {
+    auto now = std::chrono::system_clock::now();
+    std::time_t secs = std::chrono::system_clock::to_time_t(now);
+    long micros = static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(
+        now.time_since_epoch()).count() % 1000000);
+    std::tm local;
+    localtime_r(&secs, &local);
+    char buf[40];
+    size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &local);
+    n += snprintf(buf + n, sizeof(buf) - n, ".%06ld", micros);
+    // strftime gives "+0200"; ISO 8601 (and parse_iso_timestamp) wants "+02:00"
+    char zone[8];
+    if (strftime(zone, sizeof(zone), "%z", &local) == 5) {
+        snprintf(buf + n, sizeof(buf) - n, "%.3s:%.2s", zone, zone + 3);
+    }
+    return buf;
+}
+
+// Same message waldo.py publishes for a desktop switch; timestamp defaults to now
+inline std::string switch_event_payload(const std::string& desktop, const std::string& server = "",
+                                        const std::string& timestamp = "") {
+    std::string payload = "{\"current_desktop\": \"" + json_escape(desktop) +
+        "\", \"timestamp\": \"" + (timestamp.empty() ? iso_timestamp_now() : json_escape(timestamp)) + "\"";
+    if (!server.empty()) {
+        payload += ", \"server\": \"" + json_escape(server) + "\"";
+    }
+    return payload + "}";
+}
+
+// Connect, disconnect and clipboard records for the events topic
+inline std::string log_record_payload(const native::LogRecord& record, const std::string& server,
+                                      const std::string& timestamp = "") {
+    std::string payload = "{\"event\": \"" + std::string(native::event_kind_name(record.kind)) +
+        "\", \"screen\": \"" + json_escape(std::string(record.screen, record.desktop_len)) + "\"";
+    if (record.clipboard >= 0) {
+        payload += ", \"clipboard\": " + std::to_string(record.clipboard);
+    }
+    payload += ", \"timestamp\": \"" + (timestamp.empty() ? iso_timestamp_now() : json_escape(timestamp)) + "\"";
+    if (!server.empty()) {
+        payload += ", \"server\": \"" + json_escape(server) + "\"";
+    }
+    return payload + "}";
+}
+
+// "flapping" when a burst starts being suppressed, "settled" when it ends
+inline std::string flap_status_payload(const char* status, const native::FlapFilter& filter,
+                                       const std::string& server) {
+    std::string payload = "{\"event\": \"" + std::string(status) + "\", \"screen\": \"" +
+        json_escape(filter.screen()) + "\", \"suppressed\": " +
+        std::to_string(filter.burst_suppressed_count()) + ", \"timestamp\": \"" + iso_timestamp_now() + "\"";
+    if (!server.empty()) {
+        payload += ", \"server\": \"" + json_escape(server) + "\"";
+    }
+    return payload + "}";
+}
+
+// Offset of the value of a top-level "key" in a flat JSON object, or npos
+inline size_t json_field_value(const std::string& json, const std::string& key) {
+    const std::string quoted = "\"" + key + "\"";
+    size_t pos = 0;
+    while ((pos = json.find(quoted, pos)) != std::string::npos) {
+        size_t p = pos + quoted.size();
+        pos = p;
+        while (p < json.size() && isspace(static_cast<unsigned char>(json[p]))) {
+            p++;
+        }
+        if (p == json.size() || json[p] != ':') {
+            continue;
+        }
+        p++;
+        while (p < json.size() && isspace(static_cast<unsigned char>(json[p]))) {
+            p++;
+        }
+        return p < json.size() ? p : std::string::npos;
+    }
+    return std::string::npos;
+}
+
+/**
+ * The string value of a top-level "key" in a flat JSON object, as waldo
+ * publishes them. Escapes are decoded except \u, which never matches a
+ * desktop name; false if the key is missing or not a string.
+ */
+inline bool json_string_field(const std::string& json, const std::string& key, std::string& value) {
+    size_t p = json_field_value(json, key);
+    if (p == std::string::npos || json[p] != '"') {
+        return false;
+    }
+    value.clear();
+    for (p++; p < json.size(); p++) {
+        char c = json[p];
+        if (c == '"') {
+            return true;
+        }
+        if (c != '\\') {
+            value += c;
+            continue;
+        }
+        if (++p == json.size()) {
+            return false;
+        }
+        switch (json[p]) {
+            case 'n': value += '\n'; break;
+            case 't': value += '\t'; break;
+            case 'r': value += '\r'; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'u': return false;
+            default: value += json[p]; break;
+        }
+    }
+    return false;
+}
+
+// A top-level non-negative integer field such as "seq"; false if missing or not one
+inline bool json_uint_field(const std::string& json, const std::string& key, uint64_t& value) {
+    size_t p = json_field_value(json, key);
+    if (p == std::string::npos || !isdigit(static_cast<unsigned char>(json[p]))) {
+        return false;
+    }
+    value = 0;
+    for (; p < json.size() && isdigit(static_cast<unsigned char>(json[p])); p++) {
+        value = value * 10 + static_cast<uint64_t>(json[p] - '0');
+    }
+    return true;
+}
+
+// True if the top-level "key" is the literal true
+inline bool json_true_field(const std::string& json, const std::string& key) {
+    size_t p = json_field_value(json, key);
+    return p != std::string::npos && json.compare(p, 4, "true") == 0;
+}
+
+/**
+ * payload with `fields` (", \"key\": value" text) added before its closing
+ * brace; empty if payload is not a JSON object.
+ */
+inline std::string json_append_fields(const std::string& payload, const std::string& fields) {
+    size_t end = payload.find_last_not_of(" \t\r\n");
+    if (end == std::string::npos || payload[end] != '}' || payload[0] != '{') {
+        return "";
+    }
+    size_t last = payload.find_last_not_of(" \t\r\n", end - 1);
+    bool empty = last == 0;
+    return payload.substr(0, end) + (empty ? fields.substr(2) : fields) + payload.substr(end);
+}
+
+}  // namespace native
@@ -0,0 +1,552 @@
+/**
+ * Brokerless peer transport over nng pub0/sub0
+ *
+ * Through a broker every switch takes two network hops, and nothing moves
+ * while the broker is down. NanoSDK is built on nng, which also has plain
+ * publish/subscribe sockets: the primary's PeerPublisher listens on a TCP
+ * port and secondaries' PeerSubscribers dial it directly. nng redials a
+ * lost peer on its own, in both directions.
+ *
+ * Each message is one nng message, "topic\0" + a flags byte + the payload.
+ * A subscription to an MQTT filter subscribes the sub0 socket to the
+ * filter's literal prefix (nng filters by message prefix), and the topic is
+ * then matched with MQTT wildcard rules.
+ *
+ * Pub/sub has no retained messages and no acknowledgements. Instead the
+ * publisher remembers the last message per topic and sends it again,
+ * flagged as a replay, whenever a subscriber connects; pub0 cannot address
+ * one peer, so every subscriber gets it. A replay is handled like a
+ * retained message: it updates the current state but never reaches the
+ * ring or the callback, so it does not ring a bell. A subscriber also
+ * drops any repeat of the last live payload on a topic. A message sent while a subscriber is disconnected is not
+ * queued for it; the replay on reconnect brings it up to date.
+ */
+
+#pragma once
+
+#include <string>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <set>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <cstring>
+
+extern "C" {
+#include <nng/nng.h>
+#include <nng/protocol/pubsub0/pub.h>
+#include <nng/protocol/pubsub0/sub.h>
+}
+
+#include "event_filter.h"
+#include "event_ring.h"
+#include "state_cache.h"
+#include "state_page.h"
+#include "topics.h"
+
+namespace native {
+
+// TCP port peers meet on when none is configured
+static const int DEFAULT_PEER_PORT = 1885;
+
+// Flags byte after the topic
+static const uint8_t PEER_FLAG_REPLAY = 0x01;
+
+inline std::string peer_frame(const std::string& topic, const std::string& payload, uint8_t flags = 0) {
+    std::string frame;
+    frame.reserve(topic.size() + payload.size() + 2);
+    frame.append(topic);
+    frame.push_back('\0');
+    frame.push_back(static_cast<char>(flags));
+    frame.append(payload);
+    return frame;
+}
+
+// False if data is not a peer frame
+inline bool peer_unframe(const char* data, size_t len, std::string& topic, std::string& payload, uint8_t& flags) {
+    const char* nul = static_cast<const char*>(memchr(data, '\0', len));
+    if (!nul || static_cast<size_t>(nul - data) + 2 > len) {
+        return false;
+    }
+    topic.assign(data, nul - data);
+    flags = static_cast<uint8_t>(nul[1]);
+    payload.assign(nul + 2, len - (nul - data) - 2);
+    return true;
+}
+
+// The sub0 prefix for an MQTT filter: the whole topic and its NUL, or the part before the first wildcard
+inline std::string peer_subscription_prefix(const std::string& filter) {
+    size_t wildcard = filter.find_first_of("+#");
+    if (wildcard == std::string::npos) {
+        return filter + '\0';
+    }
+    return filter.substr(0, wildcard);
+}
+
+// tcp://host:port for a peer address
+inline std::string peer_url(const std::string& host, int port) {
+    return "tcp://" + host + ":" + std::to_string(port);
+}
+
+class PeerPublisher {
+public:
+    explicit PeerPublisher(const std::string& url) : url(url) {
+        int rv = nng_pub0_open(&sock);
+        if (rv != 0) {
+            throw std::runtime_error("Failed to open peer publisher: " + std::string(nng_strerror(rv)));
+        }
+        nng_pipe_notify(sock, NNG_PIPE_EV_ADD_POST, pipe_cb, this);
+        nng_pipe_notify(sock, NNG_PIPE_EV_REM_POST, pipe_cb, this);
+    }
+
+    ~PeerPublisher() {
+        nng_close(sock);
+    }
+
+    PeerPublisher(const PeerPublisher&) = delete;
+    PeerPublisher& operator=(const PeerPublisher&) = delete;
+
+    // Start accepting subscribers; throws if the address cannot be bound (e.g. the port is taken)
+    void listen() {
+        if (listening) {
+            return;
+        }
+        int rv = nng_listener_create(&listener, sock, url.c_str());
+        if (rv == 0) {
+            rv = nng_listener_start(listener, 0);
+            if (rv != 0) {
+                nng_listener_close(listener);
+            }
+        }
+        if (rv != 0) {
+            throw std::runtime_error("Failed to listen on " + url + ": " + std::string(nng_strerror(rv)));
+        }
+        listening = true;
+    }
+
+    // Stop accepting subscribers and drop the connected ones
+    void close() {
+        if (listening) {
+            nng_listener_close(listener);
+            listening = false;
+        }
+    }
+
+    bool is_listening() const {
+        return listening;
+    }
+
+    // The TCP port listened on, useful after listening on port 0
+    int bound_port() const {
+        int port = 0;
+        if (listening) {
+            nng_listener_get_int(listener, NNG_OPT_TCP_BOUND_PORT, &port);
+        }
+        return port;
+    }
+
+    /**
+     * Send to every connected subscriber, and remember it to replay to
+     * subscribers that connect later. False only if nng refused the
+     * message; with no subscribers connected it is just remembered.
+     */
+    bool publish(const std::string& topic, const std::string& payload) {
+        {
+            std::lock_guard<std::mutex> lock(last_mutex);
+            last[topic] = payload;
+        }
+        if (send(peer_frame(topic, payload))) {
+            sent.fetch_add(1);
+            return true;
+        }
+        send_failures.fetch_add(1);
+        return false;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"peers", static_cast<uint64_t>(peers.load())},
+            {"sent", sent.load()},
+            {"send_failures", send_failures.load()},
+            {"replays", replays.load()},
+        };
+    }
+
+private:
+    static void pipe_cb(nng_pipe /* pipe */, nng_pipe_ev ev, void* arg) {
+        PeerPublisher* publisher = static_cast<PeerPublisher*>(arg);
+        if (ev == NNG_PIPE_EV_REM_POST) {
+            publisher->peers.fetch_sub(1);
+            return;
+        }
+        publisher->peers.fetch_add(1);
+        publisher->replay();
+    }
+
+    // A subscriber connected: send it (and everyone) the last message per topic
+    void replay() {
+        std::vector<std::string> frames;
+        {
+            std::lock_guard<std::mutex> lock(last_mutex);
+            for (const auto& entry : last) {
+                frames.push_back(peer_frame(entry.first, entry.second, PEER_FLAG_REPLAY));
+            }
+        }
+        for (auto& frame : frames) {
+            if (send(frame)) {
+                replays.fetch_add(1);
+            }
+        }
+    }
+
+    bool send(const std::string& frame) {
+        // pub0 never blocks: a subscriber whose queue is full misses the message
+        return nng_send(sock, const_cast<char*>(frame.data()), frame.size(), NNG_FLAG_NONBLOCK) == 0;
+    }
+
+    std::string url;
+    nng_socket sock;
+    nng_listener listener;
+    bool listening = false;
+
+    std::mutex last_mutex;
+    std::map<std::string, std::string> last;
+
+    std::atomic<int> peers{0};
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> send_failures{0};
+    std::atomic<uint64_t> replays{0};
+};
+
+/**
+ * Receives from a PeerPublisher. Mirrors the parts of NanoMQTTClient a
+ * subscriber uses: a message callback run on the receive thread, the
+ * event filter, the current-state cache and the state page and event ring
+ * for local readers.
+ */
+class PeerSubscriber {
+public:
+    explicit PeerSubscriber(const std::string& url) : url(url) {
+        int rv = nng_sub0_open(&sock);
+        if (rv != 0) {
+            throw std::runtime_error("Failed to open peer subscriber: " + std::string(nng_strerror(rv)));
+        }
+        nng_pipe_notify(sock, NNG_PIPE_EV_ADD_POST, pipe_cb, this);
+        nng_pipe_notify(sock, NNG_PIPE_EV_REM_POST, pipe_cb, this);
+        if ((rv = nng_aio_alloc(&rx_aio, nullptr, nullptr)) != 0) {
+            nng_close(sock);
+            throw std::runtime_error("Failed to allocate receive aio: " + std::string(nng_strerror(rv)));
+        }
+    }
+
+    ~PeerSubscriber() {
+        disconnect();
+        nng_close(sock);
+        nng_aio_free(rx_aio);
+    }
+
+    PeerSubscriber(const PeerSubscriber&) = delete;
+    PeerSubscriber& operator=(const PeerSubscriber&) = delete;
+
+    /**
+     * Start dialing the publisher. Returns at once: the dialer keeps
+     * retrying in the background until the publisher is up, and redials
+     * whenever the link drops; is_connected() tells whether it is linked.
+     */
+    bool connect() {
+        if (dialer_started) {
+            return true;
+        }
+        int rv = nng_dialer_create(&dialer, sock, url.c_str());
+        if (rv != 0) {
+            throw std::runtime_error("Failed to create dialer for " + url + ": " + std::string(nng_strerror(rv)));
+        }
+        nng_dialer_set_bool(dialer, NNG_OPT_TCP_NODELAY, true);
+        if ((rv = nng_dialer_start(dialer, NNG_FLAG_NONBLOCK)) != 0) {
+            nng_dialer_close(dialer);
+            throw std::runtime_error("Failed to dial " + url + ": " + std::string(nng_strerror(rv)));
+        }
+        dialer_started = true;
+        return true;
+    }
+
+    // Stop the receive loop and hang up; subscriptions are kept for connect()
+    void disconnect() {
+        stop_message_loop();
+        if (dialer_started) {
+            nng_dialer_close(dialer);
+            dialer_started = false;
+        }
+    }
+
+    // Hang up and dial again, keeping subscriptions and the receive loop
+    bool restart() {
+        bool was_running = running.load();
+        disconnect();
+        connect();
+        if (was_running) {
+            start_message_loop();
+        }
+        return true;
+    }
+
+    bool is_connected() const {
+        return peers.load() > 0;
+    }
+
+    bool subscribe(const std::string& filter, int /* qos */ = 0) {
+        std::string prefix = peer_subscription_prefix(filter);
+        std::lock_guard<std::mutex> lock(filters_mutex);
+        if (filters.count(filter)) {
+            return true;
+        }
+        if (prefixes[prefix]++ == 0 && nng_socket_set(sock, NNG_OPT_SUB_SUBSCRIBE, prefix.data(), prefix.size()) != 0) {
+            prefixes.erase(prefix);
+            return false;
+        }
+        filters.insert(filter);
+        return true;
+    }
+
+    bool unsubscribe(const std::string& filter) {
+        std::lock_guard<std::mutex> lock(filters_mutex);
+        auto found = filters.find(filter);
+        if (found == filters.end()) {
+            return false;
+        }
+        filters.erase(found);
+        std::string prefix = peer_subscription_prefix(filter);
+        if (--prefixes[prefix] == 0) {
+            prefixes.erase(prefix);
+            nng_socket_set(sock, NNG_OPT_SUB_UNSUBSCRIBE, prefix.data(), prefix.size());
+        }
+        return true;
+    }
+
+    // Subscribe first, so no message falls between the two
+    bool resubscribe(const std::string& old_filter, const std::string& new_filter, int qos = 0) {
+        if (old_filter == new_filter) {
+            return true;
+        }
+        if (!subscribe(new_filter, qos)) {
+            return false;
+        }
+        unsubscribe(old_filter);
+        return true;
+    }
+
+    void set_message_callback(std::function<void(const std::string&, const std::string&)> callback) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        message_callback = callback;
+    }
+
+    // As NanoMQTTClient::set_event_filter()
+    void set_event_filter(int max_age_ms, bool order = true) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        if (max_age_ms < 0 && !order) {
+            event_filter.reset();
+        } else {
+            event_filter.reset(new EventFilter(max_age_ms, order));
+        }
+    }
+
+    // As NanoMQTTClient::set_state_page()
+    void set_state_page(const std::string& name) {
+        std::unique_ptr<StatePageWriter> page;
+        if (!name.empty()) {
+            page.reset(new StatePageWriter(name));
+        }
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        state_page = std::move(page);
+        DesktopState latest;
+        if (state_page && states.latest(latest)) {
+            state_page->write(latest);
+        }
+    }
+
+    // As NanoMQTTClient::set_event_ring()
+    void set_event_ring(const std::string& name) {
+        std::unique_ptr<EventRingWriter> ring;
+        if (!name.empty()) {
+            ring.reset(new EventRingWriter(name));
+        }
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        event_ring = std::move(ring);
+    }
+
+    bool current_state(DesktopState& state, bool any_server = true, const std::string& server = "") const {
+        return states.latest(state, any_server, server);
+    }
+
+    std::vector<DesktopState> current_states() const {
+        return states.all();
+    }
+
+    void start_message_loop() {
+        if (running.load()) {
+            return;
+        }
+        running.store(true);
+        worker_thread = std::thread([this]() { message_loop(); });
+    }
+
+    void stop_message_loop() {
+        {
+            std::lock_guard<std::mutex> lock(rx_mutex);
+            running.store(false);
+            nng_aio_cancel(rx_aio);
+        }
+        if (worker_thread.joinable()) {
+            worker_thread.join();
+        }
+    }
+
+    std::map<std::string, uint64_t> receive_stats() const {
+        return {
+            {"messages", rx_messages.load()},
+            {"connects", connects.load()},
+            {"unmatched", unmatched.load()},
+            {"repeats_dropped", repeats_dropped.load()},
+            {"stale_dropped", stale_dropped.load()},
+            {"reordered_dropped", reordered_dropped.load()},
+            {"state_only", state_only.load()},
+        };
+    }
+
+private:
+    static void pipe_cb(nng_pipe /* pipe */, nng_pipe_ev ev, void* arg) {
+        PeerSubscriber* subscriber = static_cast<PeerSubscriber*>(arg);
+        if (ev == NNG_PIPE_EV_REM_POST) {
+            subscriber->peers.fetch_sub(1);
+        } else {
+            subscriber->peers.fetch_add(1);
+            subscriber->connects.fetch_add(1);
+        }
+    }
+
+    void message_loop() {
+        while (running.load()) {
+            {
+                // Checked under rx_mutex so a stop cannot slip in before the receive
+                std::lock_guard<std::mutex> lock(rx_mutex);
+                if (!running.load()) {
+                    break;
+                }
+                nng_recv_aio(sock, rx_aio);
+            }
+            nng_aio_wait(rx_aio);
+            int rv = nng_aio_result(rx_aio);
+            if (rv == NNG_ECLOSED) {
+                break;
+            }
+            if (rv != 0) {
+                continue;
+            }
+            nng_msg* msg = nng_aio_get_msg(rx_aio);
+            rx_messages.fetch_add(1);
+            handle_message(static_cast<const char*>(nng_msg_body(msg)), nng_msg_len(msg));
+            nng_msg_free(msg);
+        }
+    }
+
+    void handle_message(const char* data, size_t len) {
+        std::string topic, payload;
+        uint8_t flags;
+        if (!peer_unframe(data, len, topic, payload, flags) || !matches_filter(topic)) {
+            unmatched.fetch_add(1);
+            return;
+        }
+        bool replay = flags & PEER_FLAG_REPLAY;
+
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        // A replay goes to every peer when one connects; it is the current
+        // state, not a new switch, so it only updates the state
+        if (replay) {
+            file_state(topic, payload, true);
+            state_only.fetch_add(1);
+            return;
+        }
+        std::string& previous = last_payload[topic];
+        if (previous == payload) {
+            repeats_dropped.fetch_add(1);
+            return;
+        }
+        previous = payload;
+
+        if (event_filter) {
+            EventVerdict verdict = event_filter->check(topic, payload);
+            if (verdict == EventVerdict::Stale) {
+                stale_dropped.fetch_add(1);
+                return;
+            }
+            if (verdict == EventVerdict::Reordered) {
+                reordered_dropped.fetch_add(1);
+                return;
+            }
+        }
+        file_state(topic, payload, false);
+        if (event_ring) {
+            event_ring->write(topic, payload);
+        }
+        if (message_callback) {
+            message_callback(topic, payload);
+        }
+    }
+
+    bool matches_filter(const std::string& topic) {
+        std::lock_guard<std::mutex> lock(filters_mutex);
+        for (const auto& filter : filters) {
+            if (topic_matches(filter, topic)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // callback_mutex held
+    void file_state(const std::string& topic, const std::string& payload, bool replay) {
+        DesktopState latest;
+        if (states.update(topic, payload, replay) && state_page && states.latest(latest)) {
+            state_page->write(latest);
+        }
+    }
+
+    std::string url;
+    nng_socket sock;
+    nng_dialer dialer;
+    bool dialer_started = false;
+
+    std::atomic<bool> running{false};
+    std::thread worker_thread;
+    std::mutex rx_mutex;
+    nng_aio* rx_aio = nullptr;
+
+    // MQTT filters subscribed, and sub0 prefix -> filters using it
+    std::mutex filters_mutex;
+    std::set<std::string> filters;
+    std::map<std::string, int> prefixes;
+
+    // Guarded by callback_mutex
+    std::mutex callback_mutex;
+    std::function<void(const std::string&, const std::string&)> message_callback;
+    std::unique_ptr<EventFilter> event_filter;
+    std::unique_ptr<StatePageWriter> state_page;
+    std::unique_ptr<EventRingWriter> event_ring;
+    std::map<std::string, std::string> last_payload;
+    StateCache states;
+
+    std::atomic<int> peers{0};
+    std::atomic<uint64_t> connects{0};
+    std::atomic<uint64_t> rx_messages{0};
+    std::atomic<uint64_t> unmatched{0};
+    std::atomic<uint64_t> repeats_dropped{0};
+    std::atomic<uint64_t> stale_dropped{0};
+    std::atomic<uint64_t> reordered_dropped{0};
+    std::atomic<uint64_t> state_only{0};
+};
+
+}  // namespace native
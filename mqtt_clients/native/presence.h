@@ -0,0 +1,156 @@
+/**
+ * Fleet presence through retained messages and the MQTT Last Will
+ *
+ * Every client that enables presence owns one retained topic,
+ * PREFIX/NAME/ROLE (e.g. synergy/presence/office/found-him), and keeps it
+ * true for the broker's whole view of the session:
+ *
+ *   {"status": "online", "name": "office", "role": "found-him", "pid": 4242, "since": 1760000000}
+ *
+ * is published retained on every new session, and the same topic is the
+ * session's Last Will, so if the client dies or its link drops the broker
+ * itself publishes
+ *
+ *   {"status": "offline", "name": "office", "role": "found-him", "reason": "lost"}
+ *
+ * once the keepalive runs out. A clean DISCONNECT cancels the will, so a
+ * client shutting down publishes the offline message itself first, with
+ * "reason": "shutdown".
+ *
+ * A client watching PREFIX/# gets the whole fleet's retained states on
+ * subscribe and every change after that as it happens, into a PresenceMap.
+ * Nothing polls: the broker pushes the changes.
+ */
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include "payloads.h"
+
+namespace native {
+
+// Presence topic prefix when the configuration names none
+static const char* const DEFAULT_PRESENCE_TOPIC = "synergy/presence";
+
+inline std::string presence_topic(const std::string& prefix, const std::string& name, const std::string& role) {
+    return prefix + "/" + name + "/" + role;
+}
+
+inline std::string presence_filter(const std::string& prefix) {
+    return prefix + "/#";
+}
+
+// A member's presence message; since is only sent when online
+inline std::string presence_payload(const std::string& name, const std::string& role, bool online,
+                                    const std::string& reason, uint64_t pid, uint64_t since) {
+    std::string payload = std::string("{\"status\": \"") + (online ? "online" : "offline") + "\", \"name\": \"" +
+                          json_escape(name) + "\", \"role\": \"" + json_escape(role) + "\"";
+    if (online) {
+        payload += ", \"pid\": " + std::to_string(pid) + ", \"since\": " + std::to_string(since);
+    } else {
+        payload += ", \"reason\": \"" + json_escape(reason) + "\"";
+    }
+    return payload + "}";
+}
+
+// One member as last reported; member is the topic below the prefix ("office/found-him")
+struct PresenceEntry {
+    std::string member;
+    std::string name;
+    std::string role;
+    bool online = false;
+    std::string reason;         // why it went offline: "lost" (the will) or "shutdown"
+    uint64_t pid = 0;
+    uint64_t since = 0;         // epoch seconds the session came online
+    int64_t changed_us = 0;     // system clock, when this client saw the status change
+};
+
+// Thread-safe: the receive thread updates, any thread reads
+class PresenceMap {
+public:
+    explicit PresenceMap(const std::string& prefix) : prefix(prefix) {}
+
+    // True if topic is a member's presence topic under this map's prefix
+    bool covers(const std::string& topic) const {
+        return topic.size() > prefix.size() + 1 && topic.compare(0, prefix.size(), prefix) == 0 &&
+               topic[prefix.size()] == '/';
+    }
+
+    // File a presence message; false if the payload is not one
+    bool update(const std::string& topic, const std::string& payload) {
+        std::string status;
+        if (!json_string_field(payload, "status", status) || (status != "online" && status != "offline")) {
+            std::lock_guard<std::mutex> lock(mutex);
+            invalid++;
+            return false;
+        }
+        bool online = status == "online";
+        int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::string member = topic.substr(prefix.size() + 1);
+        auto found = members.find(member);
+        bool changed = found == members.end() || found->second.online != online;
+        PresenceEntry& entry = members[member];
+        entry.member = member;
+        json_string_field(payload, "name", entry.name);
+        json_string_field(payload, "role", entry.role);
+        entry.online = online;
+        entry.reason.clear();
+        entry.pid = 0;
+        entry.since = 0;
+        if (online) {
+            json_uint_field(payload, "pid", entry.pid);
+            json_uint_field(payload, "since", entry.since);
+        } else {
+            json_string_field(payload, "reason", entry.reason);
+        }
+        if (changed) {
+            entry.changed_us = now_us;
+            changes++;
+        }
+        return true;
+    }
+
+    std::vector<PresenceEntry> entries() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<PresenceEntry> out;
+        out.reserve(members.size());
+        for (const auto& entry : members) {
+            out.push_back(entry.second);
+        }
+        return out;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t online = 0;
+        for (const auto& entry : members) {
+            online += entry.second.online ? 1 : 0;
+        }
+        return {
+            {"members", members.size()},
+            {"online", online},
+            {"offline", members.size() - online},
+            {"changes", changes},
+            {"invalid", invalid},
+        };
+    }
+
+private:
+    const std::string prefix;
+    mutable std::mutex mutex;
+    std::map<std::string, PresenceEntry> members;
+    uint64_t changes = 0;
+    uint64_t invalid = 0;
+};
+
+}  // namespace native
@@ -0,0 +1,190 @@
+/**
+ * Request/response queries for the current desktop
+ *
+ * A subscriber that wants the active desktop now, rather than at the next
+ * switch, publishes a query on topic + "/query":
+ *
+ *   {"id": 7, "reply_to": "synergy/reply/found-him-1234", "server": "..."}
+ *
+ * The primary's publisher (NanoMQTTClient::serve_state) answers from the
+ * last message it stamped, on the reply_to topic, with the query's id
+ * added; {"id": 7} alone if it has published nothing yet. Replies must go
+ * under topic + "/reply/", so a query cannot make the publisher write to
+ * any other topic. "server" is optional and narrows the answer to one
+ * server's last switch.
+ *
+ * Each client has its own reply topic, and the id tells its queries apart.
+ * PendingQueries matches replies to callers: every query waits on its own
+ * condition variable, so any number can be outstanding from different
+ * threads and a reply wakes only its caller, whatever order they arrive in.
+ */
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include "state_cache.h"
+
+namespace native {
+
+// Queries go to topic + QUERY_SUFFIX, answers to topic + QUERY_REPLY_INFIX + a per-client name
+static const char* const QUERY_SUFFIX = "/query";
+static const char* const QUERY_REPLY_INFIX = "/reply/";
+
+// query_current() timeout when none is given
+static const int QUERY_TIMEOUT_MS = 1000;
+
+inline std::string query_topic(const std::string& topic) {
+    return topic + QUERY_SUFFIX;
+}
+
+inline std::string query_reply_topic(const std::string& topic, const std::string& inbox) {
+    return topic + QUERY_REPLY_INFIX + inbox;
+}
+
+inline bool is_query_topic(const std::string& topic) {
+    const size_t n = strlen(QUERY_SUFFIX);
+    return topic.size() > n && topic.compare(topic.size() - n, n, QUERY_SUFFIX) == 0;
+}
+
+// A reply_to a publisher serving `topic` may answer on
+inline bool is_reply_topic_for(const std::string& topic, const std::string& reply_to) {
+    const std::string prefix = topic + QUERY_REPLY_INFIX;
+    return reply_to.size() > prefix.size() && reply_to.compare(0, prefix.size(), prefix) == 0 &&
+           reply_to.find_first_of("+#", prefix.size()) == std::string::npos;
+}
+
+// What query_current() learned
+struct QueryResult {
+    bool known = false;         // false if the publisher has not published a switch yet
+    DesktopState state;
+    uint64_t rtt_us = 0;        // query sent to answer received
+};
+
+// Thread-safe: callers open and wait, the receive thread resolves
+class PendingQueries {
+public:
+    // Register a query about to be sent; returns its id
+    uint64_t open() {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t id = next_id++;
+        std::shared_ptr<Pending> query(new Pending());
+        query->sent = std::chrono::steady_clock::now();
+        pending[id] = query;
+        sent++;
+        return id;
+    }
+
+    // The query could not be sent; forget it
+    void cancel(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.erase(id);
+        sent--;
+    }
+
+    /**
+     * Wait up to timeout_ms for the reply to id; false on timeout. The
+     * query is forgotten either way, so a reply arriving later is counted
+     * as late and dropped.
+     */
+    bool wait(uint64_t id, int timeout_ms, std::string& reply, uint64_t& rtt_us) {
+        std::shared_ptr<Pending> query;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = pending.find(id);
+            if (found == pending.end()) {
+                return false;
+            }
+            query = found->second;
+        }
+
+        bool answered;
+        {
+            std::unique_lock<std::mutex> lock(query->mutex);
+            answered = query->cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return query->done; });
+            if (answered) {
+                reply = query->reply;
+                rtt_us = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(query->answered - query->sent).count());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.erase(id);
+        if (answered) {
+            this->answered++;
+            last_rtt_us = rtt_us;
+            max_rtt_us = rtt_us > max_rtt_us ? rtt_us : max_rtt_us;
+        } else {
+            timeouts++;
+        }
+        return answered;
+    }
+
+    // Hand a reply to its waiting caller; false if no caller is waiting for id
+    bool resolve(uint64_t id, const std::string& reply) {
+        std::shared_ptr<Pending> query;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = pending.find(id);
+            if (found == pending.end()) {
+                late++;
+                return false;
+            }
+            query = found->second;
+        }
+        {
+            std::lock_guard<std::mutex> lock(query->mutex);
+            if (query->done) {
+                return false;
+            }
+            query->reply = reply;
+            query->answered = std::chrono::steady_clock::now();
+            query->done = true;
+        }
+        query->cv.notify_one();
+        return true;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {
+            {"sent", sent},
+            {"answered", answered},
+            {"timeouts", timeouts},
+            {"late", late},
+            {"pending", pending.size()},
+            {"last_rtt_us", last_rtt_us},
+            {"max_rtt_us", max_rtt_us},
+        };
+    }
+
+private:
+    struct Pending {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+        std::string reply;
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::steady_clock::time_point answered;
+    };
+
+    mutable std::mutex mutex;
+    std::map<uint64_t, std::shared_ptr<Pending>> pending;
+    uint64_t next_id = 1;
+    uint64_t sent = 0;
+    uint64_t answered = 0;
+    uint64_t timeouts = 0;
+    uint64_t late = 0;
+    uint64_t last_rtt_us = 0;
+    uint64_t max_rtt_us = 0;
+};
+
+}  // namespace native
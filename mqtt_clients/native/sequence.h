@@ -0,0 +1,411 @@
+/**
+ * Event sequence numbers
+ *
+ * A switch carries a timestamp, but nothing that tells a subscriber one went
+ * missing in a QoS 0/1 delivery or across a reconnect. Publishers therefore
+ * add the publishing host ("source") and a "seq" that rises by one per topic
+ * and "server". SequenceStamper keeps those counters and persists them, so a
+ * restarted waldo carries on where it stopped instead of starting over.
+ *
+ * SequenceTracker is the subscriber's side. Per topic, source and server it
+ * sorts each message into:
+ *
+ * - InOrder: the next one, or the first seen from that source.
+ * - Gap: newer, but some were skipped; delivered, and the caller asks for
+ *   the current state.
+ * - Duplicate: already seen (a QoS 1 redelivery); dropped.
+ * - Late: one counted missing that arrived after a newer one; dropped, as
+ *   the subscriber already has newer state.
+ * - Reset: seq 1 again, the publisher lost its state file; delivered and
+ *   tracking starts over.
+ * - Current: a state reply (`"state": true`) the subscriber already has;
+ *   dropped without counting as a duplicate.
+ *
+ * Messages without a seq are not tracked.
+ */
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cinttypes>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "payloads.h"
+
+namespace native {
+
+// Subscribers ask for a topic's current state on topic + this suffix
+static const char* const STATE_REQUEST_SUFFIX = "/resync";
+
+// How many seqs behind the newest a late arrival is still told apart from a duplicate
+static const uint64_t SEQUENCE_WINDOW = 64;
+
+inline std::string state_request_topic(const std::string& topic) {
+    return topic + STATE_REQUEST_SUFFIX;
+}
+
+inline bool is_state_request_topic(const std::string& topic) {
+    const size_t n = strlen(STATE_REQUEST_SUFFIX);
+    return topic.size() > n && topic.compare(topic.size() - n, n, STATE_REQUEST_SUFFIX) == 0;
+}
+
+/**
+ * Sequence counters on disk: a header, one "seq<TAB>topic<TAB>server" line
+ * per counter and a checksum line, rewritten in place after every stamp.
+ * As with CheckpointFile, pwrite() reaches the page cache (which survives
+ * the process being killed) and fsync() runs at most once per
+ * SYNC_INTERVAL_MS, plus on close.
+ */
+class SequenceFile {
+public:
+    static constexpr int SYNC_INTERVAL_MS = 1000;
+
+    explicit SequenceFile(const std::string& path) : path(path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open sequence file " + path + ": " +
+                                     std::string(strerror(errno)));
+        }
+    }
+
+    ~SequenceFile() {
+        sync();
+        close(fd);
+    }
+
+    SequenceFile(const SequenceFile&) = delete;
+    SequenceFile& operator=(const SequenceFile&) = delete;
+
+    // Counters keyed by topic + '\0' + server; false (and none) if missing or damaged
+    bool load(std::map<std::string, uint64_t>& counters) const {
+        std::string data;
+        char buf[4096];
+        ssize_t n;
+        off_t offset = 0;
+        while ((n = pread(fd, buf, sizeof(buf), offset)) > 0) {
+            data.append(buf, static_cast<size_t>(n));
+            offset += n;
+        }
+
+        size_t sum_at = data.rfind('\n', data.size() > 1 ? data.size() - 2 : 0);
+        if (data.compare(0, 17, "waldo-sequence 1\n") != 0 || sum_at == std::string::npos) {
+            return false;
+        }
+        uint64_t checksum = 0;
+        if (sscanf(data.c_str() + sum_at + 1, "%" SCNx64, &checksum) != 1 ||
+            checksum != fnv1a(data.data(), sum_at + 1)) {
+            return false;
+        }
+
+        std::map<std::string, uint64_t> loaded;
+        size_t pos = 17;
+        while (pos <= sum_at) {
+            size_t eol = data.find('\n', pos);
+            std::string line = data.substr(pos, eol - pos);
+            pos = eol + 1;
+            size_t tab1 = line.find('\t');
+            size_t tab2 = tab1 == std::string::npos ? tab1 : line.find('\t', tab1 + 1);
+            if (tab2 == std::string::npos) {
+                continue;
+            }
+            std::string key = line.substr(tab1 + 1, tab2 - tab1 - 1) + '\0' + line.substr(tab2 + 1);
+            loaded[key] = strtoull(line.c_str(), nullptr, 10);
+        }
+        counters.swap(loaded);
+        return true;
+    }
+
+    void store(const std::map<std::string, uint64_t>& counters) {
+        std::string data = "waldo-sequence 1\n";
+        for (const auto& entry : counters) {
+            size_t split = entry.first.find('\0');
+            data += std::to_string(entry.second) + '\t' + entry.first.substr(0, split) + '\t' +
+                    entry.first.substr(split + 1) + '\n';
+        }
+        char sum[24];
+        snprintf(sum, sizeof(sum), "%016" PRIx64 "\n", fnv1a(data.data(), data.size()));
+        data += sum;
+
+        if (pwrite(fd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()) &&
+            ftruncate(fd, static_cast<off_t>(data.size())) == 0) {
+            writes++;
+            dirty = true;
+        }
+        if (dirty && std::chrono::steady_clock::now() - last_sync >=
+                         std::chrono::milliseconds(SYNC_INTERVAL_MS)) {
+            sync();
+        }
+    }
+
+    void sync() {
+        if (!dirty) {
+            return;
+        }
+#if defined(__APPLE__)
+        fsync(fd);
+#else
+        fdatasync(fd);
+#endif
+        dirty = false;
+        last_sync = std::chrono::steady_clock::now();
+    }
+
+    uint64_t write_count() const {
+        return writes;
+    }
+
+private:
+    std::string path;
+    int fd = -1;
+    bool dirty = false;
+    uint64_t writes = 0;
+    std::chrono::steady_clock::time_point last_sync{};
+};
+
+/**
+ * Publisher side: adds "source" and the next "seq" to each payload and
+ * remembers the last one per topic and server to answer state requests.
+ * Not thread-safe; NanoMQTTClient serialises it with the send.
+ */
+class SequenceStamper {
+public:
+    // An empty state_path keeps the counters in memory only
+    explicit SequenceStamper(const std::string& source, const std::string& state_path = "")
+        : source(source) {
+        if (source.empty()) {
+            throw std::runtime_error("Sequence numbers need a source name");
+        }
+        if (!state_path.empty()) {
+            file.reset(new SequenceFile(state_path));
+            std::map<std::string, uint64_t> saved;
+            if (file->load(saved)) {
+                for (const auto& entry : saved) {
+                    counters[entry.first].seq = entry.second;
+                }
+            }
+        }
+    }
+
+    /**
+     * payload with "source" and the next "seq" added; unchanged if it is not
+     * a JSON object. A retry of a payload whose send failed (see sent())
+     * keeps its seq, so it stays one event for every subscriber.
+     */
+    std::string stamp(const std::string& topic, const std::string& payload) {
+        std::string server;
+        json_string_field(payload, "server", server);
+        const std::string key = topic + '\0' + server;
+        auto found = counters.find(key);
+        if (found != counters.end() && !found->second.sent && found->second.last_raw == payload) {
+            return found->second.last_payload;
+        }
+        uint64_t seq = (found == counters.end() ? 0 : found->second.seq) + 1;
+        std::string stamped = json_append_fields(
+            payload, ", \"source\": \"" + json_escape(source) + "\", \"seq\": " + std::to_string(seq));
+        if (stamped.empty()) {
+            return payload;
+        }
+        Counter& counter = counters[key];
+        counter.seq = seq;
+        counter.last_raw = payload;
+        counter.last_payload = stamped;
+        counter.sent = false;
+        counter.order = ++stamps;
+        if (file) {
+            std::map<std::string, uint64_t> snapshot;
+            for (const auto& entry : counters) {
+                snapshot[entry.first] = entry.second.seq;
+            }
+            file->store(snapshot);
+        }
+        return stamped;
+    }
+
+    // The last payload stamped for topic and its server reached the broker
+    void sent(const std::string& topic, const std::string& stamped) {
+        std::string server;
+        json_string_field(stamped, "server", server);
+        auto found = counters.find(topic + '\0' + server);
+        if (found != counters.end() && found->second.last_payload == stamped) {
+            found->second.sent = true;
+            found->second.last_raw.clear();
+        }
+    }
+
+    /**
+     * Replies to a state request for topic: the last payload published per
+     * server, marked `"state": true`. A request naming another source gets
+     * none; one naming a server gets only that server's.
+     */
+    std::vector<std::string> state_replies(const std::string& topic, const std::string& request) const {
+        std::string wanted_source, wanted_server;
+        if (json_string_field(request, "source", wanted_source) && !wanted_source.empty() &&
+            wanted_source != source) {
+            return {};
+        }
+        bool one_server = json_string_field(request, "server", wanted_server);
+
+        std::vector<std::string> replies;
+        const std::string prefix = topic + '\0';
+        for (auto it = counters.lower_bound(prefix); it != counters.end(); ++it) {
+            if (it->first.compare(0, prefix.size(), prefix) != 0) {
+                break;
+            }
+            if (it->second.last_payload.empty() ||
+                (one_server && it->first.compare(prefix.size(), std::string::npos, wanted_server) != 0)) {
+                continue;
+            }
+            replies.push_back(json_append_fields(it->second.last_payload, ", \"state\": true"));
+        }
+        return replies;
+    }
+
+    /**
+     * The payload stamped most recently for topic, from any server or (if
+     * the query names one) from the query's "server"; empty if none.
+     */
+    std::string latest_state(const std::string& topic, const std::string& query) const {
+        std::string wanted_server;
+        bool one_server = json_string_field(query, "server", wanted_server);
+
+        const Counter* newest = nullptr;
+        const std::string prefix = topic + '\0';
+        for (auto it = counters.lower_bound(prefix); it != counters.end(); ++it) {
+            if (it->first.compare(0, prefix.size(), prefix) != 0) {
+                break;
+            }
+            if (it->second.last_payload.empty() ||
+                (one_server && it->first.compare(prefix.size(), std::string::npos, wanted_server) != 0)) {
+                continue;
+            }
+            if (!newest || it->second.order > newest->order) {
+                newest = &it->second;
+            }
+        }
+        return newest ? newest->last_payload : std::string();
+    }
+
+    const std::string& source_name() const {
+        return source;
+    }
+
+    uint64_t file_writes() const {
+        return file ? file->write_count() : 0;
+    }
+
+private:
+    struct Counter {
+        uint64_t seq = 0;
+        std::string last_raw;       // before stamping, kept until it is sent
+        std::string last_payload;
+        bool sent = false;
+        uint64_t order = 0;         // stamps before this one, to tell the newest apart
+    };
+
+    std::string source;
+    std::map<std::string, Counter> counters;
+    uint64_t stamps = 0;
+    std::unique_ptr<SequenceFile> file;
+};
+
+enum class SequenceVerdict : uint8_t {
+    Untracked,
+    InOrder,
+    Gap,
+    Duplicate,
+    Late,
+    Reset,
+    Current,
+};
+
+// Subscriber side; not thread-safe (NanoMQTTClient checks under callback_mutex)
+class SequenceTracker {
+public:
+    SequenceVerdict check(const std::string& topic, const std::string& payload) {
+        uint64_t seq;
+        std::string source;
+        if (!json_uint_field(payload, "seq", seq) || !json_string_field(payload, "source", source)) {
+            return SequenceVerdict::Untracked;
+        }
+        std::string server;
+        json_string_field(payload, "server", server);
+        bool state_reply = json_true_field(payload, "state");
+
+        auto found = sources.find(topic + '\0' + source + '\0' + server);
+        if (found == sources.end()) {
+            sources[topic + '\0' + source + '\0' + server] = Window{seq, 1};
+            return SequenceVerdict::InOrder;
+        }
+        Window& window = found->second;
+
+        if (seq > window.newest) {
+            uint64_t skipped = seq - window.newest - 1;
+            window.seen = skipped + 1 >= SEQUENCE_WINDOW ? 1 : (window.seen << (skipped + 1)) | 1;
+            window.newest = seq;
+            if (skipped == 0) {
+                return SequenceVerdict::InOrder;
+            }
+            gaps++;
+            missed += skipped;
+            return SequenceVerdict::Gap;
+        }
+        if (seq == 1 && window.newest > 1 && !state_reply) {
+            window = Window{1, 1};
+            resets++;
+            return SequenceVerdict::Reset;
+        }
+        if (state_reply) {
+            return SequenceVerdict::Current;
+        }
+
+        uint64_t behind = window.newest - seq;
+        if (behind >= SEQUENCE_WINDOW || (window.seen >> behind) & 1) {
+            duplicates++;
+            return SequenceVerdict::Duplicate;
+        }
+        window.seen |= uint64_t(1) << behind;
+        late++;
+        if (missed > 0) {
+            missed--;
+        }
+        return SequenceVerdict::Late;
+    }
+
+    std::map<std::string, uint64_t> stats() const {
+        return {
+            {"seq_sources", sources.size()},
+            {"seq_gaps", gaps},
+            {"seq_missed", missed},
+            {"seq_duplicates", duplicates},
+            {"seq_late", late},
+            {"seq_resets", resets},
+        };
+    }
+
+private:
+    // Newest seq and a bitmap of which of the SEQUENCE_WINDOW before it were seen (bit 0: newest)
+    struct Window {
+        uint64_t newest;
+        uint64_t seen;
+    };
+
+    std::map<std::string, Window> sources;
+    uint64_t gaps = 0;
+    uint64_t missed = 0;
+    uint64_t duplicates = 0;
+    uint64_t late = 0;
+    uint64_t resets = 0;
+};
+
+}  // namespace native
@@ -0,0 +1,111 @@
+/**
+ * Last-value cache of the current desktop
+ *
+ * found-him used to know nothing after starting or reconnecting until the
+ * next switch, which can be hours away. The client now files every switch
+ * it accepts here, per topic, source and server. With retained publishing
+ * (NanoMQTTClient::set_retained_topic) the broker hands the last switch to
+ * every new subscription, so the cache is filled as soon as the SUBACK
+ * completes. Lookups are answered from memory.
+ *
+ * Thread-safe: the receive thread updates it while callers read. The lock
+ * is held only to copy an entry, never across a callback.
+ */
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include "payloads.h"
+
+namespace native {
+
+struct DesktopState {
+    std::string topic;
+    std::string source;         // publisher's "source", empty if unstamped
+    std::string server;         // "server" field, empty for a single server
+    std::string desktop;
+    std::string timestamp;      // as published
+    uint64_t seq = 0;           // 0 if unstamped
+    bool retained = false;      // delivered from the broker's retained message
+    std::chrono::steady_clock::time_point updated;
+};
+
+// The switch in payload, received now; false if it has no "current_desktop"
+inline bool parse_desktop_state(const std::string& topic, const std::string& payload, bool retained,
+                                DesktopState& state) {
+    if (!json_string_field(payload, "current_desktop", state.desktop)) {
+        return false;
+    }
+    state.topic = topic;
+    json_string_field(payload, "source", state.source);
+    json_string_field(payload, "server", state.server);
+    json_string_field(payload, "timestamp", state.timestamp);
+    json_uint_field(payload, "seq", state.seq);
+    state.retained = retained;
+    state.updated = std::chrono::steady_clock::now();
+    return true;
+}
+
+class StateCache {
+public:
+    // File a switch; false if the payload has no "current_desktop"
+    bool update(const std::string& topic, const std::string& payload, bool retained) {
+        DesktopState state;
+        if (!parse_desktop_state(topic, payload, retained, state)) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        states[topic + '\0' + state.source + '\0' + state.server] = std::move(state);
+        updates++;
+        return true;
+    }
+
+    /**
+     * The most recently received state, from any server or (with
+     * any_server false) from `server` only. False if there is none yet.
+     */
+    bool latest(DesktopState& out, bool any_server = true, const std::string& server = "") const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const DesktopState* newest = nullptr;
+        for (const auto& entry : states) {
+            if ((any_server || entry.second.server == server) &&
+                (!newest || entry.second.updated > newest->updated)) {
+                newest = &entry.second;
+            }
+        }
+        if (!newest) {
+            return false;
+        }
+        out = *newest;
+        return true;
+    }
+
+    std::vector<DesktopState> all() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<DesktopState> copy;
+        copy.reserve(states.size());
+        for (const auto& entry : states) {
+            copy.push_back(entry.second);
+        }
+        return copy;
+    }
+
+    uint64_t update_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return updates;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, DesktopState> states;
+    uint64_t updates = 0;
+};
+
+}  // namespace native
@@ -0,0 +1,289 @@
+/**
+ * Current desktop in a shared-memory page
+ *
+ * Shell prompts, status bars and scripts ask "which desktop is active?"
+ * many times a second. A subscriber that keeps a StatePageWriter copies
+ * every state it files (native/state_cache.h) into a small POSIX shared
+ * memory object (/dev/shm/<name> on Linux). StatePageReader maps the same
+ * object read-only and answers from it: no broker, no locks, no syscalls
+ * after the first open.
+ *
+ * The page is guarded by a seqlock. The writer makes `sequence` odd,
+ * rewrites the fields and makes it even again; a reader copies the fields
+ * and retries if `sequence` was odd or changed meanwhile. Readers never
+ * block the writer, and a reader that dies mid-read leaves nothing behind.
+ *
+ * A seqlock allows one writer. Subscribers on the same machine (several
+ * found-him instances, say) share a page name by default, so a writer
+ * takes an flock() on the object and only writes while it holds it; the
+ * others try again with each update and take over once the holder exits.
+ * The page is left in place on exit, so readers still see the last state
+ * and its age.
+ */
+
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "state_cache.h"
+
+namespace native {
+
+// Shared memory object name (shm_open) used when none is configured
+static const char* const DEFAULT_STATE_PAGE = "/synergy-desktop";
+
+// Reader retries before giving up on a page that keeps changing under it
+static const int STATE_PAGE_READ_ATTEMPTS = 1000;
+
+static const uint32_t STATE_PAGE_MAGIC = 0x4b534453;  // "SDSK"
+static const uint32_t STATE_PAGE_VERSION = 1;
+
+// Fixed layout shared between processes; strings are NUL-terminated and truncated to fit
+struct StatePageLayout {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint64_t> sequence;     // odd while the writer is mid-update
+    uint64_t updates;                   // states written since the page was created
+    int64_t updated_us;                 // system clock, microseconds since the epoch
+    uint64_t seq;                       // publisher's sequence number, 0 if unstamped
+    uint32_t writer_pid;
+    uint8_t retained;
+    char desktop[128];
+    char server[64];
+    char source[64];
+    char timestamp[40];
+    char topic[128];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the seqlock needs a lock-free 64-bit atomic");
+
+// What a reader gets back: the page's fields at one consistent point
+struct StatePageSnapshot {
+    std::string desktop;
+    std::string server;
+    std::string source;
+    std::string timestamp;
+    std::string topic;
+    uint64_t seq = 0;
+    uint64_t updates = 0;
+    int64_t updated_us = 0;
+    uint32_t writer_pid = 0;
+    bool retained = false;
+};
+
+// Valid shm_open() names: one leading slash, no others, not just "/"
+inline bool is_state_page_name(const std::string& name) {
+    return name.size() > 1 && name.size() < 255 && name[0] == '/' && name.find('/', 1) == std::string::npos;
+}
+
+class StatePageWriter {
+public:
+    explicit StatePageWriter(const std::string& name) : name(name) {
+        if (!is_state_page_name(name)) {
+            throw std::runtime_error("Invalid state page name " + name + ": must be /NAME");
+        }
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open state page " + name + ": " + std::string(strerror(errno)));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 ||
+            (static_cast<size_t>(st.st_size) < sizeof(StatePageLayout) &&
+             ftruncate(fd, sizeof(StatePageLayout)) != 0)) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Failed to size state page " + name + ": " + std::string(strerror(err)));
+        }
+        void* mapped = mmap(nullptr, sizeof(StatePageLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Failed to map state page " + name + ": " + std::string(strerror(err)));
+        }
+        page = static_cast<StatePageLayout*>(mapped);
+    }
+
+    ~StatePageWriter() {
+        munmap(page, sizeof(StatePageLayout));
+        close(fd);  // releases the flock
+    }
+
+    StatePageWriter(const StatePageWriter&) = delete;
+    StatePageWriter& operator=(const StatePageWriter&) = delete;
+
+    // Publish state to readers; false while another writer holds the page
+    bool write(const DesktopState& state) {
+        if (!owner && !take_ownership()) {
+            return false;
+        }
+        uint64_t sequence = page->sequence.load(std::memory_order_relaxed);
+        page->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        page->updates++;
+        page->updated_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+        page->seq = state.seq;
+        page->writer_pid = static_cast<uint32_t>(getpid());
+        page->retained = state.retained ? 1 : 0;
+        copy_field(page->desktop, sizeof(page->desktop), state.desktop);
+        copy_field(page->server, sizeof(page->server), state.server);
+        copy_field(page->source, sizeof(page->source), state.source);
+        copy_field(page->timestamp, sizeof(page->timestamp), state.timestamp);
+        copy_field(page->topic, sizeof(page->topic), state.topic);
+
+        page->sequence.store(sequence + 2, std::memory_order_release);
+        writes++;
+        return true;
+    }
+
+    const std::string& page_name() const {
+        return name;
+    }
+
+    bool is_owner() const {
+        return owner;
+    }
+
+    uint64_t write_count() const {
+        return writes;
+    }
+
+private:
+    bool take_ownership() {
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            return false;
+        }
+        owner = true;
+        // A page from another version (or a fresh one) is laid out again; a
+        // writer that died mid-update leaves sequence odd, so round it up
+        if (page->magic != STATE_PAGE_MAGIC || page->version != STATE_PAGE_VERSION) {
+            page->sequence.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            page->updates = 0;
+            page->magic = STATE_PAGE_MAGIC;
+            page->version = STATE_PAGE_VERSION;
+            page->sequence.store(2, std::memory_order_release);
+        } else if (page->sequence.load(std::memory_order_relaxed) & 1) {
+            page->sequence.fetch_add(1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    static void copy_field(char* field, size_t size, const std::string& value) {
+        size_t n = value.size() < size - 1 ? value.size() : size - 1;
+        memcpy(field, value.data(), n);
+        memset(field + n, 0, size - n);
+    }
+
+    std::string name;
+    int fd = -1;
+    StatePageLayout* page = nullptr;
+    bool owner = false;
+    uint64_t writes = 0;
+};
+
+class StatePageReader {
+public:
+    // Throws if the page does not exist (no subscriber has written one) or is not a state page
+    explicit StatePageReader(const std::string& name = DEFAULT_STATE_PAGE) : name(name) {
+        if (!is_state_page_name(name)) {
+            throw std::runtime_error("Invalid state page name " + name + ": must be /NAME");
+        }
+        int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open state page " + name + ": " + std::string(strerror(errno)));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(StatePageLayout)) {
+            close(fd);
+            throw std::runtime_error("State page " + name + " is not initialised");
+        }
+        void* mapped = mmap(nullptr, sizeof(StatePageLayout), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Failed to map state page " + name + ": " + std::string(strerror(errno)));
+        }
+        page = static_cast<const StatePageLayout*>(mapped);
+    }
+
+    ~StatePageReader() {
+        munmap(const_cast<StatePageLayout*>(page), sizeof(StatePageLayout));
+    }
+
+    StatePageReader(const StatePageReader&) = delete;
+    StatePageReader& operator=(const StatePageReader&) = delete;
+
+    /**
+     * Consistent copy of the page; false if nothing was written yet, the
+     * page is from another version, or it kept changing for
+     * STATE_PAGE_READ_ATTEMPTS tries.
+     */
+    bool read(StatePageSnapshot& out) const {
+        StatePageLayout copy;
+        for (int attempt = 0; attempt < STATE_PAGE_READ_ATTEMPTS; attempt++) {
+            uint64_t before = page->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            copy.magic = page->magic;
+            copy.version = page->version;
+            copy.updates = page->updates;
+            copy.updated_us = page->updated_us;
+            copy.seq = page->seq;
+            copy.writer_pid = page->writer_pid;
+            copy.retained = page->retained;
+            memcpy(copy.desktop, page->desktop, sizeof(copy.desktop));
+            memcpy(copy.server, page->server, sizeof(copy.server));
+            memcpy(copy.source, page->source, sizeof(copy.source));
+            memcpy(copy.timestamp, page->timestamp, sizeof(copy.timestamp));
+            memcpy(copy.topic, page->topic, sizeof(copy.topic));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (page->sequence.load(std::memory_order_relaxed) != before) {
+                continue;
+            }
+
+            if (copy.magic != STATE_PAGE_MAGIC || copy.version != STATE_PAGE_VERSION || copy.updates == 0) {
+                return false;
+            }
+            out.desktop = field(copy.desktop, sizeof(copy.desktop));
+            out.server = field(copy.server, sizeof(copy.server));
+            out.source = field(copy.source, sizeof(copy.source));
+            out.timestamp = field(copy.timestamp, sizeof(copy.timestamp));
+            out.topic = field(copy.topic, sizeof(copy.topic));
+            out.seq = copy.seq;
+            out.updates = copy.updates;
+            out.updated_us = copy.updated_us;
+            out.writer_pid = copy.writer_pid;
+            out.retained = copy.retained != 0;
+            return true;
+        }
+        return false;
+    }
+
+    const std::string& page_name() const {
+        return name;
+    }
+
+private:
+    static std::string field(const char* data, size_t size) {
+        return std::string(data, strnlen(data, size));
+    }
+
+    std::string name;
+    const StatePageLayout* page = nullptr;
+};
+
+}  // namespace native
@@ -0,0 +1,276 @@
+/**
+ * Switch log publisher
+ *
+ * Glue between the log follower, the event parser, the flap filter and an
+ * MQTT client: the piece that turns Synergy log writes into published
+ * switches, shared by the Python bindings and synergy-monitord.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <stdexcept>
+
+#include "event_parser.h"
+#include "flap_filter.h"
+#include "log_follower.h"
+#include "mqtt_client.h"
+#include "payloads.h"
+
+namespace native {
+
+/**
+ * Follows Synergy logs natively and turns switch lines into events.
+ * 
+ * With start_publishing() the event is published from the follower thread
+ * itself, so a log write reaches the broker without a tail process, a pipe
+ * or the Python interpreter in between; Python only hears about it
+ * afterwards through the optional callback.
+ * 
+ * Several logs (one per Synergy server) can be followed by the same thread
+ * and published through the same client. Events from a log added with a
+ * server name carry it in the payload's "server" field.
+ * 
+ * Lines are parsed by the table-driven event parser, so client connects,
+ * disconnects and clipboard updates are recognised in the same pass. They
+ * are counted, and published to a separate events topic when one is set.
+ * 
+ * Each event is committed to the checkpoint, if enabled, once it has been
+ * handed to the client, so a restart neither publishes it again nor skips
+ * the ones after it.
+ * 
+ * With flap suppression enabled, each log's switches pass through a
+ * FlapFilter (native/flap_filter.h): clean switches are published at once,
+ * edge-riding bursts are held back until the pointer settles, and the
+ * follower thread wakes at the settle deadline to publish the final screen.
+ */
+class SwitchLogFollower {
+public:
+    using EventCallback = std::function<void(const std::string&, bool, const std::string&)>;
+    
+    SwitchLogFollower() = default;
+    
+    SwitchLogFollower(const std::string& path, bool start_at_end = true) {
+        add_log(path, "", start_at_end, "");
+    }
+    
+    ~SwitchLogFollower() {
+        // Before the members the follower thread uses are destroyed
+        follower.stop();
+    }
+    
+    size_t add_log(const std::string& path, const std::string& server, bool start_at_end,
+                   const std::string& checkpoint_path) {
+        size_t index = follower.add_source(path, start_at_end);
+        if (!checkpoint_path.empty()) {
+            follower.enable_checkpoint(checkpoint_path, index);
+        }
+        servers.push_back(server);
+        return index;
+    }
+    
+    /**
+     * Suppress switch flapping: rapid reversals within dwell_ms beyond
+     * `hysteresis` per burst are held back until the pointer settles. With
+     * report, "flapping"/"settled" status events go to the events topic.
+     * Call before starting; dwell_ms <= 0 disables.
+     */
+    void enable_flap_filter(int dwell_ms, int hysteresis, bool report) {
+        if (follower.is_running()) {
+            throw std::runtime_error("Flap filter must be enabled before the follower starts");
+        }
+        flap_dwell_ms = dwell_ms;
+        flap_hysteresis = hysteresis;
+        report_flapping = report;
+    }
+    
+    void start(EventCallback callback) {
+        start_publishing(nullptr, "", 0, callback);
+    }
+    
+    void start_publishing(NanoMQTTClient* target, const std::string& publish_topic, int qos,
+                          EventCallback callback) {
+        if (follower.is_running()) {
+            throw std::runtime_error("Log follower already started");
+        }
+        client = target;
+        set_topic(publish_topic);
+        publish_qos = qos;
+        on_event = callback;
+        flap_filters.clear();
+        if (flap_dwell_ms > 0) {
+            flap_filters.assign(servers.size(), native::FlapFilter(flap_dwell_ms, flap_hysteresis));
+            follower.set_tick_handler([this]() { settle_flaps(); });
+        }
+        follower.start([this](size_t source, const char* data, size_t len) {
+            handle_chunk(source, data, len);
+        });
+    }
+    
+    // Checkpoint for the first log, for single-log use
+    void enable_checkpoint(const std::string& checkpoint_path) {
+        follower.enable_checkpoint(checkpoint_path);
+    }
+    
+    void set_topic(const std::string& publish_topic) {
+        std::lock_guard<std::mutex> lock(topic_mutex);
+        topic = publish_topic;
+    }
+    
+    // Topic for connect/disconnect/clipboard records; empty only counts them
+    void set_events_topic(const std::string& publish_topic) {
+        std::lock_guard<std::mutex> lock(topic_mutex);
+        events_topic = publish_topic;
+    }
+    
+    void stop() {
+        follower.stop();
+    }
+    
+    bool is_running() const {
+        return follower.is_running();
+    }
+    
+    std::map<std::string, uint64_t> stats() const {
+        std::map<std::string, uint64_t> result = follower.stats();
+        result["events"] = events.load();
+        result["connects"] = record_counts[static_cast<size_t>(native::EventKind::Connect)].load();
+        result["disconnects"] = record_counts[static_cast<size_t>(native::EventKind::Disconnect)].load();
+        result["clipboards"] = record_counts[static_cast<size_t>(native::EventKind::Clipboard)].load();
+        result["publish_failures"] = publish_failures.load();
+        result["flaps_suppressed"] = flaps_suppressed.load();
+        result["flap_bursts"] = flap_bursts.load();
+        return result;
+    }
+    
+    std::map<std::string, uint64_t> log_stats(size_t index) const {
+        return follower.source_stats(index);
+    }
+    
+private:
+    native::LogFollower follower;
+    std::vector<std::string> servers;
+    NanoMQTTClient* client = nullptr;
+    std::mutex topic_mutex;
+    std::string topic;
+    std::string events_topic;
+    int publish_qos = 0;
+    EventCallback on_event;
+    
+    // One filter per log, used only on the follower thread
+    std::vector<native::FlapFilter> flap_filters;
+    int flap_dwell_ms = 0;
+    int flap_hysteresis = 0;
+    bool report_flapping = false;
+    
+    std::atomic<uint64_t> events{0};
+    std::atomic<uint64_t> record_counts[4] = {};
+    std::atomic<uint64_t> publish_failures{0};
+    std::atomic<uint64_t> flaps_suppressed{0};
+    std::atomic<uint64_t> flap_bursts{0};
+    
+    void handle_chunk(size_t source, const char* data, size_t len) {
+        const std::string& server = servers[source];
+        native::default_event_parser().parse(data, len, [this, source, &server](const native::LogRecord& record) {
+            if (record.kind == native::EventKind::Switch) {
+                handle_event(source, std::string(record.screen, record.desktop_len));
+            } else {
+                handle_record(record, server);
+            }
+            follower.commit_event(record.line_end);
+        });
+    }
+    
+    void handle_record(const native::LogRecord& record, const std::string& server) {
+        record_counts[static_cast<size_t>(record.kind)].fetch_add(1);
+        
+        std::string publish_topic;
+        {
+            std::lock_guard<std::mutex> lock(topic_mutex);
+            publish_topic = events_topic;
+        }
+        if (client && !publish_topic.empty()) {
+            if (!client->publish(publish_topic, log_record_payload(record, server), publish_qos)) {
+                publish_failures.fetch_add(1);
+            }
+        }
+    }
+    
+    void handle_event(size_t source, const std::string& desktop) {
+        events.fetch_add(1);
+        
+        if (!flap_filters.empty()) {
+            native::FlapFilter& filter = flap_filters[source];
+            native::FlapAction action = filter.on_switch(desktop, std::chrono::steady_clock::now());
+            if (action != native::FlapAction::Publish) {
+                flaps_suppressed.fetch_add(1);
+                if (action == native::FlapAction::StartFlapping) {
+                    flap_bursts.fetch_add(1);
+                    publish_flap_status("flapping", filter, servers[source]);
+                }
+                follower.wake_at(filter.deadline());
+                return;
+            }
+        }
+        publish_switch(desktop, servers[source]);
+    }
+    
+    // Tick handler: publish where settled bursts ended, re-arm for the rest
+    void settle_flaps() {
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < flap_filters.size(); i++) {
+            native::FlapFilter& filter = flap_filters[i];
+            std::string desktop;
+            if (filter.poll(now, desktop)) {
+                if (!desktop.empty()) {
+                    publish_switch(desktop, servers[i]);
+                }
+                publish_flap_status("settled", filter, servers[i]);
+            } else if (filter.is_flapping()) {
+                follower.wake_at(filter.deadline());
+            }
+        }
+    }
+    
+    void publish_flap_status(const char* status, const native::FlapFilter& filter, const std::string& server) {
+        if (!report_flapping || !client) {
+            return;
+        }
+        std::string publish_topic;
+        {
+            std::lock_guard<std::mutex> lock(topic_mutex);
+            publish_topic = events_topic;
+        }
+        if (!publish_topic.empty() &&
+            !client->publish(publish_topic, flap_status_payload(status, filter, server), publish_qos)) {
+            publish_failures.fetch_add(1);
+        }
+    }
+    
+    void publish_switch(const std::string& desktop, const std::string& server) {
+        bool published = false;
+        if (client) {
+            std::string publish_topic;
+            {
+                std::lock_guard<std::mutex> lock(topic_mutex);
+                publish_topic = topic;
+            }
+            published = client->publish(publish_topic, switch_event_payload(desktop, server), publish_qos);
+            if (!published) {
+                publish_failures.fetch_add(1);
+            }
+        }
+        
+        if (on_event) {
+            on_event(desktop, published, server);
+        }
+    }
+};
+
+}  // namespace native
@@ -0,0 +1,256 @@
+/**
+ * Synergy switch-event scanner
+ *
+ * Finds desktop switch lines in a buffer of log text without splitting it
+ * into lines first. The buffer is searched for the `switch from "` marker
+ * with SIMD compares (AVX2 or SSE2 on x86-64, NEON on ARM64, memchr
+ * elsewhere), and only the lines containing it are parsed. Every other
+ * line is skipped at memory speed.
+ *
+ * A line is a switch event only if it matches the grammar exactly:
+ *
+ *     ... switch from "<from>" to "<to>"[ ...]
+ *
+ * with non-empty quoted names and the closing quote at the end of the line
+ * or followed by a space (Synergy appends " at x,y"). Synergy's trailing
+ * "-xxxxxxxx" hex hash is stripped from the target name.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NANOMQ_SCAN_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NANOMQ_SCAN_NEON 1
+#endif
+
+namespace native {
+
+static const char SWITCH_MARKER[] = "switch from \"";
+static const size_t SWITCH_MARKER_LEN = sizeof(SWITCH_MARKER) - 1;
+static const char SWITCH_SEPARATOR[] = "\" to \"";
+static const size_t SWITCH_SEPARATOR_LEN = sizeof(SWITCH_SEPARATOR) - 1;
+static const size_t SWITCH_HASH_SUFFIX_LEN = 9;   // "-" + 8 lowercase hex digits
+
+struct SwitchEvent {
+    const char* from;
+    size_t from_len;
+    const char* to;             // target name as logged
+    size_t to_len;
+    size_t desktop_len;         // length of `to` without the hash suffix
+    size_t line_end;            // buffer offset just past the event's line
+};
+
+inline bool is_lower_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+}
+
+// "studio-77773e4b" -> "studio"
+inline size_t strip_hash_suffix(const char* name, size_t len) {
+    if (len < SWITCH_HASH_SUFFIX_LEN || name[len - SWITCH_HASH_SUFFIX_LEN] != '-') {
+        return len;
+    }
+    for (size_t i = len - SWITCH_HASH_SUFFIX_LEN + 1; i < len; i++) {
+        if (!is_lower_hex(name[i])) {
+            return len;
+        }
+    }
+    return len - SWITCH_HASH_SUFFIX_LEN;
+}
+
+inline bool marker_at(const char* p) {
+    return memcmp(p + 1, SWITCH_MARKER + 1, SWITCH_MARKER_LEN - 2) == 0;
+}
+
+inline const char* find_marker_scalar(const char* p, const char* end) {
+    while (static_cast<size_t>(end - p) >= SWITCH_MARKER_LEN) {
+        p = static_cast<const char*>(memchr(p, 's', end - p - SWITCH_MARKER_LEN + 1));
+        if (!p) {
+            return nullptr;
+        }
+        if (p[SWITCH_MARKER_LEN - 1] == '"' && marker_at(p)) {
+            return p;
+        }
+        p++;
+    }
+    return nullptr;
+}
+
+/*
+ * Vector search: compare a block against the marker's first character and
+ * the block shifted by the marker length against its last character. Only
+ * positions where both match are verified with memcmp, which for log text
+ * is rarely more than the real markers.
+ */
+#if defined(NANOMQ_SCAN_X86)
+__attribute__((target("avx2")))
+inline const char* find_marker_avx2(const char* p, const char* end) {
+    const __m256i first = _mm256_set1_epi8('s');
+    const __m256i last = _mm256_set1_epi8('"');
+    while (static_cast<size_t>(end - p) >= 32 + SWITCH_MARKER_LEN - 1) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + SWITCH_MARKER_LEN - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (marker_at(p + bit)) {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+    return find_marker_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+inline const char* find_marker_sse2(const char* p, const char* end) {
+    const __m128i first = _mm_set1_epi8('s');
+    const __m128i last = _mm_set1_epi8('"');
+    while (static_cast<size_t>(end - p) >= 16 + SWITCH_MARKER_LEN - 1) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + SWITCH_MARKER_LEN - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (marker_at(p + bit)) {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+    return find_marker_scalar(p, end);
+}
+
+inline bool have_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#elif defined(NANOMQ_SCAN_NEON)
+inline const char* find_marker_neon(const char* p, const char* end) {
+    const uint8x16_t first = vdupq_n_u8('s');
+    const uint8x16_t last = vdupq_n_u8('"');
+    while (static_cast<size_t>(end - p) >= 16 + SWITCH_MARKER_LEN - 1) {
+        uint8x16_t head = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        uint8x16_t tail = vld1q_u8(reinterpret_cast<const uint8_t*>(p + SWITCH_MARKER_LEN - 1));
+        uint8x16_t eq = vandq_u8(vceqq_u8(head, first), vceqq_u8(tail, last));
+        // Narrow to 4 bits per byte to get a scalar mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask) {
+            int bit = __builtin_ctzll(mask) >> 2;
+            if (marker_at(p + bit)) {
+                return p + bit;
+            }
+            mask &= ~(0xFULL << (bit * 4));
+        }
+        p += 16;
+    }
+    return find_marker_scalar(p, end);
+}
+#endif
+
+inline const char* find_marker(const char* p, const char* end) {
+#if defined(NANOMQ_SCAN_X86)
+    return have_avx2() ? find_marker_avx2(p, end) : find_marker_sse2(p, end);
+#elif defined(NANOMQ_SCAN_NEON)
+    return find_marker_neon(p, end);
+#else
+    return find_marker_scalar(p, end);
+#endif
+}
+
+inline const char* scan_kernel_name() {
+#if defined(NANOMQ_SCAN_X86)
+    return have_avx2() ? "avx2" : "sse2";
+#elif defined(NANOMQ_SCAN_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// Parse the rest of a line that starts with the marker
+inline bool parse_switch(const char* marker, const char* line_end, SwitchEvent& event) {
+    const char* from = marker + SWITCH_MARKER_LEN;
+    const char* from_end = static_cast<const char*>(memchr(from, '"', line_end - from));
+    if (!from_end || from_end == from) {
+        return false;
+    }
+    if (static_cast<size_t>(line_end - from_end) < SWITCH_SEPARATOR_LEN ||
+        memcmp(from_end, SWITCH_SEPARATOR, SWITCH_SEPARATOR_LEN) != 0) {
+        return false;
+    }
+
+    const char* to = from_end + SWITCH_SEPARATOR_LEN;
+    const char* to_end = static_cast<const char*>(memchr(to, '"', line_end - to));
+    if (!to_end || to_end == to) {
+        return false;
+    }
+    const char* after = to_end + 1;
+    if (after != line_end && *after != ' ' && *after != '\r') {
+        return false;
+    }
+
+    event.from = from;
+    event.from_len = from_end - from;
+    event.to = to;
+    event.to_len = to_end - to;
+    event.desktop_len = strip_hash_suffix(to, event.to_len);
+    return true;
+}
+
+/**
+ * Call on_event(const SwitchEvent&) for every switch line in the buffer, in
+ * order, at most once per line.
+ *
+ * A trailing line without a newline is only considered when `final` is set
+ * (end of input); otherwise it is left for the caller to complete. Returns
+ * the number of bytes fully scanned, i.e. up to the end of the last
+ * complete line (or everything when `final`).
+ */
+template <class Handler>
+size_t scan_switch_events(const char* data, size_t len, Handler&& on_event, bool final = true) {
+    const char* end = data + len;
+    const char* complete_end = end;
+    if (!final) {
+        complete_end = data;
+        for (const char* q = end; q > data; q--) {
+            if (q[-1] == '\n') {
+                complete_end = q;
+                break;
+            }
+        }
+    }
+
+    const char* p = data;
+    SwitchEvent event;
+    while (p < complete_end) {
+        const char* marker = find_marker(p, complete_end);
+        if (!marker) {
+            break;
+        }
+        const char* nl = static_cast<const char*>(memchr(marker, '\n', complete_end - marker));
+        const char* line_end = nl ? nl : complete_end;
+
+        if (parse_switch(marker, line_end, event)) {
+            event.line_end = (nl ? nl + 1 : complete_end) - data;
+            on_event(static_cast<const SwitchEvent&>(event));
+            p = nl ? nl + 1 : complete_end;
+        } else {
+            p = marker + 1;
+        }
+    }
+    return complete_end - data;
+}
+
+}  // namespace native
@@ -0,0 +1,39 @@
+/**
+ * MQTT topic filters
+ *
+ * Kept apart from the client so tools that never open a connection (the
+ * event ring readers, synergy-events) match topics the same way.
+ */
+
+#pragma once
+
+#include <string>
+#include <algorithm>
+
+namespace native {
+
+// MQTT topic filter match: '+' matches one level, a trailing '#' the rest
+inline bool topic_matches(const std::string& filter, const std::string& topic) {
+    size_t f = 0, t = 0;
+    while (true) {
+        size_t f_end = std::min(filter.find('/', f), filter.size());
+        size_t t_end = std::min(topic.find('/', t), topic.size());
+        if (filter.compare(f, f_end - f, "#") == 0) {
+            return true;
+        }
+        bool wildcard = filter.compare(f, f_end - f, "+") == 0;
+        if (!wildcard && filter.compare(f, f_end - f, topic, t, t_end - t) != 0) {
+            return false;
+        }
+        bool filter_done = f_end == filter.size();
+        bool topic_done = t_end == topic.size();
+        if (filter_done || topic_done) {
+            // "a/#" also matches "a"
+            return filter_done == topic_done || (topic_done && filter.compare(f_end + 1, std::string::npos, "#") == 0);
+        }
+        f = f_end + 1;
+        t = t_end + 1;
+    }
+}
+
+}  // namespace native
@@ -12,6 +12,7 @@ import json
 import logging
 import platform
 import subprocess
+from typing import Optional
 import paho.mqtt.client as mqtt
 from .interface import MQTTPublisherInterface, MQTTSubscriberInterface
 
@@ -200,6 +201,22 @@ class PahoMQTTPublisher(MQTTPublisherInterface):
         if self.client:
             self.client.loop_stop()
             self.client.disconnect()
+    
+    def restart(self) -> bool:
+        """
+        Reconnect in place using paho's own reconnect; on_connect restores
+        the connection state once the broker answers.
+        
+        Returns:
+            bool: True if the reconnect was started, False otherwise
+        """
+        if not self.client:
+            return False
+        try:
+            return self.client.reconnect() == mqtt.MQTT_ERR_SUCCESS
+        except Exception as e:
+            logger.warning(f"In-place restart failed: {e}")
+            return False
 
 
 class PahoMQTTSubscriber(MQTTSubscriberInterface):
@@ -240,8 +257,7 @@ class PahoMQTTSubscriber(MQTTSubscriberInterface):
         self.broker = broker
         self.port = port
         self.topic = topic
-        self.key = key
-        self.value = value
+        self._match = (key, value)
         self.bell_func = bell_func
         self.quiet = quiet
         self.client = None
@@ -250,6 +266,24 @@ class PahoMQTTSubscriber(MQTTSubscriberInterface):
         self.max_reconnect_delay = 60
         self.last_message_time = time.time()
         
+    @property
+    def key(self) -> str:
+        """JSON key to monitor; stored with value as one tuple so both swap together."""
+        return self._match[0]
+    
+    @key.setter
+    def key(self, key: str):
+        self._match = (key, self._match[1])
+    
+    @property
+    def value(self) -> str:
+        """Value to match for the monitored key."""
+        return self._match[1]
+    
+    @value.setter
+    def value(self, value: str):
+        self._match = (self._match[0], value)
+    
     def get_bell_function(self):
         """
         Determine the appropriate bell/beep function based on the operating system.
@@ -309,6 +343,10 @@ class PahoMQTTSubscriber(MQTTSubscriberInterface):
         Parses JSON messages and checks if the configured key matches the
         expected value. Rings the system bell when a match is found.
         
+        The retained message the broker sends on every (re)subscribe and
+        state replies (`"state": true`) are the current state, not a switch
+        happening now, so they never ring the bell.
+        
         Args:
             client: The client instance for this callback
             userdata: The private user data
@@ -317,18 +355,25 @@ class PahoMQTTSubscriber(MQTTSubscriberInterface):
         
         self.last_message_time = time.time()
         
+        if msg.retain:
+            logger.debug(f"Ignoring retained state on {msg.topic}")
+            return
+        
         try:
             # Parse JSON message
             payload = json.loads(msg.payload.decode())
+            if isinstance(payload, dict) and payload.get('state') is True:
+                return
             
             # Check if specified key exists and matches value
-            if self.key in payload and payload[self.key] == self.value:
+            key, value = self._match
+            if key in payload and payload[key] == value:
                 # Ring terminal bell
                 if self.bell_func:
                     self.bell_func()
 
                 if not self.quiet:
-                    print(f"Match found! {self.key} = {payload[self.key]}")
+                    print(f"Match found! {key} = {payload[key]}")
         
         except json.JSONDecodeError:
             logger.debug(f"Failed to parse JSON message: {msg.payload}")
@@ -448,4 +493,51 @@ class PahoMQTTSubscriber(MQTTSubscriberInterface):
         finally:
             if self.client:
                 self.client.loop_stop()
-                self.client.disconnect()
\ No newline at end of file
+                self.client.disconnect()
+    
+    def restart(self) -> bool:
+        """
+        Reconnect in place using paho's own reconnect; on_connect restores
+        the subscription once the broker answers.
+        
+        Returns:
+            bool: True if the reconnect was started, False otherwise
+        """
+        if not self.client:
+            return False
+        try:
+            return self.client.reconnect() == mqtt.MQTT_ERR_SUCCESS
+        except Exception as e:
+            logger.warning(f"In-place restart failed: {e}")
+            return False
+    
+    def reconfigure(self, topic: Optional[str] = None, key: Optional[str] = None,
+                    value: Optional[str] = None) -> bool:
+        """
+        Swap the topic and match target on the live connection.
+        
+        Subscribes to the new topic before unsubscribing from the old one;
+        paho sends both in order on the same connection, so there is no
+        window without a subscription.
+        
+        Args:
+            topic: New topic to subscribe to (None keeps the current one)
+            key: New JSON key to monitor (None keeps the current one)
+            value: New value to match (None keeps the current one)
+            
+        Returns:
+            bool: True if the new settings are in effect, False otherwise
+        """
+        if topic and topic != self.topic:
+            if self.client and self.connected:
+                result, _ = self.client.subscribe(topic, qos=1)
+                if result != mqtt.MQTT_ERR_SUCCESS:
+                    logger.error(f"Failed to subscribe to {topic}")
+                    return False
+                self.client.unsubscribe(self.topic)
+            # on_connect subscribes to self.topic after a reconnect
+            self.topic = topic
+        
+        self._match = (key or self.key, value or self.value)
+        logger.info(f"Reconfigured: topic={self.topic}, {self.key} = {self.value}")
+        return True
@@ -0,0 +1,347 @@
+"""
+Publish stage decoupled from log ingestion.
+
+waldo's reader hands each message to a PublishQueue and goes straight back
+to the log; a worker thread publishes from a bounded queue. A failed
+publish is retried on a schedule (2s, then 4s, as waldo did inline) while
+new messages keep flowing, so a misbehaving broker never stalls reading or
+backs up the `tail -F` pipe.
+
+With a flap filter, switches that flap along a screen edge are held back
+until the pointer settles (see native/flap_filter.h); clean switches still
+go straight to the queue.
+
+The queue and filter are nanomq_bindings.EventQueue and FlapFilter when the
+bindings are built, and equivalent Python classes otherwise, so this works
+with every client type.
+"""
+
+import heapq
+import itertools
+import logging
+import threading
+import time
+from collections import deque
+from typing import Callable, Optional
+
+from .interface import MQTTPublisherInterface
+
+logger = logging.getLogger('publish_queue')
+
+try:
+    from nanomq_bindings import EventQueue as _NativeEventQueue, FlapFilter as _NativeFlapFilter
+except ImportError:
+    _NativeEventQueue = None
+    _NativeFlapFilter = None
+
+
+class PyEventQueue:
+    """Python stand-in for nanomq_bindings.EventQueue, with the same interface."""
+    
+    def __init__(self, capacity: int = 1024):
+        if capacity < 1:
+            raise ValueError("Queue capacity must be at least 1")
+        self._items = deque()
+        self._capacity = capacity
+        self._ready = threading.Condition()
+        self._closed = False
+        self._counts = {'high_water': 0, 'pushed': 0, 'popped': 0, 'dropped': 0}
+    
+    def push(self, message: str) -> bool:
+        with self._ready:
+            dropped = len(self._items) == self._capacity
+            if dropped:
+                self._items.popleft()
+                self._counts['dropped'] += 1
+            self._items.append(message)
+            self._counts['pushed'] += 1
+            self._counts['high_water'] = max(self._counts['high_water'], len(self._items))
+            self._ready.notify()
+        return not dropped
+    
+    def pop(self, timeout_ms: int = 100) -> Optional[str]:
+        with self._ready:
+            if not self._ready.wait_for(lambda: self._items or self._closed, timeout_ms / 1000):
+                return None
+            if not self._items:
+                return None
+            self._counts['popped'] += 1
+            return self._items.popleft()
+    
+    def close(self):
+        with self._ready:
+            self._closed = True
+            self._ready.notify_all()
+    
+    def is_closed(self) -> bool:
+        return self._closed
+    
+    def __len__(self) -> int:
+        return len(self._items)
+    
+    def stats(self) -> dict:
+        with self._ready:
+            return dict(self._counts, capacity=self._capacity, depth=len(self._items))
+
+
+def create_event_queue(capacity: int = 1024):
+    """Create the native bounded queue if available, else the Python one."""
+    if _NativeEventQueue is not None:
+        return _NativeEventQueue(capacity)
+    return PyEventQueue(capacity)
+
+
+class PyFlapFilter:
+    """Python stand-in for nanomq_bindings.FlapFilter, with the same interface and rules."""
+    
+    def __init__(self, dwell_ms: int = 300, hysteresis: int = 0):
+        self._dwell = dwell_ms / 1000
+        self._hysteresis = hysteresis
+        self._last_switch = None
+        self._flapping = False
+        self._reversals = 0
+        self._previous = self._current = self._published = ''
+        self._burst_suppressed = 0
+        self._counts = {'suppressed': 0, 'bursts': 0}
+    
+    def on_switch(self, desktop: str) -> str:
+        now = time.monotonic()
+        rapid = self._last_switch is not None and now - self._last_switch < self._dwell
+        reversal = rapid and desktop == self._previous
+        self._previous, self._current, self._last_switch = self._current, desktop, now
+        
+        if not rapid:
+            self._flapping = False
+            self._reversals = 0
+            self._published = desktop
+            return 'publish'
+        if self._flapping:
+            self._counts['suppressed'] += 1
+            self._burst_suppressed += 1
+            return 'suppress'
+        if reversal:
+            self._reversals += 1
+            if self._reversals > self._hysteresis:
+                self._flapping = True
+                self._counts['bursts'] += 1
+                self._counts['suppressed'] += 1
+                self._burst_suppressed = 1
+                return 'flapping'
+        self._published = desktop
+        return 'publish'
+    
+    def poll(self) -> Optional[str]:
+        if not self._flapping or time.monotonic() - self._last_switch < self._dwell:
+            return None
+        self._flapping = False
+        self._reversals = 0
+        if self._current == self._published:
+            return ''
+        self._published = self._current
+        return self._current
+    
+    def timeout(self) -> Optional[float]:
+        if not self._flapping:
+            return None
+        return max(0.0, self._last_switch + self._dwell - time.monotonic())
+    
+    def is_flapping(self) -> bool:
+        return self._flapping
+    
+    def screen(self) -> str:
+        return self._current
+    
+    def burst_suppressed(self) -> int:
+        return self._burst_suppressed
+    
+    def stats(self) -> dict:
+        return dict(self._counts)
+
+
+def create_flap_filter(dwell_ms: int = 300, hysteresis: int = 0):
+    """Create the native flap filter if available, else the Python one."""
+    if _NativeFlapFilter is not None:
+        return _NativeFlapFilter(dwell_ms, hysteresis)
+    return PyFlapFilter(dwell_ms, hysteresis)
+
+
+class PublishQueue:
+    """
+    Publishes queued messages from a worker thread, retrying failures.
+    
+    Messages are published in order. A failed one is retried after
+    retry_delay, then twice that, up to max_retries attempts in total; it
+    does not hold up messages behind it. If a newer message is published
+    while an older one waits for its retry, the older one is dropped as
+    superseded: subscribers track the current desktop, and delivering a stale
+    switch after a fresh one would move them backwards. For the same reason
+    a retry that comes due while a newer message also waits for one is
+    dropped, and the newer one goes out on its own schedule.
+    
+    When the queue is full the oldest message is dropped (see
+    native/event_queue.h); metrics() reports how often.
+    
+    With a flap filter, switches submitted with their desktop are filtered
+    before they are queued; the worker publishes where a flapping burst
+    settled once the filter's dwell has passed.
+    """
+    
+    def __init__(self, publisher: MQTTPublisherInterface, capacity: int = 1024, max_retries: int = 3,
+                 retry_delay: float = 2.0, on_published: Optional[Callable[[str], None]] = None,
+                 flap_filter=None):
+        """
+        Start the publish worker.
+        
+        Args:
+            publisher: Connected publisher to send through
+            capacity: Messages held while the broker is slow or down
+            max_retries: Publish attempts per message, including the first
+            retry_delay: Seconds before the first retry; doubles after each
+            on_published: Optional callback(message) after each successful publish
+            flap_filter: Optional FlapFilter (see create_flap_filter) for switch bursts
+        """
+        self.publisher = publisher
+        self.max_retries = max_retries
+        self.retry_delay = retry_delay
+        self.on_published = on_published
+        self.queue = create_event_queue(capacity)
+        self.flap_filter = flap_filter
+        
+        # Message of the latest held-back switch; the filter is shared with the reader
+        self._flap_lock = threading.Lock()
+        self._flap_message = None
+        
+        # (due, order, failures, message), order counting messages as they are
+        # first attempted; only the worker thread touches it
+        self._retries = []
+        self._order = itertools.count()
+        self._counts = {'published': 0, 'retries': 0, 'failures': 0, 'superseded': 0}
+        self._drain_deadline = None
+        self._idle = threading.Event()
+        self._worker = threading.Thread(target=self._run, name='publish-queue', daemon=True)
+        self._worker.start()
+    
+    def submit(self, message: str, desktop: Optional[str] = None) -> bool:
+        """
+        Queue a message for publishing; never blocks.
+        
+        Args:
+            message: Payload to publish
+            desktop: The switch's desktop, to run it through the flap filter
+        
+        Returns:
+            bool: False if the queue was full and its oldest message was dropped
+        """
+        if self.flap_filter is not None and desktop is not None:
+            with self._flap_lock:
+                action = self.flap_filter.on_switch(desktop)
+                if action != 'publish':
+                    self._flap_message = message
+                    if action == 'flapping':
+                        logger.info(f"Switches flapping at {desktop}; holding them until the pointer settles")
+                    return True
+        if not self.queue.push(message):
+            logger.warning("Publish queue full, dropped the oldest message")
+            return False
+        return True
+    
+    def close(self, timeout: float = 10.0):
+        """
+        Stop accepting messages and wait for the worker to drain.
+        
+        Queued messages are published and due retries attempted until
+        timeout; whatever is left after that is counted as failed.
+        """
+        self._drain_deadline = time.monotonic() + timeout
+        self.queue.close()
+        self._worker.join(timeout + 1.0)
+        logger.info(f"Publish queue metrics: {self.metrics()}")
+    
+    def metrics(self) -> dict:
+        """Queue depth and drop counts, plus published, retried, failed, superseded and suppressed messages."""
+        stats = dict(self.queue.stats())
+        stats.update(self._counts)
+        stats['retry_pending'] = len(self._retries)
+        if self.flap_filter is not None:
+            flaps = self.flap_filter.stats()
+            stats['flaps_suppressed'] = flaps['suppressed']
+            stats['flap_bursts'] = flaps['bursts']
+        return stats
+    
+    def _flap_timeout(self) -> Optional[float]:
+        if self.flap_filter is None:
+            return None
+        with self._flap_lock:
+            return self.flap_filter.timeout()
+    
+    def _settle_flaps(self):
+        if self.flap_filter is None:
+            return
+        with self._flap_lock:
+            settled = self.flap_filter.poll()
+            if settled is None:
+                return
+            message, self._flap_message = self._flap_message, None
+        logger.info(f"Switches settled at {self.flap_filter.screen()} "
+                    f"after {self.flap_filter.burst_suppressed()} suppressed")
+        if settled and message:
+            self._attempt(message, 0, next(self._order))
+    
+    def _attempt(self, message: str, failures: int, order: int):
+        if self.publisher.publish(message):
+            self._counts['published'] += 1
+            # Only older messages are superseded; a newer one's retry must still go out
+            newer = [retry for retry in self._retries if retry[1] > order]
+            if len(newer) != len(self._retries):
+                self._counts['superseded'] += len(self._retries) - len(newer)
+                heapq.heapify(newer)
+                self._retries = newer
+            if self.on_published:
+                self.on_published(message)
+            return
+        
+        failures += 1
+        if failures < self.max_retries:
+            delay = self.retry_delay * 2 ** (failures - 1)
+            logger.debug(f"Publish retry {failures}/{self.max_retries} in {delay}s")
+            self._counts['retries'] += 1
+            heapq.heappush(self._retries, (time.monotonic() + delay, order, failures, message))
+        else:
+            self._counts['failures'] += 1
+            logger.error(f"Failed to publish after {self.max_retries} retries: {message}")
+    
+    def _run(self):
+        while True:
+            self._settle_flaps()
+            now = time.monotonic()
+            while self._retries and self._retries[0][0] <= now:
+                _, order, failures, message = heapq.heappop(self._retries)
+                if any(retry[1] > order for retry in self._retries):
+                    # A newer message is waiting too; sending this one first would flash a stale desktop
+                    self._counts['superseded'] += 1
+                    continue
+                self._attempt(message, failures, order)
+            
+            flap_timeout = self._flap_timeout()
+            closing = self.queue.is_closed()
+            if closing and len(self.queue) == 0:
+                if not self._retries and flap_timeout is None:
+                    return
+                if now >= self._drain_deadline:
+                    self._counts['failures'] += len(self._retries)
+                    self._retries.clear()
+                    return
+            
+            # A burst can start while we wait, so don't sleep far past a dwell
+            wait = 0.5 if self.flap_filter is None else 0.1
+            if self._retries:
+                wait = min(wait, self._retries[0][0] - now)
+            if flap_timeout is not None:
+                wait = min(wait, flap_timeout)
+            if closing and len(self.queue) == 0:
+                # pop() no longer blocks once closed; sleep until the next retry or settle
+                self._idle.wait(min(wait, max(self._drain_deadline - now, 0.0)))
+                continue
+            message = self.queue.pop(max(1, int(wait * 1000)))
+            if message is not None:
+                self._attempt(message, 0, next(self._order))
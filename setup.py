@@ -15,6 +15,9 @@ from pybind11.setup_helpers import Pybind11Extension, build_ext
 from pybind11 import get_cmake_dir
 import pybind11
 
+# Set NANOMQ_ENABLE_TLS=1 to build NanoSDK with Mbed TLS (mqtts:// support)
+ENABLE_TLS = os.environ.get("NANOMQ_ENABLE_TLS", "0") == "1"
+
 
 def build_nanosdk():
     """Build NanoSDK using CMake."""
@@ -28,6 +31,7 @@ def build_nanosdk():
         f"-DNNG_ENABLE_QUIC=OFF",
         f"-DNNG_TESTS=OFF",
         f"-DNNG_TOOLS=OFF",
+        f"-DNNG_ENABLE_TLS={'ON' if ENABLE_TLS else 'OFF'}",
     ]
     
     # Platform-specific settings
@@ -71,15 +75,27 @@ ext_modules = [
             "mqtt_clients/nanomq_bindings.cpp",
         ],
         include_dirs=[
+            "mqtt_clients",
             "external/nanosdk/include",
             "external/nanosdk/src/core",
             pybind11.get_include(),
         ],
-        libraries=["nng"],
+        # rt: shm_open for the state page (native/state_page.h) on older glibc
+        libraries=["nng", "z"] + (["rt"] if platform.system() == "Linux" else [])
+                  + (["mbedtls", "mbedx509", "mbedcrypto"] if ENABLE_TLS else []),
         library_dirs=[
             "build/lib",
             "build/external/nanosdk",
         ],
+        depends=[
+            "mqtt_clients/native/backfill.h",
+            "mqtt_clients/native/checkpoint.h",
+            "mqtt_clients/native/event_parser.h",
+            "mqtt_clients/native/event_queue.h",
+            "mqtt_clients/native/flap_filter.h",
+            "mqtt_clients/native/log_follower.h",
+            "mqtt_clients/native/switch_scanner.h",
+        ],
         language="c++",
         cxx_std=17,
     ),
@@ -31,6 +31,12 @@ if [ "$MQTT_CLIENT_TYPE" = "nanomq" ]; then
         echo "To build NanoMQ support, run: ./build.sh"
         MQTT_CLIENT_TYPE="paho"
     fi
+elif [ "$MQTT_CLIENT_TYPE" = "peer" ]; then
+    # No fallback: paho needs a broker that peer mode does not run
+    if ! python3 -c "import nanomq_bindings" 2>/dev/null; then
+        echo "Error: MQTT_CLIENT_TYPE=peer needs the NanoMQ bindings. Build them with: ./build.sh"
+        exit 1
+    fi
 fi
 
 # Ensure logs directory exists
@@ -44,7 +50,6 @@ FOUND_HIM_PIDS=$(pgrep -f "python3 ./found-him.py" || true)
 if [ -n "$WALDO_PIDS" ] || [ -n "$FOUND_HIM_PIDS" ]; then
     echo "Found running services. Stopping them first..."
     ./stop.sh
-    sleep 2
 fi
 
 echo "=== Synergy Screen Monitor ==="
@@ -80,22 +85,35 @@ if [ "$ROLE" = "primary" ]; then
     echo "=== PRIMARY MODE: Running log monitor + optional local alerts ==="
     
     # Validate primary configuration
-    if [ -z "$SYNERGY_LOG_PATH" ]; then
-        echo "ERROR: SYNERGY_LOG_PATH must be set for primary machines"
-        echo "Please check your .env file or set the environment variable"
-        exit 1
-    fi
-    
-    if [ ! -f "$SYNERGY_LOG_PATH" ]; then
-        echo "ERROR: Synergy log file not found: $SYNERGY_LOG_PATH"
-        echo "Please check your SYNERGY_LOG_PATH setting"
-        exit 1
+    if [ -n "$SYNERGY_LOG_SOURCES" ]; then
+        # Several servers' logs, checked by waldo.py itself
+        if [ "${SYNERGY_LOG_FOLLOW:-tail}" != "native" ]; then
+            echo "ERROR: SYNERGY_LOG_SOURCES requires SYNERGY_LOG_FOLLOW=native"
+            exit 1
+        fi
+        echo "Monitoring Synergy logs: $SYNERGY_LOG_SOURCES"
+    else
+        if [ -z "$SYNERGY_LOG_PATH" ]; then
+            echo "ERROR: SYNERGY_LOG_PATH must be set for primary machines"
+            echo "Please check your .env file or set the environment variable"
+            exit 1
+        fi
+        
+        if [ ! -f "$SYNERGY_LOG_PATH" ]; then
+            echo "ERROR: Synergy log file not found: $SYNERGY_LOG_PATH"
+            echo "Please check your SYNERGY_LOG_PATH setting"
+            exit 1
+        fi
+        
+        echo "Monitoring Synergy log: $SYNERGY_LOG_PATH"
     fi
     
-    echo "Monitoring Synergy log: $SYNERGY_LOG_PATH"
-    
-    # Start local alert service if target desktop is specified
-    if [ -n "$TARGET_DESKTOP" ] && [ "$TARGET_DESKTOP" != "" ]; then
+    # Local alerts: inside waldo.py on its connection (combined), or found-him.py alongside
+    LOCAL_ALERT=""
+    if [ -n "$TARGET_DESKTOP" ] && [ "${PRIMARY_RUNTIME:-separate}" = "combined" ] && [ "$MQTT_CLIENT_TYPE" = "nanomq" ]; then
+        echo "Local alerts for desktop $TARGET_DESKTOP run inside waldo.py (combined runtime)"
+        LOCAL_ALERT="$TARGET_DESKTOP"
+    elif [ -n "$TARGET_DESKTOP" ] && [ "$TARGET_DESKTOP" != "" ]; then
         echo "Starting local alert service for desktop: $TARGET_DESKTOP"
         local_alert_args=(python3 ./found-him.py "$TARGET_DESKTOP" --broker "$MQTT_BROKER" --port "$MQTT_PORT" --topic "$MQTT_TOPIC" --client-type "$MQTT_CLIENT_TYPE")
         if [ "$DEBUG_MODE" = "true" ]; then
@@ -109,9 +127,18 @@ if [ "$ROLE" = "primary" ]; then
     if [ "$DEBUG_MODE" = "true" ]; then
         waldo_args+=(--debug)
     fi
+    if [ -n "$LOCAL_ALERT" ]; then
+        waldo_args+=(--alert "$LOCAL_ALERT")
+    fi
     
-    echo "Starting Log Monitor Service (Waldo) in foreground..."
-    tail -F "$SYNERGY_LOG_PATH" | "${waldo_args[@]}"
+    if [ "${SYNERGY_LOG_FOLLOW:-tail}" = "native" ]; then
+        echo "Starting Log Monitor Service (Waldo, native log follower) in foreground..."
+        # No path: waldo.py follows SYNERGY_LOG_SOURCES, or SYNERGY_LOG_PATH
+        "${waldo_args[@]}" --follow
+    else
+        echo "Starting Log Monitor Service (Waldo) in foreground..."
+        tail -F "$SYNERGY_LOG_PATH" | "${waldo_args[@]}"
+    fi
     
 elif [ "$ROLE" = "secondary" ]; then
     echo "=== SECONDARY MODE: Running alert service only ==="
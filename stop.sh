@@ -5,6 +5,17 @@
 
 set -e  # Exit on any error
 
+# Wait up to 1s for processes matching a pattern to exit after SIGTERM.
+# The clients close their connections gracefully in well under that.
+wait_for_exit() {
+    local pattern="$1"
+    for _ in 1 2 3 4 5 6 7 8 9 10; do
+        pgrep -f "$pattern" > /dev/null 2>&1 || return 0
+        sleep 0.1
+    done
+    return 1
+}
+
 echo "=== Synergy Screen Monitor - Stopping Services ==="
 
 # Find and stop all waldo.py processes
@@ -12,7 +23,7 @@ WALDO_PIDS=$(pgrep -f "python3 ./waldo.py" || true)
 if [ -n "$WALDO_PIDS" ]; then
     echo "Stopping waldo.py processes: $WALDO_PIDS"
     echo "$WALDO_PIDS" | xargs kill 2>/dev/null || true
-    sleep 1
+    wait_for_exit "python3 ./waldo.py" || true
 
     # Force kill if still running
     WALDO_PIDS=$(pgrep -f "python3 ./waldo.py" || true)
@@ -29,7 +40,7 @@ FOUND_HIM_PIDS=$(pgrep -f "python3 ./found-him.py" || true)
 if [ -n "$FOUND_HIM_PIDS" ]; then
     echo "Stopping found-him.py processes: $FOUND_HIM_PIDS"
     echo "$FOUND_HIM_PIDS" | xargs kill 2>/dev/null || true
-    sleep 1
+    wait_for_exit "python3 ./found-him.py" || true
 
     # Force kill if still running
     FOUND_HIM_PIDS=$(pgrep -f "python3 ./found-him.py" || true)
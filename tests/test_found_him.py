@@ -92,6 +92,7 @@ class TestMQTTSubscriber:
         """Test message processing with matching value"""
         mock_client = Mock()
         mock_msg = Mock()
+        mock_msg.retain = False
         mock_msg.payload = json.dumps({
             'desktop': 'target',
             'timestamp': '2025-01-28T00:00:00'
@@ -107,6 +108,7 @@ class TestMQTTSubscriber:
         """Test message processing without matching value"""
         mock_client = Mock()
         mock_msg = Mock()
+        mock_msg.retain = False
         mock_msg.payload = json.dumps({
             'desktop': 'other',
             'timestamp': '2025-01-28T00:00:00'
@@ -122,6 +124,7 @@ class TestMQTTSubscriber:
         """Test message processing with missing key"""
         mock_client = Mock()
         mock_msg = Mock()
+        mock_msg.retain = False
         mock_msg.payload = json.dumps({
             'other_key': 'target',
             'timestamp': '2025-01-28T00:00:00'
@@ -133,10 +136,44 @@ class TestMQTTSubscriber:
         mock_bell.assert_not_called()
         mock_print.assert_not_called()
     
+    def test_on_message_retained_state_ignored(self, subscriber, mock_bell):
+        """Test the retained switch sent on subscribe does not ring the bell"""
+        mock_client = Mock()
+        mock_msg = Mock()
+        mock_msg.retain = True
+        mock_msg.payload = json.dumps({
+            'desktop': 'target',
+            'timestamp': '2025-01-28T00:00:00'
+        }).encode()
+        
+        with patch('builtins.print') as mock_print:
+            subscriber.on_message(mock_client, None, mock_msg)
+        
+        mock_bell.assert_not_called()
+        mock_print.assert_not_called()
+    
+    def test_on_message_state_reply_ignored(self, subscriber, mock_bell):
+        """Test a resync state reply does not ring the bell"""
+        mock_client = Mock()
+        mock_msg = Mock()
+        mock_msg.retain = False
+        mock_msg.payload = json.dumps({
+            'desktop': 'target',
+            'timestamp': '2025-01-28T00:00:00',
+            'state': True
+        }).encode()
+        
+        with patch('builtins.print') as mock_print:
+            subscriber.on_message(mock_client, None, mock_msg)
+        
+        mock_bell.assert_not_called()
+        mock_print.assert_not_called()
+    
     def test_on_message_invalid_json(self, subscriber, mock_bell):
         """Test message processing with invalid JSON"""
         mock_client = Mock()
         mock_msg = Mock()
+        mock_msg.retain = False
         mock_msg.payload = b'invalid json'
         
         # Should not raise exception
@@ -9,17 +9,21 @@ import pytest
 import json
 import time
 import threading
-from unittest.mock import Mock, patch, MagicMock
+from unittest.mock import Mock, patch, MagicMock, call
 
 # Test if NanoMQ is available
 try:
-    from mqtt_clients.nanomq_client import NanoMQTTPublisher, NanoMQTTSubscriber, NANOMQ_AVAILABLE
+    from mqtt_clients.nanomq_client import (NanoMQTTPublisher, NanoMQTTSubscriber, RingSubscriber,
+                                            PeerPublisher, PeerSubscriber, NANOMQ_AVAILABLE)
     from mqtt_clients.factory import MQTTClientFactory
     nanomq_available = NANOMQ_AVAILABLE
 except ImportError:
     nanomq_available = False
     NanoMQTTPublisher = None
     NanoMQTTSubscriber = None
+    RingSubscriber = None
+    PeerPublisher = None
+    PeerSubscriber = None
 
 
 # Skip all tests if NanoMQ is not available
@@ -55,6 +59,50 @@ class TestNanoMQTTPublisher:
             with pytest.raises(RuntimeError, match="NanoMQ bindings are not available"):
                 NanoMQTTPublisher("test.broker", 1883, "test/topic")
     
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_with_tls(self, mock_bindings):
+        """Test TLS settings are applied to the native client."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        tls = {'ca_file': '/etc/ca.crt', 'cert_file': '', 'key_file': '', 'server_name': 'broker'}
+        
+        NanoMQTTPublisher("test.broker", 8883, "test/topic", tls=tls)
+        
+        mock_client.configure_tls.assert_called_once_with(**tls)
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_without_tls(self, mock_bindings):
+        """Test plain TCP clients never configure TLS."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        
+        mock_client.configure_tls.assert_not_called()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_with_tuning_profile(self, mock_bindings):
+        """Test the named tuning preset is passed to the native constructor."""
+        profile = Mock()
+        mock_bindings.TuningProfile.preset.return_value = profile
+        
+        NanoMQTTPublisher("test.broker", 1883, "test/topic", tuning="low-latency")
+        
+        mock_bindings.TuningProfile.preset.assert_called_once_with("low-latency")
+        mock_bindings.NanoMQTTClient.assert_called_once_with("test.broker", 1883, profile)
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_with_busy_poll(self, mock_bindings):
+        """Test a busy-poll budget overrides the default profile."""
+        profile = Mock()
+        mock_bindings.TuningProfile.preset.return_value = profile
+        
+        NanoMQTTPublisher("test.broker", 1883, "test/topic", busy_poll_us=150)
+        
+        mock_bindings.TuningProfile.preset.assert_called_once_with("default")
+        assert profile.rx_busy_poll_us == 150
+        mock_bindings.NanoMQTTClient.assert_called_once_with("test.broker", 1883, profile)
+    
     @patch('mqtt_clients.nanomq_client.nanomq_bindings')
     @patch('time.sleep')
     def test_connect_with_retry_success(self, mock_sleep, mock_bindings):
@@ -148,6 +196,245 @@ class TestNanoMQTTPublisher:
         
         assert publisher.connected is False
         mock_client.disconnect.assert_called_once()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_restart_in_place(self, mock_bindings):
+        """Test restart reuses the native client instead of creating a new one."""
+        mock_client = Mock()
+        mock_client.restart.return_value = True
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        
+        assert publisher.restart() is True
+        assert publisher.connected is True
+        mock_client.restart.assert_called_once()
+        mock_bindings.NanoMQTTClient.assert_called_once()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_restart_failure(self, mock_bindings):
+        """Test a failed restart leaves the publisher disconnected."""
+        mock_client = Mock()
+        mock_client.restart.side_effect = RuntimeError("Connection timeout")
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        publisher.connected = True
+        
+        assert publisher.restart() is False
+        assert publisher.connected is False
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_local_subscriber_shares_connection(self, mock_bindings):
+        """Test the local subscriber reuses the publisher's client and enables local delivery."""
+        mock_client = Mock()
+        mock_client.subscribe.return_value = True
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        bell_func = Mock()
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        subscriber = publisher.local_subscriber("current_desktop", "studio", bell_func)
+        
+        assert subscriber.client is mock_client
+        mock_bindings.NanoMQTTClient.assert_called_once()
+        
+        assert subscriber.attach() is True
+        mock_client.set_local_delivery.assert_called_once_with("test/topic")
+        mock_client.subscribe.assert_called_once_with("test/topic", qos=1)
+        mock_client.start_message_loop.assert_called_once()
+        mock_client.connect.assert_not_called()
+        
+        # Local delivery calls the shared callback from publish()
+        on_message = mock_client.set_message_callback.call_args[0][0]
+        on_message("test/topic", '{"current_desktop": "studio"}')
+        bell_func.assert_called_once()
+        
+        publisher.close()
+        mock_client.set_local_delivery.assert_called_with('')
+        mock_client.stop_message_loop.assert_called()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_reconnect_reattaches_local_subscriber(self, mock_bindings):
+        """Test the shared subscription is restored after reconnecting and follows the topic."""
+        mock_client = Mock()
+        mock_client.connect.return_value = True
+        mock_client.subscribe.return_value = True
+        mock_client.resubscribe.return_value = True
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "old/topic")
+        publisher.local_subscriber("current_desktop", "studio", Mock())
+        
+        publisher.connect_with_retry()
+        mock_client.subscribe.assert_called_once_with("old/topic", qos=1)
+        
+        assert publisher.reconfigure(topic="new/topic") is True
+        mock_client.resubscribe.assert_called_once_with("old/topic", "new/topic", qos=1)
+        mock_client.set_local_delivery.assert_called_with("new/topic")
+        assert publisher.subscriber.topic == "new/topic"
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_sequence_stamping_serves_state(self, mock_bindings):
+        """Test a publisher with a source stamps sequence numbers and answers state requests."""
+        mock_client = Mock()
+        mock_client.connect.return_value = True
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "old/topic", source="office",
+                                      sequence_file="/tmp/waldo.sequence")
+        mock_client.enable_sequence.assert_called_once_with("office", "/tmp/waldo.sequence")
+        
+        publisher.connect_with_retry()
+        mock_client.serve_state.assert_called_once_with("old/topic")
+        mock_client.start_message_loop.assert_called_once()
+        
+        publisher.reconfigure(topic="new/topic")
+        mock_client.serve_state.assert_called_with("new/topic")
+        
+        NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        mock_client.enable_sequence.assert_called_once()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_retained_state(self, mock_bindings):
+        """Test a retaining publisher moves its retained topic along with the topic."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "old/topic", retain=True)
+        mock_client.set_retained_topic.assert_called_once_with("old/topic")
+        
+        publisher.reconfigure(topic="new/topic")
+        mock_client.set_retained_topic.assert_called_with("new/topic")
+        
+        NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        assert mock_client.set_retained_topic.call_count == 2
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_multicast_needs_source(self, mock_bindings):
+        """Test a publisher multicasts only when it stamps sequence numbers."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        multicast = {'group': '239.255.77.77', 'port': 1886, 'interface': ''}
+        
+        NanoMQTTPublisher("test.broker", 1883, "test/topic", multicast=multicast)
+        mock_client.enable_multicast.assert_not_called()
+        
+        NanoMQTTPublisher("test.broker", 1883, "test/topic", source="office", multicast=multicast)
+        mock_client.enable_multicast.assert_called_once_with(group='239.255.77.77', port=1886, interface='')
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_presence_announces_and_watches(self, mock_bindings):
+        """Test a publisher with presence announces itself, watches the fleet and runs the receive loop."""
+        mock_client = Mock()
+        mock_client.connect.return_value = True
+        mock_client.presence.return_value = {'lab/found-him': {'online': True}}
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        presence = {'topic': 'synergy/presence', 'name': 'office', 'role': 'waldo', 'watch': True}
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic", presence=presence)
+        mock_client.enable_presence.assert_called_once_with('synergy/presence', 'office', 'waldo')
+        mock_client.watch_presence.assert_called_once_with('synergy/presence')
+        
+        publisher.connect_with_retry()
+        mock_client.start_message_loop.assert_called_once()
+        mock_client.serve_state.assert_not_called()
+        assert publisher.presence() == {'lab/found-him': {'online': True}}
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_follow_log_publishes_natively(self, mock_bindings):
+        """Test the native log follower publishes through the publisher's client."""
+        mock_client = Mock()
+        mock_follower = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        mock_bindings.LogFollower.return_value = mock_follower
+        on_event = Mock()
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        publisher.follow_log("/tmp/synergy.log", on_event)
+        
+        mock_bindings.LogFollower.assert_called_once_with("/tmp/synergy.log", True)
+        mock_follower.start_publishing.assert_called_once_with(
+            mock_client, "test/topic", qos=1, on_event=on_event)
+        
+        publisher.reconfigure("new/topic")
+        mock_follower.set_topic.assert_called_once_with("new/topic")
+        
+        publisher.stop_following()
+        mock_follower.stop.assert_called_once()
+        assert publisher.follower is None
+
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_follow_log_with_checkpoint(self, mock_bindings):
+        """Test the checkpoint is enabled before the follower starts."""
+        mock_follower = Mock()
+        mock_bindings.LogFollower.return_value = mock_follower
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        publisher.follow_log("/tmp/synergy.log", checkpoint_path="/tmp/waldo.checkpoint")
+        
+        assert [c[0] for c in mock_follower.method_calls] == ['enable_checkpoint', 'start_publishing']
+        mock_follower.enable_checkpoint.assert_called_once_with("/tmp/waldo.checkpoint")
+
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_follow_logs_shares_one_follower(self, mock_bindings):
+        """Test several servers' logs are followed by one follower on one client."""
+        mock_client = Mock()
+        mock_follower = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        mock_bindings.LogFollower.return_value = mock_follower
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        publisher.follow_logs([("office", "/logs/a.log"), ("lab", "/logs/b.log")],
+                              checkpoint_path="/tmp/waldo.checkpoint", events_topic="synergy/events")
+        
+        mock_bindings.LogFollower.assert_called_once_with()
+        mock_follower.add_log.assert_has_calls([
+            call("/logs/a.log", server="office", start_at_end=True,
+                 checkpoint_path="/tmp/waldo.checkpoint.office"),
+            call("/logs/b.log", server="lab", start_at_end=True,
+                 checkpoint_path="/tmp/waldo.checkpoint.lab"),
+        ])
+        mock_follower.set_events_topic.assert_called_once_with("synergy/events")
+        mock_follower.start_publishing.assert_called_once_with(
+            mock_client, "test/topic", qos=1, on_event=None)
+
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_follow_logs_enables_flap_filter(self, mock_bindings):
+        """Test flap suppression settings reach the native follower before it starts."""
+        mock_follower = Mock()
+        mock_bindings.LogFollower.return_value = mock_follower
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        publisher.follow_logs([("", "/logs/a.log")], flap_dwell_ms=300, flap_hysteresis=1,
+                              report_flapping=True)
+        
+        mock_follower.enable_flap_filter.assert_called_once_with(300, 1, True)
+        assert mock_follower.method_calls[-1][0] == 'start_publishing'
+
+    @patch('mqtt_clients.nanomq_client.time.sleep')
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_backfill_publishes_in_throttled_batches(self, mock_bindings, mock_sleep):
+        """Test backfill parses all files at once and paces the batches to the rate."""
+        mock_client = Mock()
+        mock_backfill = MagicMock()
+        mock_backfill.__len__.return_value = 25
+        mock_backfill.publish.side_effect = lambda client, topic, events_topic, begin, end, qos: min(end, 25) - begin
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        mock_bindings.LogBackfill.return_value = mock_backfill
+        
+        publisher = NanoMQTTPublisher("test.broker", 1883, "test/topic")
+        published = publisher.backfill([("office", "/logs/a.log.1.gz"), ("office", "/logs/a.log")],
+                                       rate=100, events_topic="synergy/events")
+        
+        assert published == 25
+        mock_bindings.LogBackfill.assert_called_once_with(
+            ["/logs/a.log.1.gz", "/logs/a.log"], ["office", "office"], 0)
+        mock_backfill.publish.assert_has_calls([
+            call(mock_client, "test/topic", "synergy/events", 0, 10, qos=1),
+            call(mock_client, "test/topic", "synergy/events", 10, 20, qos=1),
+            call(mock_client, "test/topic", "synergy/events", 20, 30, qos=1),
+        ])
+        assert mock_sleep.called
 
 
 @pytest.mark.unit
@@ -180,6 +467,106 @@ class TestNanoMQTTSubscriber:
             with pytest.raises(RuntimeError, match="NanoMQ bindings are not available"):
                 NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None)
     
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_with_event_filter(self, mock_bindings):
+        """Test that a staleness limit and sequence tracking are set on the native client."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None)
+        mock_client.set_event_filter.assert_not_called()
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None, max_event_age_ms=5000)
+        mock_client.set_event_filter.assert_called_once_with(5000, True)
+        mock_client.set_sequence_tracking.assert_not_called()
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None, track_sequence=True)
+        mock_client.set_sequence_tracking.assert_called_once_with(True)
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_with_state_page(self, mock_bindings):
+        """Test the state page and event ring are set on the native client and a failure only disables them."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None)
+        mock_client.set_state_page.assert_not_called()
+        mock_client.set_event_ring.assert_not_called()
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None, event_ring="/test-events")
+        mock_client.set_event_ring.assert_called_once_with("/test-events")
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None, state_page="/test-desktop")
+        mock_client.set_state_page.assert_called_once_with("/test-desktop")
+        
+        mock_client.set_state_page.side_effect = RuntimeError("Failed to open state page")
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None,
+                                        state_page="/test-desktop")
+        assert subscriber.client is mock_client
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_with_multicast(self, mock_bindings):
+        """Test the subscriber joins the multicast group and a failure only disables the fast path."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        multicast = {'group': '239.255.77.77', 'port': 1886, 'interface': '192.168.1.20'}
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None)
+        mock_client.set_multicast_receive.assert_not_called()
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None, multicast=multicast)
+        mock_client.set_multicast_receive.assert_called_once_with(group='239.255.77.77', port=1886,
+                                                                  interface='192.168.1.20')
+        
+        mock_client.set_multicast_receive.side_effect = RuntimeError("Failed to join multicast group")
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None,
+                                        multicast=multicast)
+        assert subscriber.client is mock_client
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_init_with_presence(self, mock_bindings):
+        """Test a subscriber announces itself without watching, and a shared client is left to its publisher."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        presence = {'topic': 'synergy/presence', 'name': 'office', 'role': 'found-him', 'watch': False}
+        
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None, presence=presence)
+        mock_client.enable_presence.assert_called_once_with('synergy/presence', 'office', 'found-him')
+        mock_client.watch_presence.assert_not_called()
+        
+        shared = Mock()
+        NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None, presence=presence,
+                           client=shared)
+        shared.enable_presence.assert_not_called()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_get_current_desktop(self, mock_bindings):
+        """Test the current desktop is answered by the native client's state cache."""
+        mock_client = Mock()
+        mock_client.current_desktop.return_value = {'desktop': 'workstation', 'retained': True}
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None)
+        
+        assert subscriber.get_current_desktop("studio")['desktop'] == 'workstation'
+        mock_client.current_desktop.assert_called_once_with("studio")
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_query_current(self, mock_bindings):
+        """Test the current desktop query goes to the subscribed topic and a failure returns None."""
+        mock_client = Mock()
+        mock_client.query_current.return_value = {'desktop': 'studio', 'rtt_ms': 1.5}
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None)
+        
+        assert subscriber.query_current(timeout=0.5)['desktop'] == 'studio'
+        mock_client.query_current.assert_called_once_with("test/topic", 500, '')
+        
+        mock_client.query_current.side_effect = RuntimeError("query_current() needs the message loop running")
+        assert subscriber.query_current(server="laptop") is None
+        mock_client.query_current.assert_called_with("test/topic", 1000, 'laptop')
+    
     @patch('mqtt_clients.nanomq_client.nanomq_bindings')
     def test_on_message_match(self, mock_bindings):
         """Test message processing with matching content."""
@@ -241,6 +628,55 @@ class TestNanoMQTTSubscriber:
         mock_client.connect.assert_called_once()
         mock_client.subscribe.assert_called_once_with("test/topic", qos=1)
     
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_restart_in_place(self, mock_bindings):
+        """Test restart leaves resubscription to the native client."""
+        mock_client = Mock()
+        mock_client.restart.return_value = True
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "test/topic", "key", "value", None)
+        
+        assert subscriber.restart() is True
+        assert subscriber.connected is True
+        mock_client.restart.assert_called_once()
+        mock_client.subscribe.assert_not_called()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_reconfigure_live(self, mock_bindings):
+        """Test reconfigure moves the subscription and swaps the match target."""
+        mock_client = Mock()
+        mock_client.resubscribe.return_value = True
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        bell_func = Mock()
+        
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "old/topic", "desktop", "laptop", bell_func)
+        subscriber.connected = True
+        
+        assert subscriber.reconfigure(topic="new/topic", value="workstation") is True
+        
+        mock_client.resubscribe.assert_called_once_with("old/topic", "new/topic", qos=1)
+        assert subscriber.topic == "new/topic"
+        assert subscriber.key == "desktop"
+        assert subscriber.value == "workstation"
+        
+        subscriber._on_message("new/topic", '{"desktop": "workstation"}')
+        bell_func.assert_called_once()
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_reconfigure_failure_keeps_settings(self, mock_bindings):
+        """Test a failed resubscribe leaves topic and target unchanged."""
+        mock_client = Mock()
+        mock_client.resubscribe.return_value = False
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "old/topic", "desktop", "laptop", None)
+        subscriber.connected = True
+        
+        assert subscriber.reconfigure(topic="new/topic", value="workstation") is False
+        assert subscriber.topic == "old/topic"
+        assert subscriber.value == "laptop"
+    
     @patch('mqtt_clients.nanomq_client.nanomq_bindings')
     def test_get_bell_function_macos(self, mock_bindings):
         """Test bell function selection for macOS."""
@@ -266,6 +702,29 @@ class TestNanoMQTTSubscriber:
             
             # Bell function should be callable
             assert callable(bell_func)
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_bell_queues_on_action_executor(self, mock_bindings):
+        """Test the default bell only queues on the native executor, which detach() stops."""
+        mock_client = Mock()
+        mock_client.subscribe.return_value = True
+        mock_actions = Mock()
+        mock_bindings.ActionExecutor.return_value = mock_actions
+        mock_bindings.default_bell_command.return_value = ['paplay', 'bell.oga']
+        
+        subscriber = NanoMQTTSubscriber("test.broker", 1883, "test/topic", "desktop", "workstation", None,
+                                        client=mock_client)
+        subscriber.attach()
+        subscriber._on_message("test/topic", json.dumps({"desktop": "workstation"}))
+        subscriber._on_message("test/topic", json.dumps({"desktop": "workstation"}))
+        
+        mock_bindings.ActionExecutor.assert_called_once_with(debounce_ms=250)
+        mock_actions.set_action.assert_called_once_with('bell', ['paplay', 'bell.oga'], bell_fallback=True)
+        assert mock_actions.trigger.call_args_list == [call('bell'), call('bell')]
+        
+        subscriber.detach()
+        mock_actions.stop.assert_called_once()
+        assert subscriber.actions is None
 
 
 @pytest.mark.unit
@@ -308,6 +767,95 @@ class TestMQTTClientFactoryNanoMQ:
         assert subscriber.key == 'key'
         assert subscriber.value == 'value'
         assert subscriber.bell_func == bell_func
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_create_subscriber_with_tls(self, mock_bindings):
+        """Test factory forwards TLS options to the NanoMQ subscriber."""
+        mock_client = Mock()
+        mock_bindings.NanoMQTTClient.return_value = mock_client
+        
+        MQTTClientFactory.create_subscriber(
+            'nanomq', 'test.broker', 8883, 'test/topic', 'key', 'value',
+            tls={'ca_file': '/etc/ca.crt'}
+        )
+        
+        mock_client.configure_tls.assert_called_once_with(ca_file='/etc/ca.crt')
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_ring_client_only_subscribes(self, mock_bindings):
+        """Test the ring client reads the event ring and cannot publish."""
+        assert 'ring' in MQTTClientFactory.get_supported_clients()
+        assert 'ring' not in MQTTClientFactory.get_supported_clients(publishing=True)
+        with pytest.raises(ValueError, match="only subscribes"):
+            MQTTClientFactory.create_publisher('ring', 'test.broker', 1883, 'test/topic')
+        
+        mock_reader = Mock()
+        mock_reader.next.side_effect = [None, ('test/topic', '{"current_desktop": "studio"}'),
+                                        ('test/topic', '{"current_desktop": "laptop"}'), KeyboardInterrupt()]
+        mock_bindings.EventRingReader.return_value = mock_reader
+        bell_func = Mock()
+        
+        subscriber = MQTTClientFactory.create_subscriber('ring', 'test.broker', 1883, 'test/topic',
+                                                         'current_desktop', 'studio', bell_func,
+                                                         ring='/test-events')
+        assert isinstance(subscriber, RingSubscriber)
+        subscriber.run()
+        
+        mock_bindings.EventRingReader.assert_called_once_with('/test-events')
+        mock_reader.next.assert_called_with(1000, 'test/topic')
+        bell_func.assert_called_once()
+        assert subscriber.get_current_desktop()['current_desktop'] == 'laptop'
+        assert subscriber.get_current_desktop('studio') is None
+    
+    @patch('mqtt_clients.nanomq_client.nanomq_bindings')
+    def test_peer_clients(self, mock_bindings):
+        """Test the peer client publishes and subscribes without a broker."""
+        assert 'peer' in MQTTClientFactory.get_supported_clients(publishing=True)
+        mock_bindings.peer_url.side_effect = lambda host, port: f"tcp://{host}:{port}"
+        mock_publisher = Mock()
+        mock_publisher.publish.return_value = True
+        mock_bindings.PeerPublisher.return_value = mock_publisher
+        
+        publisher = MQTTClientFactory.create_publisher('peer', 'test.broker', 1885, 'test/topic')
+        assert isinstance(publisher, PeerPublisher)
+        assert publisher.connect_with_retry() is True
+        assert publisher.publish('{"current_desktop": "studio"}') is True
+        
+        mock_bindings.PeerPublisher.assert_called_once_with('tcp://0.0.0.0:1885')
+        mock_publisher.listen.assert_called_once()
+        mock_publisher.publish.assert_called_once_with('test/topic', '{"current_desktop": "studio"}')
+        
+        mock_client = Mock()
+        mock_client.subscribe.return_value = True
+        mock_client.is_connected.side_effect = [True, KeyboardInterrupt()]
+        mock_client.current_desktop.return_value = {'desktop': 'studio'}
+        mock_bindings.PeerSubscriber.return_value = mock_client
+        bell_func = Mock()
+        
+        subscriber = MQTTClientFactory.create_subscriber('peer', 'primary.lan', 1885, 'test/topic',
+                                                         'current_desktop', 'studio', bell_func,
+                                                         max_event_age_ms=5000)
+        assert isinstance(subscriber, PeerSubscriber)
+        mock_bindings.PeerSubscriber.assert_called_once_with('tcp://primary.lan:1885')
+        mock_client.set_event_filter.assert_called_once_with(5000, True)
+        
+        on_message = mock_client.set_message_callback.call_args[0][0]
+        with patch('mqtt_clients.nanomq_client.time.sleep'):
+            subscriber.run()
+            on_message('test/topic', '{"current_desktop": "studio"}')
+        
+        mock_client.connect.assert_called_once()
+        mock_client.subscribe.assert_called_once_with('test/topic')
+        mock_client.start_message_loop.assert_called_once()
+        mock_client.disconnect.assert_called_once()
+        bell_func.assert_called_once()
+        assert subscriber.query_current() == {'desktop': 'studio'}
+    
+    def test_client_options_rejected_for_paho(self):
+        """Test TLS is never silently dropped for clients without support."""
+        with pytest.raises(ValueError, match="only supported by the nanomq client"):
+            MQTTClientFactory.create_publisher('paho', 'test.broker', 8883, 'test/topic',
+                                               tls={'ca_file': '/etc/ca.crt'})
 
 
 @pytest.mark.integration
@@ -0,0 +1,466 @@
+"""
+Behavioral tests for the native helpers in the NanoMQ bindings.
+
+Runs the compiled code rather than mocks: the log event parser and switch
+scanner over log lines as Synergy, Barrier, Deskflow and Input Leap write
+them, the flap filter, the bounded event queue, and sequence tracking with
+the shared memory state page and event ring against a local broker stand-in.
+"""
+
+import os
+import sys
+import time
+import json
+import types
+
+import pytest
+
+try:
+    import nanomq_bindings
+except ImportError:
+    nanomq_bindings = None
+
+# What these tests call; an extension built before a helper was added lacks it
+NATIVE_API = ('parse_log_events', 'scan_switch_events', 'FlapFilter', 'EventQueue',
+              'StatePageReader', 'EventRingReader', 'NanoMQTTClient')
+
+
+@pytest.fixture(autouse=True)
+def require_native():
+    """Skip, with the reason shown, unless the compiled bindings are importable."""
+    # The bindings must be the compiled module, not a stand-in
+    if not isinstance(nanomq_bindings, types.ModuleType):
+        pytest.skip("NanoMQ bindings not built - run 'python setup.py build_ext --inplace' to build")
+    missing = [name for name in NATIVE_API if not hasattr(nanomq_bindings, name)]
+    if missing:
+        pytest.skip(f"NanoMQ bindings are missing {', '.join(missing)} - rebuild with "
+                    f"'python setup.py build_ext --inplace'")
+
+
+# The forks kept Synergy's log wording; they differ in timestamps, levels,
+# line endings and screen names
+SYNERGY_LOG = (
+    b'[2024-01-15T10:30:45] INFO: switch from "laptop-1234abcd" to "studio-77773e4b" at 1919,540\n'
+    b'[2024-01-15T10:30:46] NOTE: client "laptop-1234abcd" has connected\n'
+    b'[2024-01-15T10:30:47] DEBUG: screen "laptop-1234abcd" updated clipboard 1\n'
+)
+BARRIER_LOG = (
+    b'[2024-03-02T08:15:00] INFO: switch from "macbook" to "linux-box" at 0,720\r\n'
+    b'[2024-03-02T08:15:02] NOTE: client "macbook" has disconnected\r\n'
+)
+DESKFLOW_LOG = (
+    b'[2024-11-05T14:02:11] DEBUG1: opening configuration "/home/user/.config/Deskflow/deskflow.conf"\n'
+    b'[2024-11-05T14:02:12] NOTE: client "workstation" has connected\n'
+    b'[2024-11-05T14:02:20] INFO: switch from "server" to "workstation" at 2559,800\n'
+)
+INPUT_LEAP_LOG = (
+    b'[2024-06-20T21:40:01] INFO: switch from "desk" to "tv" at 3839,1080\n'
+    b'[2024-06-20T21:40:03] DEBUG: screen "tv" updated clipboard 0\n'
+)
+
+
+def line_aligned_split(data, cut):
+    """Records from the complete lines before cut, then from the rest, as the follower reads them."""
+    head = data[:cut]
+    end = head.rfind(b'\n') + 1
+    return (nanomq_bindings.parse_log_events(data[:end]) +
+            nanomq_bindings.parse_log_events(data[end:]))
+
+
+@pytest.mark.unit
+class TestParseLogEvents:
+    """Test cases for parse_log_events."""
+
+    def test_synergy_lines(self):
+        """Test switch, connect and clipboard lines with hashed screen names."""
+        records = nanomq_bindings.parse_log_events(SYNERGY_LOG)
+
+        assert [r['kind'] for r in records] == ['switch', 'connect', 'clipboard']
+        assert records[0]['screen'] == 'studio-77773e4b'
+        assert records[0]['desktop'] == 'studio'
+        assert records[0]['from'] == 'laptop-1234abcd'
+        assert records[0]['time'] == '2024-01-15T10:30:45'
+        assert records[1]['desktop'] == 'laptop'
+        assert records[2]['clipboard'] == 1
+
+    def test_barrier_crlf_lines(self):
+        """Test Windows line endings do not leak into the names."""
+        records = nanomq_bindings.parse_log_events(BARRIER_LOG)
+
+        assert [(r['kind'], r['screen']) for r in records] == [
+            ('switch', 'linux-box'), ('disconnect', 'macbook')]
+        assert records[0]['from'] == 'macbook'
+
+    def test_deskflow_lines(self):
+        """Test unrelated lines are skipped and the rest kept in order."""
+        records = nanomq_bindings.parse_log_events(DESKFLOW_LOG)
+
+        assert [(r['kind'], r['desktop']) for r in records] == [
+            ('connect', 'workstation'), ('switch', 'workstation')]
+        assert records[1]['time'] == '2024-11-05T14:02:20'
+
+    def test_input_leap_lines(self):
+        """Test switch and clipboard lines."""
+        records = nanomq_bindings.parse_log_events(INPUT_LEAP_LOG)
+
+        assert [(r['kind'], r['screen']) for r in records] == [('switch', 'tv'), ('clipboard', 'tv')]
+        assert records[1]['clipboard'] == 0
+
+    def test_connect_and_disconnect_share_an_anchor(self):
+        """Test 'has connected' and 'has disconnected' are told apart."""
+        records = nanomq_bindings.parse_log_events(
+            b'NOTE: client "lab" has connected\nNOTE: client "lab" has disconnected\n')
+
+        assert [r['kind'] for r in records] == ['connect', 'disconnect']
+
+    def test_screen_names_that_spell_other_anchors(self):
+        """Test names such as 'client' or 'switch from' do not start another match."""
+        switch = nanomq_bindings.parse_log_events(b'INFO: switch from "client" to "screen" at 0,0\n')
+        clipboard = nanomq_bindings.parse_log_events(b'DEBUG: screen "switch from" updated clipboard 0\n')
+
+        assert [(r['kind'], r['from'], r['screen']) for r in switch] == [('switch', 'client', 'screen')]
+        assert [(r['kind'], r['screen']) for r in clipboard] == [('clipboard', 'switch from')]
+
+    def test_failed_match_does_not_hide_a_later_one(self):
+        """Test a near-miss earlier on the line does not stop the switch after it."""
+        records = nanomq_bindings.parse_log_events(
+            b'DEBUG: client "a" has connectedness; switch from "a" to "b" at 0,0\n')
+
+        assert [(r['kind'], r['screen']) for r in records] == [('switch', 'b')]
+
+    def test_one_record_per_line(self):
+        """Test only the first switch on a line is reported."""
+        records = nanomq_bindings.parse_log_events(
+            b'INFO: switch from "a" to "b" at 0,0 switch from "b" to "c" at 0,0\n')
+
+        assert [r['screen'] for r in records] == ['b']
+
+    @pytest.mark.parametrize('line', [
+        b'INFO: switch from "a" to "b"x\n',
+        b'NOTE: client "c" has connectedness\n',
+        b'DEBUG: screen "c" updated clipboard x\n',
+        b'INFO: switch from "" to "b" at 0,0\n',
+        b'INFO: switch from "laptop" to "stu',
+    ])
+    def test_near_misses(self, line):
+        """Test lines that almost match yield nothing."""
+        assert nanomq_bindings.parse_log_events(line) == []
+
+    def test_uppercase_suffix_is_kept(self):
+        """Test only Synergy's lowercase hex suffix is stripped from the desktop."""
+        records = nanomq_bindings.parse_log_events(
+            b'INFO: switch from "a-1234abcd" to "b-1234ABCD" at 0,0\n')
+
+        assert records[0]['desktop'] == 'b-1234ABCD'
+
+    def test_complete_line_without_newline(self):
+        """Test a whole line at the end of the buffer is parsed without its newline."""
+        records = nanomq_bindings.parse_log_events(b'INFO: switch from "a" to "b" at 0,0')
+
+        assert [r['screen'] for r in records] == ['b']
+
+    @pytest.mark.parametrize('log', [SYNERGY_LOG, BARRIER_LOG, DESKFLOW_LOG, INPUT_LEAP_LOG],
+                             ids=['synergy', 'barrier', 'deskflow', 'input-leap'])
+    def test_chunk_boundaries(self, log):
+        """Test every read boundary gives the same records once partial lines are carried over."""
+        whole = nanomq_bindings.parse_log_events(log)
+
+        for cut in range(len(log) + 1):
+            assert line_aligned_split(log, cut) == whole, cut
+
+    def test_cut_line_yields_nothing_until_complete(self):
+        """Test a line cut inside a name is not reported early."""
+        line = b'[2024-01-15T10:30:45] INFO: switch from "laptop" to "studio" at 1919,540\n'
+
+        for cut in range(line.index(b'"studio"') + 1, line.index(b' at ')):
+            assert nanomq_bindings.parse_log_events(line[:cut]) == [], cut
+        assert len(nanomq_bindings.parse_log_events(line)) == 1
+
+
+@pytest.mark.unit
+class TestScanSwitchEvents:
+    """Test cases for scan_switch_events."""
+
+    def test_matches_parser_switches(self):
+        """Test the scanner finds the same switches as the parser."""
+        log = SYNERGY_LOG + BARRIER_LOG + DESKFLOW_LOG + INPUT_LEAP_LOG
+        switches = [(r['from'], r['screen'], r['desktop'])
+                    for r in nanomq_bindings.parse_log_events(log) if r['kind'] == 'switch']
+
+        assert nanomq_bindings.scan_switch_events(log) == switches
+        assert len(switches) == 4
+
+    def test_ignores_other_kinds(self):
+        """Test connect, disconnect and clipboard lines are not switches."""
+        log = (b'NOTE: client "lab" has connected\nNOTE: client "lab" has disconnected\n'
+               b'DEBUG: screen "switch from" updated clipboard 0\n')
+
+        assert nanomq_bindings.scan_switch_events(log) == []
+
+    def test_strips_hash_suffix(self):
+        """Test the desktop drops Synergy's hash suffix."""
+        events = nanomq_bindings.scan_switch_events(SYNERGY_LOG)
+
+        assert events == [('laptop-1234abcd', 'studio-77773e4b', 'studio')]
+
+    @pytest.mark.parametrize('log', [SYNERGY_LOG, DESKFLOW_LOG])
+    def test_chunk_boundaries(self, log):
+        """Test every line-aligned split finds the same switches."""
+        whole = nanomq_bindings.scan_switch_events(log)
+
+        for cut in range(len(log) + 1):
+            end = log[:cut].rfind(b'\n') + 1
+            split = (nanomq_bindings.scan_switch_events(log[:end]) +
+                     nanomq_bindings.scan_switch_events(log[end:]))
+            assert split == whole, cut
+
+
+@pytest.mark.unit
+class TestFlapFilter:
+    """Test cases for FlapFilter."""
+
+    def test_single_switch_publishes(self):
+        """Test an isolated switch is published."""
+        flap = nanomq_bindings.FlapFilter(1000, 0)
+
+        assert flap.on_switch('studio') == 'publish'
+        assert not flap.is_flapping()
+        assert flap.timeout() is None
+
+    def test_rapid_switches_start_a_burst(self):
+        """Test a switch back within dwell starts suppressing."""
+        flap = nanomq_bindings.FlapFilter(1000, 0)
+
+        actions = [flap.on_switch(screen) for screen in ['b', 'a', 'b', 'a']]
+
+        assert actions == ['publish', 'publish', 'flapping', 'suppress']
+        assert flap.is_flapping()
+        assert flap.screen() == 'a'
+        assert flap.poll() is None
+
+    def test_burst_settles_after_dwell(self):
+        """Test poll() settles on the published screen and counts the burst."""
+        flap = nanomq_bindings.FlapFilter(100, 0)
+        for screen in ['b', 'a', 'b', 'a']:
+            flap.on_switch(screen)
+
+        time.sleep(0.25)
+
+        assert flap.poll() == ''
+        assert not flap.is_flapping()
+        assert flap.burst_suppressed() == 2
+        assert flap.stats() == {'suppressed': 2, 'bursts': 1}
+
+
+@pytest.mark.unit
+class TestEventQueue:
+    """Test cases for EventQueue."""
+
+    def test_fifo_order(self):
+        """Test messages come out in the order they went in."""
+        queue = nanomq_bindings.EventQueue(4)
+        for message in ['a', 'b', 'c']:
+            assert queue.push(message)
+
+        assert [queue.pop(10) for _ in range(3)] == ['a', 'b', 'c']
+        assert queue.pop(10) is None
+
+    def test_full_queue_drops_oldest(self):
+        """Test pushing into a full queue drops the oldest message."""
+        queue = nanomq_bindings.EventQueue(2)
+        queue.push('a')
+        queue.push('b')
+
+        assert queue.push('c') is False
+        assert [queue.pop(10), queue.pop(10)] == ['b', 'c']
+        stats = queue.stats()
+        assert stats['dropped'] == 1
+        assert stats['high_water'] == 2
+        assert stats['pushed'] == 3
+        assert stats['popped'] == 2
+
+    def test_close_drains_then_returns_none(self):
+        """Test queued messages can still be popped after close()."""
+        queue = nanomq_bindings.EventQueue(4)
+        queue.push('a')
+        queue.close()
+
+        assert queue.is_closed()
+        assert queue.pop(10) == 'a'
+        assert queue.pop(1000) is None
+
+
+@pytest.mark.unit
+class TestSharedMemoryReaders:
+    """Test cases for StatePageReader and EventRingReader."""
+
+    def test_missing_state_page_raises(self):
+        """Test attaching to a page nobody created fails."""
+        with pytest.raises(Exception):
+            nanomq_bindings.StatePageReader('/synergy-test-missing-%d' % os.getpid())
+
+    def test_missing_event_ring_raises(self):
+        """Test attaching to a ring nobody created fails."""
+        with pytest.raises(Exception):
+            nanomq_bindings.EventRingReader('/synergy-test-missing-%d' % os.getpid())
+
+
+@pytest.fixture
+def shm_names():
+    """Unique state page and event ring names, removed afterwards."""
+    names = ('/synergy-test-page-%d' % os.getpid(), '/synergy-test-ring-%d' % os.getpid())
+    yield names
+    for name in names:
+        path = '/dev/shm' + name
+        if os.path.exists(path):
+            os.unlink(path)
+
+
+@pytest.fixture
+def broker():
+    """Local MQTT broker stand-in from the benchmarks."""
+    sys.path.insert(0, os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))),
+                                    'benchmarks'))
+    from mqtt_standin import BrokerStandIn
+    stand_in = BrokerStandIn()
+    yield stand_in
+    stand_in.close()
+
+
+@pytest.mark.integration
+class TestSequenceTracking:
+    """Sequence tracking, state page and event ring on a real subscriber."""
+
+    TOPIC = 'synergy/test'
+
+    def payload(self, seq):
+        return json.dumps({'current_desktop': 'desk-%d' % seq, 'timestamp': '2024-01-15T10:30:45',
+                           'server': 'lab', 'source': 'pub-host', 'seq': seq})
+
+    def test_duplicates_and_late_messages_are_dropped(self, broker, shm_names):
+        """Test seqs 1, 2, 2, 5, 4, 6 reach the callback, page and ring as 1, 2, 5, 6."""
+        page_name, ring_name = shm_names
+        received = []
+        subscriber = nanomq_bindings.NanoMQTTClient('127.0.0.1', broker.port)
+        subscriber.set_sequence_tracking(True)
+        subscriber.set_state_page(page_name)
+        subscriber.set_event_ring(ring_name)
+        subscriber.set_message_callback(lambda topic, payload: received.append(json.loads(payload)['seq']))
+        publisher = nanomq_bindings.NanoMQTTClient('127.0.0.1', broker.port)
+        try:
+            assert subscriber.connect('test-sub-%d' % os.getpid())
+            assert subscriber.subscribe(self.TOPIC)
+            subscriber.start_message_loop()
+            ring = nanomq_bindings.EventRingReader(ring_name, True)
+            assert publisher.connect('test-pub-%d' % os.getpid())
+            time.sleep(0.2)
+
+            for seq in [1, 2, 2, 5, 4, 6]:
+                assert publisher.publish(self.TOPIC, self.payload(seq))
+
+            deadline = time.time() + 5
+            while len(received) < 4 and time.time() < deadline:
+                time.sleep(0.05)
+            time.sleep(0.2)
+
+            assert received == [1, 2, 5, 6]
+            stats = subscriber.sequence_stats()
+            assert stats['seq_duplicates'] == 1
+            assert stats['seq_gaps'] == 1
+            assert stats['seq_late'] == 1
+            assert stats['seq_missed'] == 1
+
+            state = nanomq_bindings.StatePageReader(page_name).read()
+            assert state['desktop'] == 'desk-6'
+            assert state['seq'] == 6
+            assert state['source'] == 'pub-host'
+            assert state['server'] == 'lab'
+
+            ring_seqs = []
+            event = ring.next(1000, self.TOPIC)
+            while event is not None:
+                ring_seqs.append(json.loads(event[1])['seq'])
+                event = ring.next(100, self.TOPIC)
+            assert ring_seqs == [1, 2, 5, 6]
+        finally:
+            publisher.disconnect()
+            subscriber.stop_message_loop()
+            subscriber.disconnect()
+
+
+@pytest.mark.integration
+class TestRetainedState:
+    """Retained messages and state replies update the state without reaching the callback."""
+
+    TOPIC = 'synergy/test-retained'
+
+    def test_retained_switch_on_subscribe_does_not_ring(self, broker, shm_names):
+        """Test the broker's retained switch fills the state page but is not a match."""
+        page_name, ring_name = shm_names
+        received = []
+        publisher = nanomq_bindings.NanoMQTTClient('127.0.0.1', broker.port)
+        subscriber = nanomq_bindings.NanoMQTTClient('127.0.0.1', broker.port)
+        subscriber.set_state_page(page_name)
+        subscriber.set_event_ring(ring_name)
+        subscriber.set_message_callback(lambda topic, payload: received.append(json.loads(payload)))
+        try:
+            assert publisher.connect('test-pub-%d' % os.getpid())
+            old = {'current_desktop': 'studio', 'timestamp': '2024-01-15T10:30:45+00:00'}
+            assert publisher.publish(self.TOPIC, json.dumps(old), 1, True)
+            time.sleep(0.2)
+
+            assert subscriber.connect('test-sub-%d' % os.getpid())
+            assert subscriber.subscribe(self.TOPIC)
+            subscriber.start_message_loop()
+            ring = nanomq_bindings.EventRingReader(ring_name, True)
+            deadline = time.time() + 5
+            while subscriber.current_desktop() is None and time.time() < deadline:
+                time.sleep(0.05)
+
+            state = subscriber.current_desktop()
+            assert state['desktop'] == 'studio'
+            assert state['retained'] is True
+            assert nanomq_bindings.StatePageReader(page_name).read()['desktop'] == 'studio'
+
+            reply = {'current_desktop': 'laptop', 'timestamp': '2024-01-15T10:31:00+00:00', 'state': True}
+            live = {'current_desktop': 'studio', 'timestamp': '2024-01-15T10:32:00+00:00'}
+            assert publisher.publish(self.TOPIC, json.dumps(reply))
+            assert publisher.publish(self.TOPIC, json.dumps(live))
+            deadline = time.time() + 5
+            while not received and time.time() < deadline:
+                time.sleep(0.05)
+            time.sleep(0.2)
+
+            # Only the live switch is an event; the other two are current state
+            assert [m['timestamp'] for m in received] == [live['timestamp']]
+            assert subscriber.receive_stats()['state_only'] == 2
+            event = ring.next(1000, self.TOPIC)
+            assert json.loads(event[1])['timestamp'] == live['timestamp']
+            assert ring.next(100, self.TOPIC) is None
+        finally:
+            publisher.disconnect()
+            subscriber.stop_message_loop()
+            subscriber.disconnect()
+
+
+@pytest.mark.integration
+class TestConnectRejected:
+    """A rejected CONNACK leaves the client able to connect again."""
+
+    def test_connect_after_reject(self, broker):
+        """Test a second connect() after a rejection dials again instead of claiming a session."""
+        client = nanomq_bindings.NanoMQTTClient('127.0.0.1', broker.port)
+        broker.connack_code = 5
+        try:
+            with pytest.raises(RuntimeError, match='rejected'):
+                client.connect('test-reject-%d' % os.getpid(), 2000)
+            assert not client.is_connected()
+            with pytest.raises(RuntimeError, match='rejected'):
+                client.connect('test-reject-%d' % os.getpid(), 2000)
+
+            broker.connack_code = 0
+            assert client.connect('test-reject-%d' % os.getpid(), 2000)
+            assert client.is_connected()
+            assert client.subscribe('synergy/test-reject')
+        finally:
+            client.disconnect()
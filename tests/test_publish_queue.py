@@ -0,0 +1,174 @@
+"""Unit tests for the publish stage that decouples waldo's reader from the broker"""
+
+import threading
+import time
+import pytest
+from unittest.mock import Mock
+
+from mqtt_clients.publish_queue import PublishQueue, PyEventQueue, PyFlapFilter
+
+
+@pytest.mark.unit
+class TestEventQueue:
+    """Test cases for the bounded queue (Python fallback of nanomq_bindings.EventQueue)"""
+
+    def test_full_queue_drops_oldest(self):
+        """Test push never blocks and evicts the oldest message when full"""
+        queue = PyEventQueue(2)
+
+        assert queue.push('a') is True
+        assert queue.push('b') is True
+        assert queue.push('c') is False
+
+        assert queue.pop(10) == 'b'
+        assert queue.pop(10) == 'c'
+        stats = queue.stats()
+        assert stats['dropped'] == 1
+        assert stats['high_water'] == 2
+        assert stats['depth'] == 0
+
+    def test_pop_times_out_and_close_wakes(self):
+        """Test pop returns None on timeout, and promptly once closed"""
+        queue = PyEventQueue(4)
+        assert queue.pop(10) is None
+
+        threading.Timer(0.05, queue.close).start()
+        start = time.monotonic()
+        assert queue.pop(5000) is None
+        assert time.monotonic() - start < 2
+
+
+@pytest.mark.unit
+class TestPublishQueue:
+    """Test cases for PublishQueue"""
+
+    def test_publishes_in_order(self):
+        """Test messages are published in submission order and reported"""
+        publisher = Mock()
+        publisher.publish.return_value = True
+        published = []
+
+        queue = PublishQueue(publisher, on_published=published.append)
+        for message in ['one', 'two', 'three']:
+            queue.submit(message)
+        queue.close()
+
+        assert published == ['one', 'two', 'three']
+        assert queue.metrics()['published'] == 3
+
+    def test_retry_does_not_block_newer_messages(self):
+        """Test a failed publish is retried later while newer messages go out"""
+        publisher = Mock()
+        attempts = []
+
+        def publish(message):
+            attempts.append(message)
+            return message != 'old' or attempts.count('old') > 1
+
+        publisher.publish.side_effect = publish
+        queue = PublishQueue(publisher, retry_delay=0.2)
+        queue.submit('old')
+        time.sleep(0.05)
+        queue.submit('new')
+        queue.close()
+
+        # 'new' went out before the retry was due and superseded 'old'
+        assert attempts == ['old', 'new']
+        metrics = queue.metrics()
+        assert metrics['retries'] == 1
+        assert metrics['superseded'] == 1
+        assert metrics['retry_pending'] == 0
+
+    def test_older_retry_keeps_newer_retry_pending(self):
+        """Test a newer message's pending retry is never dropped for an older one"""
+        publisher = Mock()
+        attempts = []
+        broker_up = threading.Event()
+
+        def publish(message):
+            attempts.append(message)
+            return broker_up.is_set()
+
+        publisher.publish.side_effect = publish
+        queue = PublishQueue(publisher, retry_delay=0.1)
+        queue.submit('A')
+        time.sleep(0.02)
+        queue.submit('B')
+        time.sleep(0.02)
+        broker_up.set()
+        queue.close()
+
+        # A's retry was superseded by B's, and B, the current desktop, went out
+        assert attempts == ['A', 'B', 'B']
+        metrics = queue.metrics()
+        assert metrics['published'] == 1
+        assert metrics['superseded'] == 1
+        assert metrics['retry_pending'] == 0
+
+    def test_gives_up_after_max_retries(self):
+        """Test a message that keeps failing is counted as a failure"""
+        publisher = Mock()
+        publisher.publish.return_value = False
+
+        queue = PublishQueue(publisher, max_retries=3, retry_delay=0.01)
+        queue.submit('lost')
+        queue.close()
+
+        assert publisher.publish.call_count == 3
+        metrics = queue.metrics()
+        assert metrics['retries'] == 2
+        assert metrics['failures'] == 1
+
+
+@pytest.mark.unit
+class TestFlapFilter:
+    """Test cases for flap suppression (Python fallback of nanomq_bindings.FlapFilter)"""
+
+    def test_clean_and_traversing_switches_publish_immediately(self):
+        """Test switches that are not rapid reversals are never held back"""
+        flaps = PyFlapFilter(dwell_ms=300)
+
+        assert flaps.on_switch('a') == 'publish'
+        assert flaps.on_switch('b') == 'publish'
+        assert flaps.on_switch('c') == 'publish'
+        assert flaps.timeout() is None
+
+    def test_edge_riding_burst_settles_on_final_screen(self):
+        """Test a reversal starts suppression and the final screen is published once settled"""
+        flaps = PyFlapFilter(dwell_ms=50)
+
+        assert flaps.on_switch('a') == 'publish'
+        assert flaps.on_switch('b') == 'publish'
+        assert flaps.on_switch('a') == 'flapping'
+        assert flaps.on_switch('b') == 'suppress'
+        assert flaps.on_switch('a') == 'suppress'
+        assert flaps.poll() is None
+
+        time.sleep(0.08)
+        assert flaps.poll() == 'a'
+        assert flaps.stats() == {'suppressed': 3, 'bursts': 1}
+
+    def test_hysteresis_lets_reversals_through(self):
+        """Test the first `hysteresis` reversals of a burst are still published"""
+        flaps = PyFlapFilter(dwell_ms=300, hysteresis=1)
+
+        flaps.on_switch('a')
+        flaps.on_switch('b')
+        assert flaps.on_switch('a') == 'publish'
+        assert flaps.on_switch('b') == 'flapping'
+
+    def test_publish_queue_holds_back_flapping(self):
+        """Test PublishQueue publishes the clean switch at once and the settled one after dwell"""
+        publisher = Mock()
+        publisher.publish.return_value = True
+        published = []
+
+        queue = PublishQueue(publisher, on_published=published.append,
+                             flap_filter=PyFlapFilter(dwell_ms=50))
+        for desktop in ['a', 'b', 'a', 'b', 'a']:
+            queue.submit(f'to {desktop}', desktop=desktop)
+        time.sleep(0.3)
+
+        assert published == ['to a', 'to b', 'to a']
+        queue.close()
+        assert queue.metrics()['flaps_suppressed'] == 3
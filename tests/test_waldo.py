@@ -2,9 +2,13 @@
 
 import pytest
 import time
+import functools
+import json
+from datetime import datetime
 from unittest.mock import Mock, patch, MagicMock, call
 import paho.mqtt.client as mqtt
 from mqtt_clients.paho_client import PahoMQTTPublisher as MQTTPublisher
+from mqtt_clients.publish_queue import PublishQueue
 
 
 class TestMQTTPublisher:
@@ -174,6 +178,48 @@ class TestLogProcessing:
         assert mock_publisher.publish.call_count == 1
         published_message = mock_publisher.publish.call_args[0][0]
         assert '"current_desktop": "desktop1"' in published_message
+        # Timestamps carry their UTC offset so subscribers in other zones compare correctly
+        timestamp = json.loads(published_message)['timestamp']
+        assert datetime.fromisoformat(timestamp).utcoffset() is not None
+
+    @patch('waldo.MQTTClientFactory')
+    def test_process_logs_with_local_alert(self, mock_factory):
+        """Test --alert attaches a subscriber on the publisher's own connection"""
+        from waldo import process_logs
+
+        mock_publisher = MagicMock()
+        mock_factory.create_publisher.return_value = mock_publisher
+
+        with patch('sys.stdin', []), patch('waldo.Config.EVENT_MAX_AGE_MS', 5000), \
+                patch('waldo.Config.EVENT_SEQUENCE', True), patch('waldo.Config.STATE_PAGE', '/test-desktop'), \
+                patch('waldo.Config.EVENT_RING', '/test-events'):
+            process_logs('test.broker', 1883, 'test/topic', 'nanomq', alert='studio')
+
+        mock_publisher.local_subscriber.assert_called_once_with('current_desktop', 'studio',
+                                                                max_event_age_ms=5000,
+                                                                track_sequence=True,
+                                                                state_page='/test-desktop',
+                                                                event_ring='/test-events')
+        mock_publisher.local_subscriber.return_value.attach.assert_called_once()
+        mock_factory.create_subscriber.assert_not_called()
+
+    @patch('waldo.MQTTClientFactory')
+    def test_sighup_updates_local_alert_target(self, mock_factory):
+        """Test SIGHUP applies a new TARGET_DESKTOP to the local alert, not just the topic"""
+        from waldo import process_logs
+
+        mock_publisher = MagicMock()
+        mock_factory.create_publisher.return_value = mock_publisher
+
+        with patch('sys.stdin', []), patch('waldo.install_signal_handlers') as mock_handlers:
+            process_logs('test.broker', 1883, 'test/topic', 'nanomq', alert='studio')
+        reconfigure = mock_handlers.call_args[0][1]
+
+        with patch('waldo.reload_config', return_value={'topic': 'new/topic', 'value': 'office'}):
+            reconfigure()
+
+        mock_publisher.reconfigure.assert_called_once_with('new/topic')
+        mock_publisher.local_subscriber.return_value.reconfigure.assert_called_once_with(value='office')
 
     @patch('waldo.MQTTClientFactory')
     def test_process_logs_retry_logic(self, mock_factory):
@@ -186,8 +232,10 @@ class TestLogProcessing:
         # Simulate publish failing twice then succeeding
         mock_publisher.publish.side_effect = [False, False, True]
 
+        # Same schedule as production (delay, then double), scaled down
+        fast_queue = functools.partial(PublishQueue, retry_delay=0.01)
         with patch('sys.stdin', ['switch from "other-aabbccdd" to "desktop1-12345678" at 0,100\n']):
-            with patch('time.sleep') as mock_sleep:
+            with patch('waldo.PublishQueue', fast_queue), patch('time.sleep') as mock_sleep:
                 try:
                     process_logs('test.broker', 1883, 'test/topic')
                 except StopIteration:
@@ -195,6 +243,124 @@ class TestLogProcessing:
 
         # Should have tried 3 times
         assert mock_publisher.publish.call_count == 3
-        # Should have slept between retries
-        assert mock_sleep.call_count == 2
-        mock_sleep.assert_has_calls([call(2), call(4)])  # Exponential backoff
\ No newline at end of file
+        # Retries are scheduled by the publish stage; the reader never sleeps
+        mock_sleep.assert_not_called()
+
+@pytest.mark.unit
+class TestParseSwitchLine:
+    """Test cases for switch-line parsing"""
+
+    def test_switch_line(self):
+        """Test a switch line yields the target with the hash suffix stripped"""
+        from utils import parse_switch_line
+
+        line = '[2025-01-01T12:00:00] INFO: switch from "laptop-1234abcd" to "studio-77773e4b" at 1919,540\n'
+        assert parse_switch_line(line) == 'studio'
+
+    def test_switch_line_at_end_of_line(self):
+        """Test the closing quote may end the line"""
+        from utils import parse_switch_line
+
+        assert parse_switch_line('switch from "a" to "desk"\n') == 'desk'
+
+    def test_unrelated_lines_ignored(self):
+        """Test lines that merely contain to "..." are not switch events"""
+        from utils import parse_switch_line
+
+        assert parse_switch_line('DEBUG: sending clipboard to "studio-77773e4b"\n') is None
+        assert parse_switch_line('switch from "" to "studio"\n') is None
+        assert parse_switch_line('switch from "a" to "studio"x\n') is None
+
+@pytest.mark.unit
+class TestRotatedLogs:
+    """Test cases for finding a log's rotated predecessors"""
+
+    def test_oldest_first(self, tmp_path):
+        """Test numbered and gzipped rotations come oldest first, the live log last"""
+        from utils import rotated_logs
+
+        for name in ['synergy.log', 'synergy.log.1', 'synergy.log.2.gz', 'synergy.log.10.gz',
+                     'synergy.log.bak', 'other.log.1']:
+            (tmp_path / name).write_text('')
+
+        assert rotated_logs(str(tmp_path / 'synergy.log')) == [
+            str(tmp_path / 'synergy.log.10.gz'),
+            str(tmp_path / 'synergy.log.2.gz'),
+            str(tmp_path / 'synergy.log.1'),
+            str(tmp_path / 'synergy.log'),
+        ]
+
+    def test_dated_rotations(self, tmp_path):
+        """Test dateext rotations sort by date and a missing live log is skipped"""
+        from utils import rotated_logs
+
+        for name in ['synergy.log-20250102.gz', 'synergy.log-20250101']:
+            (tmp_path / name).write_text('')
+
+        assert rotated_logs(str(tmp_path / 'synergy.log')) == [
+            str(tmp_path / 'synergy.log-20250101'),
+            str(tmp_path / 'synergy.log-20250102.gz'),
+        ]
+
+@pytest.mark.unit
+class TestLogSources:
+    """Test cases for parsing and checking the logs to follow"""
+
+    def test_tagged_and_untagged(self):
+        """Test SERVER=PATH and bare PATH specs"""
+        from config import get_log_sources
+
+        assert get_log_sources(['office=/logs/a.log', ' /logs/b.log ']) == [
+            ('office', '/logs/a.log'),
+            ('', '/logs/b.log'),
+        ]
+
+    def test_duplicate_server_tag_rejected(self):
+        """Test two logs under one tag are an error, since they would share a checkpoint"""
+        from config import get_log_sources, log_source_errors
+
+        sources = get_log_sources(['office=/logs/a.log', 'office=/logs/b.log', '/logs/c.log', '/logs/d.log'])
+        errors = log_source_errors(sources)
+        assert len(errors) == 1
+        assert "'office'" in errors[0] and '/logs/a.log' in errors[0] and '/logs/b.log' in errors[0]
+        assert log_source_errors(get_log_sources(['office=/logs/a.log', 'lab=/logs/b.log'])) == []
+
+@pytest.mark.unit
+class TestMainFunction:
+    """Test the command line entry point"""
+
+    @patch('sys.argv', ['waldo.py', '--client-type', 'nanomq', '--alert', 'studio'])
+    @patch('waldo.override_config')
+    @patch('waldo.live_publisher_options', return_value={})
+    @patch('waldo.process_logs')
+    def test_alert_passed_to_process_logs(self, mock_process_logs, mock_live_options, mock_override):
+        """Test --alert is parsed and reaches the publisher as start.sh passes it"""
+        from waldo import main
+
+        main()
+
+        mock_process_logs.assert_called_once()
+        assert mock_process_logs.call_args.kwargs['alert'] == 'studio'
+
+    @patch('sys.argv', ['waldo.py', '--client-type', 'paho'])
+    @patch('waldo.override_config')
+    @patch('waldo.process_logs')
+    def test_alert_defaults_to_none(self, mock_process_logs, mock_override):
+        """Test no local alert runs unless --alert is given"""
+        from waldo import main
+
+        main()
+
+        assert mock_process_logs.call_args.kwargs['alert'] is None
+
+    @patch('sys.argv', ['waldo.py', '--client-type', 'paho', '--alert', 'studio'])
+    @patch('waldo.override_config')
+    @patch('waldo.process_logs')
+    def test_alert_requires_nanomq(self, mock_process_logs, mock_override):
+        """Test --alert is refused for clients that cannot share the connection"""
+        from waldo import main
+
+        with pytest.raises(SystemExit):
+            main()
+
+        mock_process_logs.assert_not_called()
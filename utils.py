@@ -1,13 +1,30 @@
 """Utility functions for the Synergy MQTT monitoring system"""
 
+import os
+import re
+import sys
 import time
+import signal
 import functools
 import logging
-from typing import Callable, Any, Optional, TypeVar, cast
+from typing import Callable, Any, List, Optional, TypeVar, cast
+
+try:
+    from nanomq_bindings import scan_switch_events as _native_scan_switch_events
+except ImportError:
+    _native_scan_switch_events = None
 
 
 logger = logging.getLogger(__name__)
 
+# Same grammar as the native scanner (mqtt_clients/native/switch_scanner.h):
+#   switch from "<from>" to "<to>" followed by a space or the end of the line
+SWITCH_LINE_RE = re.compile(r'switch from "([^"\n]+)" to "([^"\n]+)"(?=[ \r\n]|$)')
+SWITCH_HASH_SUFFIX_RE = re.compile(r'-[0-9a-f]{8}$')
+
+# Suffixes logrotate gives rotated logs: ".3", ".3.gz", "-20250101", "-20250101.gz"
+ROTATED_LOG_RE = re.compile(r'^(?:\.(\d+)|-(\d{8,10}))(?:\.gz)?$')
+
 T = TypeVar('T')
 
 
@@ -72,6 +89,69 @@ def retry_with_backoff(
     return decorator
 
 
+def parse_switch_line(line: str) -> Optional[str]:
+    """
+    Extract the desktop a Synergy log line switches to.
+    
+    Only lines of the form `switch from "<a>" to "<b>"` count, so other log
+    lines that happen to contain `to "` are ignored. Synergy's trailing hex
+    hash is stripped ("studio-77773e4b" -> "studio"). Uses the native SIMD
+    scanner when the NanoMQ bindings are built.
+    
+    Args:
+        line: One line of the Synergy log
+    
+    Returns:
+        The target desktop name, or None if the line is not a switch event
+    """
+    if _native_scan_switch_events is not None:
+        events = _native_scan_switch_events(line.encode())
+        return events[0][2] if events else None
+    
+    match = SWITCH_LINE_RE.search(line)
+    if not match:
+        return None
+    return SWITCH_HASH_SUFFIX_RE.sub('', match.group(2))
+
+
+def rotated_logs(path: str) -> List[str]:
+    """
+    List a log and its rotated predecessors, oldest first.
+    
+    Recognises logrotate's numbered names (synergy.log.1, synergy.log.2.gz)
+    and dated names (synergy.log-20250101, synergy.log-20250101.gz); the
+    live log, if present, comes last.
+    
+    Args:
+        path: The live log
+    
+    Returns:
+        Existing file paths in the order their lines were written
+    """
+    directory = os.path.dirname(path) or '.'
+    base = os.path.basename(path)
+    numbered, dated = [], []
+    try:
+        names = os.listdir(directory)
+    except OSError:
+        names = []
+    for name in names:
+        match = ROTATED_LOG_RE.match(name[len(base):]) if name.startswith(base) else None
+        if not match:
+            continue
+        full = os.path.join(directory, name)
+        if match.group(1):
+            numbered.append((-int(match.group(1)), full))
+        else:
+            dated.append((match.group(2), full))
+
+    # Higher numbers are older; dates sort oldest first as strings
+    logs = [p for _, p in sorted(numbered)] + [p for _, p in sorted(dated)]
+    if os.path.exists(path):
+        logs.append(path)
+    return logs
+
+
 def setup_logging(name: str, level: int = logging.INFO) -> logging.Logger:
     """
     Set up a logger with consistent formatting.
@@ -97,4 +177,48 @@ def setup_logging(name: str, level: int = logging.INFO) -> logging.Logger:
     handler.setFormatter(formatter)
     logger.addHandler(handler)
     
-    return logger
\ No newline at end of file
+    return logger
+
+def install_signal_handlers(restart: Callable[[], Any],
+                            reconfigure: Optional[Callable[[], Any]] = None,
+                            restart_marker: Optional[str] = None) -> None:
+    """
+    Install the service lifecycle signal handlers.
+    
+    SIGTERM exits through the normal shutdown path so ``finally`` blocks can
+    close the MQTT connection gracefully. SIGUSR1 calls ``restart`` to
+    reconnect in place, which is how watchdog.sh recovers from a broker
+    outage without relaunching the process. SIGHUP calls ``reconfigure``
+    to apply changed settings on the live connection.
+    
+    Args:
+        restart: Callable that re-establishes the broker connection
+        reconfigure: Optional callable that reloads settings and applies them
+        restart_marker: Optional file written once an in-place restart has
+            reconnected; watchdog.sh removes it, signals, and waits for it
+    """
+    def on_term(signum, frame):
+        logger.info("Received SIGTERM, shutting down")
+        sys.exit(0)
+    
+    def on_restart(signum, frame):
+        logger.info("Received SIGUSR1, restarting connection in place")
+        if not restart():
+            logger.warning("In-place restart did not reconnect")
+            return
+        if restart_marker:
+            try:
+                with open(restart_marker, 'w') as marker:
+                    marker.write(f"{os.getpid()} {time.time():.3f}\n")
+            except OSError as e:
+                logger.warning(f"Could not write restart marker {restart_marker}: {e}")
+    
+    def on_reconfigure(signum, frame):
+        logger.info("Received SIGHUP, reloading configuration")
+        reconfigure()
+    
+    signal.signal(signal.SIGTERM, on_term)
+    if hasattr(signal, 'SIGUSR1'):
+        signal.signal(signal.SIGUSR1, on_restart)
+    if reconfigure and hasattr(signal, 'SIGHUP'):
+        signal.signal(signal.SIGHUP, on_reconfigure)
@@ -1,13 +1,15 @@
 import sys
 import os
-import re
 import json
 import argparse
 import time
 import logging
 from datetime import datetime
 from mqtt_clients.factory import MQTTClientFactory
-from config import Config, get_mqtt_config, override_config
+from mqtt_clients.publish_queue import PublishQueue, create_flap_filter
+from config import (Config, get_mqtt_config, get_client_options, get_log_sources, get_multicast_options,
+                    get_presence_options, log_source_errors, override_config, reload_config)
+from utils import install_signal_handlers, parse_switch_line, rotated_logs
 
 # Configure logging - only show errors by default
 # Create logs directory if it doesn't exist
@@ -34,65 +36,245 @@ logging.basicConfig(
 )
 logger = logging.getLogger('waldo')
 
-def process_logs(broker_address, port, topic, client_type='paho'):
+def attach_local_alert(publisher, target_desktop):
+    """
+    Run found-him's alert for target_desktop inside this process.
+    
+    The subscriber shares the publisher's NanoMQ connection: switches read
+    here ring the bell as soon as they are published, without the round trip
+    through the broker, and the broker's copy is dropped as a duplicate.
+    Other primaries' switches still arrive through the broker.
+    
+    Args:
+        publisher: Connected NanoMQTTPublisher
+        target_desktop: Desktop name to alert on
+    """
+    subscriber = publisher.local_subscriber('current_desktop', target_desktop,
+                                            max_event_age_ms=Config.EVENT_MAX_AGE_MS,
+                                            track_sequence=Config.EVENT_SEQUENCE,
+                                            state_page=Config.STATE_PAGE,
+                                            event_ring=Config.EVENT_RING)
+    subscriber.attach()
+    logger.info(f"Local alert for {target_desktop} shares the publisher's connection")
+    return subscriber
+
+def reconfigure_from_env(publisher, subscriber=None):
+    """
+    Apply reload_config() on SIGHUP: the publish topic, and with a local
+    alert the target desktop too.
+    
+    Args:
+        publisher: Publisher to move to the new topic (its local subscriber follows)
+        subscriber: Local alert subscriber from attach_local_alert(), if any
+    
+    Returns:
+        bool: True if the new settings are in effect
+    """
+    updates = reload_config()
+    applied = publisher.reconfigure(updates.get('topic'))
+    if subscriber and updates.get('value'):
+        applied = subscriber.reconfigure(value=updates['value']) and applied
+    return applied
+
+def live_publisher_options(client_type):
+    """
+    Publisher options for live events: sequence numbers, retained state,
+    the multicast fast path and presence.
+    
+    Only the nanomq client supports them, and backfills never use them: a
+    replay of history would consume the live publisher's numbers, leave
+    an old switch as the retained one, ring bells on the LAN and mark the
+    live publisher offline when it ends.
+    
+    Args:
+        client_type: MQTT client type the publisher will use
+        
+    Returns:
+        dict: Keyword arguments for the publisher, empty if disabled
+    """
+    if client_type != 'nanomq':
+        return {}
+    options = {}
+    if Config.EVENT_SEQUENCE:
+        sequence_file = Config.EVENT_SEQUENCE_FILE
+        if sequence_file:
+            os.makedirs(os.path.dirname(sequence_file) or '.', exist_ok=True)
+        options.update(source=Config.EVENT_SOURCE, sequence_file=sequence_file)
+    if Config.MQTT_RETAIN_STATE:
+        options['retain'] = True
+    if Config.EVENT_SEQUENCE and Config.MULTICAST_GROUP:
+        options['multicast'] = get_multicast_options()
+    if Config.PRESENCE:
+        options['presence'] = get_presence_options('waldo')
+    return options
+
+def process_logs(broker_address, port, topic, client_type='paho', client_options=None, alert=None):
     """
     Process Synergy log entries from stdin and publish desktop switching events.
     
     Reads log lines from stdin, extracts desktop names from switch events,
-    and publishes them as JSON messages to the MQTT broker.
+    and hands them as JSON messages to a publish queue. Publishing and its
+    retries run on the queue's worker thread, so a slow or failing broker
+    never stops the reader from draining the log pipe.
     
     Args:
         broker_address: MQTT broker hostname or IP address
         port: MQTT broker port number
         topic: MQTT topic to publish messages to
         client_type: MQTT client type to use (default: 'paho')
+        client_options: Optional client settings such as TLS (nanomq only)
+        alert: Optional desktop to alert on in-process (nanomq only)
     """
-    publisher = MQTTClientFactory.create_publisher(client_type, broker_address, port, topic)
+    publisher = MQTTClientFactory.create_publisher(client_type, broker_address, port, topic,
+                                                   **(client_options or {}))
     
     # Initial connection
     publisher.connect_with_retry()
+    subscriber = attach_local_alert(publisher, alert) if alert else None
+    install_signal_handlers(publisher.restart, lambda: reconfigure_from_env(publisher, subscriber),
+                            restart_marker=os.path.join(log_dir, 'waldo.restarted'))
+    
+    def on_published(message):
+        print(json.loads(message)['current_desktop'], flush=True)
+    
+    flap_filter = None
+    if Config.FLAP_DWELL_MS > 0:
+        flap_filter = create_flap_filter(Config.FLAP_DWELL_MS, Config.FLAP_HYSTERESIS)
+    queue = PublishQueue(publisher, capacity=Config.PUBLISH_QUEUE_SIZE, on_published=on_published,
+                         flap_filter=flap_filter)
     
     try:
         for line in sys.stdin:
-            match = re.search(r'to "([^"]+)"', line)
-            if match:
-                raw_name = match.group(1)
-                # Strip trailing Synergy hex hash suffix (e.g., "studio-77773e4b" -> "studio")
-                system_name = re.sub(r'-[0-9a-f]{8}$', '', raw_name)
-                timestamp = datetime.now().isoformat()
-                message = json.dumps({
+            # Desktop name with the Synergy hex hash suffix stripped
+            # (e.g., "studio-77773e4b" -> "studio")
+            system_name = parse_switch_line(line)
+            if system_name:
+                timestamp = datetime.now().astimezone().isoformat()
+                queue.submit(json.dumps({
                     'current_desktop': system_name,
                     'timestamp': timestamp
-                })
-                
-                # Retry publishing with exponential backoff
-                retry_count = 0
-                max_retries = 3
-                published = False
-                
-                while retry_count < max_retries and not published:
-                    if publisher.publish(message):
-                        print(f"{system_name}")
-                        published = True
-                    else:
-                        retry_count += 1
-                        if retry_count < max_retries:
-                            wait_time = 2 ** retry_count
-                            logger.debug(f"Publish retry {retry_count}/{max_retries}, waiting {wait_time}s")
-                            time.sleep(wait_time)
-
-                if not published:
-                    logger.error(f"Failed to publish after {max_retries} retries: {system_name}")
+                }), desktop=system_name)
 
     except KeyboardInterrupt:
         logger.info("Received interrupt signal, shutting down")
     except Exception as e:
         logger.error(f"Unexpected error in process_logs: {e}")
     finally:
+        queue.close()
         logger.info("Closing MQTT connection")
         publisher.close()
 
-if __name__ == "__main__":
+def follow_logs(broker_address, port, topic, sources, client_options=None, checkpoint_path=None, alert=None):
+    """
+    Follow Synergy logs natively and publish desktop switching events.
+    
+    Replaces reading `tail -F` output from stdin: the NanoMQ log follower
+    watches the files itself, survives rotation and truncation, and publishes
+    each switch from native code. Requires the nanomq client.
+    
+    Several servers' logs share one follower thread and one MQTT connection;
+    events from a log with a server name carry it in the payload. Client
+    connects, disconnects and clipboard updates go to MQTT_EVENTS_TOPIC if set.
+    
+    With a checkpoint path, the read position is saved after every published
+    switch and a restart resumes there, even if the log was rotated meanwhile.
+    
+    Args:
+        broker_address: MQTT broker hostname or IP address
+        port: MQTT broker port number
+        topic: MQTT topic to publish messages to
+        sources: (server, path) pairs of Synergy logs to follow
+        client_options: Optional client settings such as TLS
+        checkpoint_path: Optional file to save and resume the read position
+        alert: Optional desktop to alert on in-process
+    """
+    publisher = MQTTClientFactory.create_publisher('nanomq', broker_address, port, topic,
+                                                   **(client_options or {}))
+    
+    # Initial connection
+    publisher.connect_with_retry()
+    subscriber = attach_local_alert(publisher, alert) if alert else None
+    install_signal_handlers(publisher.restart, lambda: reconfigure_from_env(publisher, subscriber),
+                            restart_marker=os.path.join(log_dir, 'waldo.restarted'))
+    
+    def on_event(system_name, published, server):
+        if published:
+            print(f"{server}: {system_name}" if server else f"{system_name}", flush=True)
+        else:
+            logger.error(f"Failed to publish: {system_name}")
+            publisher.connected = False
+    
+    try:
+        publisher.follow_logs(sources, on_event, checkpoint_path=checkpoint_path,
+                              events_topic=Config.MQTT_EVENTS_TOPIC, flap_dwell_ms=Config.FLAP_DWELL_MS,
+                              flap_hysteresis=Config.FLAP_HYSTERESIS, report_flapping=Config.FLAP_REPORT)
+        while True:
+            time.sleep(1)
+            if not publisher.connected:
+                publisher.connect_with_retry()
+    
+    except KeyboardInterrupt:
+        logger.info("Received interrupt signal, shutting down")
+    except Exception as e:
+        logger.error(f"Unexpected error in follow_logs: {e}")
+    finally:
+        publisher.stop_following()
+        logger.info("Closing MQTT connection")
+        publisher.close()
+
+def backfill_logs(broker_address, port, topic, sources, client_options=None, output=None,
+                  rate=0.0, threads=0):
+    """
+    Replay Synergy's log history: each log plus its rotated (and gzipped)
+    predecessors, parsed in parallel into one time-ordered event stream.
+    
+    The events are written to `output` as JSON lines, or published to the
+    broker, throttled to `rate` events per second if given. Requires the
+    NanoMQ bindings.
+    
+    Args:
+        broker_address: MQTT broker hostname or IP address
+        port: MQTT broker port number
+        topic: MQTT topic to publish messages to
+        sources: (server, path) pairs of live Synergy logs
+        client_options: Optional client settings such as TLS
+        output: Optional JSON-lines file to write instead of publishing
+        rate: Events per second when publishing, 0 for unthrottled
+        threads: Parser threads, 0 for one per core
+    """
+    files = [(server, log) for server, path in sources for log in rotated_logs(path)]
+    if not files:
+        logger.error(f"No logs found for {', '.join(path for _, path in sources)}")
+        return
+    
+    if output:
+        from mqtt_clients.nanomq_client import load_backfill
+        backfill = load_backfill(files, threads)
+        count = backfill.write_jsonl(output)
+        logger.info(f"Wrote {count} events from {len(files)} file(s) to {output}: {backfill.stats()}")
+        print(f"{count} events -> {output}")
+        return
+    
+    publisher = MQTTClientFactory.create_publisher('nanomq', broker_address, port, topic,
+                                                   **(client_options or {}))
+    publisher.connect_with_retry()
+    try:
+        published = publisher.backfill(files, rate=rate, threads=threads,
+                                       events_topic=Config.MQTT_EVENTS_TOPIC)
+        print(f"{published} events published")
+    except KeyboardInterrupt:
+        logger.info("Received interrupt signal, shutting down")
+    finally:
+        logger.info("Closing MQTT connection")
+        publisher.close()
+
+def main():
+    """
+    Main entry point for the log publisher.
+    
+    Parses command-line arguments, validates the configuration and reads
+    the Synergy log from stdin, follows it natively or backfills it.
+    """
     parser = argparse.ArgumentParser(description='Process logs and publish to MQTT.')
     parser.add_argument('--broker', type=str, default=Config.MQTT_BROKER, 
                         help=f'MQTT broker address (default: {Config.MQTT_BROKER})')
@@ -101,10 +283,30 @@ if __name__ == "__main__":
     parser.add_argument('--topic', type=str, default=Config.MQTT_TOPIC, 
                         help=f'MQTT topic (default: {Config.MQTT_TOPIC})')
     parser.add_argument('--client-type', type=str, default=Config.MQTT_CLIENT_TYPE, 
-                        choices=MQTTClientFactory.get_supported_clients(),
+                        choices=MQTTClientFactory.get_supported_clients(publishing=True),
                         help=f'MQTT client type to use (default: {Config.MQTT_CLIENT_TYPE})')
     parser.add_argument('--debug', action='store_true', default=Config.DEBUG_MODE,
                         help='Enable debug logging')
+    parser.add_argument('--follow', nargs='*', default=None, metavar='[SERVER=]LOG_PATH',
+                        help='Follow logs natively instead of reading stdin (nanomq only); '
+                             'several logs can be given, tagged with their Synergy server '
+                             f'(default: SYNERGY_LOG_SOURCES or {Config.SYNERGY_LOG_PATH})')
+    parser.add_argument('--backfill', nargs='*', default=None, metavar='[SERVER=]LOG_PATH',
+                        help='Replay the logs and their rotated .N/.gz predecessors in time order, '
+                             'then exit (needs the nanomq bindings; same sources as --follow)')
+    parser.add_argument('--output', type=str, default=None, metavar='PATH',
+                        help='With --backfill, write JSON lines here instead of publishing')
+    parser.add_argument('--rate', type=float, default=0.0,
+                        help='With --backfill, publish at most this many events per second (default: no limit)')
+    parser.add_argument('--threads', type=int, default=0,
+                        help='With --backfill, parser threads (default: one per core)')
+    parser.add_argument('--checkpoint', type=str, default=Config.SYNERGY_LOG_CHECKPOINT,
+                        metavar='PATH',
+                        help='File recording the --follow read position; pass "" to always start '
+                             f'at the end of the log (default: {Config.SYNERGY_LOG_CHECKPOINT})')
+    parser.add_argument('--alert', type=str, default=None, metavar='DESKTOP',
+                        help='Also alert when DESKTOP becomes active, on the publisher\'s connection '
+                             '(nanomq only; default: no local alert)')
     
     args = parser.parse_args()
     
@@ -133,4 +335,35 @@ if __name__ == "__main__":
             logger.error(f"  - {error}")
         sys.exit(1)
     
-    process_logs(args.broker, args.port, args.topic, args.client_type)
\ No newline at end of file
+    if args.alert and args.client_type != 'nanomq':
+        logger.error("--alert requires --client-type nanomq; run found-him.py separately instead")
+        sys.exit(1)
+    
+    if args.backfill is not None:
+        if args.client_type != 'nanomq' and not args.output:
+            logger.error("--backfill requires --client-type nanomq unless --output is given")
+            sys.exit(1)
+        backfill_logs(args.broker, args.port, args.topic, get_log_sources(args.backfill), get_client_options(),
+                      output=args.output, rate=args.rate, threads=args.threads)
+    elif args.follow is not None:
+        if args.client_type != 'nanomq':
+            logger.error("--follow requires --client-type nanomq")
+            sys.exit(1)
+        sources = get_log_sources(args.follow)
+        source_errors = log_source_errors(sources)
+        if source_errors:
+            for error in source_errors:
+                logger.error(error)
+            sys.exit(1)
+        follow_logs(args.broker, args.port, args.topic, sources,
+                    {**get_client_options(), **live_publisher_options('nanomq')},
+                    checkpoint_path=args.checkpoint or None, alert=args.alert)
+    elif args.client_type == 'peer':
+        # No broker: secondaries dial this host's peer port
+        process_logs(args.broker, Config.PEER_PORT, args.topic, 'peer')
+    else:
+        process_logs(args.broker, args.port, args.topic, args.client_type,
+                     {**get_client_options(), **live_publisher_options(args.client_type)}, alert=args.alert)
+
+if __name__ == "__main__":
+    main()
@@ -25,22 +25,38 @@ def show_message(topic, payload):
     except:
         pass
 
+# Read the host's event ring when a local subscriber writes one, instead of
+# opening another broker connection
+client_type = Config.MQTT_CLIENT_TYPE
+client_options = {}
+try:
+    from mqtt_clients.nanomq_client import ring_available
+    if ring_available(Config.EVENT_RING):
+        client_type = 'ring'
+        client_options = {'ring': Config.EVENT_RING}
+except ImportError:
+    pass
+
 # Create subscriber
 subscriber = MQTTClientFactory.create_subscriber(
-    client_type=Config.MQTT_CLIENT_TYPE,
+    client_type=client_type,
     broker=Config.MQTT_BROKER,
     port=Config.MQTT_PORT,
     topic=Config.MQTT_TOPIC,
     key='current_desktop',
     value='*',  # Match anything
-    bell_func=None
+    bell_func=None,
+    **client_options
 )
 
 # Override message callback to just display
 subscriber._on_message = show_message
 subscriber.bell_func = lambda: None  # No beep
 
-print(f"Connected to {Config.MQTT_BROKER}:{Config.MQTT_PORT}")
+if client_type == 'ring':
+    print(f"Reading event ring {Config.EVENT_RING}")
+else:
+    print(f"Connected to {Config.MQTT_BROKER}:{Config.MQTT_PORT}")
 print(f"Watching topic: {Config.MQTT_TOPIC}")
 print("")
 
@@ -21,6 +21,8 @@ CHECK_INTERVAL=${WATCHDOG_CHECK_INTERVAL:-30}  # Check every 30 seconds
 MAX_RESTART_ATTEMPTS=${WATCHDOG_MAX_RESTARTS:-3}  # Max restarts within window
 RESTART_WINDOW=${WATCHDOG_RESTART_WINDOW:-300}  # 5 minute window
 BROKER_CHECK_TIMEOUT=${WATCHDOG_BROKER_TIMEOUT:-5}  # Broker connectivity timeout
+PRESENCE_CHECK_INTERVAL=${WATCHDOG_PRESENCE_INTERVAL:-300}  # Fleet presence query every 5 minutes
+RESTART_CONFIRM_TIMEOUT=${WATCHDOG_RESTART_CONFIRM_TIMEOUT:-15}  # Wait for an in-place restart to reconnect
 
 # Set defaults
 ROLE=${ROLE:-"secondary"}
@@ -29,6 +31,9 @@ MQTT_PORT=${MQTT_PORT:-"1883"}
 LOG_DIR=${LOG_DIR:-"./logs"}
 
 # Watchdog state
+PRESENCE_STATUS=3
+PRESENCE_OFFLINE=""
+PRESENCE_CHECKED_AT=0
 WATCHDOG_LOG="${LOG_DIR}/watchdog.log"
 RESTART_HISTORY_FILE="${LOG_DIR}/watchdog_restarts.log"
 PID_FILE="${LOG_DIR}/watchdog.pid"
@@ -74,13 +79,99 @@ cleanup() {
 
 trap cleanup EXIT INT TERM
 
+# Ask the broker for the fleet's presence (nanomq client with PRESENCE on).
+# Every client keeps a retained online message with an offline Last Will, so
+# one subscribe tells whether the broker is up and whether this host's
+# services still hold their sessions. Sets PRESENCE_OFFLINE to this host's
+# offline members and returns 0 (all online), 1 (some offline), 2 (broker
+# unreachable within BROKER_CHECK_TIMEOUT) or 3 (presence not available
+# here, or the query itself failed)
+check_presence() {
+    PRESENCE_OFFLINE=""
+    if [ "$MQTT_CLIENT_TYPE" != "nanomq" ] || [ "${PRESENCE:-false}" != "true" ]; then
+        return 3
+    fi
+
+    # Roles this host runs; in the combined runtime waldo.py does the alerting
+    local roles=""
+    if [ "$ROLE" = "primary" ]; then
+        roles="waldo"
+    fi
+    if [ -n "$TARGET_DESKTOP" ] && ! { [ "$ROLE" = "primary" ] && [ "${PRIMARY_RUNTIME:-separate}" = "combined" ]; }; then
+        roles="$roles found-him"
+    fi
+
+    local status=0
+    PRESENCE_OFFLINE=$(python3 - "$roles" "$BROKER_CHECK_TIMEOUT" 2>/dev/null <<'PYTHON_SCRIPT'
+import os
+import sys
+import time
+
+try:
+    from config import Config, get_client_options
+    from mqtt_clients.nanomq_client import NANOMQ_AVAILABLE, create_native_client
+except Exception:
+    sys.exit(3)
+if not NANOMQ_AVAILABLE:
+    sys.exit(3)
+
+roles = sys.argv[1].split()
+timeout = float(sys.argv[2])
+try:
+    options = get_client_options()
+    client = create_native_client(Config.MQTT_BROKER, Config.MQTT_PORT, options.get('tls'), options.get('tuning'))
+    client.watch_presence(Config.PRESENCE_TOPIC)
+    try:
+        if not client.connect(f"synergy-watchdog-{os.getpid()}", timeout_ms=int(timeout * 1000)):
+            sys.exit(2)
+    except RuntimeError:
+        sys.exit(2)
+    client.start_message_loop()
+
+    # The broker sends the retained states straight after the SUBSCRIBE
+    deadline = time.time() + min(timeout, 1.0)
+    expected = {f"{Config.PRESENCE_NAME}/{role}" for role in roles}
+    while time.time() < deadline and not expected <= set(client.presence()):
+        time.sleep(0.05)
+    fleet = client.presence()
+    client.disconnect()
+except Exception:
+    # A failed query says nothing about the services
+    sys.exit(3)
+
+offline = sorted(member for member in expected if member in fleet and not fleet[member]['online'])
+print(' '.join(offline))
+sys.exit(1 if offline else 0)
+PYTHON_SCRIPT
+) || status=$?
+    return $status
+}
+
 # Check if MQTT broker is reachable
 check_broker_availability() {
-    if nc -zv -w "$BROKER_CHECK_TIMEOUT" "$MQTT_BROKER" "$MQTT_PORT" > /dev/null 2>&1; then
-        return 0
-    else
+    # Brokerless peer mode: the primary is the publisher, secondaries probe it instead
+    if [ "$MQTT_CLIENT_TYPE" = "peer" ]; then
+        if [ "$ROLE" = "primary" ]; then
+            return 0
+        fi
+        nc -zv -w "$BROKER_CHECK_TIMEOUT" "${PEER_HOST:-$MQTT_BROKER}" "${PEER_PORT:-1885}" > /dev/null 2>&1
+        return
+    fi
+    if ! nc -zv -w "$BROKER_CHECK_TIMEOUT" "$MQTT_BROKER" "$MQTT_PORT" > /dev/null 2>&1; then
         return 1
     fi
+    # The presence query costs an interpreter and an MQTT session, so it runs
+    # every PRESENCE_CHECK_INTERVAL, and on every check while it reports a
+    # problem so the failure count can build up
+    local now=$(date +%s)
+    if [ "$PRESENCE_STATUS" = "1" ] || [ "$PRESENCE_STATUS" = "2" ] ||
+       [ $((now - PRESENCE_CHECKED_AT)) -ge "$PRESENCE_CHECK_INTERVAL" ]; then
+        PRESENCE_CHECKED_AT=$now
+        PRESENCE_STATUS=0
+        check_presence || PRESENCE_STATUS=$?
+    fi
+    # The port answered but the broker did not complete an MQTT session
+    [ "$PRESENCE_STATUS" != "2" ]
 }
 
 # Check if waldo.py is running (primary mode only)
@@ -95,11 +186,13 @@ check_waldo_running() {
     return 0  # Not needed for secondary
 }
 
-# Check if found-him.py is running
+# Check if found-him.py is running, or waldo.py alerts itself (combined primary runtime)
 check_found_him_running() {
     if [ -n "$TARGET_DESKTOP" ] && [ "$TARGET_DESKTOP" != "" ]; then
         if pgrep -f "python3 ./found-him.py" > /dev/null 2>&1; then
             return 0
+        elif pgrep -f "python3 ./waldo.py .*--alert" > /dev/null 2>&1; then
+            return 0
         else
             return 1
         fi
@@ -151,6 +244,62 @@ record_restart() {
     mv "$temp_file" "$RESTART_HISTORY_FILE" 2>/dev/null || true
 }
 
+# Wait for the broker if it's down
+wait_for_broker() {
+    if check_broker_availability; then
+        return 0
+    fi
+
+    log_warn "MQTT broker not available, waiting for it to come back online..."
+    local wait_count=0
+    local max_wait=60  # Wait up to 5 minutes (60 * 5s = 300s)
+
+    while [ $wait_count -lt $max_wait ]; do
+        sleep 5
+        if check_broker_availability; then
+            log_info "MQTT broker is back online"
+            return 0
+        fi
+        wait_count=$((wait_count + 1))
+    done
+
+    log_error "MQTT broker still unavailable after 5 minutes"
+    return 1
+}
+
+# SIGUSR1 the running services and wait for each to confirm it reconnected:
+# a service writes LOG_DIR/<name>.restarted once its in-place restart has a
+# connection again. Returns 1 if any of them did not confirm in time
+restart_in_place() {
+    local markers=()
+    local service
+    for service in waldo found-him; do
+        rm -f "${LOG_DIR}/${service}.restarted"
+        if pkill -USR1 -f "python3 ./${service}.py" 2>/dev/null; then
+            markers+=("${LOG_DIR}/${service}.restarted")
+        fi
+    done
+
+    local waited=0
+    local marker
+    while [ $waited -lt "$RESTART_CONFIRM_TIMEOUT" ]; do
+        sleep 1
+        waited=$((waited + 1))
+        local pending=0
+        for marker in "${markers[@]}"; do
+            [ -f "$marker" ] || pending=$((pending + 1))
+        done
+        if [ $pending -eq 0 ]; then
+            return 0
+        fi
+    done
+
+    for marker in "${markers[@]}"; do
+        [ -f "$marker" ] || log_warn "No in-place restart confirmation from $(basename "$marker" .restarted)"
+    done
+    return 1
+}
+
 # Restart services
 restart_services() {
     local reason="$1"
@@ -169,32 +318,25 @@ restart_services() {
 
     record_restart
 
-    # Stop existing services
-    log_info "Stopping existing services..."
-    ./stop.sh >> "$WATCHDOG_LOG" 2>&1 || true
-    sleep 2
-
-    # Wait for broker if it's down
-    if ! check_broker_availability; then
-        log_warn "MQTT broker not available, waiting for it to come back online..."
-        local wait_count=0
-        local max_wait=60  # Wait up to 5 minutes (60 * 5s = 300s)
-
-        while [ $wait_count -lt $max_wait ]; do
-            sleep 5
-            if check_broker_availability; then
-                log_info "MQTT broker is back online"
-                break
-            fi
-            wait_count=$((wait_count + 1))
-        done
+    # Processes that are still alive only lost the broker: once it is back,
+    # SIGUSR1 makes them reconnect in place on their existing sockets
+    if check_waldo_running && check_found_him_running; then
+        wait_for_broker || return 1
 
-        if [ $wait_count -ge $max_wait ]; then
-            log_error "MQTT broker still unavailable after 5 minutes"
-            return 1
+        log_info "Restarting connections in place..."
+        if restart_in_place; then
+            log_info "Services restarted in place"
+            return 0
         fi
+        log_warn "In-place restart not confirmed within ${RESTART_CONFIRM_TIMEOUT}s, restarting processes"
     fi
 
+    # Stop existing services (stop.sh waits for the processes to exit)
+    log_info "Stopping existing services..."
+    ./stop.sh >> "$WATCHDOG_LOG" 2>&1 || true
+
+    wait_for_broker || return 1
+
     # Start services
     log_info "Starting services..."
     ./start.sh >> "$WATCHDOG_LOG" 2>&1 &
@@ -231,6 +373,12 @@ monitor_services() {
             # Broker is available, check services
             local services_ok=true
 
+            # A live process whose session the broker gave up on (its will fired)
+            if [ "$PRESENCE_STATUS" = "1" ]; then
+                log_error "Offline in fleet presence: $PRESENCE_OFFLINE"
+                services_ok=false
+            fi
+
             # Check waldo.py (primary only)
             if [ "$ROLE" = "primary" ]; then
                 if ! check_waldo_running; then
@@ -251,7 +399,7 @@ monitor_services() {
                 consecutive_failures=$((consecutive_failures + 1))
 
                 if [ $consecutive_failures -ge $max_consecutive_failures ]; then
-                    restart_services "Service process(es) not running"
+                    restart_services "Service process(es) not running or disconnected"
                     consecutive_failures=0
                 fi
             else